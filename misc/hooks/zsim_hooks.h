@@ -14,6 +14,7 @@
 #define ZSIM_MAGIC_OP_HEARTBEAT         (1028)
 #define ZSIM_MAGIC_OP_WORK_BEGIN        (1029) //ubik
 #define ZSIM_MAGIC_OP_WORK_END          (1030) //ubik
+#define ZSIM_MAGIC_OP_CHECKPOINT        (1034)
 
 #ifdef __x86_64__
 #define HOOKS_STR  "HOOKS"
@@ -43,6 +44,11 @@ static inline void zsim_heartbeat() {
     zsim_magic_op(ZSIM_MAGIC_OP_HEARTBEAT);
 }
 
+//Saves or restores a checkpoint of warmed state at the end of the current phase (needs sim.checkpointAt = "Magic")
+static inline void zsim_checkpoint() {
+    zsim_magic_op(ZSIM_MAGIC_OP_CHECKPOINT);
+}
+
 static inline void zsim_work_begin() { zsim_magic_op(ZSIM_MAGIC_OP_WORK_BEGIN); }
 static inline void zsim_work_end() { zsim_magic_op(ZSIM_MAGIC_OP_WORK_END); }
 
@@ -24,6 +24,12 @@
  */
 
 #include "access_tracing.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "bithacks.h"
 
 // Concatenate HDF5 header path prefix with the header file names, because
@@ -42,7 +48,101 @@
 
 #define PT_CHUNKSIZE (1024*256u)  // 256K records (~6MB)
 
-AccessTraceReader::AccessTraceReader(std::string _fname) : fname(_fname.c_str()) {
+static const char NATIVE_MAGIC[8] = {'Z', 'S', 'I', 'M', 'T', 'R', 'C', '1'};
+
+// HDF5 is not thread-safe, and readers may decode in a background thread while writers dump
+static lock_t h5Lock = 0;
+
+// Starts reading [addr, addr+bytes) from disk asynchronously
+static void AdviseWillNeed(const void* addr, size_t bytes) {
+    uintptr_t pageMask = sysconf(_SC_PAGESIZE) - 1;
+    uintptr_t start = ((uintptr_t)addr) & ~pageMask;
+    madvise((void*)start, ((uintptr_t)addr) + bytes - start, MADV_WILLNEED);
+}
+
+static void WriteFully(int fd, const void* data, size_t bytes, off_t offset, const char* fname) {
+    const char* d = static_cast<const char*>(data);
+    while (bytes) {
+        ssize_t w = pwrite(fd, d, bytes, offset);
+        if (w <= 0) panic("Could not write trace file %s: %s", fname, strerror(errno));
+        d += w;
+        bytes -= w;
+        offset += w;
+    }
+}
+
+AccessTraceReader::AccessTraceReader(std::string _fname, TraceThreadSpawnFn spawn)
+    : fname(_fname.c_str()), records(nullptr), map(nullptr), mapBytes(0), curChunk(0), prefetch(false), stopDecoding(false)
+{
+    for (uint32_t i = 0; i < NUM_BUFS; i++) bufs[i] = nullptr;
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0) panic("Could not open trace file %s", fname.c_str());
+    char magic[sizeof(NATIVE_MAGIC)];
+    if (pread(fd, magic, sizeof(magic), 0) == sizeof(magic) && memcmp(magic, NATIVE_MAGIC, sizeof(magic)) == 0) {
+        openNative(fd);
+    } else {
+        openHDF5();
+    }
+    close(fd);
+
+    curFrameRecord = 0;
+    cur = 0;
+    max = chunkRecords(0);
+
+    if (records) {
+        buf = records;
+        if (max) AdviseWillNeed(records, (max + chunkRecords(1))*sizeof(PackedAccessRecord));
+        return;
+    }
+
+    prefetch = spawn && numRecords > max;
+    for (uint32_t i = 0; i < NUM_BUFS; i++) {
+        bufs[i] = (max && (i == 0 || prefetch))? gm_calloc<PackedAccessRecord>(max) : nullptr;
+        futex_init(&fullLocks[i]);
+        futex_lock(&fullLocks[i]);
+        futex_init(&emptyLocks[i]);
+    }
+    futex_lock(&emptyLocks[0]);  // chunk 0 is decoded here, and read first
+    buf = bufs[0];
+    if (max) decodeChunk(0, buf);
+    if (prefetch) {
+        futex_init(&decoderDone);
+        futex_lock(&decoderDone);
+        spawn(decodeThreadTrampoline, this);
+    }
+}
+
+AccessTraceReader::~AccessTraceReader() {
+    if (prefetch) {
+        // The decode thread is either decoding, or waiting for the buffer of the chunk we are reading (it is at most
+        // NUM_BUFS-1 chunks ahead, and all other buffers are free), so releasing that buffer lets it see stopDecoding
+        stopDecoding = true;
+        __sync_synchronize();
+        futex_unlock(&emptyLocks[curChunk % NUM_BUFS]);
+        futex_lock(&decoderDone);
+    }
+    for (uint32_t i = 0; i < NUM_BUFS; i++) if (bufs[i]) gm_free(bufs[i]);
+    if (map) munmap(map, mapBytes);
+}
+
+void AccessTraceReader::openNative(int fd) {
+    NativeTraceHeader hdr;
+    if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr)) panic("Trace file %s truncated", fname.c_str());
+    if (!hdr.finished) panic("Trace file %s unfinished (halted simulation?)", fname.c_str());
+    numRecords = hdr.numRecords;
+    numChildren = hdr.numChildren;
+
+    mapBytes = sizeof(hdr) + numRecords*sizeof(PackedAccessRecord);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < mapBytes) panic("Trace file %s truncated", fname.c_str());
+    map = mmap(nullptr, mapBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) panic("Could not mmap trace file %s: %s", fname.c_str(), strerror(errno));
+    madvise(map, mapBytes, MADV_SEQUENTIAL);
+    records = reinterpret_cast<PackedAccessRecord*>(static_cast<char*>(map) + sizeof(hdr));
+}
+
+void AccessTraceReader::openHDF5() {
+    futex_lock(&h5Lock);
     hid_t fid = H5Fopen(fname.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
     if (fid == H5I_INVALID_HID) panic("Could not open HDF5 file %s", fname.c_str());
 
@@ -65,17 +165,42 @@ AccessTraceReader::AccessTraceReader(std::string _fname) : fname(_fname.c_str())
     H5Aread(ncAttr, H5T_NATIVE_UINT, &numChildren);
     H5Aclose(ncAttr);
 
-    curFrameRecord = 0;
-    cur = 0;
-    max = MIN(PT_CHUNKSIZE, numRecords);
-    buf = max? gm_calloc<PackedAccessRecord>(max) : nullptr;
+    H5PTclose(table);
+    H5Fclose(fid);
+    futex_unlock(&h5Lock);
+}
 
-    if (max) {
-        H5PTread_packets(table, 0, max, buf);
-    }
+uint32_t AccessTraceReader::chunkRecords(uint64_t chunk) const {
+    uint64_t first = chunk*PT_CHUNKSIZE;
+    return (first < numRecords)? MIN(PT_CHUNKSIZE, numRecords - first) : 0;
+}
 
+void AccessTraceReader::decodeChunk(uint64_t chunk, PackedAccessRecord* dst) {
+    futex_lock(&h5Lock);
+    hid_t fid = H5Fopen(fname.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (fid == H5I_INVALID_HID) panic("Could not open HDF5 file %s", fname.c_str());
+    hid_t table = H5PTopen(fid, "accs");
+    if (table == H5I_INVALID_HID) panic("Could not open HDF5 packet table");
+    H5PTread_packets(table, chunk*PT_CHUNKSIZE, chunkRecords(chunk), dst);
     H5PTclose(table);
     H5Fclose(fid);
+    futex_unlock(&h5Lock);
+}
+
+void AccessTraceReader::decodeThreadTrampoline(void* arg) {
+    static_cast<AccessTraceReader*>(arg)->decodeLoop();
+}
+
+void AccessTraceReader::decodeLoop() {
+    uint64_t numChunks = (numRecords + PT_CHUNKSIZE - 1)/PT_CHUNKSIZE;
+    for (uint64_t c = 1; c < numChunks; c++) {
+        uint32_t b = c % NUM_BUFS;
+        futex_lock(&emptyLocks[b]);
+        if (stopDecoding) break;
+        decodeChunk(c, bufs[b]);
+        futex_unlock(&fullLocks[b]);
+    }
+    futex_unlock(&decoderDone);  // last access to this reader
 }
 
 void AccessTraceReader::nextChunk() {
@@ -83,22 +208,49 @@ void AccessTraceReader::nextChunk() {
     curFrameRecord += max;
 
     if (curFrameRecord < numRecords) {
+        curChunk++;
         cur = 0;
-        max = MIN(PT_CHUNKSIZE, numRecords - curFrameRecord);
-        hid_t fid = H5Fopen(fname.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
-        if (fid == H5I_INVALID_HID) panic("Could not open HDF5 file %s", fname.c_str());
-        hid_t table = H5PTopen(fid, "accs");
-        if (table == H5I_INVALID_HID) panic("Could not open HDF5 packet table");
-        H5PTread_packets(table, curFrameRecord, max, buf);
-        H5PTclose(table);
-        H5Fclose(fid);
+        max = chunkRecords(curChunk);
+        if (records) {
+            buf = records + curFrameRecord;
+            uint32_t nextMax = chunkRecords(curChunk + 1);
+            if (nextMax) AdviseWillNeed(buf + max, nextMax*sizeof(PackedAccessRecord));
+        } else if (prefetch) {
+            uint32_t b = curChunk % NUM_BUFS;
+            futex_unlock(&emptyLocks[(curChunk - 1) % NUM_BUFS]);  // done with the previous chunk's buffer
+            futex_lock(&fullLocks[b]);
+            buf = bufs[b];
+        } else {
+            decodeChunk(curChunk, buf);
+        }
     } else {
         assert_msg(curFrameRecord == numRecords, "%ld %ld", curFrameRecord, numRecords);  // aaand we're done
     }
 }
 
 
-AccessTraceWriter::AccessTraceWriter(g_string _fname, uint32_t numChildren) : fname(_fname) {
+AccessTraceWriter::AccessTraceWriter(g_string _fname, uint32_t _numChildren) : fname(_fname), numChildren(_numChildren), numRecords(0) {
+    size_t sfxLen = strlen(TRACE_NATIVE_SUFFIX);
+    native = fname.size() >= sfxLen && fname.compare(fname.size() - sfxLen, sfxLen, TRACE_NATIVE_SUFFIX) == 0;
+    if (native) {
+        int fd = open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) panic("Could not create trace file %s: %s", fname.c_str(), strerror(errno));
+        writeNativeHeader(fd, false);
+        close(fd);
+    } else {
+        futex_lock(&h5Lock);
+        createHDF5();
+        futex_unlock(&h5Lock);
+    }
+
+    // Initialize buffer
+    buf = gm_calloc<PackedAccessRecord>(PT_CHUNKSIZE);
+    cur = 0;
+    max = PT_CHUNKSIZE;
+    assert((uint32_t)(((char*) &buf[1]) - ((char*) &buf[0])) == sizeof(PackedAccessRecord));
+}
+
+void AccessTraceWriter::createHDF5() {
     // Create record structure
     hid_t accType = H5Tenum_create(H5T_NATIVE_USHORT);
     uint16_t val;
@@ -155,15 +307,41 @@ AccessTraceWriter::AccessTraceWriter(g_string _fname, uint32_t numChildren) : fn
     H5Aclose(fAttr);
 
     H5Fclose(fid);
+}
 
-    // Initialize buffer
-    buf = gm_calloc<PackedAccessRecord>(PT_CHUNKSIZE);
-    cur = 0;
-    max = PT_CHUNKSIZE;
-    assert((uint32_t)(((char*) &buf[1]) - ((char*) &buf[0])) == sizeof(PackedAccessRecord));
+void AccessTraceWriter::writeNativeHeader(int fd, bool finished) {
+    NativeTraceHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, NATIVE_MAGIC, sizeof(hdr.magic));
+    hdr.numChildren = numChildren;
+    hdr.finished = finished;
+    hdr.numRecords = numRecords;
+    WriteFully(fd, &hdr, sizeof(hdr), 0, fname.c_str());
 }
 
 void AccessTraceWriter::dump(bool cont) {
+    if (native) {
+        int fd = open(fname.c_str(), O_WRONLY);
+        if (fd < 0) panic("Could not open trace file %s: %s", fname.c_str(), strerror(errno));
+        WriteFully(fd, buf, cur*sizeof(PackedAccessRecord), sizeof(NativeTraceHeader) + numRecords*sizeof(PackedAccessRecord), fname.c_str());
+        numRecords += cur;
+        if (!cont) writeNativeHeader(fd, true);
+        close(fd);
+    } else {
+        futex_lock(&h5Lock);
+        dumpHDF5(cont);
+        futex_unlock(&h5Lock);
+    }
+
+    if (!cont) {
+        gm_free(buf);
+        buf = nullptr;
+        max = 0;
+    }
+    cur = 0;
+}
+
+void AccessTraceWriter::dumpHDF5(bool cont) {
     hid_t fid = H5Fopen(fname.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
     if (fid == H5I_INVALID_HID) panic("Could not open HDF5 file %s", fname.c_str());
     hid_t table = H5PTopen(fid, "accs");
@@ -176,13 +354,8 @@ void AccessTraceWriter::dump(bool cont) {
         uint32_t finished = 1;
         H5Awrite(fAttr, H5T_NATIVE_UINT, &finished);
         H5Aclose(fAttr);
-
-        gm_free(buf);
-        buf = nullptr;
-        max = 0;
     }
 
-    cur = 0;
     H5PTclose(table);
     H5Fclose(fid);
 }
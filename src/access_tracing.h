@@ -27,9 +27,14 @@
 #define ACCESS_TRACING_H_
 
 #include "g_std/g_string.h"
+#include "locks.h"
 #include "memory_hierarchy.h"
 
-/* HDF5-based classes read and write address traces in a consistent format */
+/* Classes to read and write address traces in a consistent format. Traces are stored in HDF5, or in a native
+ * binary format if the file name ends in TRACE_NATIVE_SUFFIX. Readers detect the format from the file's contents.
+ */
+
+#define TRACE_NATIVE_SUFFIX ".ztrace"
 
 struct AccessRecord {
     Address lineAddr;
@@ -47,9 +52,27 @@ struct PackedAccessRecord {
     uint16_t type;  // could be uint8_t, but causes corruption in HDF5? (wtf...)
 } /*__attribute__((packed))*/;  // 24 bytes --> no packing needed
 
+// Native format: this header, then numRecords PackedAccessRecords
+struct NativeTraceHeader {
+    char magic[8];
+    uint32_t numChildren;
+    uint32_t finished;
+    uint64_t numRecords;
+    uint64_t reserved;
+};
+
+// Starts a thread that runs fn(arg). Readers use it to decode ahead; it is a parameter because Pin tools must use Pin's threads.
+typedef void (*TraceThreadSpawnFn)(void (*fn)(void*), void* arg);
 
+/* Reads a trace in chunks. Native traces are mmapped and read in place, with readahead hints for the next
+ * chunk. HDF5 chunks are decoded into buffers; if given a spawn function, the reader decodes the next chunks
+ * in a background thread, so read() only blocks if it is faster than decoding. Destruction stops and waits for
+ * that thread, so readers can be destroyed at any point of the trace.
+ */
 class AccessTraceReader {
     private:
+        static const uint32_t NUM_BUFS = 3;  // HDF5 chunk buffers; with prefetching, up to NUM_BUFS-1 chunks are decoded ahead
+
         PackedAccessRecord* buf;
         uint32_t cur;
         uint32_t max;
@@ -59,8 +82,23 @@ class AccessTraceReader {
         uint64_t numRecords;
         uint32_t numChildren; //i.e., how many parallel streams does this file contain?
 
+        // Native traces
+        PackedAccessRecord* records;  // nullptr if HDF5
+        void* map;
+        size_t mapBytes;
+
+        // HDF5 traces. bufs[i] holds chunks i, i + NUM_BUFS, ...
+        PackedAccessRecord* bufs[NUM_BUFS];
+        lock_t fullLocks[NUM_BUFS];  // unlocked when bufs[i] has been decoded
+        lock_t emptyLocks[NUM_BUFS];  // unlocked when bufs[i] has been read, and can be refilled
+        uint64_t curChunk;
+        bool prefetch;
+        volatile bool stopDecoding;  // set on destruction; the decode thread exits at its next chunk
+        lock_t decoderDone;  // unlocked when the decode thread exits
+
     public:
-        AccessTraceReader(std::string fname);
+        explicit AccessTraceReader(std::string fname, TraceThreadSpawnFn spawn = nullptr);
+        ~AccessTraceReader();
 
         inline bool empty() const {return (cur == max);}
         uint32_t getNumChildren() const {return numChildren;}
@@ -75,7 +113,15 @@ class AccessTraceReader {
         }
 
     private:
+        void openNative(int fd);
+        void openHDF5();
+
         void nextChunk();
+        uint32_t chunkRecords(uint64_t chunk) const;
+        void decodeChunk(uint64_t chunk, PackedAccessRecord* dst);
+
+        static void decodeThreadTrampoline(void* arg);
+        void decodeLoop();
 };
 
 class AccessTraceWriter : public GlobAlloc {
@@ -84,6 +130,9 @@ class AccessTraceWriter : public GlobAlloc {
         uint32_t cur;
         uint32_t max;
         g_string fname;
+        bool native;
+        uint32_t numChildren;
+        uint64_t numRecords;  // dumped so far, native traces only
 
     public:
         AccessTraceWriter(g_string fname, uint32_t numChildren);
@@ -97,6 +146,11 @@ class AccessTraceWriter : public GlobAlloc {
         }
 
         void dump(bool cont);
+
+    private:
+        void createHDF5();
+        void dumpHDF5(bool cont);
+        void writeNativeHeader(int fd, bool finished);
 };
 
 #endif  // _ACCESS_TRACING_H
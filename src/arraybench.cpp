@@ -0,0 +1,215 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Cache array lookup microbenchmark. Fills 4-, 8-, 16- and 32-way SetAssocArrays and ZArrays (H3-hashed,
+ * as init.cpp builds them) with random lines, then measures lookups per second on a mix of hits and
+ * misses. SetAssocArrays are measured with every tag comparison kernel the host supports (scalar,
+ * SSE4.1, AVX2), so vector kernels can be compared against the scalar baseline. For zcaches, it also
+ * measures computing all ways' hashes with hashAll() vs one hash() call per way.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "cache_arrays.h"
+#include "coherence_ctrls.h"
+#include "constants.h"
+#include "galloc.h"
+#include "hash.h"
+#include "log.h"
+#include "mtrand.h"
+#include "profile_stats.h"
+#include "repl_policies.h"
+#include "simd.h"
+#include "zsim.h"
+
+using namespace std;
+
+// Referenced by checkpointing code in the cache arrays, which this benchmark never uses
+GlobSimInfo* zinfo = nullptr;
+uint32_t lineBits = 6;
+
+static const uint32_t NUM_ADDRS = 1 << 20;  // lookup addresses, cycled through
+static const uint32_t WAYS[] = {4, 8, 16, 32};
+
+// Coherence controller stand-in that only tracks which lines are valid (for LRU)
+class BenchCC : public CC {
+    private:
+        vector<bool> valid;
+
+    public:
+        explicit BenchCC(uint32_t numLines) : valid(numLines, false) {}
+
+        void setValid(uint32_t lineId) { valid[lineId] = true; }
+
+        void setParents(uint32_t childId, const g_vector<MemObject*>& parents, Network* network) {}
+        void setChildren(const g_vector<BaseCache*>& children, Network* network) {}
+        void initStats(AggregateStat* cacheStat) {}
+
+        bool startAccess(MemReq& req) { return false; }
+        bool shouldAllocate(const MemReq& req) { return true; }
+        uint64_t processEviction(const MemReq& triggerReq, Address wbLineAddr, int32_t lineId, uint64_t startCycle) { return startCycle; }
+        uint64_t processAccess(const MemReq& req, int32_t lineId, uint64_t startCycle, uint64_t* getDoneCycle = nullptr) { return startCycle; }
+        void endAccess(const MemReq& req) {}
+
+        void startInv(const InvReq& req) {}
+        uint64_t processInv(const InvReq& req, int32_t lineId, uint64_t startCycle) { return startCycle; }
+
+        uint32_t numSharers(uint32_t lineId) { return 0; }
+        bool isValid(uint32_t lineId) { return valid[lineId]; }
+
+        void saveState(CheckpointWriter& cw, const std::string& name) {}
+        void restoreState(CheckpointReader& cr, const std::string& name) {}
+};
+
+static Address RandLine(MTRand& rng) {
+    return 1 + ((((uint64_t)rng.randInt()) << 32) | rng.randInt()) % (1ul << 42);
+}
+
+// Fills the array with random lines, and returns a lookup stream with the given fraction of hits
+static vector<Address> Fill(CacheArray* array, BenchCC* cc, uint32_t numLines, uint32_t hitPct, MTRand& rng) {
+    MESIState state = I;
+    MemReq req = {0, GETS, 0, &state, 0, nullptr, state, 0, 0};
+    vector<Address> inserted;
+    for (uint32_t i = 0; i < numLines; i++) {
+        Address lineAddr = RandLine(rng);
+        req.lineAddr = lineAddr;
+        Address wbLineAddr;
+        uint32_t lineId = array->preinsert(lineAddr, &req, &wbLineAddr);
+        array->postinsert(lineAddr, &req, lineId);
+        cc->setValid(lineId);
+        inserted.push_back(lineAddr);
+    }
+
+    // Zcaches may have evicted some inserted lines, so only look up the ones still there
+    vector<Address> resident;
+    for (Address lineAddr : inserted) {
+        if (array->lookup(lineAddr, &req, false) != -1) resident.push_back(lineAddr);
+    }
+    if (resident.empty()) panic("Nothing resident after fill");
+
+    vector<Address> addrs(NUM_ADDRS);
+    for (Address& a : addrs) {
+        a = (rng.randInt(99) < hitPct)? resident[rng.randInt(resident.size() - 1)] : RandLine(rng);
+    }
+    return addrs;
+}
+
+// Returns Mlookups/s
+static double Lookups(CacheArray* array, const vector<Address>& addrs, uint64_t numLookups, uint64_t& hits) {
+    MESIState state = I;
+    MemReq req = {0, GETS, 0, &state, 0, nullptr, state, 0, 0};
+    hits = 0;
+    uint64_t startNs = getNs();
+    for (uint64_t i = 0; i < numLookups; i++) {
+        hits += array->lookup(addrs[i % NUM_ADDRS], &req, false) != -1;
+    }
+    uint64_t ns = getNs() - startNs;
+    return 1e3*numLookups/ns;
+}
+
+// Returns Maddresses/s, computing all ways' hashes either with hashAll() or with hash() per way
+static double Hashes(HashFamily* hf, uint32_t ways, const vector<Address>& addrs, uint64_t numAddrs, bool all, uint64_t& checksum) {
+    uint64_t hashes[MAX_ZARRAY_WAYS];
+    checksum = 0;
+    uint64_t startNs = getNs();
+    for (uint64_t i = 0; i < numAddrs; i++) {
+        Address lineAddr = addrs[i % NUM_ADDRS];
+        if (all) {
+            hf->hashAll(lineAddr, ways, hashes);
+        } else {
+            for (uint32_t w = 0; w < ways; w++) hashes[w] = hf->hash(w, lineAddr);
+        }
+        for (uint32_t w = 0; w < ways; w++) checksum += hashes[w];
+    }
+    uint64_t ns = getNs() - startNs;
+    return 1e3*numAddrs/ns;
+}
+
+int main(int argc, const char* argv[]) {
+    InitLog(""); //no log header
+    if (argc > 4) {
+        info("Measures SetAssocArray and ZArray lookups per second for 4, 8, 16 and 32 ways");
+        info("Usage: %s [<size KB> (default 2048)] [<Mlookups> (default 20)] [<hit %%> (default 50)]", argv[0]);
+        exit(1);
+    }
+
+    uint32_t sizeKB = (argc >= 2)? strtoul(argv[1], nullptr, 0) : 2048;
+    uint64_t numLookups = ((argc >= 3)? strtoul(argv[2], nullptr, 0) : 20)*1000000ul;
+    uint32_t hitPct = (argc >= 4)? strtoul(argv[3], nullptr, 0) : 50;
+
+    uint32_t numLines = (sizeKB*1024) >> lineBits;
+    for (uint32_t ways : WAYS) {
+        if (numLines % ways || !isPow2(numLines/ways)) panic("%d KB does not give a power of 2 sets with %d ways", sizeKB, ways);
+    }
+
+    gm_init((32<<20) + 2*3*numLines*64 /*ample for arrays, policies and hash tables*/);
+
+    SimdLevel simd = HostSimdLevel();
+    info("%d KB arrays, %ld Mlookups, %d%% hits, host kernels: %s", sizeKB, numLookups/1000000, hitPct,
+            (simd == SIMD_AVX2)? "AVX2" : (simd == SIMD_SSE4)? "SSE4.1" : "scalar");
+    info("%10s %6s %14s %8s", "array", "ways", "Mlookups/s", "hit %");
+
+    MTRand rng(0xA77A7);
+    for (uint32_t z = 0; z < 2; z++) {
+        for (uint32_t ways : WAYS) {
+            uint32_t setBits = 31 - __builtin_clz(numLines/ways);
+            ReplPolicy* rp = new LRUReplPolicy<false>(numLines);
+            BenchCC* cc = new BenchCC(numLines);
+            rp->setCC(cc);
+            uint64_t hits;
+            if (z) {
+                CacheArray* array = new ZArray(numLines, ways, 4*ways, rp, new H3HashFamily(ways, setBits, 0xCAC7EAFFA1));
+                vector<Address> addrs = Fill(array, cc, numLines, hitPct, rng);
+                double rate = Lookups(array, addrs, numLookups, hits);
+                info("%10s %6d %14.2f %8.1f", "Z", ways, rate, 100.0*hits/numLookups);
+            } else {
+                SetAssocArray* array = new SetAssocArray(numLines, ways, rp, new H3HashFamily(1, setBits, 0xCAC7EAFFA1));
+                vector<Address> addrs = Fill(array, cc, numLines, hitPct, rng);
+                for (uint32_t level = SIMD_NONE; level <= (uint32_t)simd; level++) {
+                    array->setSimdLevel((SimdLevel)level);
+                    double rate = Lookups(array, addrs, numLookups, hits);
+                    const char* name = (level == SIMD_AVX2)? "SA-AVX2" : (level == SIMD_SSE4)? "SA-SSE4.1" : "SA-scalar";
+                    info("%10s %6d %14.2f %8.1f", name, ways, rate, 100.0*hits/numLookups);
+                }
+            }
+        }
+    }
+
+    // Hashing alone: the bulk of ZArray lookup cost
+    info("%10s %6s %14s %14s", "H3 funcs", "", "hashAll Ma/s", "hash() Ma/s");
+    for (uint32_t ways : WAYS) {
+        HashFamily* hf = new H3HashFamily(ways, 31 - __builtin_clz(numLines/ways), 0xCAC7EAFFA1);
+        vector<Address> addrs(NUM_ADDRS);
+        for (Address& a : addrs) a = RandLine(rng);
+        uint64_t numAddrs = numLookups/ways;
+        uint64_t sumAll, sumEach;
+        double rateAll = Hashes(hf, ways, addrs, numAddrs, true, sumAll);
+        double rateEach = Hashes(hf, ways, addrs, numAddrs, false, sumEach);
+        if (sumAll != sumEach) panic("hashAll() and hash() disagree with %d functions", ways);
+        info("%10d %6s %14.2f %14.2f", ways, "", rateAll, rateEach);
+    }
+    return 0;
+}
@@ -0,0 +1,376 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bbl_cache.h"
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_set>
+#include "bithacks.h"
+#include "core.h"
+#include "log.h"
+
+#define BBL_CACHE_MAGIC 0x31304342424c535aL  // "ZSLBBC01"
+
+/* File layout: Header, then numRecords variable-size records. Decoded uops depend on the
+ * decoder, so the header is tagged with the identity of the libzsim.so that wrote it; a
+ * rebuilt simulator discards the whole file.
+ */
+struct BblCacheHeader {
+    uint64_t magic;
+    uint32_t uopBytes;  // sizeof(DynUop)
+    uint32_t recordBytes;  // sizeof(Record)
+    uint64_t toolHash;
+    uint64_t numRecords;
+};
+
+static inline uint64_t fnv1a(const void* data, size_t len, uint64_t h = 0xcbf29ce484222325L) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3L;
+    }
+    return h;
+}
+
+// Hashes the name and identity of a file; returns 0 if the file cannot be stat'd
+static uint64_t hashFile(const char* name) {
+    struct stat st;
+    if (stat(name, &st) != 0) return 0;
+    uint64_t h = fnv1a(name, strlen(name));
+    h = fnv1a(&st.st_dev, sizeof(st.st_dev), h);
+    h = fnv1a(&st.st_ino, sizeof(st.st_ino), h);
+    h = fnv1a(&st.st_size, sizeof(st.st_size), h);
+    h = fnv1a(&st.st_mtime, sizeof(st.st_mtime), h);
+    return h;
+}
+
+static uint64_t getToolHash() {
+    Dl_info dlInfo;
+    if (!dladdr(reinterpret_cast<void*>(&getToolHash), &dlInfo) || !dlInfo.dli_fname) return 0;
+    return hashFile(dlInfo.dli_fname);
+}
+
+BblCache::BblCache(const char* _path) : path(_path), map(nullptr), mapBytes(0), numFlushed(0) {
+    futex_init(&lock);
+    hits = misses = stale = 0;
+    missDecodeNs = 0;
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        info("BBL cache %s does not exist, will be created", path.c_str());
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        mapBytes = st.st_size;
+        map = mmap(nullptr, mapBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            warn("BBL cache %s: mmap failed, ignoring it", path.c_str());
+            map = nullptr;
+            mapBytes = 0;
+        }
+    }
+    close(fd);
+    if (!map) return;
+
+    std::vector<const Record*> records;
+    if (!parse(static_cast<const uint8_t*>(map), mapBytes, records)) {
+        warn("BBL cache %s is invalid or was produced by a different build, ignoring it", path.c_str());
+        munmap(map, mapBytes);
+        map = nullptr;
+        mapBytes = 0;
+        return;
+    }
+
+    for (const Record* r : records) entries[r->key] = {r, false};
+    info("BBL cache %s: loaded %ld records", path.c_str(), records.size());
+}
+
+BblCache::~BblCache() {
+    if (map) munmap(map, mapBytes);
+    for (uint8_t* r : newRecords) free(r);
+}
+
+bool BblCache::parse(const uint8_t* buf, size_t len, std::vector<const Record*>& records) {
+    if (len < sizeof(BblCacheHeader)) return false;
+    const BblCacheHeader* hdr = reinterpret_cast<const BblCacheHeader*>(buf);
+    if (hdr->magic != BBL_CACHE_MAGIC || hdr->uopBytes != sizeof(DynUop) || hdr->recordBytes != sizeof(Record)) return false;
+    if (hdr->toolHash != getToolHash()) return false;
+
+    size_t pos = sizeof(BblCacheHeader);
+    for (uint64_t i = 0; i < hdr->numRecords; i++) {
+        if (pos + sizeof(Record) > len) return false;
+        const Record* r = reinterpret_cast<const Record*>(buf + pos);
+        size_t sz = Record::size(r->uops);
+        if (pos + sz > len) return false;
+        records.push_back(r);
+        pos += sz;
+    }
+    return pos == len;
+}
+
+// Image hashes are computed once per image and process
+static std::unordered_map<uint32_t, uint64_t> imgHashes;  // IMG_Id -> image hash
+static lock_t imgHashesLock = 0;
+
+bool GetBblKey(BBL bbl, uint32_t instrs, uint32_t bytes, BblKey& key) {
+    ADDRINT addr = BBL_Address(bbl);
+    IMG img = IMG_FindByAddress(addr);
+    if (!IMG_Valid(img)) return false;
+
+    uint32_t id = IMG_Id(img);
+    futex_lock(&imgHashesLock);
+    auto it = imgHashes.find(id);
+    if (it == imgHashes.end()) it = imgHashes.insert(std::make_pair(id, hashFile(IMG_Name(img).c_str()))).first;
+    key.imgHash = it->second;
+    futex_unlock(&imgHashesLock);
+    if (!key.imgHash) return false;
+
+    key.offset = addr - IMG_LowAddress(img);
+    key.instrs = instrs;
+    key.bytes = bytes;
+    return true;
+}
+
+uint64_t HashBblCode(ADDRINT addr, uint32_t bytes) {
+    // BBLs can be large, so copy and hash in chunks (FNV-1a is sequential, so this matches hashing all bytes at once)
+    uint8_t buf[256];
+    uint64_t h = fnv1a(nullptr, 0);
+    for (uint32_t off = 0; off < bytes; off += sizeof(buf)) {
+        size_t len = MIN(sizeof(buf), bytes - off);
+        size_t copied = PIN_SafeCopy(buf, reinterpret_cast<VOID*>(addr + off), len);
+        h = fnv1a(buf, copied, h);
+        if (copied < len) break;  // unreadable code, hash what we could read
+    }
+    return h;
+}
+
+// Allocates a BblInfo for the BBL at addr with the given decoded uops
+static BblInfo* makeBblInfo(ADDRINT addr, uint32_t instrs, uint32_t bytes, uint32_t uops, uint32_t approxInstrs, const DynUop* uopArray) {
+    uint32_t objBytes = offsetof(BblInfo, oooBbl) + DynBbl::bytes(uops);
+    BblInfo* bblInfo = static_cast<BblInfo*>(gm_malloc(objBytes));  // can't use type-safe interface
+    DynBbl& dynBbl = bblInfo->oooBbl[0];
+    dynBbl.addr = addr;
+    dynBbl.uops = uops;
+    dynBbl.approxInstrs = approxInstrs;
+    memcpy(dynBbl.uop, uopArray, sizeof(DynUop)*uops);
+    bblInfo->instrs = instrs;
+    bblInfo->bytes = bytes;
+    return bblInfo;
+}
+
+BblInfo* BblCache::lookup(BBL bbl, const BblKey& key) {
+    futex_lock(&lock);
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        misses++;
+        futex_unlock(&lock);
+        return nullptr;
+    }
+
+    Entry& e = it->second;
+    if (!e.validated) {
+        // Lazy validation: the image may have been rebuilt in place with the same size and mtime, or patched
+        if (HashBblCode(BBL_Address(bbl), key.bytes) != e.rec->codeHash) {
+            entries.erase(it);  // will be replaced by insert()
+            stale++;
+            misses++;
+            futex_unlock(&lock);
+            return nullptr;
+        }
+        e.validated = true;
+    }
+    const Record* r = e.rec;
+    hits++;
+    futex_unlock(&lock);
+
+    return makeBblInfo(BBL_Address(bbl), key.instrs, key.bytes, r->uops, r->approxInstrs, r->uopArray());
+}
+
+void BblCache::insert(BBL bbl, const BblKey& key, const BblInfo* bblInfo, uint64_t decodeNs) {
+    futex_lock(&lock);
+    missDecodeNs += decodeNs;
+    if (entries.count(key)) {
+        futex_unlock(&lock);
+        return;
+    }
+
+    const DynBbl& dynBbl = bblInfo->oooBbl[0];
+    uint8_t* buf = static_cast<uint8_t*>(malloc(Record::size(dynBbl.uops)));
+    Record* r = reinterpret_cast<Record*>(buf);
+    r->key = key;
+    r->codeHash = HashBblCode(BBL_Address(bbl), key.bytes);
+    r->uops = dynBbl.uops;
+    r->approxInstrs = dynBbl.approxInstrs;
+    memcpy(buf + sizeof(Record), dynBbl.uop, sizeof(DynUop)*dynBbl.uops);
+
+    newRecords.push_back(buf);
+    entries[key] = {r, true};
+    futex_unlock(&lock);
+}
+
+void BblCache::flush(uint64_t instrNs) {
+    futex_lock(&lock);
+
+    info("BBL cache %s: %ld hits, %ld misses (%ld stale); %.3f s instrumenting, %.3f s of it decoding misses",
+            path.c_str(), hits, misses, stale, instrNs/1e9, missDecodeNs/1e9);
+
+    if (numFlushed == newRecords.size()) {
+        futex_unlock(&lock);
+        return;
+    }
+
+    // Other processes may share the file; serialize read-merge-rename cycles
+    std::string lockPath = path + ".lock";
+    int lockFd = open(lockPath.c_str(), O_RDWR | O_CREAT, 0644);
+    if (lockFd < 0 || flock(lockFd, LOCK_EX) != 0) {
+        warn("BBL cache %s: could not lock %s, not saving %ld new records", path.c_str(), lockPath.c_str(), newRecords.size() - numFlushed);
+        if (lockFd >= 0) close(lockFd);
+        futex_unlock(&lock);
+        return;
+    }
+
+    // Re-read the current file, since it may have changed since we mapped it
+    std::vector<uint8_t> cur;
+    std::vector<const Record*> curRecords;
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            cur.resize(st.st_size);
+            size_t pos = 0;
+            while (pos < cur.size()) {
+                ssize_t r = read(fd, &cur[pos], cur.size() - pos);
+                if (r <= 0) break;
+                pos += r;
+            }
+            if (pos != cur.size() || !parse(&cur[0], cur.size(), curRecords)) curRecords.clear();  // drop invalid/stale file
+        }
+        close(fd);
+    }
+
+    // Our records replace any (possibly stale) ones with the same key
+    std::unordered_set<BblKey, BblKeyHash> newKeys;
+    for (size_t i = numFlushed; i < newRecords.size(); i++) newKeys.insert(reinterpret_cast<const Record*>(newRecords[i])->key);
+    std::vector<const Record*> kept;
+    for (const Record* r : curRecords) if (!newKeys.count(r->key)) kept.push_back(r);
+    size_t added = newKeys.size();
+
+    std::string tmpPath = path + ".tmp." + std::to_string(getpid());
+    FILE* f = fopen(tmpPath.c_str(), "w");
+    if (!f) {
+        warn("BBL cache %s: could not open %s, not saving %ld new records", path.c_str(), tmpPath.c_str(), added);
+    } else {
+        BblCacheHeader hdr;
+        hdr.magic = BBL_CACHE_MAGIC;
+        hdr.uopBytes = sizeof(DynUop);
+        hdr.recordBytes = sizeof(Record);
+        hdr.toolHash = getToolHash();
+        hdr.numRecords = kept.size() + added;
+
+        bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+        for (const Record* r : kept) ok = ok && fwrite(r, Record::size(r->uops), 1, f) == 1;
+        for (size_t i = numFlushed; i < newRecords.size(); i++) {
+            const Record* r = reinterpret_cast<const Record*>(newRecords[i]);
+            ok = ok && fwrite(r, Record::size(r->uops), 1, f) == 1;
+        }
+        ok = (fclose(f) == 0) && ok;
+
+        if (ok && rename(tmpPath.c_str(), path.c_str()) == 0) {
+            info("BBL cache %s: saved %ld new records, %ld total", path.c_str(), added, hdr.numRecords);
+        } else {
+            warn("BBL cache %s: write failed, not saving %ld new records", path.c_str(), added);
+            unlink(tmpPath.c_str());
+        }
+    }
+
+    numFlushed = newRecords.size();  // entries still point to them, so they stay allocated
+
+    flock(lockFd, LOCK_UN);
+    close(lockFd);
+    futex_unlock(&lock);
+}
+
+SharedBblTable::SharedBblTable(uint32_t numBuckets) {
+    assert(isPow2(numBuckets));
+    buckets = gm_calloc<Node* volatile>(numBuckets);
+    bucketMask = numBuckets - 1;
+    hits = copies = inserts = 0;
+}
+
+void SharedBblTable::initStats(AggregateStat* parentStat) {
+    AggregateStat* tableStat = new AggregateStat();
+    tableStat->init("bblTable", "Shared decoded-BBL table stats");
+    ProxyStat* hitsStat = new ProxyStat();
+    hitsStat->init("hits", "Lookups that found a BBL decoded by any process", const_cast<uint64_t*>(&hits));
+    ProxyStat* copiesStat = new ProxyStat();
+    copiesStat->init("copies", "Hits on BBLs at a different address, which were copied", const_cast<uint64_t*>(&copies));
+    ProxyStat* insertsStat = new ProxyStat();
+    insertsStat->init("inserts", "Decoded BBLs inserted", const_cast<uint64_t*>(&inserts));
+    tableStat->append(hitsStat);
+    tableStat->append(copiesStat);
+    tableStat->append(insertsStat);
+    parentStat->append(tableStat);
+}
+
+BblInfo* SharedBblTable::lookup(BBL bbl, const BblKey& key) {
+    uint64_t codeHash = 0;  // computed on the first key match
+    for (Node* n = buckets[BblKeyHash()(key) & bucketMask]; n; n = n->next) {
+        if (!(n->key == key)) continue;
+        if (!codeHash) codeHash = HashBblCode(BBL_Address(bbl), key.bytes);
+        if (n->codeHash != codeHash) continue;  // same image file, different code (e.g., patched)
+
+        __sync_fetch_and_add(&hits, 1);
+        BblInfo* bblInfo = n->bblInfo;
+        const DynBbl& dynBbl = bblInfo->oooBbl[0];
+        if (dynBbl.addr == BBL_Address(bbl)) return bblInfo;
+
+        __sync_fetch_and_add(&copies, 1);
+        return makeBblInfo(BBL_Address(bbl), key.instrs, key.bytes, dynBbl.uops, dynBbl.approxInstrs, dynBbl.uop);
+    }
+    return nullptr;
+}
+
+void SharedBblTable::insert(BBL bbl, const BblKey& key, BblInfo* bblInfo) {
+    Node* n = new Node();
+    n->key = key;
+    n->codeHash = HashBblCode(BBL_Address(bbl), key.bytes);
+    n->bblInfo = bblInfo;
+
+    Node* volatile* bucket = &buckets[BblKeyHash()(key) & bucketMask];
+    do {
+        n->next = *bucket;
+    } while (!__sync_bool_compare_and_swap(bucket, n->next, n));  // full barrier, so n is visible before it is linked
+    __sync_fetch_and_add(&inserts, 1);
+}
@@ -0,0 +1,179 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBL_CACHE_H_
+#define BBL_CACHE_H_
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "decoder.h"
+#include "galloc.h"
+#include "locks.h"
+#include "pin.H"
+#include "stats.h"
+
+/* Process-independent identity of a BBL: (image, offset in image, instrs, bytes). Images are
+ * identified by a hash of their path and file identity (device, inode, size, mtime).
+ */
+struct BblKey {
+    uint64_t imgHash;
+    uint64_t offset;
+    uint32_t instrs;
+    uint32_t bytes;
+
+    bool operator==(const BblKey& k) const {
+        return imgHash == k.imgHash && offset == k.offset && instrs == k.instrs && bytes == k.bytes;
+    }
+};
+
+struct BblKeyHash {
+    size_t operator()(const BblKey& k) const {
+        return (k.imgHash ^ (k.offset * 0x9E3779B97F4A7C15L)) + k.instrs*31 + k.bytes;
+    }
+};
+
+// Returns false if the BBL is not backed by an image (e.g., JIT'd code). Call with the client lock held (as in instrumentation).
+bool GetBblKey(BBL bbl, uint32_t instrs, uint32_t bytes, BblKey& key);
+
+// Hash of the BBL's code bytes, used to validate records
+uint64_t HashBblCode(ADDRINT addr, uint32_t bytes);
+
+/* Persistent on-disk cache of OOO-decoded BBLs.
+ *
+ * Decoding is a large fraction of instrumentation time, and most runs decode
+ * the same binaries and libraries over and over. This cache stores decoded
+ * DynBbls keyed by (image, offset in image, instrs, bytes), so they survive
+ * across runs. The file is mmapped read-only at startup; records are checked
+ * lazily, on first lookup, against a hash of the live code bytes, so stale
+ * records (e.g., from a recompiled binary) are simply treated as misses.
+ * Newly decoded BBLs are buffered and merged into the file on flush().
+ *
+ * Code not backed by an image (e.g., JIT'd code) is never cached.
+ *
+ * The cache is process-local (holds mmap'd pointers); each process opens its
+ * own. Concurrent flushes from several processes are serialized with a lock
+ * file, and the file is replaced atomically through rename().
+ */
+class BblCache {
+    private:
+        // On-disk record, followed by uops DynUops. Records are 8-byte aligned.
+        struct Record {
+            BblKey key;
+            uint64_t codeHash;  // hash of the BBL's code bytes
+            uint32_t uops;
+            uint32_t approxInstrs;
+
+            static uint32_t size(uint32_t uops) {
+                return sizeof(Record) + sizeof(DynUop)*uops;
+            }
+            const DynUop* uopArray() const {
+                return reinterpret_cast<const DynUop*>(this + 1);
+            }
+        };
+
+        struct Entry {
+            const Record* rec;
+            bool validated;
+        };
+
+        std::string path;
+
+        // Mapped file, if any
+        void* map;
+        size_t mapBytes;
+
+        std::unordered_map<BblKey, Entry, BblKeyHash> entries;  // both mapped and new records
+        std::vector<uint8_t*> newRecords;  // malloc'd, written on flush()
+        size_t numFlushed;  // newRecords[0..numFlushed) are already on disk
+
+        lock_t lock;
+
+        // Profiling, reported on flush()
+        uint64_t hits, misses, stale;
+        uint64_t missDecodeNs;
+
+    public:
+        explicit BblCache(const char* _path);
+        ~BblCache();
+
+        /* On a hit, returns a gm-allocated BblInfo equivalent to what Decoder::decodeBbl(bbl, true) would produce.
+         * key must come from GetBblKey(bbl, ...).
+         * On a miss, returns nullptr; the caller should decode and insert() the result.
+         */
+        BblInfo* lookup(BBL bbl, const BblKey& key);
+
+        // decodeNs is the time it took to decode the BBL, reported on flush()
+        void insert(BBL bbl, const BblKey& key, const BblInfo* bblInfo, uint64_t decodeNs);
+
+        /* Merges new records into the file and reports statistics, including instrNs, the time this process has
+         * spent instrumenting code so far (compare a run with a cold cache against one with a warm cache to see the
+         * savings). Can be called multiple times.
+         */
+        void flush(uint64_t instrNs);
+
+    private:
+        // Parses a mapped cache file into entries; returns false if the file is invalid or stale
+        static bool parse(const uint8_t* buf, size_t len, std::vector<const Record*>& records);
+};
+
+/* Decoded-BBL table shared by all simulated processes, in the global heap.
+ *
+ * Forked workers instrument the same libc and shared-library BBLs; with this
+ * table, only the first process decodes each one. Lookups are lock-free:
+ * buckets are singly-linked lists of immutable nodes, and inserts CAS the new
+ * node at the bucket head (two processes racing on the same BBL may both
+ * insert it, which is harmless). BblInfos are shared directly when the BBL is
+ * at the same address (e.g., after fork), and copied otherwise, since DynBbl
+ * holds the absolute address.
+ */
+class SharedBblTable : public GlobAlloc {
+    private:
+        struct Node : public GlobAlloc {
+            BblKey key;
+            uint64_t codeHash;
+            BblInfo* bblInfo;
+            Node* next;
+        };
+
+        Node* volatile* buckets;
+        uint32_t bucketMask;
+
+        // Stats
+        volatile uint64_t hits, copies, inserts;
+
+    public:
+        explicit SharedBblTable(uint32_t numBuckets);
+
+        void initStats(AggregateStat* parentStat);
+
+        // Returns a decoded BblInfo for bbl if some process has inserted it, nullptr otherwise
+        BblInfo* lookup(BBL bbl, const BblKey& key);
+
+        void insert(BBL bbl, const BblKey& key, BblInfo* bblInfo);
+};
+
+#endif  // BBL_CACHE_H_
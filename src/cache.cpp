@@ -24,6 +24,7 @@
  */
 
 #include "cache.h"
+#include "checkpoint.h"
 #include "hash.h"
 
 #include "event_recorder.h"
@@ -58,6 +59,20 @@ void Cache::initCacheStats(AggregateStat* cacheStat) {
     rp->initStats(cacheStat);
 }
 
+void Cache::saveState(CheckpointWriter& cw) {
+    std::string n = name.c_str();
+    array->saveState(cw, n + ".array");
+    rp->saveState(cw, n + ".repl");
+    cc->saveState(cw, n);
+}
+
+void Cache::restoreState(CheckpointReader& cr) {
+    std::string n = name.c_str();
+    array->restoreState(cr, n + ".array");
+    rp->restoreState(cr, n + ".repl");
+    cc->restoreState(cr, n);
+}
+
 uint64_t Cache::access(MemReq& req) {
     uint64_t respCycle = req.cycle;
     bool skipAccess = cc->startAccess(req); //may need to skip access due to races (NOTE: may change req.type!)
@@ -70,6 +85,7 @@ uint64_t Cache::access(MemReq& req) {
             //Make space for new line
             Address wbLineAddr;
             lineId = array->preinsert(req.lineAddr, &req, &wbLineAddr); //find the lineId to replace
+            req.evictedLineAddr = cc->isValid(lineId)? wbLineAddr : 0;
             trace(Cache, "[%s] Evicting 0x%lx", name.c_str(), wbLineAddr);
 
             //Evictions are not in the critical path in any sane implementation -- we do not include their delays
@@ -125,8 +141,8 @@ uint64_t Cache::access(MemReq& req) {
     return respCycle;
 }
 
-void Cache::startInvalidate() {
-    cc->startInv(); //note we don't grab tcc; tcc serializes multiple up accesses, down accesses don't see it
+void Cache::startInvalidate(const InvReq& req) {
+    cc->startInv(req); //note we don't grab tcc; tcc serializes multiple up accesses, down accesses don't see it
 }
 
 uint64_t Cache::finishInvalidate(const InvReq& req) {
@@ -67,14 +67,17 @@ class Cache : public BaseCache {
 
         //NOTE: reqWriteback is pulled up to true, but not pulled down to false.
         virtual uint64_t invalidate(const InvReq& req) {
-            startInvalidate();
+            startInvalidate(req);
             return finishInvalidate(req);
         }
 
+        void saveState(CheckpointWriter& cw);
+        void restoreState(CheckpointReader& cr);
+
     protected:
         void initCacheStats(AggregateStat* cacheStat);
 
-        void startInvalidate(); // grabs cc's downLock
+        void startInvalidate(const InvReq& req); // grabs cc's downLock
         uint64_t finishInvalidate(const InvReq& req); // performs inv and releases downLock
 };
 
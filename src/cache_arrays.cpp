@@ -24,26 +24,80 @@
  */
 
 #include "cache_arrays.h"
+#include <immintrin.h>
+#include <string.h>
+#include "checkpoint.h"
+#include "constants.h"
 #include "hash.h"
+#include "pad.h"
 #include "repl_policies.h"
 
+/* Tag comparison kernels: return the way of tags[0..ways) that matches lineAddr, or -1 */
+
+static inline int32_t FindTagScalar(const Address* tags, uint32_t ways, Address lineAddr) {
+    for (uint32_t w = 0; w < ways; w++) {
+        if (tags[w] == lineAddr) return w;
+    }
+    return -1;
+}
+
+__attribute__((target("sse4.1")))
+static int32_t FindTagSSE4(const Address* tags, uint32_t ways, Address lineAddr) {
+    __m128i key = _mm_set1_epi64x(lineAddr);
+    uint32_t w = 0;
+    for (; w + 2 <= ways; w += 2) {
+        __m128i cmp = _mm_cmpeq_epi64(_mm_loadu_si128((const __m128i*)&tags[w]), key);
+        uint32_t mask = _mm_movemask_pd(_mm_castsi128_pd(cmp));
+        if (mask) return w + __builtin_ctz(mask);
+    }
+    int32_t res = FindTagScalar(&tags[w], ways - w, lineAddr);
+    return (res == -1)? -1 : w + res;
+}
+
+__attribute__((target("avx2")))
+static int32_t FindTagAVX2(const Address* tags, uint32_t ways, Address lineAddr) {
+    __m256i key = _mm256_set1_epi64x(lineAddr);
+    uint32_t w = 0;
+    // 8 ways per iteration; two independent compares give more ILP than one
+    for (; w + 8 <= ways; w += 8) {
+        __m256i cmp0 = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)&tags[w]), key);
+        __m256i cmp1 = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)&tags[w+4]), key);
+        uint32_t mask = _mm256_movemask_pd(_mm256_castsi256_pd(cmp0)) | (_mm256_movemask_pd(_mm256_castsi256_pd(cmp1)) << 4);
+        if (mask) return w + __builtin_ctz(mask);
+    }
+    for (; w + 4 <= ways; w += 4) {
+        __m256i cmp = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)&tags[w]), key);
+        uint32_t mask = _mm256_movemask_pd(_mm256_castsi256_pd(cmp));
+        if (mask) return w + __builtin_ctz(mask);
+    }
+    int32_t res = FindTagScalar(&tags[w], ways - w, lineAddr);
+    return (res == -1)? -1 : w + res;
+}
+
 /* Set-associative array implementation */
 
 SetAssocArray::SetAssocArray(uint32_t _numLines, uint32_t _assoc, ReplPolicy* _rp, HashFamily* _hf) : rp(_rp), hf(_hf), numLines(_numLines), assoc(_assoc)  {
-    array = gm_calloc<Address>(numLines);
+    array = gm_calloc_aligned<Address>(CACHE_LINE_BYTES, numLines); //line ids are set-major, so sets start at host line boundaries
     numSets = numLines/assoc;
     setMask = numSets - 1;
     assert_msg(isPow2(numSets), "must have a power of 2 # sets, but you specified %d", numSets);
+    //Scalar by default: in arraybench, the vector kernels were no faster than the scalar loop at 4-32 ways
+    simd = SIMD_NONE;
 }
 
 int32_t SetAssocArray::lookup(const Address lineAddr, const MemReq* req, bool updateReplacement) {
     uint32_t set = hf->hash(0, lineAddr) & setMask;
     uint32_t first = set*assoc;
-    for (uint32_t id = first; id < first + assoc; id++) {
-        if (array[id] ==  lineAddr) {
-            if (updateReplacement) rp->update(id, req);
-            return id;
-        }
+    int32_t way;
+    switch (simd) {
+        case SIMD_AVX2: way = FindTagAVX2(&array[first], assoc, lineAddr); break;
+        case SIMD_SSE4: way = FindTagSSE4(&array[first], assoc, lineAddr); break;
+        default: way = FindTagScalar(&array[first], assoc, lineAddr);
+    }
+    if (way != -1) {
+        uint32_t id = first + way;
+        if (updateReplacement) rp->update(id, req);
+        return id;
     }
     return -1;
 }
@@ -64,6 +118,22 @@ void SetAssocArray::postinsert(const Address lineAddr, const MemReq* req, uint32
     rp->update(candidate, req);
 }
 
+void CacheArray::saveState(CheckpointWriter& cw, const std::string& name) {
+    cw.unsupported(name);
+}
+
+void CacheArray::restoreState(CheckpointReader& cr, const std::string& name) {
+    cr.unsupported(name);
+}
+
+void SetAssocArray::saveState(CheckpointWriter& cw, const std::string& name) {
+    cw.write(name, array, numLines*sizeof(Address));
+}
+
+void SetAssocArray::restoreState(CheckpointReader& cr, const std::string& name) {
+    cr.read(name, array, numLines*sizeof(Address));
+}
+
 
 /* ZCache implementation */
 
@@ -71,6 +141,7 @@ ZArray::ZArray(uint32_t _numLines, uint32_t _ways, uint32_t _candidates, ReplPol
     : rp(_rp), hf(_hf), numLines(_numLines), ways(_ways), cands(_candidates)
 {
     assert_msg(ways > 1, "zcaches need >=2 ways to work");
+    if (ways > MAX_ZARRAY_WAYS) panic("zcaches support up to %d ways (%d given)", MAX_ZARRAY_WAYS, ways);
     assert_msg(cands >= ways, "candidates < ways does not make sense in a zcache");
     assert_msg(numLines % ways == 0, "number of lines is not a multiple of ways");
 
@@ -79,8 +150,8 @@ ZArray::ZArray(uint32_t _numLines, uint32_t _ways, uint32_t _candidates, ReplPol
     assert_msg(isPow2(numSets), "must have a power of 2 # sets, but you specified %d", numSets);
     setMask = numSets - 1;
 
-    lookupArray = gm_calloc<uint32_t>(numLines);
-    array = gm_calloc<Address>(numLines);
+    lookupArray = gm_calloc_aligned<uint32_t>(CACHE_LINE_BYTES, numLines);
+    array = gm_calloc_aligned<Address>(CACHE_LINE_BYTES, numLines);
     for (uint32_t i = 0; i < numLines; i++) {
         lookupArray[i] = i;  // start with a linear mapping; with swaps, it'll get progressively scrambled
     }
@@ -103,6 +174,7 @@ int32_t ZArray::lookup(const Address lineAddr, const MemReq* req, bool updateRep
      */
     if (unlikely(!lineAddr)) panic("ZArray::lookup called with lineAddr==0 -- your app just segfaulted");
 
+    //Hash lazily: most hits end the walk early, so computing all ways up front (hashAll) is not faster here
     for (uint32_t w = 0; w < ways; w++) {
         uint32_t lineId = lookupArray[w*numSets + (hf->hash(w, lineAddr) & setMask)];
         if (array[lineId] == lineAddr) {
@@ -125,8 +197,10 @@ uint32_t ZArray::preinsert(const Address lineAddr, const MemReq* req, Address* w
     //info("Replacement for incoming 0x%lx", lineAddr);
 
     //Seeds
+    uint64_t hashes[MAX_ZARRAY_WAYS];
+    hf->hashAll(lineAddr, ways, hashes);
     for (uint32_t w = 0; w < ways; w++) {
-        uint32_t pos = w*numSets + (hf->hash(w, lineAddr) & setMask);
+        uint32_t pos = w*numSets + (hashes[w] & setMask);
         uint32_t lineId = lookupArray[pos];
         candidates[w].set(pos, lineId, -1);
         all_valid &= (array[lineId] != 0);
@@ -138,8 +212,9 @@ uint32_t ZArray::preinsert(const Address lineAddr, const MemReq* req, Address* w
         uint32_t fringeId = candidates[fringeStart].lineId;
         Address fringeAddr = array[fringeId];
         assert(fringeAddr);
+        hf->hashAll(fringeAddr, ways, hashes);
         for (uint32_t w = 0; w < ways; w++) {
-            uint32_t hval = hf->hash(w, fringeAddr) & setMask;
+            uint32_t hval = hashes[w] & setMask;
             uint32_t pos = w*numSets + hval;
             uint32_t lineId = lookupArray[pos];
 
@@ -216,3 +291,19 @@ void ZArray::postinsert(const Address lineAddr, const MemReq* req, uint32_t cand
     statSwaps.inc(swapArrayLen-1);
 }
 
+void ZArray::saveState(CheckpointWriter& cw, const std::string& name) {
+    cw.write(name + ".tags", array, numLines*sizeof(Address));
+    cw.write(name + ".positions", lookupArray, numLines*sizeof(uint32_t));
+}
+
+void ZArray::restoreState(CheckpointReader& cr, const std::string& name) {
+    //Tags and positions must be restored together
+    std::vector<Address> tags(numLines);
+    std::vector<uint32_t> positions(numLines);
+    if (cr.read(name + ".tags", tags.data(), numLines*sizeof(Address)) &&
+        cr.read(name + ".positions", positions.data(), numLines*sizeof(uint32_t)))
+    {
+        memcpy(array, tags.data(), numLines*sizeof(Address));
+        memcpy(lookupArray, positions.data(), numLines*sizeof(uint32_t));
+    }
+}
@@ -26,7 +26,9 @@
 #ifndef CACHE_ARRAYS_H_
 #define CACHE_ARRAYS_H_
 
+#include <string>
 #include "memory_hierarchy.h"
+#include "simd.h"
 #include "stats.h"
 
 /* General interface of a cache array. The array is a fixed-size associative container that
@@ -49,6 +51,10 @@ class CacheArray : public GlobAlloc {
         virtual void postinsert(const Address lineAddr, const MemReq* req, uint32_t lineId) = 0;
 
         virtual void initStats(AggregateStat* parent) {}
+
+        //Checkpointing (see checkpoint.h); name is the array's section. Caches whose array does not implement it can't be restored.
+        virtual void saveState(CheckpointWriter& cw, const std::string& name);
+        virtual void restoreState(CheckpointReader& cr, const std::string& name);
 };
 
 class ReplPolicy;
@@ -64,6 +70,7 @@ class SetAssocArray : public CacheArray {
         uint32_t numSets;
         uint32_t assoc;
         uint32_t setMask;
+        SimdLevel simd; //tag comparison kernel to use (scalar unless overridden)
 
     public:
         SetAssocArray(uint32_t _numLines, uint32_t _assoc, ReplPolicy* _rp, HashFamily* _hf);
@@ -71,6 +78,12 @@ class SetAssocArray : public CacheArray {
         int32_t lookup(const Address lineAddr, const MemReq* req, bool updateReplacement);
         uint32_t preinsert(const Address lineAddr, const MemReq* req, Address* wbLineAddr);
         void postinsert(const Address lineAddr, const MemReq* req, uint32_t candidate);
+
+        //Overrides the tag comparison kernel (for arraybench); the host must support it
+        void setSimdLevel(SimdLevel level) { simd = level; }
+
+        void saveState(CheckpointWriter& cw, const std::string& name);
+        void restoreState(CheckpointReader& cr, const std::string& name);
 };
 
 /* The cache array that started this simulator :) */
@@ -106,6 +119,9 @@ class ZArray : public CacheArray {
         uint32_t getLastCandIdx() const {return lastCandIdx;}
 
         void initStats(AggregateStat* parentStat);
+
+        void saveState(CheckpointWriter& cw, const std::string& name);
+        void restoreState(CheckpointReader& cr, const std::string& name);
 };
 
 // Simple wrapper classes and iterators for candidates in each case; simplifies replacement policy interface without sacrificing performance
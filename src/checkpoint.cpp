@@ -0,0 +1,265 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "checkpoint.h"
+#include <string.h>
+#include <unistd.h>
+#include "core.h"
+#include "g_std/g_vector.h"
+#include "log.h"
+#include "memory_hierarchy.h"
+#include "zsim.h"
+
+#define CHECKPOINT_MAGIC 0x31305450434b435aL  // "ZCKCPT01"
+
+/* File layout: Header, then numSections sections, each a SectionHeader followed by
+ * the name (nameLen bytes, no terminator) and the data.
+ */
+struct CheckpointHeader {
+    uint64_t magic;
+    uint32_t numSections;
+    uint32_t lineBits;  // line addresses are only meaningful with the same line size
+};
+
+struct SectionHeader {
+    uint32_t nameLen;
+    uint32_t pad;
+    uint64_t bytes;
+};
+
+/* CheckpointWriter */
+
+CheckpointWriter::CheckpointWriter(const char* _path) : path(_path), totalBytes(0), numSections(0) {
+    tmpPath = path + ".tmp." + std::to_string(getpid());
+    f = fopen(tmpPath.c_str(), "w");
+    if (!f) panic("Could not open checkpoint file %s for writing", tmpPath.c_str());
+    CheckpointHeader hdr = {CHECKPOINT_MAGIC, 0, lineBits};
+    if (fwrite(&hdr, sizeof(hdr), 1, f) != 1) panic("Checkpoint %s: write failed", tmpPath.c_str());
+}
+
+CheckpointWriter::CheckpointWriter() : f(nullptr), totalBytes(0), numSections(0) {}
+
+CheckpointWriter::~CheckpointWriter() {
+    if (f) {
+        fclose(f);
+        unlink(tmpPath.c_str());
+    }
+}
+
+void CheckpointWriter::write(const std::string& name, const void* buf, size_t bytes) {
+    if (!f) {  // dry run
+        layout.push_back({name, bytes, {}});
+        return;
+    }
+    SectionHeader sh = {(uint32_t)name.size(), 0, bytes};
+    bool ok = fwrite(&sh, sizeof(sh), 1, f) == 1;
+    ok = ok && fwrite(name.c_str(), name.size(), 1, f) == 1;
+    ok = ok && (bytes == 0 || fwrite(buf, bytes, 1, f) == 1);
+    if (!ok) panic("Checkpoint %s: write of section %s failed", tmpPath.c_str(), name.c_str());
+    numSections++;
+    totalBytes += bytes;
+}
+
+void CheckpointWriter::writeGeometry(const std::string& name, const void* buf, size_t bytes) {
+    write(name, buf, bytes);
+    if (!f) {
+        const uint8_t* b = static_cast<const uint8_t*>(buf);
+        layout.back().geometry.assign(b, b + bytes);
+    }
+}
+
+void CheckpointWriter::unsupported(const std::string& name) {
+    if (f) warn("Checkpoint: %s does not support checkpoints, not saved", name.c_str());
+    unsupportedNames.push_back(name);
+}
+
+void CheckpointWriter::close() {
+    assert(f);
+    CheckpointHeader hdr = {CHECKPOINT_MAGIC, numSections, lineBits};
+    bool ok = fseek(f, 0, SEEK_SET) == 0 && fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    ok = (fclose(f) == 0) && ok;
+    f = nullptr;
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) panic("Could not write checkpoint file %s", path.c_str());
+    info("Wrote checkpoint %s: %d sections, %ld bytes", path.c_str(), numSections, totalBytes);
+}
+
+/* CheckpointReader */
+
+CheckpointReader::CheckpointReader(const char* _path) : path(_path), numRestored(0), numCold(0) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) panic("Could not open checkpoint file %s", path.c_str());
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (len < (long)sizeof(CheckpointHeader)) panic("Checkpoint %s is truncated", path.c_str());
+    data.resize(len);
+    if (fread(data.data(), len, 1, f) != 1) panic("Could not read checkpoint file %s", path.c_str());
+    fclose(f);
+
+    CheckpointHeader hdr;
+    memcpy(&hdr, data.data(), sizeof(hdr));
+    if (hdr.magic != CHECKPOINT_MAGIC) panic("%s is not a checkpoint file", path.c_str());
+    if (hdr.lineBits != lineBits) panic("Checkpoint %s has %d-byte lines, but the system uses %d-byte lines", path.c_str(), 1 << hdr.lineBits, 1 << lineBits);
+
+    size_t pos = sizeof(hdr);
+    for (uint32_t i = 0; i < hdr.numSections; i++) {
+        SectionHeader sh;
+        if (pos + sizeof(sh) > data.size()) panic("Checkpoint %s is truncated", path.c_str());
+        memcpy(&sh, &data[pos], sizeof(sh));
+        pos += sizeof(sh);
+        if (pos + sh.nameLen + sh.bytes > data.size()) panic("Checkpoint %s is truncated", path.c_str());
+        std::string name(reinterpret_cast<const char*>(&data[pos]), sh.nameLen);
+        pos += sh.nameLen;
+        sections[name] = {pos, sh.bytes, false};
+        pos += sh.bytes;
+    }
+}
+
+bool CheckpointReader::read(const std::string& name, void* buf, size_t bytes) {
+    auto it = sections.find(name);
+    if (it == sections.end()) {
+        warn("Checkpoint: no section %s, it will start cold", name.c_str());
+        numCold++;
+        return false;
+    }
+    Section& s = it->second;
+    s.used = true;
+    if (s.bytes != bytes) {
+        warn("Checkpoint: section %s has %ld bytes, expected %ld (different geometry?), it will start cold", name.c_str(), s.bytes, bytes);
+        numCold++;
+        return false;
+    }
+    memcpy(buf, &data[s.offset], bytes);
+    numRestored++;
+    return true;
+}
+
+bool CheckpointReader::read(const std::string& name, std::vector<uint8_t>& buf) {
+    auto it = sections.find(name);
+    if (it == sections.end()) {
+        warn("Checkpoint: no section %s, it will start cold", name.c_str());
+        numCold++;
+        return false;
+    }
+    Section& s = it->second;
+    s.used = true;
+    buf.assign(data.begin() + s.offset, data.begin() + s.offset + s.bytes);
+    numRestored++;
+    return true;
+}
+
+bool CheckpointReader::matches(const CheckpointWriter& dryRun) {
+    bool match = true;
+    for (const std::string& name : dryRun.getUnsupported()) {
+        warn("Checkpoint: %s does not support checkpoints", name.c_str());
+        match = false;
+    }
+    for (const CheckpointWriter::LayoutEntry& e : dryRun.getLayout()) {
+        auto it = sections.find(e.name);
+        if (it == sections.end()) {
+            warn("Checkpoint: no section %s", e.name.c_str());
+            match = false;
+        } else if (it->second.bytes != e.bytes) {
+            warn("Checkpoint: section %s has %ld bytes, expected %ld (different geometry?)", e.name.c_str(), it->second.bytes, e.bytes);
+            match = false;
+        } else if (!e.geometry.empty() && memcmp(&data[it->second.offset], e.geometry.data(), e.bytes) != 0) {
+            warn("Checkpoint: section %s does not match the system's geometry", e.name.c_str());
+            match = false;
+        }
+    }
+    return match;
+}
+
+void CheckpointReader::unsupported(const std::string& name) {
+    warn("Checkpoint: %s does not support checkpoints, it will start cold", name.c_str());
+    numCold++;
+}
+
+void CheckpointReader::finish() {
+    for (auto& kv : sections) {
+        if (!kv.second.used) warn("Checkpoint: section %s does not match any component, ignored", kv.first.c_str());
+    }
+    info("Restored checkpoint %s: %d sections restored, %d components cold", path.c_str(), numRestored, numCold);
+}
+
+/* Triggering */
+
+static void SaveCheckpoint(const char* file) {
+    info("Saving checkpoint at phase %ld", zinfo->numPhases);
+    CheckpointWriter cw(file);
+    for (BaseCache* c : *zinfo->caches) c->saveState(cw);
+    if (zinfo->cores) for (uint32_t i = 0; i < zinfo->numCores; i++) zinfo->cores[i]->saveState(cw);
+    cw.close();
+    if (zinfo->checkpointExit) {
+        zinfo->terminationConditionMet = true;
+        info("Checkpoint saved, terminating (sim.checkpointExit)");
+    }
+}
+
+static void RestoreCheckpoint(const char* file) {
+    info("Restoring checkpoint at phase %ld", zinfo->numPhases);
+    CheckpointReader cr(file);
+
+    CheckpointWriter dryRun;
+    for (BaseCache* c : *zinfo->caches) c->saveState(dryRun);
+    if (cr.matches(dryRun)) {
+        for (BaseCache* c : *zinfo->caches) c->restoreState(cr);
+    } else {
+        warn("Checkpoint %s does not match the memory hierarchy, all caches will start cold", file);
+    }
+
+    if (zinfo->cores) for (uint32_t i = 0; i < zinfo->numCores; i++) zinfo->cores[i]->restoreState(cr);
+    cr.finish();
+}
+
+void CheckpointPhaseEnd() {
+    if (zinfo->checkpointDone) return;
+    assert(zinfo->checkpointSaveFile || zinfo->checkpointRestoreFile);
+
+    switch (zinfo->checkpointTrigger) {
+        case CKPT_ROI:
+            break;
+        case CKPT_MAGIC:
+            if (!zinfo->checkpointRequested) return;
+            break;
+        case CKPT_INSTRS:
+            {
+                uint64_t totalInstrs = 0;
+                for (uint32_t i = 0; i < zinfo->numCores; i++) totalInstrs += zinfo->cores[i]->getInstrs();
+                if (totalInstrs < zinfo->checkpointInstrs) return;
+            }
+            break;
+        default:
+            panic("Invalid checkpoint trigger %d", zinfo->checkpointTrigger);
+    }
+
+    zinfo->checkpointDone = true;
+    if (zinfo->checkpointRestoreFile) {
+        RestoreCheckpoint(zinfo->checkpointRestoreFile);
+    } else {
+        SaveCheckpoint(zinfo->checkpointSaveFile);
+    }
+}
@@ -0,0 +1,138 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Checkpoints of warmed microarchitectural state (sim.checkpointSave/checkpointRestore)
+ *
+ * A checkpoint is a flat file of named sections. Each component (cache arrays,
+ * replacement policies, coherence directories, prefetchers, branch predictors)
+ * saves its state under its own name through saveState(), and restoreState()
+ * reads it back. Timing parameters (latencies, network, memory) are not part
+ * of the state, so a checkpoint can be restored into any config where the
+ * components have the same names and geometry.
+ *
+ * Cache state is restored all-or-nothing: caches, their directories and their
+ * children must agree (e.g., inclusion), so if any cache does not match the
+ * checkpoint, all caches start cold. Predictors are independent, and each one
+ * is restored if it matches.
+ */
+class CheckpointWriter {
+    private:
+        std::string path;
+        std::string tmpPath;
+        FILE* f;
+        uint64_t totalBytes;
+        uint32_t numSections;
+
+    public:
+        // Layout of a dry-run save, used to check that a checkpoint matches the system before restoring it
+        struct LayoutEntry {
+            std::string name;
+            size_t bytes;
+            std::vector<uint8_t> geometry;  // contents, for geometry sections only; these must match exactly
+        };
+
+    private:
+        std::vector<LayoutEntry> layout;
+        std::vector<std::string> unsupportedNames;
+
+    public:
+        explicit CheckpointWriter(const char* _path);
+        CheckpointWriter();  // layout-only (dry-run) writer, writes no file
+        ~CheckpointWriter();
+
+        void write(const std::string& name, const void* buf, size_t bytes);
+
+        template <typename T>
+        void write(const std::string& name, const std::vector<T>& v) {
+            write(name, v.data(), v.size()*sizeof(T));
+        }
+
+        // Small section describing a component's geometry (e.g., number of children); restores require it to match exactly
+        void writeGeometry(const std::string& name, const void* buf, size_t bytes);
+
+        // Called by components whose state can't be saved; their cache will not be restorable
+        void unsupported(const std::string& name);
+
+        // Finishes the file and atomically replaces path with it
+        void close();
+
+        const std::vector<LayoutEntry>& getLayout() const {return layout;}
+        const std::vector<std::string>& getUnsupported() const {return unsupportedNames;}
+};
+
+class CheckpointReader {
+    private:
+        std::string path;
+        std::vector<uint8_t> data;
+        struct Section {
+            size_t offset;
+            size_t bytes;
+            bool used;
+        };
+        std::unordered_map<std::string, Section> sections;
+        uint32_t numRestored, numCold;
+
+    public:
+        explicit CheckpointReader(const char* _path);
+
+        // Copies section name to buf; returns false, leaving buf untouched, if it does not exist or its size differs
+        bool read(const std::string& name, void* buf, size_t bytes);
+
+        // Variable-size sections; returns false if the section does not exist
+        bool read(const std::string& name, std::vector<uint8_t>& buf);
+
+        // Checks that every section of a dry-run layout is in the checkpoint with the same size (and contents, for geometry sections)
+        bool matches(const CheckpointWriter& dryRun);
+
+        // Called by components that don't support checkpoints (they start cold)
+        void unsupported(const std::string& name);
+
+        // Reports what was restored, and the sections no component claimed (e.g., a cache that was renamed)
+        void finish();
+};
+
+/* Checkpoint triggers. The checkpoint is saved or restored at the end of the
+ * phase in which the trigger fires, with all threads stopped.
+ */
+enum CheckpointTrigger {
+    CKPT_ROI,     // end of the first simulated phase (i.e., at ROI start, after fast-forwarding)
+    CKPT_MAGIC,   // after the program issues the CHECKPOINT magic op
+    CKPT_INSTRS,  // once the aggregate number of simulated instructions reaches sim.checkpointInstrs
+};
+
+// Called by the end-of-phase code; saves or restores the whole system if the trigger has fired
+void CheckpointPhaseEnd();
+
+#endif  // CHECKPOINT_H_
@@ -24,7 +24,9 @@
  */
 
 #include "coherence_ctrls.h"
+#include <vector>
 #include "cache.h"
+#include "checkpoint.h"
 #include "network.h"
 
 /* Do a simple XOR block hash on address to determine its bank. Hacky for now,
@@ -53,7 +55,7 @@ void MESIBottomCC::init(const g_vector<MemObject*>& _parents, Network* network,
 }
 
 
-uint64_t MESIBottomCC::processEviction(Address wbLineAddr, uint32_t lineId, bool lowerLevelWriteback, uint64_t cycle, uint32_t srcId) {
+uint64_t MESIBottomCC::processEviction(Address wbLineAddr, uint32_t lineId, bool lowerLevelWriteback, uint64_t cycle, uint32_t srcId, bool warm) {
     MESIState* state = &array[lineId];
     if (lowerLevelWriteback) {
         //If this happens, when tcc issued the invalidations, it got a writeback. This means we have to do a PUTX, i.e. we have to transition to M if we are in E
@@ -61,19 +63,20 @@ uint64_t MESIBottomCC::processEviction(Address wbLineAddr, uint32_t lineId, bool
         *state = M; //Silent E->M transition (at eviction); now we'll do a PUTX
     }
     uint64_t respCycle = cycle;
+    uint32_t flags = warm? MemReq::WARM : 0; //no other flags
     switch (*state) {
         case I:
             break; //Nothing to do
         case S:
         case E:
             {
-                MemReq req = {wbLineAddr, PUTS, selfId, state, cycle, &ccLock, *state, srcId, 0 /*no flags*/};
+                MemReq req = {wbLineAddr, PUTS, selfId, state, cycle, ccLock.get(wbLineAddr), *state, srcId, flags};
                 respCycle = parents[getParentId(wbLineAddr)]->access(req);
             }
             break;
         case M:
             {
-                MemReq req = {wbLineAddr, PUTX, selfId, state, cycle, &ccLock, *state, srcId, 0 /*no flags*/};
+                MemReq req = {wbLineAddr, PUTX, selfId, state, cycle, ccLock.get(wbLineAddr), *state, srcId, flags};
                 respCycle = parents[getParentId(wbLineAddr)]->access(req);
             }
             break;
@@ -84,14 +87,15 @@ uint64_t MESIBottomCC::processEviction(Address wbLineAddr, uint32_t lineId, bool
     return respCycle;
 }
 
-uint64_t MESIBottomCC::processAccess(Address lineAddr, uint32_t lineId, AccessType type, uint64_t cycle, uint32_t srcId, uint32_t flags) {
+uint64_t MESIBottomCC::processAccess(Address lineAddr, uint32_t lineId, AccessType type, uint64_t cycle, uint32_t srcId, uint32_t flags, Address pc) {
     uint64_t respCycle = cycle;
     MESIState* state = &array[lineId];
+    ProfCounters& p = getProf(lineAddr, flags & MemReq::WARM);
     switch (type) {
         // A PUTS/PUTX does nothing w.r.t. higher coherence levels --- it dies here
         case PUTS: //Clean writeback, nothing to do (except profiling)
             assert(*state != I);
-            profPUTS.inc();
+            p.PUTS++;
             break;
         case PUTX: //Dirty writeback
             assert(*state == M || *state == E);
@@ -99,34 +103,34 @@ uint64_t MESIBottomCC::processAccess(Address lineAddr, uint32_t lineId, AccessTy
                 //Silent transition, record that block was written to
                 *state = M;
             }
-            profPUTX.inc();
+            p.PUTX++;
             break;
         case GETS:
             if (*state == I) {
                 uint32_t parentId = getParentId(lineAddr);
-                MemReq req = {lineAddr, GETS, selfId, state, cycle, &ccLock, *state, srcId, flags};
+                MemReq req = {lineAddr, GETS, selfId, state, cycle, ccLock.get(lineAddr), *state, srcId, flags, pc};
                 uint32_t nextLevelLat = parents[parentId]->access(req) - cycle;
                 uint32_t netLat = parentRTTs[parentId];
-                profGETNextLevelLat.inc(nextLevelLat);
-                profGETNetLat.inc(netLat);
+                p.GETNextLevelLat += nextLevelLat;
+                p.GETNetLat += netLat;
                 respCycle += nextLevelLat + netLat;
-                profGETSMiss.inc();
+                p.GETSMiss++;
                 assert(*state == S || *state == E);
             } else {
-                profGETSHit.inc();
+                p.GETSHit++;
             }
             break;
         case GETX:
             if (*state == I || *state == S) {
                 //Profile before access, state changes
-                if (*state == I) profGETXMissIM.inc();
-                else profGETXMissSM.inc();
+                if (*state == I) p.GETXMissIM++;
+                else p.GETXMissSM++;
                 uint32_t parentId = getParentId(lineAddr);
-                MemReq req = {lineAddr, GETX, selfId, state, cycle, &ccLock, *state, srcId, flags};
+                MemReq req = {lineAddr, GETX, selfId, state, cycle, ccLock.get(lineAddr), *state, srcId, flags, pc};
                 uint32_t nextLevelLat = parents[parentId]->access(req) - cycle;
                 uint32_t netLat = parentRTTs[parentId];
-                profGETNextLevelLat.inc(nextLevelLat);
-                profGETNetLat.inc(netLat);
+                p.GETNextLevelLat += nextLevelLat;
+                p.GETNetLat += netLat;
                 respCycle += nextLevelLat + netLat;
             } else {
                 if (*state == E) {
@@ -139,7 +143,7 @@ uint64_t MESIBottomCC::processAccess(Address lineAddr, uint32_t lineId, AccessTy
                      */
                     *state = M;
                 }
-                profGETXHit.inc();
+                p.GETXHit++;
             }
             assert_msg(*state == M, "Wrong final state on GETX, lineId %d numLines %d, finalState %s", lineId, numLines, MESIStateName(*state));
             break;
@@ -159,8 +163,9 @@ void MESIBottomCC::processWritebackOnAccess(Address lineAddr, uint32_t lineId, A
     }
 }
 
-void MESIBottomCC::processInval(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback) {
+void MESIBottomCC::processInval(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback, bool warm) {
     MESIState* state = &array[lineId];
+    ProfCounters& p = getProf(lineAddr, warm);
     assert(*state != I);
     switch (type) {
         case INVX: //lose exclusivity
@@ -168,17 +173,17 @@ void MESIBottomCC::processInval(Address lineAddr, uint32_t lineId, InvType type,
             assert_msg(*state == E || *state == M, "Invalid state %s", MESIStateName(*state));
             if (*state == M) *reqWriteback = true;
             *state = S;
-            profINVX.inc();
+            p.INVX++;
             break;
         case INV: //invalidate
             assert(*state != I);
             if (*state == M) *reqWriteback = true;
             *state = I;
-            profINV.inc();
+            p.INV++;
             break;
         case FWD: //forward
             assert_msg(*state == S, "Invalid state %s on FWD", MESIStateName(*state));
-            profFWD.inc();
+            p.FWD++;
             break;
         default: panic("!?");
     }
@@ -190,12 +195,21 @@ uint64_t MESIBottomCC::processNonInclusiveWriteback(Address lineAddr, AccessType
     if (!nonInclusiveHack) panic("Non-inclusive %s on line 0x%lx, this cache should be inclusive", AccessTypeName(type), lineAddr);
 
     //info("Non-inclusive wback, forwarding");
-    MemReq req = {lineAddr, type, selfId, state, cycle, &ccLock, *state, srcId, flags | MemReq::NONINCLWB};
+    MemReq req = {lineAddr, type, selfId, state, cycle, ccLock.get(lineAddr), *state, srcId, flags | MemReq::NONINCLWB};
     uint64_t respCycle = parents[getParentId(lineAddr)]->access(req);
     return respCycle;
 }
 
 
+void MESIBottomCC::saveState(CheckpointWriter& cw, const std::string& name) {
+    cw.write(name, array, numLines*sizeof(MESIState));
+}
+
+void MESIBottomCC::restoreState(CheckpointReader& cr, const std::string& name) {
+    cr.read(name, array, numLines*sizeof(MESIState));
+}
+
+
 /* MESITopCC implementation */
 
 void MESITopCC::init(const g_vector<BaseCache*>& _children, Network* network, const char* name) {
@@ -208,9 +222,90 @@ void MESITopCC::init(const g_vector<BaseCache*>& _children, Network* network, co
         children[c] = _children[c];
         childrenRTTs[c] = (network)? network->getRTT(name, children[c]->getName()) : 0;
     }
+    bitmapWords = (children.size() + 63)/64;
+}
+
+uint64_t* MESITopCC::allocBitmap() {
+    uint64_t* bitmap;
+    spin_lock(&bitmapLock);
+    if (freeBitmaps.empty()) {
+        bitmap = gm_calloc<uint64_t>(bitmapWords);
+    } else {
+        bitmap = freeBitmaps.back();
+        freeBitmaps.pop_back();
+    }
+    spin_unlock(&bitmapLock);
+    return bitmap;
 }
 
-uint64_t MESITopCC::sendInvalidates(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback, uint64_t cycle, uint32_t srcId) {
+void MESITopCC::freeBitmap(uint64_t* bitmap) {
+    memset(bitmap, 0, bitmapWords*sizeof(uint64_t)); //pooled bitmaps are kept clear
+    spin_lock(&bitmapLock);
+    freeBitmaps.push_back(bitmap);
+    spin_unlock(&bitmapLock);
+}
+
+bool MESITopCC::isSharer(Entry* e, uint32_t childId) {
+    if (e->isInline()) {
+        for (uint32_t i = 0; i < e->numSharers; i++) {
+            if (e->ids[i] == childId) return true;
+        }
+        return false;
+    } else {
+        return (e->bitmap[childId/64] >> (childId % 64)) & 1;
+    }
+}
+
+void MESITopCC::addSharer(Entry* e, uint32_t childId) {
+    assert(!isSharer(e, childId));
+    if (e->numSharers < INLINE_SHARERS) {
+        //Sorted insert, so we send invalidates in child order
+        uint32_t i = e->numSharers;
+        while (i > 0 && e->ids[i-1] > childId) {
+            e->ids[i] = e->ids[i-1];
+            i--;
+        }
+        e->ids[i] = childId;
+    } else {
+        if (e->numSharers == INLINE_SHARERS) { //overflow, switch to bitmap
+            uint64_t* bitmap = allocBitmap();
+            for (uint32_t i = 0; i < INLINE_SHARERS; i++) bitmap[e->ids[i]/64] |= 1ul << (e->ids[i] % 64);
+            e->bitmap = bitmap;
+        }
+        e->bitmap[childId/64] |= 1ul << (childId % 64);
+    }
+    e->numSharers++;
+}
+
+void MESITopCC::removeSharer(Entry* e, uint32_t childId) {
+    assert(isSharer(e, childId));
+    if (e->isInline()) {
+        uint32_t i = 0;
+        while (e->ids[i] != childId) i++;
+        for (; i < e->numSharers - 1; i++) e->ids[i] = e->ids[i+1];
+    } else {
+        e->bitmap[childId/64] &= ~(1ul << (childId % 64));
+        if (e->numSharers - 1 == INLINE_SHARERS) { //fits inline again, switch back
+            uint64_t* bitmap = e->bitmap;
+            uint32_t n = 0;
+            for (uint32_t w = 0; w < bitmapWords; w++) {
+                for (uint64_t bits = bitmap[w]; bits; bits &= bits - 1) {
+                    e->ids[n++] = w*64 + __builtin_ctzl(bits);
+                }
+            }
+            assert(n == INLINE_SHARERS);
+            freeBitmap(bitmap);
+        }
+    }
+    e->numSharers--;
+}
+
+void MESITopCC::clearSharers(Entry* e) {
+    if (!e->isInline()) freeBitmap(e->bitmap);
+    e->numSharers = 0;
+}
+
+uint64_t MESITopCC::sendInvalidates(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback, uint64_t cycle, uint32_t srcId, bool warm) {
     //Send down downgrades/invalidates
     Entry* e = &array[lineId];
 
@@ -221,21 +316,29 @@ uint64_t MESITopCC::sendInvalidates(Address lineAddr, uint32_t lineId, InvType t
 
     uint64_t maxCycle = cycle; //keep maximum cycle only, we assume all invals are sent in parallel
     if (!e->isEmpty()) {
-        uint32_t numChildren = children.size();
-        uint32_t sentInvs = 0;
-        for (uint32_t c = 0; c < numChildren; c++) {
-            if (e->sharers[c]) {
-                InvReq req = {lineAddr, type, reqWriteback, cycle, srcId};
-                uint64_t respCycle = children[c]->invalidate(req);
-                respCycle += childrenRTTs[c];
-                maxCycle = MAX(respCycle, maxCycle);
-                if (type == INV) e->sharers[c] = false;
-                sentInvs++;
+        auto sendInv = [&](uint32_t c) {
+            InvReq req = {lineAddr, type, reqWriteback, cycle, srcId, warm};
+            uint64_t respCycle = children[c]->invalidate(req);
+            respCycle += childrenRTTs[c];
+            maxCycle = MAX(respCycle, maxCycle);
+        };
+
+        //Both formats visit sharers in child order
+        if (e->isInline()) {
+            for (uint32_t i = 0; i < e->numSharers; i++) sendInv(e->ids[i]);
+        } else {
+            uint32_t sentInvs = 0;
+            for (uint32_t w = 0; w < bitmapWords; w++) {
+                for (uint64_t bits = e->bitmap[w]; bits; bits &= bits - 1) {
+                    sendInv(w*64 + __builtin_ctzl(bits));
+                    sentInvs++;
+                }
             }
+            assert(sentInvs == e->numSharers);
         }
-        assert(sentInvs == e->numSharers);
+
         if (type == INV) {
-            e->numSharers = 0;
+            clearSharers(e);
         } else {
             //TODO: This is kludgy -- once the sharers format is more sophisticated, handle downgrades with a different codepath
             assert(e->exclusive);
@@ -247,14 +350,15 @@ uint64_t MESITopCC::sendInvalidates(Address lineAddr, uint32_t lineId, InvType t
 }
 
 
-uint64_t MESITopCC::processEviction(Address wbLineAddr, uint32_t lineId, bool* reqWriteback, uint64_t cycle, uint32_t srcId) {
+uint64_t MESITopCC::processEviction(Address wbLineAddr, uint32_t lineId, bool* reqWriteback, uint64_t cycle, uint32_t srcId, bool warm) {
     if (nonInclusiveHack) {
         // Don't invalidate anything, just clear our entry
+        clearSharers(&array[lineId]);
         array[lineId].clear();
         return cycle;
     } else {
         //Send down invalidates
-        return sendInvalidates(wbLineAddr, lineId, INV, reqWriteback, cycle, srcId);
+        return sendInvalidates(wbLineAddr, lineId, INV, reqWriteback, cycle, srcId, warm);
     }
 }
 
@@ -266,38 +370,34 @@ uint64_t MESITopCC::processAccess(Address lineAddr, uint32_t lineId, AccessType
         case PUTX:
             assert(e->isExclusive());
             if (flags & MemReq::PUTX_KEEPEXCL) {
-                assert(e->sharers[childId]);
+                assert(isSharer(e, childId));
                 assert(*childState == M);
                 *childState = E; //they don't hold dirty data anymore
                 break; //don't remove from sharer set. It'll keep exclusive perms.
             }
             //note NO break in general
         case PUTS:
-            assert(e->sharers[childId]);
-            e->sharers[childId] = false;
-            e->numSharers--;
+            removeSharer(e, childId);
             *childState = I;
             break;
         case GETS:
             if (e->isEmpty() && haveExclusive && !(flags & MemReq::NOEXCL)) {
                 //Give in E state
                 e->exclusive = true;
-                e->sharers[childId] = true;
-                e->numSharers = 1;
+                addSharer(e, childId);
                 *childState = E;
             } else {
                 //Give in S state
-                assert(e->sharers[childId] == false);
+                assert(!isSharer(e, childId));
 
                 if (e->isExclusive()) {
                     //Downgrade the exclusive sharer
-                    respCycle = sendInvalidates(lineAddr, lineId, INVX, inducedWriteback, cycle, srcId);
+                    respCycle = sendInvalidates(lineAddr, lineId, INVX, inducedWriteback, cycle, srcId, flags & MemReq::WARM);
                 }
 
                 assert_msg(!e->isExclusive(), "Can't have exclusivity here. isExcl=%d excl=%d numSharers=%d", e->isExclusive(), e->exclusive, e->numSharers);
 
-                e->sharers[childId] = true;
-                e->numSharers++;
+                addSharer(e, childId);
                 e->exclusive = false; //dsm: Must set, we're explicitly non-exclusive
                 *childState = S;
             }
@@ -306,18 +406,16 @@ uint64_t MESITopCC::processAccess(Address lineAddr, uint32_t lineId, AccessType
             assert(haveExclusive); //the current cache better have exclusive access to this line
 
             // If child is in sharers list (this is an upgrade miss), take it out
-            if (e->sharers[childId]) {
+            if (isSharer(e, childId)) {
                 assert_msg(!e->isExclusive(), "Spurious GETX, childId=%d numSharers=%d isExcl=%d excl=%d", childId, e->numSharers, e->isExclusive(), e->exclusive);
-                e->sharers[childId] = false;
-                e->numSharers--;
+                removeSharer(e, childId);
             }
 
             // Invalidate all other copies
-            respCycle = sendInvalidates(lineAddr, lineId, INV, inducedWriteback, cycle, srcId);
+            respCycle = sendInvalidates(lineAddr, lineId, INV, inducedWriteback, cycle, srcId, flags & MemReq::WARM);
 
             // Set current sharer, mark exclusive
-            e->sharers[childId] = true;
-            e->numSharers++;
+            addSharer(e, childId);
             e->exclusive = true;
 
             assert(e->numSharers == 1);
@@ -331,13 +429,55 @@ uint64_t MESITopCC::processAccess(Address lineAddr, uint32_t lineId, AccessType
     return respCycle;
 }
 
-uint64_t MESITopCC::processInval(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback, uint64_t cycle, uint32_t srcId) {
+uint64_t MESITopCC::processInval(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback, uint64_t cycle, uint32_t srcId, bool warm) {
     if (type == FWD) {//if it's a FWD, we should be inclusive for now, so we must have the line, just invLat works
         assert(!nonInclusiveHack); //dsm: ask me if you see this failing and don't know why
         return cycle;
     } else {
         //Just invalidate or downgrade down to children as needed
-        return sendInvalidates(lineAddr, lineId, type, reqWriteback, cycle, srcId);
+        return sendInvalidates(lineAddr, lineId, type, reqWriteback, cycle, srcId, warm);
     }
 }
 
+/* Checkpoints store the directory as one fixed-size record per line: numSharers, exclusive, and the sharers
+ * as a bitmap over all children (even if inline). The number of children is saved as geometry, so a checkpoint
+ * is only restored into a directory with the same children.
+ */
+void MESITopCC::saveState(CheckpointWriter& cw, const std::string& name) {
+    uint32_t numChildren = children.size();
+    cw.writeGeometry(name + ".children", &numChildren, sizeof(numChildren));
+
+    uint32_t recWords = 1 + bitmapWords;
+    std::vector<uint64_t> buf(numLines*recWords, 0);
+    for (uint32_t l = 0; l < numLines; l++) {
+        Entry* e = &array[l];
+        uint64_t* rec = &buf[l*recWords];
+        rec[0] = ((uint64_t)e->exclusive << 32) | e->numSharers;
+        if (e->isInline()) {
+            for (uint32_t i = 0; i < e->numSharers; i++) rec[1 + e->ids[i]/64] |= 1ul << (e->ids[i] % 64);
+        } else {
+            for (uint32_t w = 0; w < bitmapWords; w++) rec[1 + w] = e->bitmap[w];
+        }
+    }
+    cw.write(name, buf);
+}
+
+void MESITopCC::restoreState(CheckpointReader& cr, const std::string& name) {
+    uint32_t numChildren;
+    if (!cr.read(name + ".children", &numChildren, sizeof(numChildren))) return;
+    assert(numChildren == children.size()); //checked by CheckpointReader::matches()
+
+    uint32_t recWords = 1 + bitmapWords;
+    std::vector<uint64_t> buf(numLines*recWords);
+    if (!cr.read(name, buf.data(), buf.size()*sizeof(uint64_t))) return;
+    for (uint32_t l = 0; l < numLines; l++) {
+        Entry* e = &array[l];
+        const uint64_t* rec = &buf[l*recWords];
+        clearSharers(e);
+        for (uint32_t c = 0; c < numChildren; c++) {
+            if ((rec[1 + c/64] >> (c % 64)) & 1) addSharer(e, c);
+        }
+        assert(e->numSharers == (uint32_t)rec[0]);
+        e->exclusive = rec[0] >> 32;
+    }
+}
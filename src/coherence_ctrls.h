@@ -26,10 +26,12 @@
 #ifndef COHERENCE_CTRLS_H_
 #define COHERENCE_CTRLS_H_
 
-#include <bitset>
+#include <string>
+#include "bithacks.h"
 #include "constants.h"
 #include "g_std/g_string.h"
 #include "g_std/g_vector.h"
+#include "hash.h"
 #include "locks.h"
 #include "memory_hierarchy.h"
 #include "pad.h"
@@ -53,12 +55,16 @@ class CC : public GlobAlloc {
         virtual void endAccess(const MemReq& req) = 0;
 
         //Inv methods
-        virtual void startInv() = 0;
+        virtual void startInv(const InvReq& req) = 0;
         virtual uint64_t processInv(const InvReq& req, int32_t lineId, uint64_t startCycle) = 0;
 
         //Repl policy interface
         virtual uint32_t numSharers(uint32_t lineId) = 0;
         virtual bool isValid(uint32_t lineId) = 0;
+
+        //Checkpointing of coherence and directory state (see checkpoint.h); name is the cache's name
+        virtual void saveState(CheckpointWriter& cw, const std::string& name) = 0;
+        virtual void restoreState(CheckpointReader& cr, const std::string& name) = 0;
 };
 
 
@@ -76,6 +82,43 @@ class CC : public GlobAlloc {
 class Cache;
 class Network;
 
+/* Striped controller lock. Each stripe covers a group of sets of the cache array, so all the lines an access can
+ * touch (the requested line, its replacement candidates, and their coherence and directory state) are protected by
+ * the same stripe, and accesses to different stripes of a bank can proceed in parallel. This only holds for arrays
+ * that pick replacement candidates from the requested line's set (SetAssoc); hf must be the array's hash function.
+ * With a single stripe, this is just the old per-controller lock.
+ */
+class StripedLock {
+    private:
+        struct Stripe {
+            lock_t lock;
+        } ATTR_LINE_ALIGNED;
+
+        Stripe* stripes;
+        HashFamily* hf;
+        uint32_t stripeMask;
+
+    public:
+        StripedLock(uint32_t numStripes, HashFamily* _hf) : hf(_hf), stripeMask(numStripes - 1) {
+            assert(isPow2(numStripes));
+            assert(numStripes == 1 || hf);
+            stripes = gm_memalign<Stripe>(CACHE_LINE_BYTES, numStripes);
+            for (uint32_t i = 0; i < numStripes; i++) futex_init(&stripes[i].lock);
+        }
+
+        inline uint32_t size() const {
+            return stripeMask + 1;
+        }
+
+        inline uint32_t getStripe(Address lineAddr) {
+            return stripeMask? (hf->hash(0, lineAddr) & stripeMask) : 0;
+        }
+
+        inline lock_t* get(Address lineAddr) {
+            return &stripes[getStripe(lineAddr)].lock;
+        }
+};
+
 /* NOTE: To avoid virtual function overheads, there is no BottomCC interface, since we only have a MESI controller for now */
 
 class MESIBottomCC : public GlobAlloc {
@@ -86,27 +129,32 @@ class MESIBottomCC : public GlobAlloc {
         uint32_t numLines;
         uint32_t selfId;
 
-        //Profiling counters
-        Counter profGETSHit, profGETSMiss, profGETXHit, profGETXMissIM /*from invalid*/, profGETXMissSM /*from S, i.e. upgrade misses*/;
-        Counter profPUTS, profPUTX /*received from downstream*/;
-        Counter profINV, profINVX, profFWD /*received from upstream*/;
-        //Counter profWBIncl, profWBCoh /* writebacks due to inclusion or coherence, received from downstream, does not include PUTS */;
-        // TODO: Measuring writebacks is messy, do if needed
-        Counter profGETNextLevelLat, profGETNetLat;
+        //Profiling counters, one copy per lock stripe (each copy is only updated with its stripe held); stats add them up.
+        //Warming accesses (MemReq::WARM) update a second, unreported set of copies
+        struct ProfCounters {
+            uint64_t GETSHit, GETSMiss, GETXHit, GETXMissIM /*from invalid*/, GETXMissSM /*from S, i.e. upgrade misses*/;
+            uint64_t PUTS, PUTX /*received from downstream*/;
+            uint64_t INV, INVX, FWD /*received from upstream*/;
+            //uint64_t WBIncl, WBCoh /* writebacks due to inclusion or coherence, received from downstream, does not include PUTS */;
+            // TODO: Measuring writebacks is messy, do if needed
+            uint64_t GETNextLevelLat, GETNetLat;
+        } ATTR_LINE_ALIGNED;
+        ProfCounters* prof;
 
         bool nonInclusiveHack;
 
-        PAD();
-        lock_t ccLock;
-        PAD();
+        StripedLock ccLock;
 
     public:
-        MESIBottomCC(uint32_t _numLines, uint32_t _selfId, bool _nonInclusiveHack) : numLines(_numLines), selfId(_selfId), nonInclusiveHack(_nonInclusiveHack) {
-            array = gm_calloc<MESIState>(numLines);
+        MESIBottomCC(uint32_t _numLines, uint32_t _selfId, bool _nonInclusiveHack, uint32_t _lockStripes, HashFamily* _lockHf)
+            : numLines(_numLines), selfId(_selfId), nonInclusiveHack(_nonInclusiveHack), ccLock(_lockStripes, _lockHf)
+        {
+            array = gm_memalign<MESIState>(CACHE_LINE_BYTES, numLines);
             for (uint32_t i = 0; i < numLines; i++) {
                 array[i] = I;
             }
-            futex_init(&ccLock);
+            prof = gm_memalign<ProfCounters>(CACHE_LINE_BYTES, 2*ccLock.size());
+            memset(prof, 0, 2*ccLock.size()*sizeof(ProfCounters));
         }
 
         void init(const g_vector<MemObject*>& _parents, Network* network, const char* name);
@@ -117,49 +165,46 @@ class MESIBottomCC : public GlobAlloc {
         }
 
         void initStats(AggregateStat* parentStat) {
-            profGETSHit.init("hGETS", "GETS hits");
-            profGETXHit.init("hGETX", "GETX hits");
-            profGETSMiss.init("mGETS", "GETS misses");
-            profGETXMissIM.init("mGETXIM", "GETX I->M misses");
-            profGETXMissSM.init("mGETXSM", "GETX S->M misses (upgrade misses)");
-            profPUTS.init("PUTS", "Clean evictions (from lower level)");
-            profPUTX.init("PUTX", "Dirty evictions (from lower level)");
-            profINV.init("INV", "Invalidates (from upper level)");
-            profINVX.init("INVX", "Downgrades (from upper level)");
-            profFWD.init("FWD", "Forwards (from upper level)");
-            profGETNextLevelLat.init("latGETnl", "GET request latency on next level");
-            profGETNetLat.init("latGETnet", "GET request latency on network to next level");
-
-            parentStat->append(&profGETSHit);
-            parentStat->append(&profGETXHit);
-            parentStat->append(&profGETSMiss);
-            parentStat->append(&profGETXMissIM);
-            parentStat->append(&profGETXMissSM);
-            parentStat->append(&profPUTS);
-            parentStat->append(&profPUTX);
-            parentStat->append(&profINV);
-            parentStat->append(&profINVX);
-            parentStat->append(&profFWD);
-            parentStat->append(&profGETNextLevelLat);
-            parentStat->append(&profGETNetLat);
-        }
-
-        uint64_t processEviction(Address wbLineAddr, uint32_t lineId, bool lowerLevelWriteback, uint64_t cycle, uint32_t srcId);
-
-        uint64_t processAccess(Address lineAddr, uint32_t lineId, AccessType type, uint64_t cycle, uint32_t srcId, uint32_t flags);
+            auto addStat = [this, parentStat](uint64_t ProfCounters::* ctr, const char* name, const char* desc) {
+                auto stat = makeLambdaStat([this, ctr]() {
+                    uint64_t total = 0;
+                    for (uint32_t s = 0; s < ccLock.size(); s++) total += prof[s].*ctr;
+                    return total;
+                });
+                stat->init(name, desc);
+                parentStat->append(stat);
+            };
+
+            addStat(&ProfCounters::GETSHit, "hGETS", "GETS hits");
+            addStat(&ProfCounters::GETXHit, "hGETX", "GETX hits");
+            addStat(&ProfCounters::GETSMiss, "mGETS", "GETS misses");
+            addStat(&ProfCounters::GETXMissIM, "mGETXIM", "GETX I->M misses");
+            addStat(&ProfCounters::GETXMissSM, "mGETXSM", "GETX S->M misses (upgrade misses)");
+            addStat(&ProfCounters::PUTS, "PUTS", "Clean evictions (from lower level)");
+            addStat(&ProfCounters::PUTX, "PUTX", "Dirty evictions (from lower level)");
+            addStat(&ProfCounters::INV, "INV", "Invalidates (from upper level)");
+            addStat(&ProfCounters::INVX, "INVX", "Downgrades (from upper level)");
+            addStat(&ProfCounters::FWD, "FWD", "Forwards (from upper level)");
+            addStat(&ProfCounters::GETNextLevelLat, "latGETnl", "GET request latency on next level");
+            addStat(&ProfCounters::GETNetLat, "latGETnet", "GET request latency on network to next level");
+        }
+
+        uint64_t processEviction(Address wbLineAddr, uint32_t lineId, bool lowerLevelWriteback, uint64_t cycle, uint32_t srcId, bool warm);
+
+        uint64_t processAccess(Address lineAddr, uint32_t lineId, AccessType type, uint64_t cycle, uint32_t srcId, uint32_t flags, Address pc);
 
         void processWritebackOnAccess(Address lineAddr, uint32_t lineId, AccessType type);
 
-        void processInval(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback);
+        void processInval(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback, bool warm);
 
         uint64_t processNonInclusiveWriteback(Address lineAddr, AccessType type, uint64_t cycle, MESIState* state, uint32_t srcId, uint32_t flags);
 
-        inline void lock() {
-            futex_lock(&ccLock);
+        inline void lock(Address lineAddr) {
+            futex_lock(ccLock.get(lineAddr));
         }
 
-        inline void unlock() {
-            futex_unlock(&ccLock);
+        inline void unlock(Address lineAddr) {
+            futex_unlock(ccLock.get(lineAddr));
         }
 
         /* Replacement policy query interface */
@@ -169,23 +214,41 @@ class MESIBottomCC : public GlobAlloc {
 
         //Could extend with isExclusive, isDirty, etc, but not needed for now.
 
+        void saveState(CheckpointWriter& cw, const std::string& name);
+        void restoreState(CheckpointReader& cr, const std::string& name);
+
     private:
         uint32_t getParentId(Address lineAddr);
+
+        inline ProfCounters& getProf(Address lineAddr, bool warm) {
+            uint32_t stripe = ccLock.getStripe(lineAddr);
+            return prof[warm? ccLock.size() + stripe : stripe];
+        }
 };
 
 
 //Implements the "top" part: Keeps directory information, handles downgrades and invalidates
 class MESITopCC : public GlobAlloc {
     private:
+        /* Directory entry. Almost all lines have 0 or 1 sharers, so up to INLINE_SHARERS sharers are kept inline,
+         * as a sorted list of child ids. Beyond that, the entry switches to a bitmap over all children, taken from
+         * the controller's pool and returned when the sharers drop back to INLINE_SHARERS. numSharers implies the
+         * format. Entries take 16 bytes regardless of MAX_CACHE_CHILDREN.
+         */
+        static const uint32_t INLINE_SHARERS = 4;
+        static_assert(MAX_CACHE_CHILDREN <= (1 << 16), "Inline sharer ids are 16 bits");
+
         struct Entry {
             uint32_t numSharers;
-            std::bitset<MAX_CACHE_CHILDREN> sharers;
             bool exclusive;
+            union {
+                uint16_t ids[INLINE_SHARERS];
+                uint64_t* bitmap;
+            };
 
-            void clear() {
+            void clear() { //caller must have released the bitmap, if any
                 exclusive = false;
                 numSharers = 0;
-                sharers.reset();
             }
 
             bool isEmpty() {
@@ -195,6 +258,10 @@ class MESITopCC : public GlobAlloc {
             bool isExclusive() {
                 return (numSharers == 1) && (exclusive);
             }
+
+            bool isInline() {
+                return numSharers <= INLINE_SHARERS;
+            }
         };
 
         Entry* array;
@@ -204,35 +271,39 @@ class MESITopCC : public GlobAlloc {
 
         bool nonInclusiveHack;
 
-        PAD();
-        lock_t ccLock;
-        PAD();
+        //Pool of sharer bitmaps for entries with more than INLINE_SHARERS sharers (shared by all lock stripes)
+        g_vector<uint64_t*> freeBitmaps;
+        uint32_t bitmapWords;
+        lock_t bitmapLock;
+
+        StripedLock ccLock;
 
     public:
-        MESITopCC(uint32_t _numLines, bool _nonInclusiveHack) : numLines(_numLines), nonInclusiveHack(_nonInclusiveHack) {
-            array = gm_calloc<Entry>(numLines);
+        MESITopCC(uint32_t _numLines, bool _nonInclusiveHack, uint32_t _lockStripes, HashFamily* _lockHf)
+            : numLines(_numLines), nonInclusiveHack(_nonInclusiveHack), bitmapWords(0), ccLock(_lockStripes, _lockHf)
+        {
+            array = gm_calloc_aligned<Entry>(CACHE_LINE_BYTES, numLines);
             for (uint32_t i = 0; i < numLines; i++) {
                 array[i].clear();
             }
-
-            futex_init(&ccLock);
+            spin_init(&bitmapLock);
         }
 
         void init(const g_vector<BaseCache*>& _children, Network* network, const char* name);
 
-        uint64_t processEviction(Address wbLineAddr, uint32_t lineId, bool* reqWriteback, uint64_t cycle, uint32_t srcId);
+        uint64_t processEviction(Address wbLineAddr, uint32_t lineId, bool* reqWriteback, uint64_t cycle, uint32_t srcId, bool warm);
 
         uint64_t processAccess(Address lineAddr, uint32_t lineId, AccessType type, uint32_t childId, bool haveExclusive,
                 MESIState* childState, bool* inducedWriteback, uint64_t cycle, uint32_t srcId, uint32_t flags);
 
-        uint64_t processInval(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback, uint64_t cycle, uint32_t srcId);
+        uint64_t processInval(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback, uint64_t cycle, uint32_t srcId, bool warm);
 
-        inline void lock() {
-            futex_lock(&ccLock);
+        inline void lock(Address lineAddr) {
+            futex_lock(ccLock.get(lineAddr));
         }
 
-        inline void unlock() {
-            futex_unlock(&ccLock);
+        inline void unlock(Address lineAddr) {
+            futex_unlock(ccLock.get(lineAddr));
         }
 
         /* Replacement policy query interface */
@@ -240,8 +311,20 @@ class MESITopCC : public GlobAlloc {
             return array[lineId].numSharers;
         }
 
+        void saveState(CheckpointWriter& cw, const std::string& name);
+        void restoreState(CheckpointReader& cr, const std::string& name);
+
     private:
-        uint64_t sendInvalidates(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback, uint64_t cycle, uint32_t srcId);
+        uint64_t sendInvalidates(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback, uint64_t cycle, uint32_t srcId, bool warm);
+
+        //Sharer set manipulation
+        bool isSharer(Entry* e, uint32_t childId);
+        void addSharer(Entry* e, uint32_t childId);
+        void removeSharer(Entry* e, uint32_t childId);
+        void clearSharers(Entry* e);
+
+        uint64_t* allocBitmap();
+        void freeBitmap(uint64_t* bitmap);
 };
 
 static inline bool CheckForMESIRace(AccessType& type, MESIState* state, MESIState initialState) {
@@ -280,20 +363,23 @@ class MESICC : public CC {
         MESIBottomCC* bcc;
         uint32_t numLines;
         bool nonInclusiveHack;
+        uint32_t lockStripes;
+        HashFamily* lockHf;
         g_string name;
 
     public:
         //Initialization
-        MESICC(uint32_t _numLines, bool _nonInclusiveHack, g_string& _name) : tcc(nullptr), bcc(nullptr),
-            numLines(_numLines), nonInclusiveHack(_nonInclusiveHack), name(_name) {}
+        MESICC(uint32_t _numLines, bool _nonInclusiveHack, g_string& _name, uint32_t _lockStripes, HashFamily* _lockHf)
+            : tcc(nullptr), bcc(nullptr), numLines(_numLines), nonInclusiveHack(_nonInclusiveHack),
+              lockStripes(_lockStripes), lockHf(_lockHf), name(_name) {}
 
         void setParents(uint32_t childId, const g_vector<MemObject*>& parents, Network* network) {
-            bcc = new MESIBottomCC(numLines, childId, nonInclusiveHack);
+            bcc = new MESIBottomCC(numLines, childId, nonInclusiveHack, lockStripes, lockHf);
             bcc->init(parents, network, name.c_str());
         }
 
         void setChildren(const g_vector<BaseCache*>& children, Network* network) {
-            tcc = new MESITopCC(numLines, nonInclusiveHack);
+            tcc = new MESITopCC(numLines, nonInclusiveHack, lockStripes, lockHf);
             tcc->init(children, network, name.c_str());
         }
 
@@ -314,8 +400,8 @@ class MESICC : public CC {
                 futex_unlock(req.childLock);
             }
 
-            tcc->lock(); //must lock tcc FIRST
-            bcc->lock();
+            tcc->lock(req.lineAddr); //must lock tcc FIRST
+            bcc->lock(req.lineAddr);
 
             /* The situation is now stable, true race-wise. No one can touch the child state, because we hold
              * both parent's locks. So, we first handle races, which may cause us to skip the access.
@@ -339,8 +425,9 @@ class MESICC : public CC {
 
         uint64_t processEviction(const MemReq& triggerReq, Address wbLineAddr, int32_t lineId, uint64_t startCycle) {
             bool lowerLevelWriteback = false;
-            uint64_t evCycle = tcc->processEviction(wbLineAddr, lineId, &lowerLevelWriteback, startCycle, triggerReq.srcId); //1. if needed, send invalidates/downgrades to lower level
-            evCycle = bcc->processEviction(wbLineAddr, lineId, lowerLevelWriteback, evCycle, triggerReq.srcId); //2. if needed, write back line to upper level
+            bool warm = triggerReq.is(MemReq::WARM);
+            uint64_t evCycle = tcc->processEviction(wbLineAddr, lineId, &lowerLevelWriteback, startCycle, triggerReq.srcId, warm); //1. if needed, send invalidates/downgrades to lower level
+            evCycle = bcc->processEviction(wbLineAddr, lineId, lowerLevelWriteback, evCycle, triggerReq.srcId, warm); //2. if needed, write back line to upper level
             return evCycle;
         }
 
@@ -362,7 +449,7 @@ class MESICC : public CC {
                 uint32_t flags = req.flags & ~MemReq::PREFETCH; //always clear PREFETCH, this flag cannot propagate up
 
                 //if needed, fetch line or upgrade miss from upper level
-                respCycle = bcc->processAccess(req.lineAddr, lineId, req.type, startCycle, req.srcId, flags);
+                respCycle = bcc->processAccess(req.lineAddr, lineId, req.type, startCycle, req.srcId, flags, req.pc);
                 if (getDoneCycle) *getDoneCycle = respCycle;
                 if (!isPrefetch) { //prefetches only touch bcc; the demand request from the core will pull the line to lower level
                     //At this point, the line is in a good state w.r.t. upper levels
@@ -385,26 +472,36 @@ class MESICC : public CC {
                 futex_lock(req.childLock);
             }
 
-            bcc->unlock();
-            tcc->unlock();
+            bcc->unlock(req.lineAddr);
+            tcc->unlock(req.lineAddr);
         }
 
         //Inv methods
-        void startInv() {
-            bcc->lock(); //note we don't grab tcc; tcc serializes multiple up accesses, down accesses don't see it
+        void startInv(const InvReq& req) {
+            bcc->lock(req.lineAddr); //note we don't grab tcc; tcc serializes multiple up accesses, down accesses don't see it
         }
 
         uint64_t processInv(const InvReq& req, int32_t lineId, uint64_t startCycle) {
-            uint64_t respCycle = tcc->processInval(req.lineAddr, lineId, req.type, req.writeback, startCycle, req.srcId); //send invalidates or downgrades to children
-            bcc->processInval(req.lineAddr, lineId, req.type, req.writeback); //adjust our own state
+            uint64_t respCycle = tcc->processInval(req.lineAddr, lineId, req.type, req.writeback, startCycle, req.srcId, req.warm); //send invalidates or downgrades to children
+            bcc->processInval(req.lineAddr, lineId, req.type, req.writeback, req.warm); //adjust our own state
 
-            bcc->unlock();
+            bcc->unlock(req.lineAddr);
             return respCycle;
         }
 
         //Repl policy interface
         uint32_t numSharers(uint32_t lineId) {return tcc->numSharers(lineId);}
         bool isValid(uint32_t lineId) {return bcc->isValid(lineId);}
+
+        void saveState(CheckpointWriter& cw, const std::string& name) {
+            bcc->saveState(cw, name + ".cc");
+            tcc->saveState(cw, name + ".dir");
+        }
+
+        void restoreState(CheckpointReader& cr, const std::string& name) {
+            bcc->restoreState(cr, name + ".cc");
+            tcc->restoreState(cr, name + ".dir");
+        }
 };
 
 // Terminal CC, i.e., without children --- accepts GETS/X, but not PUTS/X
@@ -419,7 +516,7 @@ class MESITerminalCC : public CC {
         MESITerminalCC(uint32_t _numLines, const g_string& _name) : bcc(nullptr), numLines(_numLines), name(_name) {}
 
         void setParents(uint32_t childId, const g_vector<MemObject*>& parents, Network* network) {
-            bcc = new MESIBottomCC(numLines, childId, false /*inclusive*/);
+            bcc = new MESIBottomCC(numLines, childId, false /*inclusive*/, 1 /*single lock stripe*/, nullptr);
             bcc->init(parents, network, name.c_str());
         }
 
@@ -443,7 +540,7 @@ class MESITerminalCC : public CC {
                 futex_unlock(req.childLock);
             }
 
-            bcc->lock();
+            bcc->lock(req.lineAddr);
 
             /* The situation is now stable, true race-wise. No one can touch the child state, because we hold
              * both parent's locks. So, we first handle races, which may cause us to skip the access.
@@ -458,7 +555,7 @@ class MESITerminalCC : public CC {
 
         uint64_t processEviction(const MemReq& triggerReq, Address wbLineAddr, int32_t lineId, uint64_t startCycle) {
             bool lowerLevelWriteback = false;
-            uint64_t endCycle = bcc->processEviction(wbLineAddr, lineId, lowerLevelWriteback, startCycle, triggerReq.srcId); //2. if needed, write back line to upper level
+            uint64_t endCycle = bcc->processEviction(wbLineAddr, lineId, lowerLevelWriteback, startCycle, triggerReq.srcId, triggerReq.is(MemReq::WARM)); //2. if needed, write back line to upper level
             return endCycle;  // critical path unaffected, but TimingCache needs it
         }
 
@@ -466,7 +563,7 @@ class MESITerminalCC : public CC {
             assert(lineId != -1);
             assert(!getDoneCycle);
             //if needed, fetch line or upgrade miss from upper level
-            uint64_t respCycle = bcc->processAccess(req.lineAddr, lineId, req.type, startCycle, req.srcId, req.flags);
+            uint64_t respCycle = bcc->processAccess(req.lineAddr, lineId, req.type, startCycle, req.srcId, req.flags, req.pc);
             //at this point, the line is in a good state w.r.t. upper levels
             return respCycle;
         }
@@ -476,23 +573,31 @@ class MESITerminalCC : public CC {
             if (req.childLock) {
                 futex_lock(req.childLock);
             }
-            bcc->unlock();
+            bcc->unlock(req.lineAddr);
         }
 
         //Inv methods
-        void startInv() {
-            bcc->lock();
+        void startInv(const InvReq& req) {
+            bcc->lock(req.lineAddr);
         }
 
         uint64_t processInv(const InvReq& req, int32_t lineId, uint64_t startCycle) {
-            bcc->processInval(req.lineAddr, lineId, req.type, req.writeback); //adjust our own state
-            bcc->unlock();
+            bcc->processInval(req.lineAddr, lineId, req.type, req.writeback, req.warm); //adjust our own state
+            bcc->unlock(req.lineAddr);
             return startCycle; //no extra delay in terminal caches
         }
 
         //Repl policy interface
         uint32_t numSharers(uint32_t lineId) {return 0;} //no sharers
         bool isValid(uint32_t lineId) {return bcc->isValid(lineId);}
+
+        void saveState(CheckpointWriter& cw, const std::string& name) {
+            bcc->saveState(cw, name + ".cc");
+        }
+
+        void restoreState(CheckpointReader& cr, const std::string& name) {
+            bcc->restoreState(cr, name + ".cc");
+        }
 };
 
 #endif  // COHERENCE_CTRLS_H_
@@ -31,9 +31,13 @@
 // PIN 2.9 (rev39599) can't do more than 2048 threads...
 #define MAX_THREADS (2048)
 
-// How many children caches can each cache track? Note each bank is a separate child. This impacts sharer bit-vector sizes.
-#define MAX_CACHE_CHILDREN (256)
-//#define MAX_CACHE_CHILDREN (1024)
+// How many children caches can each cache track? Note each bank is a separate child.
+// Directory entries keep a few sharers inline and only use bitmaps (sized to the actual children) with more sharers,
+// so this does not impact per-line memory. Must fit in 16 bits (see MESITopCC::Entry).
+#define MAX_CACHE_CHILDREN (1024)
+
+// Max ways of a zcache. ZArray hashes all ways of an address at once into a stack buffer of this size.
+#define MAX_ZARRAY_WAYS (64)
 
 // Complex multiprocess runs need multiple clocks, and multiple port domains
 #define MAX_CLOCK_DOMAINS (64)
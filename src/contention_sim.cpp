@@ -33,6 +33,7 @@
 #include <vector>
 #include "log.h"
 #include "ooo_core.h"
+#include "sweep.h"
 #include "timing_core.h"
 #include "timing_event.h"
 #include "zsim.h"
@@ -58,9 +59,11 @@ void ContentionSim::SimThreadTrampoline(void* arg) {
     csim->simThreadLoop(thid);
 }
 
-ContentionSim::ContentionSim(uint32_t _numDomains, uint32_t _numSimThreads) {
+ContentionSim::ContentionSim(uint32_t _numDomains, uint32_t _numSimThreads, bool _dynamicSched, const std::vector<bool>& wheelDomains, bool _crossingLookahead) {
     numDomains = _numDomains;
     numSimThreads = _numSimThreads;
+    dynamicSched = _dynamicSched;
+    crossingLookahead = _crossingLookahead;
     threadsDone = 0;
     limit = 0;
     lastLimit = 0;
@@ -70,18 +73,26 @@ ContentionSim::ContentionSim(uint32_t _numDomains, uint32_t _numSimThreads) {
     simThreads = gm_calloc<SimThreadData>(numSimThreads);
 
     for (uint32_t i = 0; i < numDomains; i++) {
-        new (&domains[i].pq) PrioQueue<TimingEvent, PQ_BLOCKS>();
+        new (&domains[i].pq) DomainQueue<TimingEvent>(wheelDomains[i]);
         domains[i].curCycle = 0;
-        futex_init(&domains[i].pqLock);
+        domains[i].stagedEvs = nullptr;
     }
 
-    if ((numDomains % numSimThreads) != 0) panic("numDomains(%d) must be a multiple of numSimThreads(%d) for now", numDomains, numSimThreads);
+    //With dynamic scheduling, threads steal domains from readyDomains, so any numDomains/numSimThreads ratio works
+    if (!dynamicSched && (numDomains % numSimThreads) != 0) {
+        panic("numDomains(%d) must be a multiple of numSimThreads(%d) with static contention scheduling", numDomains, numSimThreads);
+    }
+
+    spin_init(&readyLock);
+    readyDomains.reserve(numDomains);
+    domainsFinished = 0;
 
     for (uint32_t i = 0; i < numSimThreads; i++) {
         futex_init(&simThreads[i].wakeLock);
         futex_lock(&simThreads[i].wakeLock); //starts locked, so first actual call to lock blocks
         simThreads[i].firstDomain = i*numDomains/numSimThreads;
         simThreads[i].supDomain = (i+1)*numDomains/numSimThreads;
+        simThreads[i].lastBusyNs = 0;
     }
 
     futex_init(&waitLock);
@@ -100,17 +111,21 @@ ContentionSim::ContentionSim(uint32_t _numDomains, uint32_t _numSimThreads) {
     lastCrossing = gm_calloc<CrossingEventInfo>(numDomains*numDomains*MAX_THREADS); //TODO: refine... this allocs too much
 }
 
+//Timing and OOO cores of the primary and sweep systems (see sweep.h) take part in contention simulation
 void ContentionSim::postInit() {
-    for (uint32_t i = 0; i < zinfo->numCores; i++) {
-        TimingCore* tcore = dynamic_cast<TimingCore*>(zinfo->cores[i]);
-        if (tcore) {
-            skipContention = false;
-            return;
-        }
-        OOOCore* ocore = dynamic_cast<OOOCore*>(zinfo->cores[i]);
-        if (ocore) {
-            skipContention = false;
-            return;
+    for (uint32_t s = 0; s <= zinfo->numSweeps; s++) {
+        Core** cores = SystemCores(s);
+        for (uint32_t i = 0; i < zinfo->numCores; i++) {
+            TimingCore* tcore = dynamic_cast<TimingCore*>(cores[i]);
+            if (tcore) {
+                skipContention = false;
+                return;
+            }
+            OOOCore* ocore = dynamic_cast<OOOCore*>(cores[i]);
+            if (ocore) {
+                skipContention = false;
+                return;
+            }
         }
     }
     skipContention = true;
@@ -134,12 +149,33 @@ void ContentionSim::initStats(AggregateStat* parentStat) {
         domStat->append(&domains[i].profIncomingCrossings);
         domStat->append(&domains[i].profIncomingCrossingSims);
         domStat->append(&domains[i].profIncomingCrossingHist);
+#endif
+#if PROFILE_ENQUEUE_DIST
+        new (&domains[i].profEnqueueDist) VectorCounter();
+        domains[i].profEnqueueDist.init("eqd", "Enqueued event distance from the domain's cycle, log2 histogram", 65);
+        domStat->append(&domains[i].profEnqueueDist);
 #endif
         new (&domains[i].profTime) ClockStat();
         domains[i].profTime.init("time", "Weave simulation time");
         domStat->append(&domains[i].profTime);
+        new (&domains[i].profLookaheadStalls) VectorCounter();
+        domains[i].profLookaheadStalls.init("laStalls", "Times an incoming crossing stalled waiting for its source domain, per source", numDomains);
+        domStat->append(&domains[i].profLookaheadStalls);
         objStat->append(domStat);
     }
+    for (uint32_t i = 0; i < numSimThreads; i++) {
+        std::stringstream ss;
+        ss << "thread-" << i;
+        AggregateStat* thStat = new AggregateStat();
+        thStat->init(gm_strdup(ss.str().c_str()), "Weave thread stats");
+        new (&simThreads[i].profBusy) ClockStat();
+        new (&simThreads[i].profIdle) Counter();
+        simThreads[i].profBusy.init("busy", "Time spent simulating domains (ns)");
+        simThreads[i].profIdle.init("idle", "Time spent in weave phase without a domain to simulate (ns)");
+        thStat->append(&simThreads[i].profBusy);
+        thStat->append(&simThreads[i].profIdle);
+        objStat->append(thStat);
+    }
     parentStat->append(objStat);
 }
 
@@ -150,13 +186,33 @@ void ContentionSim::simulatePhase(uint64_t limit) {
     assert(limit >= lastLimit);
 
     //info("simulatePhase limit %ld", limit);
-    for (uint32_t i = 0; i < zinfo->numCores; i++) {
-        TimingCore* tcore = dynamic_cast<TimingCore*>(zinfo->cores[i]);
-        if (tcore) tcore->cSimStart();
-        OOOCore* ocore = dynamic_cast<OOOCore*>(zinfo->cores[i]);
-        if (ocore) ocore->cSimStart();
+    for (uint32_t s = 0; s <= zinfo->numSweeps; s++) {
+        Core** cores = SystemCores(s);
+        for (uint32_t i = 0; i < zinfo->numCores; i++) {
+            TimingCore* tcore = dynamic_cast<TimingCore*>(cores[i]);
+            if (tcore) tcore->cSimStart();
+            OOOCore* ocore = dynamic_cast<OOOCore*>(cores[i]);
+            if (ocore) ocore->cSimStart();
+        }
+    }
+
+    if (dynamicSched) {
+        //All domains start runnable; sim threads are asleep, so no need to lock
+        //NOTE: Staged events are not in pq yet, so order by curCycle; the claiming thread drains them
+        CompareDomains cmp;
+        readyDomains.clear();
+        for (uint32_t i = 0; i < numDomains; i++) {
+            DomainData* domain = &domains[i];
+            domain->queuePrio = domain->curCycle;
+            readyDomains.push_back(domain);
+            std::push_heap(readyDomains.begin(), readyDomains.end(), cmp);
+        }
+        domainsFinished = 0;
     }
 
+    for (uint32_t i = 0; i < numSimThreads; i++) simThreads[i].lastBusyNs = simThreads[i].profBusy.get();
+    phaseStartNs = getNs();
+
     inCSim = true;
     __sync_synchronize();
 
@@ -168,14 +224,24 @@ void ContentionSim::simulatePhase(uint64_t limit) {
     //Sleep until phase is simulated
     futex_lock_nospin(&waitLock);
 
+    //Whatever part of the phase a thread did not spend simulating domains, it spent idle
+    uint64_t phaseNs = getNs() - phaseStartNs;
+    for (uint32_t i = 0; i < numSimThreads; i++) {
+        uint64_t busyNs = simThreads[i].profBusy.get() - simThreads[i].lastBusyNs;
+        if (phaseNs > busyNs) simThreads[i].profIdle.inc(phaseNs - busyNs);
+    }
+
     inCSim = false;
     __sync_synchronize();
 
-    for (uint32_t i = 0; i < zinfo->numCores; i++) {
-        TimingCore* tcore = dynamic_cast<TimingCore*>(zinfo->cores[i]);
-        if (tcore) tcore->cSimEnd();
-        OOOCore* ocore = dynamic_cast<OOOCore*>(zinfo->cores[i]);
-        if (ocore) ocore->cSimEnd();
+    for (uint32_t s = 0; s <= zinfo->numSweeps; s++) {
+        Core** cores = SystemCores(s);
+        for (uint32_t i = 0; i < zinfo->numCores; i++) {
+            TimingCore* tcore = dynamic_cast<TimingCore*>(cores[i]);
+            if (tcore) tcore->cSimEnd();
+            OOOCore* ocore = dynamic_cast<OOOCore*>(cores[i]);
+            if (ocore) ocore->cSimEnd();
+        }
     }
 
     lastLimit = limit;
@@ -195,6 +261,10 @@ void ContentionSim::enqueue(TimingEvent* ev, uint64_t cycle) {
     assert(ev->domain != -1);
     assert(ev->domain < (int32_t)numDomains);
 
+#if PROFILE_ENQUEUE_DIST
+    uint64_t dist = cycle - domains[ev->domain].curCycle;
+    domains[ev->domain].profEnqueueDist.inc(dist? 64 - __builtin_clzl(dist) : 0);
+#endif
     domains[ev->domain].pq.enqueue(ev, cycle);
 }
 
@@ -202,18 +272,36 @@ void ContentionSim::enqueueSynced(TimingEvent* ev, uint64_t cycle) {
     assert(!inCSim);
     assert(ev && ev->domain != -1);
     assert(ev->domain < (int32_t)numDomains);
-    uint32_t domain = ev->domain;
-
-    futex_lock(&domains[domain].pqLock);
+    DomainData& domain = domains[ev->domain];
 
     assert_msg(cycle >= lastLimit, "Enqueued (synced) event before last limit! cycle %ld min %ld", cycle, lastLimit);
     //Hacky, but helpful to chase events scheduled too far ahead due to bugs (e.g., cycle -1). We should probably formalize this a bit more
     assert_msg(cycle < lastLimit+10*zinfo->phaseLength+10000, "Queued  (synced) event too far into the future, cycle %ld lastLimit %ld", cycle, lastLimit);
     ev->privCycle = cycle;
     assert(ev->numParents == 0);
-    domains[ev->domain].pq.enqueue(ev, cycle);
+    assert(!ev->next);
+
+    //Lock-free push to the domain's staging list; pq is only touched in phase 2
+    TimingEvent* head;
+    do {
+        head = domain.stagedEvs;
+        ev->next = head;
+    } while (!__sync_bool_compare_and_swap(&domain.stagedEvs, head, ev));
+}
 
-    futex_unlock(&domains[domain].pqLock);
+void ContentionSim::drainStagedEvents(DomainData* domain) {
+    //Phase 1 is over, so nobody pushes concurrently; the exchange just makes a repeated drain see an empty list
+    TimingEvent* ev = __sync_lock_test_and_set(&domain->stagedEvs, nullptr);
+    while (ev) {
+        TimingEvent* next = ev->next;
+        ev->next = nullptr;
+#if PROFILE_ENQUEUE_DIST
+        uint64_t dist = ev->privCycle - domain->curCycle;
+        domain->profEnqueueDist.inc(dist? 64 - __builtin_clzl(dist) : 0);
+#endif
+        domain->pq.enqueue(ev, ev->privCycle);
+        ev = next;
+    }
 }
 
 void ContentionSim::enqueueCrossing(CrossingEvent* ev, uint64_t cycle, uint32_t srcId, uint32_t srcDomain, uint32_t dstDomain, EventRecorder* evRec) {
@@ -276,7 +364,13 @@ void ContentionSim::simThreadLoop(uint32_t thid) {
         }
 
         //info("%d --- phase start", domain);
-        simulatePhaseThread(thid);
+        if (dynamicSched) {
+            simulatePhaseThreadDynamic(thid); //accounts busy time per domain it simulates
+        } else {
+            simThreads[thid].profBusy.start();
+            simulatePhaseThread(thid);
+            simThreads[thid].profBusy.end();
+        }
         //info("%d --- phase end", domain);
 
         uint32_t val = __sync_add_and_fetch(&threadsDone, 1);
@@ -292,10 +386,14 @@ void ContentionSim::simulatePhaseThread(uint32_t thid) {
     uint32_t thDomains = simThreads[thid].supDomain - simThreads[thid].firstDomain;
     uint32_t numFinished = 0;
 
+    for (uint32_t i = simThreads[thid].firstDomain; i < simThreads[thid].supDomain; i++) {
+        drainStagedEvents(&domains[i]);
+    }
+
     if (thDomains == 1) {
         DomainData& domain = domains[simThreads[thid].firstDomain];
         domain.profTime.start();
-        PrioQueue<TimingEvent, PQ_BLOCKS>& pq = domain.pq;
+        DomainQueue<TimingEvent>& pq = domain.pq;
         while (pq.size() && pq.firstCycle() < limit) {
             uint64_t domCycle = domain.curCycle;
             uint64_t cycle;
@@ -363,7 +461,7 @@ void ContentionSim::simulatePhaseThread(uint32_t thid) {
             while (domPq.size()) {
                 DomainData* domain = domPq.top();
                 domPq.pop();
-                PrioQueue<TimingEvent, PQ_BLOCKS>& pq = domain->pq;
+                DomainQueue<TimingEvent>& pq = domain->pq;
                 if (!pq.size() || pq.firstCycle() > limit) {
                     numFinished++;
                     domain->curCycle = limit;
@@ -384,7 +482,7 @@ void ContentionSim::simulatePhaseThread(uint32_t thid) {
             while (stalledQueue.size()) {
                 DomainData* domain = stalledQueue.back();
                 stalledQueue.pop_back();
-                PrioQueue<TimingEvent, PQ_BLOCKS>& pq = domain->pq;
+                DomainQueue<TimingEvent>& pq = domain->pq;
                 if (!pq.size() || pq.firstCycle() > limit) {
                     numFinished++;
                     domain->curCycle = limit;
@@ -410,6 +508,66 @@ void ContentionSim::simulatePhaseThread(uint32_t thid) {
     __sync_synchronize();
 }
 
+/* Dynamic scheduling: Each thread claims the least-advanced runnable domain from readyDomains and simulates it
+ * until it runs out of events for this phase, or until it stalls on a crossing (prio != 0), in which case the
+ * domain goes back to readyDomains so that this or another thread can pick it up once its source domain has advanced.
+ * A domain is only ever simulated by its claiming thread, so per-domain cycle ordering is the same as with static
+ * scheduling. Domains never get new events from other domains during the weave phase, so a finished domain stays so.
+ */
+void ContentionSim::simulatePhaseThreadDynamic(uint32_t thid) {
+    SimThreadData& th = simThreads[thid];
+    CompareDomains cmp;
+
+    while (true) {
+        DomainData* domain = nullptr;
+        spin_lock(&readyLock);
+        if (readyDomains.size()) {
+            std::pop_heap(readyDomains.begin(), readyDomains.end(), cmp);
+            domain = readyDomains.back();
+            readyDomains.pop_back();
+        }
+        spin_unlock(&readyLock);
+
+        if (!domain) {
+            if (domainsFinished == numDomains) break;
+            _mm_pause();
+            continue;
+        }
+
+        th.profBusy.start();
+        domain->profTime.start();
+        drainStagedEvents(domain); //only has work the first time the domain is claimed in a phase
+        DomainQueue<TimingEvent>& pq = domain->pq;
+        while (pq.size() && pq.firstCycle() < limit) {
+            uint64_t cycle;
+            TimingEvent* te = pq.dequeue(cycle);
+            assert(cycle >= domain->curCycle);
+            if (cycle != domain->curCycle) domain->curCycle = cycle;
+            te->run(cycle);
+            uint64_t newCycle = pq.size()? pq.firstCycle() : limit;
+            assert(newCycle >= cycle);
+            if (newCycle != domain->curCycle) domain->curCycle = newCycle;
+            if (domain->prio != 0) break; //stalled on a crossing, let other domains advance
+        }
+        bool finished = !pq.size() || pq.firstCycle() >= limit;
+        domain->profTime.end();
+        th.profBusy.end();
+
+        if (finished) {
+            domain->curCycle = limit;
+            __sync_fetch_and_add(&domainsFinished, 1);
+        } else {
+            domain->queuePrio = domain->curCycle;
+            spin_lock(&readyLock);
+            readyDomains.push_back(domain);
+            std::push_heap(readyDomains.begin(), readyDomains.end(), cmp);
+            spin_unlock(&readyLock);
+        }
+    }
+
+    __sync_synchronize();
+}
+
 void ContentionSim::finish() {
     assert(!terminate);
     terminate = true;
@@ -43,6 +43,11 @@
 #define PROFILE_CROSSINGS 0
 //#define PROFILE_CROSSINGS 1
 
+//Set to 1 to record, per domain, a log2 histogram of how far ahead of the domain's current cycle events are
+//enqueued. pqbench replays these distributions through PrioQueue and TimingWheel.
+#define PROFILE_ENQUEUE_DIST 0
+//#define PROFILE_ENQUEUE_DIST 1
+
 class TimingEvent;
 class DelayEvent;
 class CrossingEvent;
@@ -62,13 +67,47 @@ class ContentionSim : public GlobAlloc {
 
         CrossingEventInfo* lastCrossing; //indexed by [srcId*doms*doms + srcDom*doms + dstDom]
 
+        //Per-domain event queue, either the block-based PrioQueue or a TimingWheel (see sim.wheelDomains).
+        //Templated so that its methods are only instantiated where TimingEvent is complete
+        template <typename T>
+        class DomainQueue {
+            private:
+                PrioQueue<T, PQ_BLOCKS>* pq;
+                TimingWheel<T>* tw;
+
+            public:
+                explicit DomainQueue(bool useWheel) : pq(nullptr), tw(nullptr) {
+                    if (useWheel) tw = new (gm_malloc<TimingWheel<T>>()) TimingWheel<T>();
+                    else pq = new (gm_malloc<PrioQueue<T, PQ_BLOCKS>>()) PrioQueue<T, PQ_BLOCKS>();
+                }
+
+                inline void enqueue(T* ev, uint64_t cycle) {
+                    if (tw) tw->enqueue(ev, cycle);
+                    else pq->enqueue(ev, cycle);
+                }
+
+                inline T* dequeue(uint64_t& deqCycle) {
+                    return tw? tw->dequeue(deqCycle) : pq->dequeue(deqCycle);
+                }
+
+                inline uint64_t size() const {
+                    return tw? tw->size() : pq->size();
+                }
+
+                inline uint64_t firstCycle() const {
+                    return tw? tw->firstCycle() : pq->firstCycle();
+                }
+        };
+
         struct DomainData : public GlobAlloc {
-            PrioQueue<TimingEvent, PQ_BLOCKS> pq;
+            DomainQueue<TimingEvent> pq;
 
             PAD();
 
             volatile uint64_t curCycle;
-            lock_t pqLock; //used on phase 1 enqueues
+            //Phase 1 enqueues are pushed here lock-free (linked through TimingEvent::next, cycle in privCycle),
+            //and moved to pq by the thread that simulates this domain at the start of phase 2
+            TimingEvent* volatile stagedEvs;
             //lock_t domainLock; //used by simulation thread
 
             uint32_t prio;
@@ -77,11 +116,15 @@ class ContentionSim : public GlobAlloc {
             PAD();
 
             ClockStat profTime;
+            VectorCounter profLookaheadStalls; //indexed by source domain; only touched by the thread simulating this domain
 
 #if PROFILE_CROSSINGS
             VectorCounter profIncomingCrossingSims;
             VectorCounter profIncomingCrossings;
             VectorCounter profIncomingCrossingHist;
+#endif
+#if PROFILE_ENQUEUE_DIST
+            VectorCounter profEnqueueDist; //bucket 0 is distance 0, bucket b > 0 is [2^(b-1), 2^b)
 #endif
         };
 
@@ -94,6 +137,10 @@ class ContentionSim : public GlobAlloc {
             uint32_t firstDomain;
             uint32_t supDomain; //supreme, ie first not included
 
+            ClockStat profBusy; //time spent simulating domains
+            Counter profIdle; //time spent in the weave phase without a domain to simulate (ns)
+            uint64_t lastBusyNs; //profBusy at the start of the current phase
+
             std::vector<std::pair<uint64_t, TimingEvent*> > logVec;
         };
 
@@ -106,6 +153,15 @@ class ContentionSim : public GlobAlloc {
         uint32_t numDomains;
         uint32_t numSimThreads;
         bool skipContention;
+        bool dynamicSched; //if true, sim threads steal runnable domains from readyDomains instead of using a static partition
+        bool crossingLookahead; //if true, crossings wait on the full minimum latency of their source path, not just the adjacent delays
+
+        PAD();
+
+        //Dynamic scheduling: heap of unclaimed, unfinished domains, ordered by queuePrio
+        lock_t readyLock;
+        g_vector<DomainData*> readyDomains;
+        volatile uint32_t domainsFinished;
 
         PAD();
 
@@ -119,6 +175,7 @@ class ContentionSim : public GlobAlloc {
         volatile uint32_t threadTicket; //used only at init
 
         volatile bool inCSim; //true when inside contention simulation
+        uint64_t phaseStartNs;
 
         PAD();
 
@@ -126,7 +183,7 @@ class ContentionSim : public GlobAlloc {
         lock_t postMortemLock;
 
     public:
-        ContentionSim(uint32_t _numDomains, uint32_t _numSimThreads);
+        ContentionSim(uint32_t _numDomains, uint32_t _numSimThreads, bool _dynamicSched, const std::vector<bool>& wheelDomains, bool _crossingLookahead);
 
         void initStats(AggregateStat* parentStat);
 
@@ -151,6 +208,13 @@ class ContentionSim : public GlobAlloc {
 
         void setPrio(uint32_t domain, uint32_t prio) {domains[domain].prio = prio;}
 
+        bool useCrossingLookahead() const {return crossingLookahead;}
+
+        //Called by the destination domain when a crossing's source has not reached it yet
+        void profileLookaheadStall(uint32_t srcDomain, uint32_t dstDomain) {
+            domains[dstDomain].profLookaheadStalls.inc(srcDomain);
+        }
+
 #if PROFILE_CROSSINGS
         void profileCrossing(uint32_t srcDomain, uint32_t dstDomain, uint32_t count) {
             domains[dstDomain].profIncomingCrossings.inc(srcDomain);
@@ -162,6 +226,8 @@ class ContentionSim : public GlobAlloc {
     private:
         void simThreadLoop(uint32_t thid);
         void simulatePhaseThread(uint32_t thid);
+        void simulatePhaseThreadDynamic(uint32_t thid);
+        void drainStagedEvents(DomainData* domain);
 
         static void SimThreadTrampoline(void* arg);
 };
@@ -37,6 +37,9 @@ struct BblInfo {
     DynBbl oooBbl[0]; //0 bytes, but will be 1-sized when we have an element (and that element has variable size as well)
 };
 
+class CheckpointWriter;
+class CheckpointReader;
+
 /* Analysis function pointer struct
  * As an artifact of having a shared code cache, we need these to be the same for different core types.
  */
@@ -85,6 +88,22 @@ class Core : public GlobAlloc {
         virtual void join() {}
 
         virtual InstrFuncPtrs GetFuncPtrs() = 0;
+
+        //Checkpointing of warmed predictor state (see checkpoint.h); most cores have none
+        virtual void saveState(CheckpointWriter& cw) {}
+        virtual void restoreState(CheckpointReader& cr) {}
+
+        /* Sweep interface (see sweep.h). With sweep systems, the primary core and the sweep cores with the same cid
+         * get the thread's instruction stream through these calls, which never take barriers. Instead, the caller
+         * stops feeding a core once it is pastPhaseEnd(), calls nextPhase() on all of them before taking the barrier,
+         * and resumes them after it.
+         */
+        virtual void sweepBbl(ADDRINT bblAddr, BblInfo* bblInfo) = 0;
+        virtual void sweepLoad(ADDRINT addr, BOOL pred) {}
+        virtual void sweepStore(ADDRINT addr, BOOL pred) {}
+        virtual void sweepBranch(ADDRINT pc, BOOL taken, ADDRINT takenNpc, ADDRINT notTakenNpc) {}
+        virtual bool pastPhaseEnd() const = 0;
+        virtual void nextPhase() = 0;
 };
 
 #endif  // CORE_H_
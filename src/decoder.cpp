@@ -31,9 +31,12 @@
 #include <string.h>
 #include <string>
 #include <vector>
+#include "bbl_cache.h"
 #include "core.h"
 #include "locks.h"
 #include "log.h"
+#include "profile_stats.h"
+#include "zsim.h"
 
 extern "C" {
 #include "xed-interface.h"
@@ -1258,10 +1261,49 @@ static std::vector<uint32_t>* bblApproxOpcodes[MAX_BBLS];
 
 #endif
 
+static BblCache* bblCache = nullptr;
+
+void Decoder::initBblCache(const char* file) {
+#ifdef BBL_PROFILING
+    warn("BBL cache %s disabled, BBL_PROFILING needs to decode every BBL", file);
+#else
+    assert(!bblCache);
+    bblCache = new BblCache(file);
+#endif
+}
+
+void Decoder::flushBblCache(uint64_t instrNs) {
+    if (bblCache) bblCache->flush(instrNs);
+}
+
 BblInfo* Decoder::decodeBbl(BBL bbl, bool oooDecoding) {
     uint32_t instrs = BBL_NumIns(bbl);
     uint32_t bytes = BBL_Size(bbl);
     BblInfo* bblInfo;
+    uint64_t startNs = 0;
+
+    //Try to reuse a previous decode, from another process or a previous run
+    SharedBblTable* bblTable = zinfo->bblTable;
+    BblKey key;
+#ifdef BBL_PROFILING
+    bool keyed = false;  // profiling needs every BBL to be decoded
+#else
+    bool keyed = oooDecoding && (bblTable || bblCache) && GetBblKey(bbl, instrs, bytes, key);
+#endif
+    if (keyed) {
+        if (bblTable) {
+            bblInfo = bblTable->lookup(bbl, key);
+            if (bblInfo) return bblInfo;
+        }
+        if (bblCache) {
+            bblInfo = bblCache->lookup(bbl, key);
+            if (bblInfo) {
+                if (bblTable) bblTable->insert(bbl, key, bblInfo);
+                return bblInfo;
+            }
+        }
+        startNs = getNs();
+    }
 
     if (oooDecoding) {
         //Decode BBL
@@ -1447,6 +1489,11 @@ BblInfo* Decoder::decodeBbl(BBL bbl, bool oooDecoding) {
     bblInfo->instrs = instrs;
     bblInfo->bytes = bytes;
 
+    if (keyed) {
+        if (bblCache) bblCache->insert(bbl, key, bblInfo, getNs() - startNs);
+        if (bblTable) bblTable->insert(bbl, key, bblInfo);
+    }
+
     return bblInfo;
 }
 
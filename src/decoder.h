@@ -128,6 +128,10 @@ class Decoder {
         //If oooDecoding is true, produces a DynBbl with DynUops that can be used in OOO cores
         static BblInfo* decodeBbl(BBL bbl, bool oooDecoding);
 
+        //Persistent decoded-BBL cache (see bbl_cache.h). Per-process; only used with oooDecoding
+        static void initBblCache(const char* file);
+        static void flushBblCache(uint64_t instrNs);  // instrNs: time spent instrumenting, reported with cache stats
+
 #ifdef BBL_PROFILING
         static void profileBbl(uint64_t bblIdx);
         static void dumpBblProfile();
@@ -1122,7 +1122,7 @@ uint64_t MemControllerBase::access(MemReq& req) {
     uint64_t respCycle = req.cycle + minLatency[accessType];
     assert(respCycle >= req.cycle);
 
-    if ((req.type != PUTS) && zinfo->eventRecorders[req.srcId]) {
+    if ((req.type != PUTS) && !req.is(MemReq::WARM) && zinfo->eventRecorders[req.srcId]) {
         Address addr = req.lineAddr;
         MemAccessEventBase* memEv =
             new (zinfo->eventRecorders[req.srcId])
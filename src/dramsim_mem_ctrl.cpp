@@ -111,7 +111,7 @@ uint64_t DRAMSimMemory::access(MemReq& req) {
     uint64_t respCycle = req.cycle + minLatency;
     assert(respCycle > req.cycle);
 
-    if ((req.type != PUTS /*discard clean writebacks*/) && zinfo->eventRecorders[req.srcId]) {
+    if ((req.type != PUTS /*discard clean writebacks*/) && !req.is(MemReq::WARM) && zinfo->eventRecorders[req.srcId]) {
         Address addr = req.lineAddr << lineBits;
         bool isWrite = (req.type == PUTX);
         DRAMSimAccEvent* memEv = new (zinfo->eventRecorders[req.srcId]) DRAMSimAccEvent(this, isWrite, addr, domain);
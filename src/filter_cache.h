@@ -99,7 +99,8 @@ class FilterCache : public Cache {
             parentStat->append(cacheStat);
         }
 
-        inline uint64_t load(Address vAddr, uint64_t curCycle) {
+        // pc is the access's PC signature (see MemReq), passed down to prefetchers on misses
+        inline uint64_t load(Address vAddr, uint64_t curCycle, Address pc = 0) {
             Address vLineAddr = vAddr >> lineBits;
             uint32_t idx = vLineAddr & setMask;
             uint64_t availCycle = filterArray[idx].availCycle; //read before, careful with ordering to avoid timing races
@@ -107,7 +108,7 @@ class FilterCache : public Cache {
                 fGETSHit++;
                 return MAX(curCycle, availCycle);
             } else {
-                return replace(vLineAddr, idx, true, curCycle);
+                return replace(vLineAddr, idx, true, curCycle, pc);
             }
         }
 
@@ -125,11 +126,11 @@ class FilterCache : public Cache {
             }
         }
 
-        uint64_t replace(Address vLineAddr, uint32_t idx, bool isLoad, uint64_t curCycle) {
+        uint64_t replace(Address vLineAddr, uint32_t idx, bool isLoad, uint64_t curCycle, Address pc = 0) {
             Address pLineAddr = procMask | vLineAddr;
             MESIState dummyState = MESIState::I;
             futex_lock(&filterLock);
-            MemReq req = {pLineAddr, isLoad? GETS : GETX, 0, &dummyState, curCycle, &filterLock, dummyState, srcId, reqFlags};
+            MemReq req = {pLineAddr, isLoad? GETS : GETX, 0, &dummyState, curCycle, &filterLock, dummyState, srcId, reqFlags, pc};
             uint64_t respCycle  = access(req);
 
             //Due to the way we do the locking, at this point the old address might be invalidated, but we have the new address guaranteed until we release the lock
@@ -148,8 +149,31 @@ class FilterCache : public Cache {
             return respCycle;
         }
 
+        /* Functional access, used to warm up the hierarchy while fast-forwarding (sim.warmFF). It updates the
+         * arrays and coherence state like a normal access, but is marked MemReq::WARM, so it keeps no stats, traces
+         * or memory timing, and uses a warming source id, which has no event recorder (see zinfo->eventRecorders).
+         * The warming thread does not own this core, whose filter may be in use by a simulated thread, so it never
+         * installs into or reads the filter; it only drops the entry whose line it evicted from the cache, as
+         * invalidate() does.
+         */
+        inline void warm(Address vAddr, bool isLoad, uint64_t curCycle) {
+            Address pLineAddr = procMask | (vAddr >> lineBits);
+            MESIState dummyState = MESIState::I;
+            futex_lock(&filterLock);
+            MemReq req = {pLineAddr, isLoad? GETS : GETX, 0, &dummyState, curCycle, &filterLock, dummyState, srcId + (1 + zinfo->numSweeps)*zinfo->numCores, reqFlags | MemReq::WARM};
+            access(req);
+            if (req.evictedLineAddr) {
+                uint32_t idx = req.evictedLineAddr & setMask;
+                if ((filterArray[idx].rdAddr | procMask) == req.evictedLineAddr) {
+                    filterArray[idx].wrAddr = -1L;
+                    filterArray[idx].rdAddr = -1L;
+                }
+            }
+            futex_unlock(&filterLock);
+        }
+
         uint64_t invalidate(const InvReq& req) {
-            Cache::startInvalidate();  // grabs cache's downLock
+            Cache::startInvalidate(req);  // grabs cache's downLock
             futex_lock(&filterLock);
             uint32_t idx = req.lineAddr & setMask; //works because of how virtual<->physical is done...
             if ((filterArray[idx].rdAddr | procMask) == req.lineAddr) { //FIXME: If another process calls invalidate(), procMask will not match even though we may be doing a capacity-induced invalidation!
@@ -166,6 +190,11 @@ class FilterCache : public Cache {
             for (uint32_t i = 0; i < numSets; i++) filterArray[i].clear();
             futex_unlock(&filterLock);
         }
+
+        void restoreState(CheckpointReader& cr) {
+            Cache::restoreState(cr);
+            contextSwitch(); //the filter may hold lines that are no longer in the cache
+        }
 };
 
 #endif  // FILTER_CACHE_H_
@@ -47,6 +47,11 @@ template <typename T> T* gm_calloc() {return static_cast<T*>(__gm_calloc(1, size
 template <typename T> T* gm_calloc(size_t objs) {return static_cast<T*>(__gm_calloc(objs, sizeof(T)));}
 template <typename T> T* gm_memalign(size_t blocksize) {return static_cast<T*>(__gm_memalign(blocksize, sizeof(T)));}
 template <typename T> T* gm_memalign(size_t blocksize, size_t objs) {return static_cast<T*>(__gm_memalign(blocksize, sizeof(T)*objs));}
+template <typename T> T* gm_calloc_aligned(size_t blocksize, size_t objs) {
+    T* res = gm_memalign<T>(blocksize, objs);
+    memset(res, 0, sizeof(T)*objs);
+    return res;
+}
 template <typename T> T* gm_dup(T* src, size_t objs) {
     T* dst = gm_malloc<T>(objs);
     memcpy(dst, src, sizeof(T)*objs);
@@ -0,0 +1,165 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* H3HashFamily regression check. Compares hash() and hashAll() against the original bitwise H3
+ * implementation (copied below) on random inputs, for all output widths and 1-16 functions.
+ * Exits with an error on the first mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "galloc.h"
+#include "hash.h"
+#include "log.h"
+#include "mtrand.h"
+
+// Original H3HashFamily, as of before byte tables and SIMD kernels. Do not change.
+class RefH3 {
+    private:
+        const uint32_t numFuncs;
+        uint32_t resShift;
+        uint64_t* hMatrix;
+
+    public:
+        RefH3(uint32_t numFunctions, uint32_t outputBits, uint64_t randSeed) : numFuncs(numFunctions) {
+            MTRand rnd(randSeed);
+            if (outputBits <= 8) {
+                resShift = 3;
+            } else if (outputBits <= 16) {
+                resShift = 2;
+            } else if (outputBits <= 32) {
+                resShift = 1;
+            } else {
+                resShift = 0;
+            }
+
+            uint32_t words = 64 >> resShift;
+            hMatrix = gm_calloc<uint64_t>(words*numFuncs);
+            for (uint32_t ii = 0; ii < numFuncs; ii++) {
+                for (uint32_t jj = 0; jj < words; jj++) {
+                    uint64_t val = 0;
+                    for (int kk = 0; kk < 64; kk++) {
+                        val = val << 1;
+                        if (rnd.randInt() % 2 == 0) val++;
+                    }
+                    hMatrix[ii*words + jj] = val;
+                }
+            }
+        }
+
+        ~RefH3() {
+            gm_free(hMatrix);
+        }
+
+        uint64_t hash(uint32_t id, uint64_t val) {
+            uint64_t res = 0;
+            uint32_t maxBits = 64 >> resShift;
+            for (uint32_t x = 0; x < maxBits; x+=8) {
+                uint32_t base = (id << (6 - resShift)) + x;
+                uint64_t res0 = val & hMatrix[base];
+                uint64_t res1 = val & hMatrix[base+1];
+                uint64_t res2 = val & hMatrix[base+2];
+                uint64_t res3 = val & hMatrix[base+3];
+
+                uint64_t res4 = val & hMatrix[base+4];
+                uint64_t res5 = val & hMatrix[base+5];
+                uint64_t res6 = val & hMatrix[base+6];
+                uint64_t res7 = val & hMatrix[base+7];
+
+                res ^= res0 ^ ((res1 << 1) | (res1 >> 63)) ^ ((res2 << 2) | (res2 >> 62)) ^ ((res3 << 3) | (res3 >> 61));
+                res ^= ((res4 << 4) | (res4 >> 60)) ^ ((res5 << 5) | (res5 >> 59)) ^ ((res6 << 6) | (res6 >> 58)) ^ ((res7 << 7) | (res7 >> 57));
+                res = (res << 8) | (res >> 56);
+            }
+
+            switch (resShift) {
+                case 0:
+                    break;
+                case 1:
+                    res = (res >> 32) ^ res;
+                    break;
+                case 2:
+                    res = (res >> 32) ^ res;
+                    res = (res >> 16) ^ res;
+                    break;
+                case 3:
+                    res = (res >> 32) ^ res;
+                    res = (res >> 16) ^ res;
+                    res = (res >> 8) ^ res;
+                    break;
+            }
+            return res;
+        }
+};
+
+static void Mismatch(const char* path, uint32_t funcs, uint32_t bits, uint64_t seed, uint32_t id, uint64_t val, uint64_t ref, uint64_t res) {
+    panic("%s mismatch: %d funcs, %d bits, seed 0x%lx, func %d, val 0x%lx: expected 0x%lx, got 0x%lx",
+            path, funcs, bits, seed, id, val, ref, res);
+}
+
+int main(int argc, const char* argv[]) {
+    InitLog(""); //no log header
+    if (argc > 2) {
+        info("Checks H3HashFamily against the original bitwise implementation on random inputs");
+        info("Usage: %s [<values per configuration> (default 10000)]", argv[0]);
+        exit(1);
+    }
+    uint32_t numVals = (argc >= 2)? strtoul(argv[1], nullptr, 0) : 10000;
+
+    gm_init(64<<20);
+    MTRand rng(0x43C43C);
+    const uint64_t seeds[] = {123132127, 0xCAC7EAFFA1, 0xB4E7AB1E};
+    const uint32_t widths[] = {1, 3, 8, 9, 16, 17, 32, 33, 63, 64};
+
+    uint64_t checked = 0;
+    for (uint64_t seed : seeds) {
+        for (uint32_t bits : widths) {
+            for (uint32_t funcs = 1; funcs <= 16; funcs++) {
+                RefH3 ref(funcs, bits, seed);
+                H3HashFamily* hf = new H3HashFamily(funcs, bits, seed);
+                uint64_t all[16];
+                for (uint32_t i = 0; i < numVals; i++) {
+                    // Mix full-width values with small ones (line addresses have zero high bytes)
+                    uint64_t val = (((uint64_t)rng.randInt()) << 32) | rng.randInt();
+                    if (i & 1) val >>= rng.randInt(63);
+                    for (uint32_t id = 0; id < funcs; id++) {
+                        uint64_t r = ref.hash(id, val);
+                        uint64_t h = hf->hash(id, val);
+                        if (h != r) Mismatch("hash()", funcs, bits, seed, id, val, r, h);
+                    }
+                    uint32_t n = 1 + i % funcs;
+                    hf->hashAll(val, n, all);
+                    for (uint32_t id = 0; id < n; id++) {
+                        uint64_t r = ref.hash(id, val);
+                        if (all[id] != r) Mismatch("hashAll()", funcs, bits, seed, id, val, r, all[id]);
+                    }
+                    checked += funcs + n;
+                }
+                delete hf;
+            }
+        }
+    }
+    info("OK: %ld hashes match", checked);
+    return 0;
+}
@@ -24,10 +24,12 @@
  */
 
 #include "hash.h"
+#include <immintrin.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include "log.h"
 #include "mtrand.h"
+#include "pad.h"
 
 H3HashFamily::H3HashFamily(uint32_t numFunctions, uint32_t outputBits, uint64_t randSeed) : numFuncs(numFunctions) {
     MTRand rnd(randSeed);
@@ -59,13 +61,57 @@ H3HashFamily::H3HashFamily(uint32_t numFunctions, uint32_t outputBits, uint64_t
             hMatrix[ii*words + jj] = val;
         }
     }
+
+    tStride = (numFuncs + 3) & ~3u; //whole AVX2 vectors
+    hMatrixT = gm_calloc<uint64_t>(words*tStride);
+    for (uint32_t ii = 0; ii < numFuncs; ii++) {
+        for (uint32_t jj = 0; jj < words; jj++) {
+            hMatrixT[jj*tStride + ii] = hMatrix[ii*words + jj];
+        }
+    }
+    simd = (numFuncs > 1)? HostSimdLevel() : SIMD_NONE;
+
+    tables = gm_memalign<uint64_t>(CACHE_LINE_BYTES, numFuncs*8*256);
+    for (uint32_t f = 0; f < numFuncs; f++) {
+        for (uint32_t b = 0; b < 8; b++) {
+            for (uint32_t v = 0; v < 256; v++) {
+                tables[(f*8 + b)*256 + v] = hashBits(f, ((uint64_t)v) << (8*b));
+            }
+        }
+    }
 }
 
 H3HashFamily::~H3HashFamily() {
     gm_free(hMatrix);
+    gm_free(hMatrixT);
+    gm_free(tables);
 }
 
-/* NOTE: This is fairly well hand-optimized. Go to the commit logs to see the speedup of this function. Main things:
+inline uint64_t H3HashFamily::fold(uint64_t res) const {
+    // Fold bits to match output
+    switch (resShift) {
+        case 0: //64-bit output
+            break;
+        case 1: //32-bit output
+            res = (res >> 32) ^ res;
+            break;
+        case 2: //16-bit output
+            res = (res >> 32) ^ res;
+            res = (res >> 16) ^ res;
+            break;
+        case 3: //8-bit output
+            res = (res >> 32) ^ res;
+            res = (res >> 16) ^ res;
+            res = (res >> 8) ^ res;
+            break;
+    }
+    return res;
+}
+
+/* Reference implementation, which computes the hash from the matrix bit by bit. We only use it to fill the
+ * byte tables, which produce the same output (see hash()).
+ *
+ * NOTE: This is fairly well hand-optimized. Go to the commit logs to see the speedup of this function. Main things:
  * 1. resShift indicates how many bits of output are computed (64, 32, 16, or 8). With less than 64 bits, several rounds are folded at the end.
  * 2. The output folding does not mask, the output is expected to be masked by caller.
  * 3. The main loop is hand-unrolled and optimized for ILP.
@@ -77,7 +123,7 @@ H3HashFamily::~H3HashFamily() {
  *     res = (res << 1) | (res >> 63);
  * }
  */
-uint64_t H3HashFamily::hash(uint32_t id, uint64_t val) {
+uint64_t H3HashFamily::hashBits(uint32_t id, uint64_t val) {
     uint64_t res = 0;
     assert(id >= 0 && id < numFuncs);
 
@@ -100,29 +146,97 @@ uint64_t H3HashFamily::hash(uint32_t id, uint64_t val) {
         res = (res << 8) | (res >> 56);
     }
 
-    // Fold bits to match output
-    switch (resShift) {
-        case 0: //64-bit output
-            break;
-        case 1: //32-bit output
-            res = (res >> 32) ^ res;
-            break;
-        case 2: //16-bit output
-            res = (res >> 32) ^ res;
-            res = (res >> 16) ^ res;
-            break;
-        case 3: //8-bit output
-            res = (res >> 32) ^ res;
-            res = (res >> 16) ^ res;
-            res = (res >> 8) ^ res;
-            break;
-    }
+    res = fold(res);
 
     //info("0x%lx", res);
 
     return res;
 }
 
+/* Table-driven hash: every step of hashBits() (and, rotate, xor, fold) is linear, so hashing val is the same
+ * as xoring the hashes of each of its bytes in place, which we have precomputed. Bit-identical to hashBits().
+ */
+uint64_t H3HashFamily::hash(uint32_t id, uint64_t val) {
+    assert(id >= 0 && id < numFuncs);
+    const uint64_t* t = &tables[id*8*256];
+    uint64_t res0 = t[0*256 + (val & 0xff)] ^ t[1*256 + ((val >> 8) & 0xff)];
+    uint64_t res1 = t[2*256 + ((val >> 16) & 0xff)] ^ t[3*256 + ((val >> 24) & 0xff)];
+    uint64_t res2 = t[4*256 + ((val >> 32) & 0xff)] ^ t[5*256 + ((val >> 40) & 0xff)];
+    uint64_t res3 = t[6*256 + ((val >> 48) & 0xff)] ^ t[7*256 + (val >> 56)];
+    return (res0 ^ res1) ^ (res2 ^ res3);
+}
+
+/* SIMD kernels for hashAll(). Each vector lane computes a different function on the same value, following
+ * exactly the same unrolled recurrence as hashBits() (so results are bit-identical), with rows taken from the
+ * transposed matrix m (row x of function f is m[x*stride + f]). Lanes are unfolded, the caller folds them.
+ */
+#define ROTL_128(v, n) _mm_or_si128(_mm_slli_epi64((v), (n)), _mm_srli_epi64((v), 64 - (n)))
+#define ROTL_256(v, n) _mm256_or_si256(_mm256_slli_epi64((v), (n)), _mm256_srli_epi64((v), 64 - (n)))
+
+__attribute__((target("sse4.1")))
+static void H3HashSSE4(const uint64_t* m, uint32_t stride, uint32_t maxBits, uint64_t val, uint64_t* out) {
+    __m128i v = _mm_set1_epi64x(val);
+    __m128i res = _mm_setzero_si128();
+    for (uint32_t x = 0; x < maxBits; x += 8) {
+        const uint64_t* row = &m[x*stride];
+        __m128i res0 = _mm_and_si128(v, _mm_loadu_si128((const __m128i*)&row[0]));
+        __m128i res1 = _mm_and_si128(v, _mm_loadu_si128((const __m128i*)&row[stride]));
+        __m128i res2 = _mm_and_si128(v, _mm_loadu_si128((const __m128i*)&row[2*stride]));
+        __m128i res3 = _mm_and_si128(v, _mm_loadu_si128((const __m128i*)&row[3*stride]));
+        __m128i res4 = _mm_and_si128(v, _mm_loadu_si128((const __m128i*)&row[4*stride]));
+        __m128i res5 = _mm_and_si128(v, _mm_loadu_si128((const __m128i*)&row[5*stride]));
+        __m128i res6 = _mm_and_si128(v, _mm_loadu_si128((const __m128i*)&row[6*stride]));
+        __m128i res7 = _mm_and_si128(v, _mm_loadu_si128((const __m128i*)&row[7*stride]));
+
+        res = _mm_xor_si128(res, _mm_xor_si128(_mm_xor_si128(res0, ROTL_128(res1, 1)), _mm_xor_si128(ROTL_128(res2, 2), ROTL_128(res3, 3))));
+        res = _mm_xor_si128(res, _mm_xor_si128(_mm_xor_si128(ROTL_128(res4, 4), ROTL_128(res5, 5)), _mm_xor_si128(ROTL_128(res6, 6), ROTL_128(res7, 7))));
+        res = ROTL_128(res, 8);
+    }
+    _mm_storeu_si128((__m128i*)out, res);
+}
+
+__attribute__((target("avx2")))
+static void H3HashAVX2(const uint64_t* m, uint32_t stride, uint32_t maxBits, uint64_t val, uint64_t* out) {
+    __m256i v = _mm256_set1_epi64x(val);
+    __m256i res = _mm256_setzero_si256();
+    for (uint32_t x = 0; x < maxBits; x += 8) {
+        const uint64_t* row = &m[x*stride];
+        __m256i res0 = _mm256_and_si256(v, _mm256_loadu_si256((const __m256i*)&row[0]));
+        __m256i res1 = _mm256_and_si256(v, _mm256_loadu_si256((const __m256i*)&row[stride]));
+        __m256i res2 = _mm256_and_si256(v, _mm256_loadu_si256((const __m256i*)&row[2*stride]));
+        __m256i res3 = _mm256_and_si256(v, _mm256_loadu_si256((const __m256i*)&row[3*stride]));
+        __m256i res4 = _mm256_and_si256(v, _mm256_loadu_si256((const __m256i*)&row[4*stride]));
+        __m256i res5 = _mm256_and_si256(v, _mm256_loadu_si256((const __m256i*)&row[5*stride]));
+        __m256i res6 = _mm256_and_si256(v, _mm256_loadu_si256((const __m256i*)&row[6*stride]));
+        __m256i res7 = _mm256_and_si256(v, _mm256_loadu_si256((const __m256i*)&row[7*stride]));
+
+        res = _mm256_xor_si256(res, _mm256_xor_si256(_mm256_xor_si256(res0, ROTL_256(res1, 1)), _mm256_xor_si256(ROTL_256(res2, 2), ROTL_256(res3, 3))));
+        res = _mm256_xor_si256(res, _mm256_xor_si256(_mm256_xor_si256(ROTL_256(res4, 4), ROTL_256(res5, 5)), _mm256_xor_si256(ROTL_256(res6, 6), ROTL_256(res7, 7))));
+        res = ROTL_256(res, 8);
+    }
+    _mm256_storeu_si256((__m256i*)out, res);
+}
+
+#undef ROTL_128
+#undef ROTL_256
+
+void H3HashFamily::hashAll(uint64_t val, uint32_t n, uint64_t* res) {
+    assert(n <= numFuncs);
+    if (simd == SIMD_NONE) {
+        HashFamily::hashAll(val, n, res);
+        return;
+    }
+
+    uint32_t maxBits = 64 >> resShift;
+    uint32_t lanes = (simd == SIMD_AVX2)? 4 : 2;
+    uint64_t vres[4];
+    for (uint32_t f = 0; f < n; f += lanes) {
+        if (simd == SIMD_AVX2) H3HashAVX2(&hMatrixT[f], tStride, maxBits, val, vres);
+        else H3HashSSE4(&hMatrixT[f], tStride, maxBits, val, vres);
+        for (uint32_t l = 0; l < lanes && f + l < n; l++) res[f + l] = fold(vres[l]);
+    }
+}
+
 #if _WITH_POLARSSL_
 
 #include "polarssl/sha1.h"
@@ -28,6 +28,7 @@
 
 #include <stdint.h>
 #include "galloc.h"
+#include "simd.h"
 
 class HashFamily : public GlobAlloc {
     public:
@@ -35,6 +36,13 @@ class HashFamily : public GlobAlloc {
         virtual ~HashFamily() {}
 
         virtual uint64_t hash(uint32_t id, uint64_t val) = 0;
+
+        /* Computes functions 0..n-1 of val into res. Families that can compute several functions at once
+         * (e.g., with SIMD) override this; results must match hash() exactly.
+         */
+        virtual void hashAll(uint64_t val, uint32_t n, uint64_t* res) {
+            for (uint32_t i = 0; i < n; i++) res[i] = hash(i, val);
+        }
 };
 
 class H3HashFamily : public HashFamily {
@@ -42,10 +50,26 @@ class H3HashFamily : public HashFamily {
         const uint32_t numFuncs;
         uint32_t resShift;
         uint64_t* hMatrix;
+
+        //Transposed copy of hMatrix (row x of all functions is contiguous, padded to tStride funcs), for hashAll()
+        uint64_t* hMatrixT;
+        uint32_t tStride;
+        SimdLevel simd;
+
+        /* H3 is linear over GF(2), so hash(val) is the XOR of the hashes of each byte of val in place. tables
+         * has the hashes of all 256 values of each of the 8 bytes of each function, laid out as [function][byte][value].
+         */
+        uint64_t* tables;
+
     public:
         H3HashFamily(uint32_t numFunctions, uint32_t outputBits, uint64_t randSeed = 123132127);
         virtual ~H3HashFamily();
         uint64_t hash(uint32_t id, uint64_t val);
+        void hashAll(uint64_t val, uint32_t n, uint64_t* res);
+
+    private:
+        uint64_t hashBits(uint32_t id, uint64_t val); //reference implementation, used to fill tables
+        inline uint64_t fold(uint64_t res) const;
 };
 
 class SHA1HashFamily : public HashFamily {
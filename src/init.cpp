@@ -31,8 +31,10 @@
 #include <string>
 #include <sys/time.h>
 #include <vector>
+#include "bbl_cache.h"
 #include "cache.h"
 #include "cache_arrays.h"
+#include "checkpoint.h"
 #include "config.h"
 #include "constants.h"
 #include "contention_sim.h"
@@ -53,6 +55,7 @@
 #include "network.h"
 #include "null_core.h"
 #include "ooo_core.h"
+#include "opt_repl_policy.h"
 #include "part_repl_policies.h"
 #include "pin_cmd.h"
 #include "prefetcher.h"
@@ -61,11 +64,14 @@
 #include "process_tree.h"
 #include "profile_stats.h"
 #include "repl_policies.h"
+#include "rrip_repl_policies.h"
+#include "sampling.h"
 #include "scheduler.h"
 #include "simple_core.h"
 #include "stats.h"
 #include "stats_filter.h"
 #include "str.h"
+#include "sweep.h"
 #include "timing_cache.h"
 #include "timing_core.h"
 #include "timing_event.h"
@@ -143,14 +149,26 @@ BaseCache* BuildCacheBank(Config& config, const string& prefix, g_string& name,
 
     //Replacement policy
     string replType = config.get<const char*>(prefix + "repl.type", (arrayType == "IdealLRUPart")? "IdealLRUPart" : "LRU");
-    ReplPolicy* rp = nullptr;
 
+    // Lock striping: lets accesses to different set groups of a (typically shared) bank proceed in parallel.
+    // Only SetAssoc arrays keep all replacement candidates in the requested line's set, and only plain LRU keeps
+    // per-line replacement state (with a timestamp per stripe); Timing/Tracing caches keep bank-wide state, and
+    // SHA1 hashing memoizes, so we disallow those.
+    uint32_t lockStripes = config.get<uint32_t>(prefix + "lockStripes", 1);
+    if (!isPow2(lockStripes) || lockStripes > numSets) panic("%s: lockStripes must be a power of 2 and <= sets (%d)", name.c_str(), numSets);
+    if (lockStripes > 1) {
+        if (isTerminal || type != "Simple") panic("%s: lockStripes requires a non-terminal, Simple cache", name.c_str());
+        if (arrayType != "SetAssoc" || hashType == "SHA1") panic("%s: lockStripes requires a SetAssoc array with None or H3 hashing", name.c_str());
+        if (replType != "LRU" && replType != "LRUNoSh") panic("%s: lockStripes requires LRU or LRUNoSh replacement", name.c_str());
+    }
+
+    ReplPolicy* rp = nullptr;
     if (replType == "LRU" || replType == "LRUNoSh") {
         bool sharersAware = (replType == "LRU") && !isTerminal;
         if (sharersAware) {
-            rp = new LRUReplPolicy<true>(numLines);
+            rp = new LRUReplPolicy<true>(numLines, ways, lockStripes);
         } else {
-            rp = new LRUReplPolicy<false>(numLines);
+            rp = new LRUReplPolicy<false>(numLines, ways, lockStripes);
         }
     } else if (replType == "LFU") {
         rp = new LFUReplPolicy(numLines);
@@ -164,6 +182,25 @@ BaseCache* BuildCacheBank(Config& config, const string& prefix, g_string& name,
         rp = new NRUReplPolicy(numLines, candidates);
     } else if (replType == "Rand") {
         rp = new RandReplPolicy(candidates);
+    } else if (replType == "SRRIP" || replType == "BRRIP" || replType == "DRRIP" || replType == "SHiP") {
+        uint32_t rrpvBits = config.get<uint32_t>(prefix + "repl.rrpvBits", 2);
+        if (rrpvBits < 1 || rrpvBits > 7) panic("%s: repl.rrpvBits must be in 1-7 (%d given)", name.c_str(), rrpvBits);
+        if (replType == "SRRIP") {
+            rp = new SRRIPReplPolicy(numLines, numSets, rrpvBits);
+        } else if (replType == "BRRIP") {
+            rp = new BRRIPReplPolicy(numLines, numSets, rrpvBits);
+        } else if (replType == "DRRIP") {
+            rp = new DRRIPReplPolicy(numLines, numSets, rrpvBits);
+        } else {
+            rp = new SHiPReplPolicy(numLines, numSets, rrpvBits);
+        }
+    } else if (replType == "Hawkeye") {
+        if (ways >= 256) panic("%s: Hawkeye supports up to 255 ways (%d given)", name.c_str(), ways);
+        rp = new HawkeyeReplPolicy(numLines, numSets, ways);
+    } else if (replType == "OPT") {
+        if (!zinfo->traceDriven) panic("%s: OPT replacement needs future knowledge, only works in trace-driven simulation", name.c_str());
+        if (!zinfo->nextUseTable) zinfo->nextUseTable = new NextUseTable(config.get<const char*>("sim.traceFile"), zinfo->outputDir);
+        rp = new OPTReplPolicy(numLines, zinfo->nextUseTable);
     } else if (replType == "WayPart" || replType == "Vantage" || replType == "IdealLRUPart") {
         if (replType == "WayPart" && arrayType != "SetAssoc") panic("WayPart replacement requires SetAssoc array");
 
@@ -265,7 +302,7 @@ BaseCache* BuildCacheBank(Config& config, const string& prefix, g_string& name,
     if (isTerminal) {
         cc = new MESITerminalCC(numLines, name);
     } else {
-        cc = new MESICC(numLines, nonInclusiveHack, name);
+        cc = new MESICC(numLines, nonInclusiveHack, name, lockStripes, hf);
     }
     rp->setCC(cc);
     if (!isTerminal) {
@@ -278,7 +315,7 @@ BaseCache* BuildCacheBank(Config& config, const string& prefix, g_string& name,
             cache = new TimingCache(numLines, cc, array, rp, accLat, invLat, mshrs, tagLat, ways, timingCandidates, domain, name);
         } else if (type == "Tracing") {
             g_string traceFile = config.get<const char*>(prefix + "traceFile","");
-            if (traceFile.empty()) traceFile = g_string(zinfo->outputDir) + "/" + name + ".trace";
+            if (traceFile.empty()) traceFile = g_string(zinfo->outputDir) + "/" + name + ".trace";  // HDF5, or native if it ends in TRACE_NATIVE_SUFFIX
             cache = new TracingCache(numLines, cc, array, rp, accLat, invLat, traceFile, name);
         } else {
             panic("Invalid cache type %s", type.c_str());
@@ -323,12 +360,12 @@ DDRMemory* BuildDDRMemory(Config& config, uint32_t lineSize, uint32_t frequency,
     return mem;
 }
 
-MemObject* BuildMemoryController(Config& config, uint32_t lineSize, uint32_t frequency, uint32_t domain, g_string& name) {
+MemObject* BuildMemoryController(Config& config, const string& prefix, uint32_t lineSize, uint32_t frequency, uint32_t domain, g_string& name) {
     //Type
-    string type = config.get<const char*>("sys.mem.type", "Simple");
+    string type = config.get<const char*>(prefix + "type", "Simple");
 
     //Latency
-    uint32_t latency = (type == "DDR")? -1 : config.get<uint32_t>("sys.mem.latency", 100);
+    uint32_t latency = (type == "DDR")? -1 : config.get<uint32_t>(prefix + "latency", 100);
 
     MemObject* mem = nullptr;
     if (type == "Simple") {
@@ -339,29 +376,29 @@ MemObject* BuildMemoryController(Config& config, uint32_t lineSize, uint32_t fre
         // a single CCT across the system, and we are dealing with latencies in *core* clock cycles
 
         // Peak bandwidth (in MB/s)
-        uint32_t bandwidth = config.get<uint32_t>("sys.mem.bandwidth", 6400);
+        uint32_t bandwidth = config.get<uint32_t>(prefix + "bandwidth", 6400);
 
         mem = new MD1Memory(lineSize, frequency, bandwidth, latency, name);
     } else if (type == "WeaveMD1") {
-        uint32_t bandwidth = config.get<uint32_t>("sys.mem.bandwidth", 6400);
-        uint32_t boundLatency = config.get<uint32_t>("sys.mem.boundLatency", latency);
+        uint32_t bandwidth = config.get<uint32_t>(prefix + "bandwidth", 6400);
+        uint32_t boundLatency = config.get<uint32_t>(prefix + "boundLatency", latency);
         mem = new WeaveMD1Memory(lineSize, frequency, bandwidth, latency, boundLatency, domain, name);
     } else if (type == "WeaveSimple") {
-        uint32_t boundLatency = config.get<uint32_t>("sys.mem.boundLatency", 100);
+        uint32_t boundLatency = config.get<uint32_t>(prefix + "boundLatency", 100);
         mem = new WeaveSimpleMemory(latency, boundLatency, domain, name);
     } else if (type == "DDR") {
-        mem = BuildDDRMemory(config, lineSize, frequency, domain, name, "sys.mem.");
+        mem = BuildDDRMemory(config, lineSize, frequency, domain, name, prefix);
     } else if (type == "DRAMSim") {
         uint64_t cpuFreqHz = 1000000 * frequency;
-        uint32_t capacity = config.get<uint32_t>("sys.mem.capacityMB", 16384);
-        string dramTechIni = config.get<const char*>("sys.mem.techIni");
-        string dramSystemIni = config.get<const char*>("sys.mem.systemIni");
-        string outputDir = config.get<const char*>("sys.mem.outputDir");
-        string traceName = config.get<const char*>("sys.mem.traceName");
+        uint32_t capacity = config.get<uint32_t>(prefix + "capacityMB", 16384);
+        string dramTechIni = config.get<const char*>(prefix + "techIni");
+        string dramSystemIni = config.get<const char*>(prefix + "systemIni");
+        string outputDir = config.get<const char*>(prefix + "outputDir");
+        string traceName = config.get<const char*>(prefix + "traceName");
         mem = new DRAMSimMemory(dramTechIni, dramSystemIni, outputDir, traceName, capacity, cpuFreqHz, latency, domain, name);
     } else if (type == "Detailed") {
         // FIXME(dsm): Don't use a separate config file... see DDRMemory
-        g_string mcfg = config.get<const char*>("sys.mem.paramFile", "");
+        g_string mcfg = config.get<const char*>(prefix + "paramFile", "");
         mem = new MemControllerBase(mcfg, lineSize, frequency, domain, name);
     } else {
         panic("Invalid memory controller type %s", type.c_str());
@@ -371,22 +408,38 @@ MemObject* BuildMemoryController(Config& config, uint32_t lineSize, uint32_t fre
 
 typedef vector<vector<BaseCache*>> CacheGroup;
 
-CacheGroup* BuildCacheGroup(Config& config, const string& name, bool isTerminal) {
+CacheGroup* BuildCacheGroup(Config& config, const string& sysPrefix, const string& name, bool isTerminal) {
     CacheGroup* cgp = new CacheGroup;
     CacheGroup& cg = *cgp;
 
-    string prefix = "sys.caches." + name + ".";
+    string prefix = sysPrefix + "caches." + name + ".";
 
     bool isPrefetcher = config.get<bool>(prefix + "isPrefetcher", false);
     if (isPrefetcher) { //build a prefetcher group
         uint32_t prefetchers = config.get<uint32_t>(prefix + "prefetchers", 1);
+        string type = config.get<const char*>(prefix + "type", "Stream");
         cg.resize(prefetchers);
         for (vector<BaseCache*>& bg : cg) bg.resize(1);
         for (uint32_t i = 0; i < prefetchers; i++) {
             stringstream ss;
             ss << name << "-" << i;
             g_string pfName(ss.str().c_str());
-            cg[i][0] = new StreamPrefetcher(pfName);
+            if (type == "Stream") {
+                cg[i][0] = new StreamPrefetcher(pfName);
+            } else if (type == "IPStride") {
+                uint32_t entries = config.get<uint32_t>(prefix + "entries", 256);
+                uint32_t degree = config.get<uint32_t>(prefix + "degree", 4);
+                if (!isPow2(entries)) panic("%s: entries (%d) must be a power of 2", name.c_str(), entries);
+                cg[i][0] = new IPStridePrefetcher(pfName, entries, degree);
+            } else if (type == "SPP") {
+                uint32_t threshold = config.get<uint32_t>(prefix + "threshold", 25);  // percent
+                if (!threshold || threshold > 100) panic("%s: threshold (%d) must be in 1-100", name.c_str(), threshold);
+                cg[i][0] = new SPPPrefetcher(pfName, threshold);
+            } else if (type == "BestOffset") {
+                cg[i][0] = new BestOffsetPrefetcher(pfName);
+            } else {
+                panic("%s: Invalid prefetcher type %s", name.c_str(), type.c_str());
+            }
         }
         return cgp;
     }
@@ -419,7 +472,12 @@ CacheGroup* BuildCacheGroup(Config& config, const string& name, bool isTerminal)
     return cgp;
 }
 
-static void InitSystem(Config& config) {
+/* Builds the caches, cores and memory controllers of the system described by the sysPrefix group ("sys." for the
+ * primary system). Sweep systems (sweep != nullptr, see sweep.h) keep their cores and L1s in sweep, and their cores'
+ * event recorders use source ids from sweep->srcIdBase. Stats go to parentStat. In trace-driven simulation,
+ * spawnThread starts the trace driver's decode thread.
+ */
+static void InitSystem(Config& config, const string& sysPrefix, SweepSystem* sweep, AggregateStat* parentStat, TraceThreadSpawnFn spawnThread) {
     unordered_map<string, string> parentMap; //child -> parent
     unordered_map<string, vector<vector<string>>> childMap; //parent -> children (a parent may have multiple children)
 
@@ -434,13 +492,13 @@ static void InitSystem(Config& config) {
     };
 
     // If a network file is specified, build a Network
-    string networkFile = config.get<const char*>("sys.networkFile", "");
+    string networkFile = config.get<const char*>(sysPrefix + "networkFile", "");
     Network* network = (networkFile != "")? new Network(networkFile.c_str()) : nullptr;
 
     // Build the caches
     vector<const char*> cacheGroupNames;
-    config.subgroups("sys.caches", cacheGroupNames);
-    string prefix = "sys.caches.";
+    config.subgroups(sysPrefix + "caches", cacheGroupNames);
+    string prefix = sysPrefix + "caches.";
 
     for (const char* grp : cacheGroupNames) {
         string group(grp);
@@ -482,7 +540,7 @@ static void InitSystem(Config& config) {
         string group = fringe.front();
         fringe.pop_front();
         if (cMap.count(group)) panic("The cache 'tree' has a loop at %s", group.c_str());
-        cMap[group] = BuildCacheGroup(config, group, isTerminal(group));
+        cMap[group] = BuildCacheGroup(config, sysPrefix, group, isTerminal(group));
         for (auto& childVec : childMap[group]) fringe.insert(fringe.end(), childVec.begin(), childVec.end());
     }
 
@@ -494,7 +552,7 @@ static void InitSystem(Config& config) {
      */
 
     //Build the memory controllers
-    uint32_t memControllers = config.get<uint32_t>("sys.mem.controllers", 1);
+    uint32_t memControllers = config.get<uint32_t>(sysPrefix + "mem.controllers", 1);
     assert(memControllers > 0);
 
     g_vector<MemObject*> mems;
@@ -506,11 +564,11 @@ static void InitSystem(Config& config) {
         g_string name(ss.str().c_str());
         //uint32_t domain = nextDomain(); //i*zinfo->numDomains/memControllers;
         uint32_t domain = i*zinfo->numDomains/memControllers;
-        mems[i] = BuildMemoryController(config, zinfo->lineSize, zinfo->freqMHz, domain, name);
+        mems[i] = BuildMemoryController(config, sysPrefix + "mem.", zinfo->lineSize, zinfo->freqMHz, domain, name);
     }
 
     if (memControllers > 1) {
-        bool splitAddrs = config.get<bool>("sys.mem.splitAddrs", true);
+        bool splitAddrs = config.get<bool>(sysPrefix + "mem.splitAddrs", true);
         if (splitAddrs) {
             MemObject* splitter = new SplitAddrMemory(mems, "mem-splitter");
             mems.resize(1);
@@ -614,15 +672,16 @@ static void InitSystem(Config& config) {
         //Instantiate the cores
         vector<const char*> coreGroupNames;
         unordered_map <string, vector<Core*>> coreMap;
-        config.subgroups("sys.cores", coreGroupNames);
+        config.subgroups(sysPrefix + "cores", coreGroupNames);
 
         uint32_t coreIdx = 0;
+        uint32_t srcIdOffset = sweep? sweep->srcIdBase : 0;
         for (const char* group : coreGroupNames) {
             if (parentMap.count(group)) panic("Core group name %s is invalid, a cache group already has that name", group);
 
             coreMap[group] = vector<Core*>();
 
-            string prefix = string("sys.cores.") + group + ".";
+            string prefix = sysPrefix + "cores." + group + ".";
             uint32_t cores = config.get<uint32_t>(prefix + "cores", 1);
             string type = config.get<const char*>(prefix + "type", "Simple");
 
@@ -668,7 +727,7 @@ static void InitSystem(Config& config) {
                     }
                     FilterCache* ic = dynamic_cast<FilterCache*>(igroup[assignedCaches[icache]][0]);
                     assert(ic);
-                    ic->setSourceId(coreIdx);
+                    ic->setSourceId(coreIdx + srcIdOffset);
                     ic->setFlags(MemReq::IFETCH | MemReq::NOEXCL);
                     assignedCaches[icache]++;
 
@@ -677,7 +736,7 @@ static void InitSystem(Config& config) {
                     }
                     FilterCache* dc = dynamic_cast<FilterCache*>(dgroup[assignedCaches[dcache]][0]);
                     assert(dc);
-                    dc->setSourceId(coreIdx);
+                    dc->setSourceId(coreIdx + srcIdOffset);
                     assignedCaches[dcache]++;
 
                     //Build the core
@@ -686,16 +745,24 @@ static void InitSystem(Config& config) {
                     } else if (type == "Timing") {
                         uint32_t domain = j*zinfo->numDomains/cores;
                         TimingCore* tcore = new (&timingCores[j]) TimingCore(ic, dc, domain, name);
-                        zinfo->eventRecorders[coreIdx] = tcore->getEventRecorder();
-                        zinfo->eventRecorders[coreIdx]->setSourceId(coreIdx);
+                        zinfo->eventRecorders[coreIdx + srcIdOffset] = tcore->getEventRecorder();
+                        zinfo->eventRecorders[coreIdx + srcIdOffset]->setSourceId(coreIdx + srcIdOffset);
                         core = tcore;
                     } else {
                         assert(type == "OOO");
                         OOOCore* ocore = new (&oooCores[j]) OOOCore(ic, dc, name);
-                        zinfo->eventRecorders[coreIdx] = ocore->getEventRecorder();
-                        zinfo->eventRecorders[coreIdx]->setSourceId(coreIdx);
+                        zinfo->eventRecorders[coreIdx + srcIdOffset] = ocore->getEventRecorder();
+                        zinfo->eventRecorders[coreIdx + srcIdOffset]->setSourceId(coreIdx + srcIdOffset);
                         core = ocore;
                     }
+                    if (sweep) {
+                        if (coreIdx >= zinfo->numCores) panic("%s: sweep system %s has more cores than sys (%d)", name.c_str(), sweep->name, zinfo->numCores);
+                        sweep->l1is[coreIdx] = ic;
+                        sweep->l1ds[coreIdx] = dc;
+                    } else {
+                        zinfo->coreL1is[coreIdx] = ic;
+                        zinfo->coreL1ds[coreIdx] = dc;
+                    }
                     coreMap[group].push_back(core);
                     coreIdx++;
                 }
@@ -719,18 +786,27 @@ static void InitSystem(Config& config) {
             }
         }
 
-        //Populate global core info
-        assert(zinfo->numCores == coreIdx);
-        zinfo->cores = gm_memalign<Core*>(CACHE_LINE_BYTES, zinfo->numCores);
+        //Populate global core info (sweep systems map cids to their cores 1:1)
+        if (sweep) {
+            if (coreIdx != zinfo->numCores) panic("Sweep system %s has %d cores, must have as many as sys (%d)", sweep->name, coreIdx, zinfo->numCores);
+        } else {
+            assert(zinfo->numCores == coreIdx);
+        }
+        Core** coreArray = gm_memalign<Core*>(CACHE_LINE_BYTES, zinfo->numCores);
         coreIdx = 0;
-        for (const char* group : coreGroupNames) for (Core* core : coreMap[group]) zinfo->cores[coreIdx++] = core;
+        for (const char* group : coreGroupNames) for (Core* core : coreMap[group]) coreArray[coreIdx++] = core;
+        if (sweep) {
+            sweep->cores = coreArray;
+        } else {
+            zinfo->cores = coreArray;
+        }
 
         //Init stats: cores
         for (const char* group : coreGroupNames) {
             AggregateStat* groupStat = new AggregateStat(true);
             groupStat->init(gm_strdup(group), "Core stats");
             for (Core* core : coreMap[group]) core->initStats(groupStat);
-            zinfo->rootStat->append(groupStat);
+            parentStat->append(groupStat);
         }
     } else {  // trace-driven: create trace driver and proxy caches
         vector<TraceDriverProxyCache*> proxies;
@@ -751,16 +827,18 @@ static void InitSystem(Config& config) {
         zinfo->traceDriver = new TraceDriver(traceFile, retraceFile, proxies,
                 config.get<bool>("sim.useSkews", true), // incorporate skews in to playback and simulator results, not only the output trace
                 config.get<bool>("sim.playPuts", true),
-                config.get<bool>("sim.playAllGets", true));
+                config.get<bool>("sim.playAllGets", true), spawnThread);
         zinfo->traceDriver->initStats(zinfo->rootStat);
     }
 
-    //Init stats: caches, mem
+    //Init stats: caches, mem (only the primary system's caches are checkpointed)
+    if (!sweep) zinfo->caches = new g_vector<BaseCache*>();
     for (const char* group : cacheGroupNames) {
         AggregateStat* groupStat = new AggregateStat(true);
         groupStat->init(gm_strdup(group), "Cache stats");
         for (vector<BaseCache*>& banks : *cMap[group]) for (BaseCache* bank : banks) bank->initStats(groupStat);
-        zinfo->rootStat->append(groupStat);
+        if (!sweep) for (vector<BaseCache*>& banks : *cMap[group]) zinfo->caches->insert(zinfo->caches->end(), banks.begin(), banks.end());
+        parentStat->append(groupStat);
     }
 
     //Initialize event recorders
@@ -769,13 +847,17 @@ static void InitSystem(Config& config) {
     AggregateStat* memStat = new AggregateStat(true);
     memStat->init("mem", "Memory controller stats");
     for (auto mem : mems) mem->initStats(memStat);
-    zinfo->rootStat->append(memStat);
+    parentStat->append(memStat);
 
     //Odds and ends: BuildCacheGroup new'd the cache groups, we need to delete them
     for (pair<string, CacheGroup*> kv : cMap) delete kv.second;
     cMap.clear();
 
-    info("Initialized system");
+    if (sweep) {
+        info("Initialized sweep system %s", sweep->name);
+    } else {
+        info("Initialized system");
+    }
 }
 
 static void PreInitStats() {
@@ -858,7 +940,7 @@ static void InitGlobalStats() {
 }
 
 
-void SimInit(const char* configFile, const char* outputDir, uint32_t shmid) {
+void SimInit(const char* configFile, const char* outputDir, uint32_t shmid, TraceThreadSpawnFn spawnThread) {
     zinfo = gm_calloc<GlobSimInfo>();
     zinfo->outputDir = gm_strdup(outputDir);
     zinfo->statsBackends = new g_vector<StatsBackend*>();
@@ -900,9 +982,28 @@ void SimInit(const char* configFile, const char* outputDir, uint32_t shmid) {
 
     zinfo->numDomains = config.get<uint32_t>("sim.domains", 1);
     uint32_t numSimThreads = config.get<uint32_t>("sim.contentionThreads", MAX((uint32_t)1, zinfo->numDomains/2)); //gives a bit of parallelism, TODO tune
-    zinfo->contentionSim = new ContentionSim(zinfo->numDomains, numSimThreads);
+    // Static: each sim thread simulates a fixed slice of domains; Dynamic: idle sim threads steal runnable domains
+    string contentionSched = config.get<const char*>("sim.contentionSched", "Static");
+    if (contentionSched != "Static" && contentionSched != "Dynamic") panic("Invalid sim.contentionSched %s", contentionSched.c_str());
+    // Domains whose events go in a timing wheel instead of a PrioQueue; better for domains with many far-off events (e.g., memory)
+    vector<bool> wheelDomains = ParseMask(config.get<const char*>("sim.wheelDomains", ""), zinfo->numDomains);
+    // If set, crossings use the minimum latency of their whole source path (e.g., network and access delays) as lookahead,
+    // so destination domains run further ahead and re-check stalled crossings less often
+    bool crossingLookahead = config.get<bool>("sim.crossingLookahead", false);
+    zinfo->contentionSim = new ContentionSim(zinfo->numDomains, numSimThreads, contentionSched == "Dynamic", wheelDomains, crossingLookahead);
     zinfo->contentionSim->initStats(zinfo->rootStat);
-    zinfo->eventRecorders = gm_calloc<EventRecorder*>(zinfo->numCores);
+
+    //Sweep systems (see sweep.h), fed the same instruction stream as the primary one
+    vector<const char*> sweepNames;
+    config.subgroups("sweep", sweepNames);
+    if (!sweepNames.empty() && zinfo->traceDriven) panic("Sweep systems need cores, can't be used in trace-driven simulation");
+    zinfo->numSweeps = sweepNames.size();
+    zinfo->sweeps = gm_calloc<SweepSystem*>(zinfo->numSweeps);
+    uint32_t numSrcIds = (1 + zinfo->numSweeps)*zinfo->numCores;
+    if (numSrcIds > MAX_THREADS) panic("%d cores in %d systems exceed the %d source ids contention simulation supports", zinfo->numCores, 1 + zinfo->numSweeps, MAX_THREADS);
+    zinfo->eventRecorders = gm_calloc<EventRecorder*>(2*numSrcIds); //ids >= numSrcIds are for warming accesses, never set
+    zinfo->coreL1is = gm_calloc<FilterCache*>(zinfo->numCores);
+    zinfo->coreL1ds = gm_calloc<FilterCache*>(zinfo->numCores);
 
     zinfo->traceWriters = new g_vector<AccessTraceWriter*>();
 
@@ -931,6 +1032,44 @@ void SimInit(const char* configFile, const char* outputDir, uint32_t shmid) {
     zinfo->ignoreHooks = config.get<bool>("sim.ignoreHooks", false);
     zinfo->ffReinstrument = config.get<bool>("sim.ffReinstrument", false);
     if (zinfo->ffReinstrument) warn("sim.ffReinstrument = true, switching fast-forwarding on a multi-threaded process may be unstable");
+    zinfo->bufferedMemInstr = config.get<bool>("sim.bufferedMemInstr", false);
+    zinfo->warmFF = config.get<bool>("sim.warmFF", false);
+    if (zinfo->warmFF && zinfo->ffReinstrument) panic("sim.warmFF needs memory instrumentation while fast-forwarding, so it can't be used with sim.ffReinstrument");
+
+    //Persistent decoded-BBL cache; relative paths are relative to the output dir
+    string bblCacheFile = config.get<const char*>("sim.bblCache", "");
+    if (bblCacheFile.empty()) {
+        zinfo->bblCacheFile = nullptr;
+    } else {
+        if (bblCacheFile[0] != '/') bblCacheFile = string(zinfo->outputDir) + "/" + bblCacheFile;
+        zinfo->bblCacheFile = gm_strdup(bblCacheFile.c_str());
+    }
+
+    //Checkpoints of warmed state; relative paths are relative to the output dir
+    string ckptSave = config.get<const char*>("sim.checkpointSave", "");
+    string ckptRestore = config.get<const char*>("sim.checkpointRestore", "");
+    if (!ckptSave.empty() && !ckptRestore.empty()) panic("sim.checkpointSave and sim.checkpointRestore are mutually exclusive");
+    //Warming threads access the caches outside the barrier, so they would race with the save/restore
+    if (zinfo->warmFF && (!ckptSave.empty() || !ckptRestore.empty())) panic("sim.warmFF can't be used with sim.checkpointSave or sim.checkpointRestore");
+    if (!ckptSave.empty() && ckptSave[0] != '/') ckptSave = string(zinfo->outputDir) + "/" + ckptSave;
+    if (!ckptRestore.empty() && ckptRestore[0] != '/') ckptRestore = string(zinfo->outputDir) + "/" + ckptRestore;
+    zinfo->checkpointSaveFile = ckptSave.empty()? nullptr : gm_strdup(ckptSave.c_str());
+    zinfo->checkpointRestoreFile = ckptRestore.empty()? nullptr : gm_strdup(ckptRestore.c_str());
+    string ckptAt = config.get<const char*>("sim.checkpointAt", "ROI");
+    if (ckptAt == "ROI") {
+        zinfo->checkpointTrigger = CKPT_ROI;
+    } else if (ckptAt == "Magic") {
+        zinfo->checkpointTrigger = CKPT_MAGIC;
+    } else if (ckptAt == "Instrs") {
+        zinfo->checkpointTrigger = CKPT_INSTRS;
+        if (zinfo->traceDriven) panic("sim.checkpointAt = Instrs needs cores, can't be used in trace-driven simulation");
+    } else {
+        panic("Invalid sim.checkpointAt %s (must be ROI, Magic or Instrs)", ckptAt.c_str());
+    }
+    zinfo->checkpointInstrs = config.get<uint64_t>("sim.checkpointInstrs", 0);
+    zinfo->checkpointExit = config.get<bool>("sim.checkpointExit", true);
+    zinfo->checkpointRequested = false;
+    zinfo->checkpointDone = !zinfo->checkpointSaveFile && !zinfo->checkpointRestoreFile;
 
     zinfo->registerThreads = config.get<bool>("sim.registerThreads", false);
     zinfo->globalPauseFlag = config.get<bool>("sim.startInGlobalPause", false);
@@ -977,7 +1116,36 @@ void SimInit(const char* configFile, const char* outputDir, uint32_t shmid) {
     zinfo->pinCmd = new PinCmd(&config, nullptr /*don't pass config file to children --- can go either way, it's optional*/, outputDir, shmid);
 
     //Caches, cores, memory controllers
-    InitSystem(config);
+    InitSystem(config, "sys.", nullptr, zinfo->rootStat, spawnThread);
+
+    //Sweep systems
+    AggregateStat* sweepStats = nullptr;
+    if (zinfo->numSweeps) {
+        sweepStats = new AggregateStat();
+        sweepStats->init("sweep", "Sweep system stats");
+        zinfo->rootStat->append(sweepStats);
+    }
+    for (uint32_t s = 0; s < zinfo->numSweeps; s++) {
+        SweepSystem* sweep = new SweepSystem(gm_strdup(sweepNames[s]), (1 + s)*zinfo->numCores);
+        AggregateStat* sysStat = new AggregateStat();
+        sysStat->init(sweep->name, "Sweep system stats");
+        InitSystem(config, string("sweep.") + sweepNames[s] + ".", sweep, sysStat, nullptr);
+        sweepStats->append(sysStat);
+        zinfo->sweeps[s] = sweep;
+    }
+
+    //Decoded-BBL table shared across processes (needs OOO decoding, so only after all cores are created)
+    zinfo->bblTable = nullptr;
+    if (config.get<bool>("sim.sharedBblTable", false)) {
+        uint32_t buckets = config.get<uint32_t>("sim.sharedBblTableBuckets", 1 << 16);
+        if (!isPow2(buckets)) panic("sim.sharedBblTableBuckets must be a power of two, %d", buckets);
+        if (zinfo->oooDecode) {
+            zinfo->bblTable = new SharedBblTable(buckets);
+            zinfo->bblTable->initStats(zinfo->rootStat);
+        } else {
+            warn("sim.sharedBblTable only applies to OOO cores, and there are none; ignoring it");
+        }
+    }
 
     //Sched stats (deferred because of circular deps)
     if (zinfo->sched) zinfo->sched->initStats(zinfo->rootStat);
@@ -991,6 +1159,29 @@ void SimInit(const char* configFile, const char* outputDir, uint32_t shmid) {
         zinfo->procStats = nullptr;
     }
 
+    //Systematic sampling (needs all the stats it reads misses from)
+    uint64_t samplingPeriod = config.get<uint64_t>("sim.samplingPeriod", 0);
+    if (samplingPeriod) {
+        if (zinfo->traceDriven) panic("sim.samplingPeriod needs a simulated process, can't be used in trace-driven simulation");
+        if (zinfo->numProcs != 1) panic("sim.samplingPeriod supports a single process (has %d)", zinfo->numProcs);
+        if (!zinfo->procArray[0]->isInFastForward()) panic("sim.samplingPeriod needs process0.startFastForwarded = true");
+        if (!zinfo->procArray[0]->getFFIPoints().empty()) panic("sim.samplingPeriod and process0.ffiPoints are mutually exclusive");
+        if (!zinfo->warmFF) warn("Sampling without sim.warmFF, caches will be cold at the start of every sample");
+        //Windows end on phase boundaries, so they should span a few phases
+        uint64_t warmup = config.get<uint64_t>("sim.samplingWarmup", 50000);
+        uint64_t window = config.get<uint64_t>("sim.samplingWindow", 50000);
+        double errorBound = config.get<double>("sim.samplingErrorBound", 0.03);
+        double confidence = config.get<double>("sim.samplingConfidence", 0.997);
+        uint32_t minSamples = config.get<uint32_t>("sim.samplingMinSamples", 30);
+        //Misses are the sum of the stats that match this filter, MPKI is not estimated if none does
+        const char* missFilter = config.get<const char*>("sim.samplingMissStats", "l3\\..*\\.mGET(S|XIM|XSM)");
+        AggregateStat* missStats = strlen(missFilter)? FilterStats(zinfo->rootStat, missFilter) : nullptr;
+        zinfo->sampler = new Sampler(samplingPeriod, warmup, window, errorBound, confidence, minSamples, missStats);
+        zinfo->sampler->initStats(zinfo->rootStat);
+    } else {
+        zinfo->sampler = nullptr;
+    }
+
     //It's a global stat, but I want it to be last...
     zinfo->profHeartbeats = new VectorCounter();
     zinfo->profHeartbeats->init("heartbeats", "Per-process heartbeats", zinfo->lineSize);
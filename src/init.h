@@ -27,8 +27,9 @@
 #define INIT_H_
 
 #include <stdint.h>
+#include "access_tracing.h"
 
-/* Read configuration options, configure system */
-void SimInit(const char* configFile, const char* outputDir, uint32_t shmid);
+/* Read configuration options, configure system. spawnThread starts the trace driver's decode thread. */
+void SimInit(const char* configFile, const char* outputDir, uint32_t shmid, TraceThreadSpawnFn spawnThread);
 
 #endif  // INIT_H_
@@ -0,0 +1,230 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "instr_trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include "bithacks.h"
+#include "log.h"
+
+static const uint64_t ITRACE_MAGIC = 0x45434152545a535aL;  // "ZSZTRACE"
+static const uint32_t ITRACE_VERSION = 1;
+static const uint32_t ITRACE_HAS_UOPS = 1;
+static const size_t ITRACE_BUF_BYTES = 1 << 20;
+
+// Tags: InstrTraceRecordType in the low 3 bits, flag in bit 3. BBL definitions use their own (internal) type.
+static const uint8_t TAG_BBL_DEF = 7;
+static const uint8_t TAG_TYPE_MASK = 0x7;
+static const uint8_t TAG_FLAG = 0x8;
+
+struct InstrTraceHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t flags;
+    uint32_t uopBytes;  // sizeof(DynUop) of the recording build
+    uint32_t pad;
+};
+
+/* Writer */
+
+InstrTraceWriter::InstrTraceWriter(const char* _path, bool _hasUops)
+    : path(_path), hasUops(_hasUops), buf(ITRACE_BUF_BYTES), bufPos(0), lastMemAddr(0), lastBblAddr(0), records(0), bytes(0)
+{
+    f = fopen(_path, "w");
+    if (!f) panic("Could not open instruction trace %s for writing", _path);
+    InstrTraceHeader hdr = {ITRACE_MAGIC, ITRACE_VERSION, hasUops? ITRACE_HAS_UOPS : 0, (uint32_t)sizeof(DynUop), 0};
+    if (fwrite(&hdr, sizeof(hdr), 1, f) != 1) panic("%s: write failed", path.c_str());
+    bytes = sizeof(hdr);
+}
+
+InstrTraceWriter::~InstrTraceWriter() {
+    flush();
+    fclose(f);
+    info("Instruction trace %s: %ld records, %ld bytes (%.2f bytes/record)", path.c_str(), records, bytes, records? ((double)bytes)/records : 0.0);
+}
+
+void InstrTraceWriter::bbl(uint64_t bblAddr, const BblInfo* bblInfo) {
+    auto it = bblIds.find(bblInfo);
+    if (likely(it != bblIds.end())) {
+        ensure(1 + 10);
+        putByte(ITR_BBL);
+        putVarint(it->second);
+    } else {
+        uint32_t id = bblIds.size();
+        bblIds[bblInfo] = id;
+        uint32_t uops = hasUops? bblInfo->oooBbl[0].uops : 0;
+        size_t uopBytes = uops*sizeof(DynUop);
+        size_t maxBytes = 1 + 6*10 + uopBytes;
+        ensure(maxBytes);
+        if (maxBytes > buf.size()) buf.resize(maxBytes);  // huge BBL
+        putByte(TAG_BBL_DEF);
+        putVarint(id);
+        putVarint(bblAddr);
+        putVarint(bblInfo->instrs);
+        putVarint(bblInfo->bytes);
+        if (hasUops) {
+            putVarint(bblInfo->oooBbl[0].approxInstrs);
+            putVarint(uops);
+            memcpy(&buf[bufPos], bblInfo->oooBbl[0].uop, uopBytes);
+            bufPos += uopBytes;
+        }
+    }
+    lastBblAddr = bblAddr;
+    records++;
+}
+
+void InstrTraceWriter::memOp(InstrTraceRecordType type, uint64_t addr, bool executed) {
+    ensure(1 + 10);
+    putByte(type | (executed? TAG_FLAG : 0));
+    putSigned(addr - lastMemAddr);
+    lastMemAddr = addr;
+    records++;
+}
+
+void InstrTraceWriter::branch(uint64_t pc, bool taken, uint64_t takenNpc, uint64_t notTakenNpc) {
+    ensure(1 + 3*10);
+    putByte(ITR_BRANCH | (taken? TAG_FLAG : 0));
+    putSigned(pc - lastBblAddr);
+    putSigned(takenNpc - pc);
+    putSigned(notTakenNpc - pc);
+    records++;
+}
+
+void InstrTraceWriter::flush() {
+    if (!bufPos) return;
+    if (fwrite(buf.data(), 1, bufPos, f) != bufPos) panic("%s: write failed", path.c_str());
+    bytes += bufPos;
+    bufPos = 0;
+    fflush(f);
+}
+
+/* Reader */
+
+InstrTraceReader::InstrTraceReader(const char* _path, bool needUops)
+    : path(_path), buf(ITRACE_BUF_BYTES), bufPos(0), bufLen(0), lastMemAddr(0), lastBblAddr(0)
+{
+    f = fopen(_path, "r");
+    if (!f) panic("Could not open instruction trace %s", _path);
+    InstrTraceHeader hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != ITRACE_MAGIC) panic("%s is not an instruction trace", _path);
+    if (hdr.version != ITRACE_VERSION) panic("%s: unsupported trace version %d (expected %d)", _path, hdr.version, ITRACE_VERSION);
+    hasUops = hdr.flags & ITRACE_HAS_UOPS;
+    if (hasUops && hdr.uopBytes != sizeof(DynUop)) panic("%s: recorded with a different uop format (%d bytes/uop, expected %ld)", _path, hdr.uopBytes, sizeof(DynUop));
+    if (needUops && !hasUops) panic("%s has no decoded uops, and OOO cores need them; record it on a system with OOO cores", _path);
+}
+
+InstrTraceReader::~InstrTraceReader() {
+    fclose(f);
+    for (BblInfo* bi : bbls) free(bi);
+}
+
+void InstrTraceReader::refill() {
+    assert(bufPos == bufLen);
+    bufLen = fread(buf.data(), 1, buf.size(), f);
+    bufPos = 0;
+}
+
+void InstrTraceReader::getBytes(void* dst, size_t n) {
+    uint8_t* d = static_cast<uint8_t*>(dst);
+    while (n) {
+        if (bufPos == bufLen) {
+            refill();
+            if (bufPos == bufLen) panic("%s: truncated trace", path.c_str());
+        }
+        size_t chunk = MIN(n, bufLen - bufPos);
+        memcpy(d, &buf[bufPos], chunk);
+        bufPos += chunk;
+        d += chunk;
+        n -= chunk;
+    }
+}
+
+void InstrTraceReader::readBblDef() {
+    uint32_t id = getVarint();
+    if (id != bbls.size()) panic("%s: out-of-order BBL definition %d (expected %ld)", path.c_str(), id, bbls.size());
+    uint64_t addr = getVarint();
+    uint32_t instrs = getVarint();
+    uint32_t bytes = getVarint();
+
+    // Same layout as the Decoder's BblInfos (oooBbl is only valid if the trace has uops)
+    BblInfo* bi;
+    if (hasUops) {
+        uint32_t approxInstrs = getVarint();
+        uint32_t uops = getVarint();
+        bi = static_cast<BblInfo*>(malloc(offsetof(BblInfo, oooBbl) + DynBbl::bytes(uops)));
+        bi->oooBbl[0].init(addr, uops, approxInstrs);
+        bi->oooBbl[0].addr = addr;
+        getBytes(bi->oooBbl[0].uop, uops*sizeof(DynUop));
+    } else {
+        bi = static_cast<BblInfo*>(malloc(sizeof(BblInfo)));
+    }
+    bi->instrs = instrs;
+    bi->bytes = bytes;
+    bbls.push_back(bi);
+    bblAddrs.push_back(addr);
+    lastBblAddr = addr;
+}
+
+bool InstrTraceReader::next(InstrTraceRecord& rec) {
+    if (eof()) return false;
+    uint8_t tag = getByte();
+    uint8_t type = tag & TAG_TYPE_MASK;
+    rec.flag = tag & TAG_FLAG;
+    switch (type) {
+        case TAG_BBL_DEF:
+            readBblDef();
+            rec.type = ITR_BBL;
+            rec.addr = lastBblAddr;
+            rec.bblInfo = bbls.back();
+            break;
+        case ITR_BBL:
+            {
+                uint64_t id = getVarint();
+                if (id >= bbls.size()) panic("%s: undefined BBL %ld", path.c_str(), id);
+                rec.type = ITR_BBL;
+                rec.bblInfo = bbls[id];
+                rec.addr = bblAddrs[id];
+                lastBblAddr = rec.addr;
+            }
+            break;
+        case ITR_LOAD:
+        case ITR_STORE:
+        case ITR_PRED_LOAD:
+        case ITR_PRED_STORE:
+            rec.type = (InstrTraceRecordType)type;
+            lastMemAddr += getSigned();
+            rec.addr = lastMemAddr;
+            break;
+        case ITR_BRANCH:
+            rec.type = ITR_BRANCH;
+            rec.addr = lastBblAddr + getSigned();
+            rec.takenNpc = rec.addr + getSigned();
+            rec.notTakenNpc = rec.addr + getSigned();
+            break;
+        default:
+            panic("%s: corrupt trace, tag 0x%x", path.c_str(), tag);
+    }
+    return true;
+}
@@ -0,0 +1,176 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INSTR_TRACE_H_
+#define INSTR_TRACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "core.h"
+
+/* Compact per-thread instruction traces (processN.recordInstrTrace, processN.instrTrace)
+ *
+ * A trace holds the sequence of analysis calls that a simulated thread made to
+ * its core: BBLs, loads, stores, and conditional branches. Replaying it feeds
+ * the core exactly what instrumentation did, without running (or attaching to)
+ * the original program, so replays are deterministic and can be run with any
+ * system config. itracesim replays traces without Pin, on Simple cores;
+ * itracecheck checks that traces read back what was written.
+ *
+ * The file is a header followed by a stream of records. Each record is a tag
+ * byte (type in the low bits, a flag above them) and LEB128 varints. Each BBL
+ * is defined inline the first time it is executed, with its decoded uops if
+ * the recording system decoded them, and is referenced by id afterwards.
+ * Addresses are delta-encoded against the previous memory address, and
+ * branch PCs against the current BBL.
+ */
+
+enum InstrTraceRecordType {
+    ITR_BBL,         // bblAddr, bblInfo
+    ITR_LOAD,        // addr
+    ITR_STORE,       // addr
+    ITR_PRED_LOAD,   // addr, flag (executed)
+    ITR_PRED_STORE,  // addr, flag (executed)
+    ITR_BRANCH,      // pc, flag (taken), takenNpc, notTakenNpc
+};
+
+struct InstrTraceRecord {
+    InstrTraceRecordType type;
+    bool flag;
+    uint64_t addr;  // bblAddr, memory address or branch pc
+    uint64_t takenNpc;
+    uint64_t notTakenNpc;
+    BblInfo* bblInfo;
+};
+
+class InstrTraceWriter {
+    private:
+        FILE* f;
+        std::string path;
+        bool hasUops;
+        std::vector<uint8_t> buf;
+        size_t bufPos;
+
+        std::unordered_map<const BblInfo*, uint32_t> bblIds;
+        uint64_t lastMemAddr;
+        uint64_t lastBblAddr;
+        uint64_t records;
+        uint64_t bytes;
+
+    public:
+        // If hasUops is set, BblInfos must have been decoded with OOO uops, and the trace includes them
+        InstrTraceWriter(const char* _path, bool _hasUops);
+        ~InstrTraceWriter();
+
+        void bbl(uint64_t bblAddr, const BblInfo* bblInfo);
+        void memOp(InstrTraceRecordType type, uint64_t addr, bool executed = true);
+        void branch(uint64_t pc, bool taken, uint64_t takenNpc, uint64_t notTakenNpc);
+
+        void flush();
+
+    private:
+        inline void ensure(size_t n) {
+            if (bufPos + n > buf.size()) flush();
+        }
+
+        inline void putByte(uint8_t b) {
+            buf[bufPos++] = b;
+        }
+
+        inline void putVarint(uint64_t v) {
+            while (v >= 0x80) {
+                buf[bufPos++] = (v & 0x7f) | 0x80;
+                v >>= 7;
+            }
+            buf[bufPos++] = v;
+        }
+
+        inline void putSigned(int64_t v) {
+            putVarint((((uint64_t)v) << 1) ^ (uint64_t)(v >> 63));  // zigzag
+        }
+};
+
+class InstrTraceReader {
+    private:
+        FILE* f;
+        std::string path;
+        std::vector<uint8_t> buf;
+        size_t bufPos, bufLen;
+
+        bool hasUops;
+        std::vector<BblInfo*> bbls;  // by id, malloc'd
+        std::vector<uint64_t> bblAddrs;
+        uint64_t lastMemAddr;
+        uint64_t lastBblAddr;
+
+    public:
+        // If needUops is set, panics unless the trace includes decoded uops
+        InstrTraceReader(const char* _path, bool needUops);
+        ~InstrTraceReader();
+
+        // Returns false at the end of the trace
+        bool next(InstrTraceRecord& rec);
+
+    private:
+        void refill();
+
+        inline bool eof() {
+            if (bufPos == bufLen) refill();
+            return bufPos == bufLen;
+        }
+
+        inline uint8_t getByte() {
+            if (bufPos == bufLen) {
+                refill();
+                if (bufPos == bufLen) panic("%s: truncated trace", path.c_str());
+            }
+            return buf[bufPos++];
+        }
+
+        inline uint64_t getVarint() {
+            uint64_t v = 0;
+            uint32_t shift = 0;
+            while (true) {
+                uint8_t b = getByte();
+                v |= ((uint64_t)(b & 0x7f)) << shift;
+                if (!(b & 0x80)) return v;
+                shift += 7;
+                if (shift >= 64) panic("%s: corrupt trace", path.c_str());
+            }
+        }
+
+        inline int64_t getSigned() {
+            uint64_t v = getVarint();
+            return (int64_t)((v >> 1) ^ -(v & 1));
+        }
+
+        void getBytes(void* dst, size_t n);
+        void readBblDef();
+};
+
+#endif  // INSTR_TRACE_H_
@@ -0,0 +1,164 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* Instruction trace round-trip check. Writes a random stream of records (BBLs from a pool of
+ * synthetic BBLs, plain and predicated loads and stores with near and far addresses, and branches)
+ * with InstrTraceWriter, reads it back with InstrTraceReader, and checks that every record matches.
+ * Runs once without uops and once with random uops, which must come back byte for byte.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "galloc.h"
+#include "instr_trace.h"
+#include "log.h"
+#include "mtrand.h"
+
+using namespace std;
+
+static const uint32_t NUM_BBLS = 4096;
+static const uint32_t MAX_UOPS = 300;  // some BBLs larger than a trace buffer refill boundary is likely
+
+static uint64_t RandAddr(MTRand& rng) {
+    return (((uint64_t)rng.randInt()) << 16) ^ rng.randInt();
+}
+
+static bool Check(const char* path, uint64_t numRecords, bool uops) {
+    MTRand rng(uops? 0x17AC3 : 0x17AC2);
+
+    // BBLs keep the same address, as the writer identifies them by their BblInfo
+    vector<BblInfo*> bbls(NUM_BBLS);
+    vector<uint64_t> bblAddrs(NUM_BBLS);
+    for (uint32_t i = 0; i < NUM_BBLS; i++) {
+        bblAddrs[i] = 0x400000 + 64ul*i + rng.randInt(63);
+        uint32_t n = 1 + rng.randInt(MAX_UOPS - 1);
+        BblInfo* bi = static_cast<BblInfo*>(malloc(offsetof(BblInfo, oooBbl) + DynBbl::bytes(n)));
+        bi->instrs = 1 + rng.randInt(n - 1);
+        bi->bytes = 1 + rng.randInt(4*n);
+        bi->oooBbl[0].init(bblAddrs[i], n, bi->instrs);
+        bi->oooBbl[0].addr = bblAddrs[i];
+        uint8_t* u = reinterpret_cast<uint8_t*>(bi->oooBbl[0].uop);
+        for (uint32_t b = 0; b < n*sizeof(DynUop); b++) u[b] = rng.randInt(255);
+        bbls[i] = bi;
+    }
+
+    vector<InstrTraceRecord> recs(numRecords);
+    uint64_t lastMem = RandAddr(rng);
+    uint32_t curBbl = 0;
+    for (InstrTraceRecord& r : recs) {
+        memset(&r, 0, sizeof(r));
+        uint32_t type = rng.randInt(9);
+        if (type < 2) {
+            curBbl = rng.randInt(NUM_BBLS - 1);
+            r.type = ITR_BBL;
+            r.addr = bblAddrs[curBbl];
+            r.bblInfo = bbls[curBbl];
+        } else if (type < 8) {
+            r.type = (InstrTraceRecordType)(ITR_LOAD + rng.randInt(3));
+            r.flag = (r.type == ITR_LOAD || r.type == ITR_STORE)? true : rng.randInt(1);
+            lastMem = rng.randInt(3)? lastMem + (int64_t)rng.randInt(1024) - 512 : RandAddr(rng);
+            r.addr = lastMem;
+        } else {
+            r.type = ITR_BRANCH;
+            r.flag = rng.randInt(1);
+            r.addr = bblAddrs[curBbl] + rng.randInt(bbls[curBbl]->bytes);
+            r.takenNpc = rng.randInt(1)? r.addr - rng.randInt(1 << 20) : r.addr + rng.randInt(1 << 20);
+            r.notTakenNpc = r.addr + 1 + rng.randInt(14);
+        }
+    }
+
+    {
+        InstrTraceWriter w(path, uops);
+        for (const InstrTraceRecord& r : recs) {
+            switch (r.type) {
+                case ITR_BBL: w.bbl(r.addr, r.bblInfo); break;
+                case ITR_BRANCH: w.branch(r.addr, r.flag, r.takenNpc, r.notTakenNpc); break;
+                default: w.memOp(r.type, r.addr, r.flag);
+            }
+        }
+    }
+
+    bool ok = true;
+    InstrTraceReader* tr = new InstrTraceReader(path, uops);
+    InstrTraceRecord rec;
+    for (uint64_t i = 0; i < numRecords && ok; i++) {
+        const InstrTraceRecord& r = recs[i];
+        if (!tr->next(rec)) {
+            warn("Trace ends at record %ld of %ld", i, numRecords);
+            ok = false;
+            break;
+        }
+        bool match = rec.type == r.type && rec.addr == r.addr && rec.flag == r.flag;
+        if (match && r.type == ITR_BBL) {
+            const BblInfo* a = r.bblInfo;
+            const BblInfo* b = rec.bblInfo;
+            match = a->instrs == b->instrs && a->bytes == b->bytes;
+            if (match && uops) {
+                match = a->oooBbl[0].uops == b->oooBbl[0].uops && a->oooBbl[0].approxInstrs == b->oooBbl[0].approxInstrs &&
+                    a->oooBbl[0].addr == b->oooBbl[0].addr &&
+                    memcmp(a->oooBbl[0].uop, b->oooBbl[0].uop, a->oooBbl[0].uops*sizeof(DynUop)) == 0;
+            }
+        } else if (match && r.type == ITR_BRANCH) {
+            match = rec.takenNpc == r.takenNpc && rec.notTakenNpc == r.notTakenNpc;
+        }
+        if (!match) {
+            warn("Record %ld differs: wrote type %d addr 0x%lx flag %d, read type %d addr 0x%lx flag %d",
+                    i, r.type, r.addr, r.flag, rec.type, rec.addr, rec.flag);
+            ok = false;
+        }
+    }
+    if (ok && tr->next(rec)) {
+        warn("Trace has records past the %ld written", numRecords);
+        ok = false;
+    }
+    delete tr;
+    for (BblInfo* bi : bbls) free(bi);
+    return ok;
+}
+
+int main(int argc, const char* argv[]) {
+    InitLog(""); //no log header
+    if (argc > 3) {
+        info("Checks that instruction traces read back exactly what was written");
+        info("Usage: %s [<trace file> (default itracecheck.trace, removed afterwards)] [<Krecords> (default 2000)]", argv[0]);
+        exit(1);
+    }
+    const char* path = (argc >= 2)? argv[1] : "itracecheck.trace";
+    uint64_t numRecords = ((argc >= 3)? strtoul(argv[2], nullptr, 0) : 2000)*1000ul;
+
+    bool ok = true;
+    for (uint32_t uops = 0; uops < 2; uops++) {
+        bool res = Check(path, numRecords, uops);
+        info("%s: %ld records %s", uops? "With uops" : "Without uops", numRecords, res? "match" : "DIFFER");
+        ok &= res;
+    }
+    remove(path);
+    if (!ok) panic("Instruction trace round-trip check failed");
+    info("OK");
+    return 0;
+}
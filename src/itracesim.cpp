@@ -0,0 +1,270 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Standalone instruction trace replay, without Pin. Replays the per-thread traces that
+ * processN.recordInstrTrace writes (see instr_trace.h) together, one Simple (IPC=1) core per
+ * trace, over the real cache models: private L1i, L1d and L2 per core, a shared LLC, and a
+ * fixed-latency memory. Cores advance in phases, as in the bound phase, so threads interleave
+ * as they would in zsim, and replays are deterministic.
+ *
+ * OOO and Timing cores need weave (contention) simulation, which runs on Pin threads, so they
+ * are not available here; replay their traces inside zsim (processN.instrTrace) instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "cache.h"
+#include "cache_arrays.h"
+#include "coherence_ctrls.h"
+#include "contention_sim.h"
+#include "filter_cache.h"
+#include "galloc.h"
+#include "hash.h"
+#include "instr_trace.h"
+#include "log.h"
+#include "mem_ctrls.h"
+#include "profile_stats.h"
+#include "repl_policies.h"
+#include "simple_core.h"
+#include "stats.h"
+#include "zsim.h"
+
+using namespace std;
+
+GlobSimInfo* zinfo = nullptr;
+uint32_t lineBits = 6;
+uint64_t procMask = 0;
+Core* cores[MAX_THREADS];
+
+// Referenced by the Pin-side core and cache code, which this tool never runs
+uint32_t getCid(uint32_t tid) { panic("No threads in itracesim"); }
+uint32_t TakeBarrier(uint32_t tid, uint32_t cid) { panic("No barriers in itracesim"); }
+void ContentionSim::enqueue(TimingEvent* ev, uint64_t cycle) { panic("No contention simulation in itracesim"); }
+void ContentionSim::enqueueSynced(TimingEvent* ev, uint64_t cycle) { panic("No contention simulation in itracesim"); }
+void ContentionSim::enqueueCrossing(CrossingEvent* ev, uint64_t cycle, uint32_t srcId, uint32_t srcDomain, uint32_t dstDomain, EventRecorder* evRec) {
+    panic("No contention simulation in itracesim");
+}
+
+// Simple core driven from a trace instead of instrumentation
+class ReplayCore : public SimpleCore {
+    private:
+        InstrTraceReader* tr;
+        uint64_t records;
+
+    public:
+        ReplayCore(FilterCache* _l1i, FilterCache* _l1d, g_string& _name, const char* trace)
+            : SimpleCore(_l1i, _l1d, _name), tr(new InstrTraceReader(trace, false)), records(0)
+        {
+            phaseEndCycle = 0;
+        }
+
+        uint64_t getRecords() const {return records;}
+
+        /* Runs the current phase. Like BblFunc, the core stops at the first BBL that takes it past the end of the
+         * phase, and skips phases it is already past. Returns false at the end of the trace.
+         */
+        bool runPhase() {
+            phaseEndCycle = zinfo->globPhaseCycles + zinfo->phaseLength;
+            if (curCycle > phaseEndCycle) return true;
+            InstrTraceRecord rec;
+            while (tr->next(rec)) {
+                records++;
+                switch (rec.type) {
+                    case ITR_BBL:
+                        sweepBbl(rec.addr, rec.bblInfo);
+                        if (curCycle > phaseEndCycle) return true;
+                        break;
+                    case ITR_LOAD:
+                        sweepLoad(rec.addr, true);
+                        break;
+                    case ITR_STORE:
+                        sweepStore(rec.addr, true);
+                        break;
+                    case ITR_PRED_LOAD:
+                        sweepLoad(rec.addr, rec.flag);
+                        break;
+                    case ITR_PRED_STORE:
+                        sweepStore(rec.addr, rec.flag);
+                        break;
+                    case ITR_BRANCH:
+                        break;  // Simple cores have no branch predictor
+                }
+            }
+            delete tr;
+            tr = nullptr;
+            return false;
+        }
+};
+
+static Cache* BuildCache(const string& name, uint32_t sizeKB, uint32_t ways, uint32_t latency, bool l1) {
+    g_string gname(name.c_str());
+    uint32_t numLines = sizeKB*1024/64;
+    if (!ways || numLines % ways || !isPow2(numLines/ways)) panic("%s: number of sets must be a power of two", name.c_str());
+    HashFamily* hf = l1? (HashFamily*) new IdHashFamily() : new H3HashFamily(1, 31 - __builtin_clz(numLines/ways), 0xCAC7EAFFA1);
+    ReplPolicy* rp = l1? (ReplPolicy*) new LRUReplPolicy<false>(numLines) : new LRUReplPolicy<true>(numLines);
+    CacheArray* array = new SetAssocArray(numLines, ways, rp, hf);
+    CC* cc = l1? (CC*) new MESITerminalCC(numLines, gname) : new MESICC(numLines, false, gname, 1, hf);
+    rp->setCC(cc);
+    if (l1) return new FilterCache(numLines/ways, numLines, cc, array, rp, latency, latency, gname);
+    return new Cache(numLines, cc, array, rp, latency, latency, gname);
+}
+
+int main(int argc, const char* argv[]) {
+    InitLog(""); //no log header
+    uint32_t l2KB = 256;
+    uint32_t llcKB = 8192;
+    uint32_t memLatency = 200;
+    uint32_t phaseLength = 10000;
+    const char* statsFile = nullptr;
+    vector<const char*> traces;
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] != '-') {
+            traces.push_back(argv[i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-l2") == 0) {
+            l2KB = strtoul(argv[++i], nullptr, 0);
+        } else if (i + 1 < argc && strcmp(argv[i], "-llc") == 0) {
+            llcKB = strtoul(argv[++i], nullptr, 0);
+        } else if (i + 1 < argc && strcmp(argv[i], "-mem") == 0) {
+            memLatency = strtoul(argv[++i], nullptr, 0);
+        } else if (i + 1 < argc && strcmp(argv[i], "-phase") == 0) {
+            phaseLength = strtoul(argv[++i], nullptr, 0);
+        } else if (i + 1 < argc && strcmp(argv[i], "-stats") == 0) {
+            statsFile = argv[++i];
+        } else {
+            traces.clear();
+            break;
+        }
+    }
+    if (traces.empty() || !phaseLength) {
+        info("Replays instruction traces (one per thread) on Simple cores with private L1s and L2s and a shared LLC");
+        info("Usage: %s [-l2 <KB> (default 256)] [-llc <KB> (default 8192)] [-mem <latency> (default 200)]", argv[0]);
+        info("       [-phase <cycles> (default 10000)] [-stats <text stats file>] <trace> [<trace> ...]");
+        exit(1);
+    }
+
+    uint32_t numCores = traces.size();
+    if (numCores > MAX_THREADS) panic("At most %d traces", MAX_THREADS);
+    gm_init((64ul << 20) + 2*64ul*(llcKB + numCores*(l2KB + 64)) /*ample for all per-line state*/);
+    zinfo = gm_calloc<GlobSimInfo>();
+    zinfo->lineSize = 64;
+    zinfo->numCores = numCores;
+    zinfo->phaseLength = phaseLength;
+    zinfo->eventRecorders = gm_calloc<EventRecorder*>(numCores);
+
+    ReplayCore* replayCores = gm_memalign<ReplayCore>(CACHE_LINE_BYTES, numCores);  // line-aligned, as init.cpp does
+    g_string memName("mem");
+    g_vector<MemObject*> memParents;
+    memParents.push_back(new SimpleMemory(memLatency, memName));
+    Cache* llc = BuildCache("llc", llcKB, 16, 27, false);
+    g_vector<MemObject*> llcParents;
+    llcParents.push_back(llc);
+
+    AggregateStat* rootStat = new AggregateStat();
+    rootStat->init("root", "Stats");
+    AggregateStat* coreStats = new AggregateStat(true);
+    coreStats->init("core", "Core stats");
+    AggregateStat* l1iStats = new AggregateStat(true);
+    l1iStats->init("l1i", "L1i stats");
+    AggregateStat* l1dStats = new AggregateStat(true);
+    l1dStats->init("l1d", "L1d stats");
+    AggregateStat* l2Stats = new AggregateStat(true);
+    l2Stats->init("l2", "L2 stats");
+
+    g_vector<BaseCache*> l2s;
+    for (uint32_t c = 0; c < numCores; c++) {
+        string suffix = "-" + to_string(c);
+        FilterCache* l1i = static_cast<FilterCache*>(BuildCache("l1i" + suffix, 32, 4, 4, true));
+        FilterCache* l1d = static_cast<FilterCache*>(BuildCache("l1d" + suffix, 32, 8, 4, true));
+        l1i->setSourceId(c);
+        l1i->setFlags(MemReq::IFETCH | MemReq::NOEXCL);
+        l1d->setSourceId(c);
+        Cache* l2 = BuildCache("l2" + suffix, l2KB, 8, 7, false);
+        g_vector<MemObject*> l2Parents;
+        l2Parents.push_back(l2);
+        l1i->setParents(0, l2Parents, nullptr);
+        l1d->setParents(1, l2Parents, nullptr);
+        g_vector<BaseCache*> l1s;
+        l1s.push_back(l1i);
+        l1s.push_back(l1d);
+        l2->setChildren(l1s, nullptr);
+        l2->setParents(c, llcParents, nullptr);
+        l2s.push_back(l2);
+
+        g_string coreName(("core" + suffix).c_str());
+        ReplayCore* core = new (&replayCores[c]) ReplayCore(l1i, l1d, coreName, traces[c]);
+        core->initStats(coreStats);
+        l1i->initStats(l1iStats);
+        l1d->initStats(l1dStats);
+        l2->initStats(l2Stats);
+    }
+    llc->setChildren(l2s, nullptr);
+    llc->setParents(0, memParents, nullptr);
+
+    rootStat->append(coreStats);
+    rootStat->append(l1iStats);
+    rootStat->append(l1dStats);
+    rootStat->append(l2Stats);
+    llc->initStats(rootStat);
+    memParents[0]->initStats(rootStat);
+    rootStat->makeImmutable();
+
+    info("%d traces, %d KB L2s, %d KB LLC, %d-cycle memory, %d-cycle phases", numCores, l2KB, llcKB, memLatency, phaseLength);
+    uint64_t startNs = getNs();
+    vector<bool> done(numCores, false);
+    uint32_t running = numCores;
+    while (running) {
+        for (uint32_t c = 0; c < numCores; c++) {
+            if (!done[c] && !replayCores[c].runPhase()) {
+                done[c] = true;
+                running--;
+            }
+        }
+        zinfo->numPhases++;
+        zinfo->globPhaseCycles += zinfo->phaseLength;
+    }
+    uint64_t ns = getNs() - startNs;
+
+    uint64_t totalInstrs = 0;
+    uint64_t totalRecords = 0;
+    for (uint32_t c = 0; c < numCores; c++) {
+        ReplayCore* core = &replayCores[c];
+        info("%3d: %12ld instrs %12ld cycles  IPC %.3f  (%s)", c, core->getInstrs(), core->getCycles(),
+                core->getCycles()? ((double)core->getInstrs())/core->getCycles() : 0.0, traces[c]);
+        totalInstrs += core->getInstrs();
+        totalRecords += core->getRecords();
+    }
+    info("%ld phases, %ld Minstrs in %.2f s (%.2f Minstrs/s, %.2f Mrecords/s)", zinfo->numPhases, totalInstrs/1000000,
+            ns/1e9, 1e3*totalInstrs/ns, 1e3*totalRecords/ns);
+
+    if (statsFile) {
+        TextBackend backend(statsFile, rootStat);
+        backend.dump(false);
+        info("Stats written to %s", statsFile);
+    }
+    return 0;
+}
@@ -0,0 +1,149 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Large-LLC access benchmark. Builds a shared LLC (SetAssoc, H3, LRU, MESICC; 32MB by default) with
+ * private L1s in front, as init.cpp does, and drives it from one host thread with random accesses
+ * from random children over a footprint twice the LLC size. Nearly every access goes to the LLC and
+ * walks its tags, replacement and directory state for a set, so host misses on per-line metadata
+ * dominate; this is what metadata layout changes should be measured with.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "cache.h"
+#include "cache_arrays.h"
+#include "coherence_ctrls.h"
+#include "contention_sim.h"
+#include "galloc.h"
+#include "hash.h"
+#include "locks.h"
+#include "log.h"
+#include "mem_ctrls.h"
+#include "mtrand.h"
+#include "profile_stats.h"
+#include "repl_policies.h"
+#include "zsim.h"
+
+using namespace std;
+
+GlobSimInfo* zinfo = nullptr;
+uint32_t lineBits = 6;
+
+// Cache::access only builds timing events with event recorders, which this benchmark does not create
+void ContentionSim::enqueue(TimingEvent* ev, uint64_t cycle) { panic("No contention simulation in llcbench"); }
+void ContentionSim::enqueueSynced(TimingEvent* ev, uint64_t cycle) { panic("No contention simulation in llcbench"); }
+void ContentionSim::enqueueCrossing(CrossingEvent* ev, uint64_t cycle, uint32_t srcId, uint32_t srcDomain, uint32_t dstDomain, EventRecorder* evRec) {
+    panic("No contention simulation in llcbench");
+}
+
+static const uint32_t L1_LINES = 512;  // 32KB
+static const uint32_t L1_WAYS = 8;
+static const uint32_t WRITE_PCT = 20;
+static const uint32_t NUM_ADDRS = 1 << 22;  // sampled once, cycled through
+
+int main(int argc, const char* argv[]) {
+    InitLog(""); //no log header
+    if (argc > 5) {
+        info("Measures access throughput of a large shared LLC");
+        info("Usage: %s [<LLC MB> (default 32)] [<LLC ways> (default 16)] [<children> (default 16)] [<Maccesses> (default 20)]", argv[0]);
+        exit(1);
+    }
+
+    uint32_t llcMB = (argc >= 2)? strtoul(argv[1], nullptr, 0) : 32;
+    uint32_t llcWays = (argc >= 3)? strtoul(argv[2], nullptr, 0) : 16;
+    uint32_t numChildren = (argc >= 4)? strtoul(argv[3], nullptr, 0) : 16;
+    uint64_t numAccesses = ((argc >= 5)? strtoul(argv[4], nullptr, 0) : 20)*1000000ul;
+
+    uint32_t llcLines = llcMB*1024*1024/64;
+    if (!llcWays || llcLines % llcWays || !isPow2(llcLines/llcWays)) panic("Number of LLC sets must be a power of two");
+    if (!numChildren || numChildren > MAX_CACHE_CHILDREN) panic("Need 1-%d children", MAX_CACHE_CHILDREN);
+
+    gm_init((64ul << 20) + 2*llcLines*64ul + numChildren*2*L1_LINES*64ul /*ample for all per-line state*/);
+    zinfo = gm_calloc<GlobSimInfo>();
+    zinfo->lineSize = 64;
+    zinfo->numCores = numChildren;
+    zinfo->eventRecorders = gm_calloc<EventRecorder*>(numChildren);
+
+    g_string memName("mem");
+    g_vector<MemObject*> memParents;
+    memParents.push_back(new SimpleMemory(100, memName));
+
+    g_string llcName("llc");
+    uint32_t setBits = 31 - __builtin_clz(llcLines/llcWays);
+    HashFamily* llcHf = new H3HashFamily(1, setBits, 0xCAC7EAFFA1);
+    ReplPolicy* llcRp = new LRUReplPolicy<true>(llcLines);
+    CacheArray* llcArray = new SetAssocArray(llcLines, llcWays, llcRp, llcHf);
+    CC* llcCc = new MESICC(llcLines, false, llcName, 1, llcHf);
+    llcRp->setCC(llcCc);
+    Cache* llc = new Cache(llcLines, llcCc, llcArray, llcRp, 10, 10, llcName);
+
+    g_vector<BaseCache*> l1s;
+    g_vector<MemObject*> llcParents;
+    llcParents.push_back(llc);
+    for (uint32_t c = 0; c < numChildren; c++) {
+        g_string l1Name("l1");
+        ReplPolicy* rp = new LRUReplPolicy<false>(L1_LINES);
+        CacheArray* array = new SetAssocArray(L1_LINES, L1_WAYS, rp, new IdHashFamily());
+        CC* cc = new MESITerminalCC(L1_LINES, l1Name);
+        rp->setCC(cc);
+        Cache* l1 = new Cache(L1_LINES, cc, array, rp, 0, 10, l1Name);
+        l1->setParents(c, llcParents, nullptr);
+        l1s.push_back(l1);
+    }
+    llc->setParents(0, memParents, nullptr);
+    llc->setChildren(l1s, nullptr);
+
+    // Sample the stream up front so the RNG stays out of the timed loop
+    MTRand rng(0x11CBE);
+    vector<Address> addrs(NUM_ADDRS);
+    vector<uint32_t> srcs(NUM_ADDRS);
+    for (uint32_t i = 0; i < NUM_ADDRS; i++) {
+        addrs[i] = 1 + rng.randInt(2*llcLines - 1);
+        srcs[i] = (rng.randInt(numChildren - 1) << 1) | (rng.randInt(99) < WRITE_PCT);
+    }
+
+    lock_t* filterLocks = gm_calloc<lock_t>(numChildren);
+    for (uint32_t c = 0; c < numChildren; c++) futex_init(&filterLocks[c]);
+
+    // One pass over the stream to warm up the LLC, then the timed run
+    info("%d MB %d-way LLC, %d children with %d KB L1s, %ld Maccesses, %d%% writes",
+            llcMB, llcWays, numChildren, L1_LINES*64/1024, numAccesses/1000000, WRITE_PCT);
+    uint64_t cycle = 0;
+    uint64_t startNs = 0;
+    for (uint64_t i = 0; i < NUM_ADDRS + numAccesses; i++) {
+        if (i == NUM_ADDRS) startNs = getNs();
+        uint32_t idx = i % NUM_ADDRS;
+        uint32_t child = srcs[idx] >> 1;
+        MESIState dummyState = I;
+        futex_lock(&filterLocks[child]);
+        MemReq req = {addrs[idx], (srcs[idx] & 1)? GETX : GETS, 0, &dummyState, cycle, &filterLocks[child], dummyState, child, 0};
+        cycle = l1s[child]->access(req);
+        futex_unlock(&filterLocks[child]);
+    }
+    uint64_t ns = getNs() - startNs;
+    info("%.2f Maccesses/s, %.1f ns/access", 1e3*numAccesses/ns, ((double)ns)/numAccesses);
+    return 0;
+}
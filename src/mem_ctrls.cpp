@@ -107,6 +107,8 @@ void MD1Memory::updateLatency() {
 }
 
 uint64_t MD1Memory::access(MemReq& req) {
+    if (req.is(MemReq::WARM)) return warmAccess(req);
+
     if (zinfo->numPhases > lastPhase) {
         futex_lock(&updateLock);
         //Recheck, someone may have updated already
@@ -145,3 +147,21 @@ uint64_t MD1Memory::access(MemReq& req) {
     return req.cycle + ((req.type == PUTS)? 0 /*PUTS is not a real access*/ : curLatency);
 }
 
+uint64_t MD1Memory::warmAccess(MemReq& req) {
+    switch (req.type) {
+        case PUTS:
+        case PUTX:
+            *req.state = I;
+            break;
+        case GETS:
+            *req.state = req.is(MemReq::NOEXCL)? S : E;
+            break;
+        case GETX:
+            *req.state = M;
+            break;
+
+        default: panic("!?");
+    }
+    return req.cycle + ((req.type == PUTS)? 0 : zeroLoadLatency);
+}
+
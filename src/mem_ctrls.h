@@ -95,6 +95,9 @@ class MD1Memory : public MemObject {
 
     private:
         void updateLatency();
+
+        //Functional warming access (MemReq::WARM): gives the line at zero-load latency, without stats or adding to the load
+        uint64_t warmAccess(MemReq& req);
 };
 
 #endif  // MEM_CTRLS_H_
@@ -89,7 +89,7 @@ struct MemReq {
     //Requester id --- used for contention simulation
     uint32_t srcId;
 
-    //Flags propagate across levels, though not to evictions
+    //Flags propagate across levels, though not to evictions (except WARM)
     //Some other things that can be indicated here: Demand vs prefetch accesses, TLB accesses, etc.
     enum Flag {
         IFETCH        = (1<<1), //For instruction fetches. Purely informative for now, does not imply NOEXCL (but ifetches should be marked NOEXCL)
@@ -97,11 +97,18 @@ struct MemReq {
         NONINCLWB     = (1<<3), //This is a non-inclusive writeback. Do not assume that the line was in the lower level. Used on NUCA (BankDir).
         PUTX_KEEPEXCL = (1<<4), //Non-relinquishing PUTX. On a PUTX, maintain the requestor's E state instead of removing the sharer (i.e., this is a pure writeback)
         PREFETCH      = (1<<5), //Prefetch GETS access. Only set at level where prefetch is issued; handled early in MESICC
+        WARM          = (1<<6), //Functional warming access (sim.warmFF). Updates cache, coherence and replacement state, but not stats, traces or memory controller timing. Also set on the evictions and invalidations it causes
     };
     uint32_t flags;
 
     inline void set(Flag f) {flags |= f;}
     inline bool is (Flag f) const {return flags & f;}
+
+    //Optional fields, zero if omitted from the initializer
+    //PC signature of the demand access that caused this request (0 if unknown, see cores). Propagates like flags
+    Address pc;
+    //If the cache that handles this request allocates a line for it, it sets this to the address of the line it evicted (0 if it was invalid); untouched otherwise. Used by prefetchers
+    Address evictedLineAddr;
 };
 
 /* Invalidation/downgrade request */
@@ -112,12 +119,15 @@ struct InvReq {
     bool* writeback;
     uint64_t cycle;
     uint32_t srcId;
+    bool warm; //caused by a MemReq::WARM access, not counted
 };
 
 /** INTERFACES **/
 
 class AggregateStat;
 class Network;
+class CheckpointWriter;
+class CheckpointReader;
 
 /* Base class for all memory objects (caches and memories) */
 class MemObject : public GlobAlloc {
@@ -134,6 +144,10 @@ class BaseCache : public MemObject {
         virtual void setParents(uint32_t _childId, const g_vector<MemObject*>& parents, Network* network) = 0;
         virtual void setChildren(const g_vector<BaseCache*>& children, Network* network) = 0;
         virtual uint64_t invalidate(const InvReq& req) = 0;
+
+        //Checkpointing of warmed state (see checkpoint.h). Called at phase boundaries, with no accesses in flight.
+        virtual void saveState(CheckpointWriter& cw) {}
+        virtual void restoreState(CheckpointReader& cr) {}
 };
 
 #endif  // MEMORY_HIERARCHY_H_
@@ -0,0 +1,364 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Computes LRU miss curves for many cache sizes and associativities in a single pass over an access trace (e.g.,
+ * one written by a TracingCache in front of the LLC), instead of replaying it once per size.
+ *
+ * - Fully-associative: exact LRU stack distances (Mattson et al.), using a Fenwick tree over access times. With
+ *   sampling 1/N, only lines whose hash is 0 mod N are tracked, and distances and misses are scaled by N, as in
+ *   SHARDS (Waldspurger et al., FAST 2015). With SHARDS-adj, the difference between the expected (accesses/N)
+ *   and actual number of sampled accesses goes to the smallest-distance bucket, so miss ratios are relative to
+ *   the expected count. Threads compute the stack distances within chunks of the trace in parallel.
+ *   Then, the first access to each line in each chunk is resolved against the global stack, in order, so
+ *   distances are still exact.
+ * - Set-associative: per-set LRU stacks with unhashed sets, as in UMon, one per number of sets. Each gives the
+ *   misses of all associativities up to its depth, like UMon's curves. They are not sampled, and run in parallel.
+ *
+ * Only GETS and GETX count as accesses. Sizes assume 64-byte lines.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "access_tracing.h"
+#include "bithacks.h"
+#include "galloc.h"
+#include "log.h"
+
+using namespace std;
+
+static const uint64_t COLD = -1L;
+static const uint32_t CHUNK_ACCESSES = 1 << 20;
+static const uint32_t MIN_KB = 16;
+
+/* LRU stack distances. The distance of an access is the number of distinct lines accessed since the last access
+ * to the same line (COLD if none), so it hits in LRU caches of more than that many lines. Each line has a mark at
+ * the time of its last access, so distances are counts of later marks. Times are compacted when they run out, so
+ * space is proportional to the footprint.
+ */
+class StackDistances {
+    private:
+        unordered_map<Address, uint64_t> lastAccess;
+        vector<uint32_t> tree;  // Fenwick tree of marks, indexed by time
+        uint64_t now;
+
+        void mark(uint64_t t, int32_t v) {
+            for (uint64_t i = t + 1; i <= tree.size(); i += i & -i) tree[i-1] += v;
+        }
+
+        // Marks in [0, t]
+        uint64_t count(uint64_t t) const {
+            uint64_t c = 0;
+            for (uint64_t i = t + 1; i; i -= i & -i) c += tree[i-1];
+            return c;
+        }
+
+        void compact() {
+            vector<Address> lines = recencyOrder();
+            uint64_t size = MAX(tree.size(), (size_t)1024);
+            while (size < 2*lines.size()) size *= 2;
+            for (now = 0; now < lines.size(); now++) lastAccess[lines[now]] = now;
+            tree.assign(size, 0);
+            for (uint64_t i = 1; i <= size; i++) {  // linear-time build, marks at [0, now)
+                if (i <= now) tree[i-1]++;
+                uint64_t p = i + (i & -i);
+                if (p <= size) tree[p-1] += tree[i-1];
+            }
+        }
+
+    public:
+        StackDistances() : now(0) {}
+
+        uint64_t access(Address lineAddr) {
+            if (now == tree.size()) compact();
+            uint64_t dist;
+            auto it = lastAccess.find(lineAddr);
+            if (it == lastAccess.end()) {
+                dist = COLD;
+                lastAccess[lineAddr] = now;
+            } else {
+                dist = lastAccess.size() - count(it->second);
+                mark(it->second, -1);
+                it->second = now;
+            }
+            mark(now++, 1);
+            return dist;
+        }
+
+        uint64_t footprint() const { return lastAccess.size(); }
+
+        // Lines from least to most recently accessed
+        vector<Address> recencyOrder() const {
+            vector< pair<uint64_t, Address> > v;
+            v.reserve(lastAccess.size());
+            for (auto& la : lastAccess) v.push_back(make_pair(la.second, la.first));
+            sort(v.begin(), v.end());
+            vector<Address> lines;
+            lines.reserve(v.size());
+            for (auto& tl : v) lines.push_back(tl.second);
+            return lines;
+        }
+};
+
+// Stack distances of a chunk of the trace, computed from an empty stack
+struct ChunkDistances {
+    vector<uint64_t> hist;  // reuses within the chunk, by distance; the last bucket has all longer ones
+    vector<Address> firsts;  // lines in order of first access, distances unknown
+    vector<Address> order;  // lines from least to most recently accessed at the end of the chunk
+};
+
+static inline bool Sampled(Address lineAddr, uint64_t sampleMask) {
+    uint64_t h = lineAddr * 0x9E3779B97F4A7C15L;
+    return ((h ^ (h >> 29)) & sampleMask) == 0;
+}
+
+static void ComputeChunkDistances(const vector<Address>& chunk, uint64_t sampleMask, uint64_t maxDist, ChunkDistances& res) {
+    StackDistances sd;
+    res.hist.assign(maxDist + 1, 0);
+    for (Address lineAddr : chunk) {
+        if (!Sampled(lineAddr, sampleMask)) continue;
+        uint64_t dist = sd.access(lineAddr);
+        if (dist == COLD) {
+            res.firsts.push_back(lineAddr);
+        } else {
+            res.hist[MIN(dist, maxDist)]++;
+        }
+    }
+    res.order = sd.recencyOrder();
+}
+
+/* Per-set LRU stacks for a number of sets, up to depth ways. A hit at stack position p hits in caches with
+ * these sets and more than p ways.
+ */
+class SetStacks {
+    private:
+        vector<Address> tags;  // depth per set, MRU first
+        vector<uint64_t> posHits;
+        uint64_t stackMisses;
+        const uint32_t sets;
+        const uint32_t depth;
+
+    public:
+        SetStacks(uint32_t _sets, uint32_t _depth) : tags(_sets*_depth, -1L), posHits(_depth, 0), stackMisses(0), sets(_sets), depth(_depth) {}
+
+        void access(Address lineAddr) {
+            Address* set = &tags[(lineAddr & (sets - 1))*depth];
+            uint32_t p = 0;
+            while (p < depth && set[p] != lineAddr) p++;
+            if (p < depth) {
+                posHits[p]++;
+            } else {
+                stackMisses++;
+                p = depth - 1;
+            }
+            for (uint32_t i = p; i > 0; i--) set[i] = set[i-1];
+            set[0] = lineAddr;
+        }
+
+        uint64_t getMisses(uint32_t ways) const {
+            assert(ways <= depth);
+            uint64_t misses = stackMisses;
+            for (uint32_t p = ways; p < depth; p++) misses += posHits[p];
+            return misses;
+        }
+};
+
+// Decodes the trace in the background while threads compute distances
+static void SpawnDecodeThread(void (*fn)(void*), void* arg) {
+    thread(fn, arg).detach();
+}
+
+static void RunTasks(const vector< function<void()> >& tasks, uint32_t numThreads) {
+    atomic<uint32_t> nextTask(0);
+    auto worker = [&]() {
+        for (uint32_t t = nextTask++; t < tasks.size(); t = nextTask++) tasks[t]();
+    };
+    vector<thread> threads;
+    for (uint32_t i = 1; i < MIN((size_t)numThreads, tasks.size()); i++) threads.push_back(thread(worker));
+    worker();
+    for (thread& th : threads) th.join();
+}
+
+int main(int argc, const char* argv[]) {
+    InitLog(""); //no log header
+    if (argc < 2 || argc > 6) {
+        info("Computes LRU miss curves of an access trace for many cache sizes in a single pass");
+        info("Usage: %s <trace> [<maxKB> (default 65536)] [<ways> (power-of-2 set-associative ways, comma-separated; default 4,8,16; 0 for fully-associative only)]", argv[0]);
+        info("       [<sampling> (track 1/N of the lines, N power of 2; default 1)] [<threads> (default: all cores)]");
+        exit(1);
+    }
+
+    uint64_t maxKB = (argc >= 3)? strtoul(argv[2], nullptr, 0) : 65536;
+    string waysList = (argc >= 4)? argv[3] : "4,8,16";
+    uint64_t sampling = (argc >= 5)? strtoul(argv[4], nullptr, 0) : 1;
+    uint32_t numThreads = (argc >= 6)? strtoul(argv[5], nullptr, 0) : thread::hardware_concurrency();
+
+    if (!isPow2(maxKB) || maxKB < MIN_KB) panic("maxKB must be a power of 2, >= %d", MIN_KB);
+    if (!sampling || !isPow2(sampling)) panic("Sampling must be a power of 2");
+    numThreads = MAX(numThreads, 1u);
+
+    vector<uint64_t> sizes;  // lines
+    for (uint64_t kb = MIN_KB; kb <= maxKB; kb *= 2) sizes.push_back(kb*1024/64);
+    uint64_t maxLines = sizes.back();
+
+    // One set of stacks per number of sets, as deep as the largest associativity with that many sets
+    vector<uint32_t> ways;
+    stringstream ss(waysList);
+    string w;
+    while (getline(ss, w, ',')) {
+        uint32_t v = strtoul(w.c_str(), nullptr, 0);
+        if (!v) continue;
+        if (!isPow2(v)) panic("Associativities must be powers of 2 (%d given)", v);
+        ways.push_back(v);
+    }
+    map<uint64_t, uint32_t> stackDepths;  // sets -> ways
+    for (uint32_t wy : ways) {
+        for (uint64_t lines : sizes) {
+            if (lines >= wy) stackDepths[lines/wy] = MAX(stackDepths[lines/wy], wy);
+        }
+    }
+    vector<SetStacks*> stacks;
+    map<uint64_t, SetStacks*> setsToStacks;
+    for (auto& sd : stackDepths) {
+        SetStacks* s = new SetStacks(sd.first, sd.second);
+        stacks.push_back(s);
+        setsToStacks[sd.first] = s;
+    }
+
+    gm_init(32<<20 /*32 MB --- should be enough*/);
+
+    AccessTraceReader tr(argv[1], SpawnDecodeThread);
+    info("Computing miss curves for %ld records, %d threads, sampling 1/%ld of the lines", tr.getNumRecords(), numThreads, sampling);
+
+    uint64_t sampleMask = sampling - 1;
+    uint64_t maxDist = maxLines/sampling;  // sampled distances >= maxDist miss in all sizes
+    StackDistances global;
+    vector<uint64_t> hist(maxDist + 1, 0);
+    uint64_t cold = 0;
+    uint64_t accesses = 0;
+    uint64_t readRecords = 0;
+
+    vector< vector<Address> > chunks(numThreads);
+    while (!tr.empty()) {
+        uint32_t numChunks = 0;
+        while (numChunks < numThreads && !tr.empty()) {
+            vector<Address>& chunk = chunks[numChunks++];
+            chunk.clear();
+            while (chunk.size() < CHUNK_ACCESSES && !tr.empty()) {
+                AccessRecord acc = tr.read();
+                readRecords++;
+                if (acc.type == GETS || acc.type == GETX) chunk.push_back(acc.lineAddr);
+            }
+            accesses += chunk.size();
+        }
+
+        vector<ChunkDistances> chunkDists(numChunks);
+        vector< function<void()> > tasks;
+        for (uint32_t c = 0; c < numChunks; c++) {
+            tasks.push_back([&, c]() { ComputeChunkDistances(chunks[c], sampleMask, maxDist, chunkDists[c]); });
+        }
+        for (SetStacks* s : stacks) {
+            tasks.push_back([&, s, numChunks]() {
+                for (uint32_t c = 0; c < numChunks; c++) {
+                    for (Address lineAddr : chunks[c]) s->access(lineAddr);
+                }
+            });
+        }
+        RunTasks(tasks, numThreads);
+
+        // Resolve first accesses in each chunk against the global stack; then, bring the global stack to the chunk's recency order
+        for (ChunkDistances& cd : chunkDists) {
+            for (Address lineAddr : cd.firsts) {
+                uint64_t dist = global.access(lineAddr);
+                if (dist == COLD) {
+                    cold++;
+                } else {
+                    hist[MIN(dist, maxDist)]++;
+                }
+            }
+            for (Address lineAddr : cd.order) global.access(lineAddr);
+            for (uint64_t d = 0; d <= maxDist; d++) hist[d] += cd.hist[d];
+        }
+
+        printf("Read %3ld%%\r", readRecords*100/MAX(tr.getNumRecords(), 1ul));
+        fflush(stdout);
+    }
+    printf("\n");
+
+    info("%ld accesses, %ld distinct lines%s", accesses, global.footprint()*sampling, (sampling > 1)? " (estimated)" : "");
+
+    // SHARDS-adj: correct the smallest-distance bucket, which hits in all sizes, by expected - actual sampled accesses
+    uint64_t sampled = cold;
+    for (uint64_t d = 0; d <= maxDist; d++) sampled += hist[d];
+    int64_t adjust = (int64_t)(accesses/sampling) - (int64_t)sampled;
+    hist[0] = MAX((int64_t)hist[0] + adjust, 0L);
+    if (sampling > 1) info("%ld sampled accesses, %ld expected", sampled, accesses/sampling);
+
+    // Misses per size, sampled distances d hit in sizes > d*sampling
+    vector<uint64_t> fullMisses;
+    uint64_t misses = cold;
+    for (uint64_t d = 0; d <= maxDist; d++) misses += hist[d];
+    uint64_t total = misses;
+    uint64_t d = 0;
+    for (uint64_t lines : sizes) {
+        for (; d*sampling < lines; d++) misses -= hist[d];
+        fullMisses.push_back(total? (uint64_t)(((double)misses)/total*accesses + 0.5) : 0);
+    }
+
+    stringstream hdr;
+    hdr << "    SizeKB         Full";
+    for (uint32_t wy : ways) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), " %8d-way", wy);
+        hdr << buf;
+    }
+    info("LRU misses:");
+    info("%s", hdr.str().c_str());
+    for (uint32_t i = 0; i < sizes.size(); i++) {
+        stringstream row;
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%10ld %12ld", sizes[i]*64/1024, fullMisses[i]);
+        row << buf;
+        for (uint32_t wy : ways) {
+            if (sizes[i] >= wy) {
+                snprintf(buf, sizeof(buf), " %12ld", setsToStacks[sizes[i]/wy]->getMisses(wy));
+            } else {
+                snprintf(buf, sizeof(buf), " %12s", "-");
+            }
+            row << buf;
+        }
+        info("%s", row.str().c_str());
+    }
+
+    return 0;
+}
@@ -56,6 +56,14 @@ void NullCore::join() {
     phaseEndCycle = zinfo->globPhaseCycles + zinfo->phaseLength;
 }
 
+void NullCore::sweepBbl(ADDRINT bblAddr, BblInfo* bblInfo) {
+    bbl(bblInfo);
+}
+
+void NullCore::nextPhase() {
+    phaseEndCycle += zinfo->phaseLength;
+}
+
 //Static class functions: Function pointers and trampolines
 
 InstrFuncPtrs NullCore::GetFuncPtrs() {
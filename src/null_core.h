@@ -50,6 +50,10 @@ class NullCore : public Core {
 
         InstrFuncPtrs GetFuncPtrs();
 
+        void sweepBbl(ADDRINT bblAddr, BblInfo* bblInfo);
+        bool pastPhaseEnd() const {return curCycle > phaseEndCycle;}
+        void nextPhase();
+
     protected:
         inline void bbl(BblInfo* bblInstrs);
 
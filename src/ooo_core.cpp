@@ -28,6 +28,7 @@
 #include <queue>
 #include <string>
 #include "bithacks.h"
+#include "checkpoint.h"
 #include "decoder.h"
 #include "filter_cache.h"
 #include "zsim.h"
@@ -80,7 +81,7 @@ void OOOCore::initStats(AggregateStat* parentStat) {
     AggregateStat* coreStat = new AggregateStat();
     coreStat->init(name.c_str(), "Core stats");
 
-    auto x = [this]() { return cRec.getUnhaltedCycles(curCycle); };
+    auto x = [this]() { return getCycles(); };
     LambdaStat<decltype(x)>* cyclesStat = new LambdaStat<decltype(x)>(x);
     cyclesStat->init("cycles", "Simulated unhalted cycles");
 
@@ -133,6 +134,15 @@ void OOOCore::contextSwitch(int32_t gid) {
 
 InstrFuncPtrs OOOCore::GetFuncPtrs() {return {LoadFunc, StoreFunc, BblFunc, BranchFunc, PredLoadFunc, PredStoreFunc, FPTR_ANALYSIS, {0}};}
 
+// The branch predictor holds no pointers, so it's saved as-is
+void OOOCore::saveState(CheckpointWriter& cw) {
+    cw.write(std::string(name.c_str()) + ".bp", &branchPred, sizeof(branchPred));
+}
+
+void OOOCore::restoreState(CheckpointReader& cr) {
+    cr.read(std::string(name.c_str()) + ".bp", &branchPred, sizeof(branchPred));
+}
+
 inline void OOOCore::load(Address addr) {
     loadAddrs[loads++] = addr;
 }
@@ -265,10 +275,11 @@ inline void OOOCore::bbl(Address bblAddr, BblInfo* bblInfo) {
                     // Wait for all previous store addresses to be resolved
                     dispatchCycle = MAX(lastStoreAddrCommitCycle+1, dispatchCycle);
 
+                    Address pc = bbl->addr + loadIdx;  // PC signature, unique per static load (see MemReq)
                     Address addr = loadAddrs[loadIdx++];
                     uint64_t reqSatisfiedCycle = dispatchCycle;
                     if (addr != ((Address)-1L)) {
-                        reqSatisfiedCycle = l1d->load(addr, dispatchCycle) + L1D_LAT;
+                        reqSatisfiedCycle = l1d->load(addr, dispatchCycle, pc) + L1D_LAT;
                         cRec.record(curCycle, dispatchCycle, reqSatisfiedCycle);
                     }
 
@@ -482,6 +493,29 @@ void OOOCore::advance(uint64_t targetCycle) {
      */
 }
 
+// Sweep interface (see sweep.h)
+void OOOCore::sweepBbl(ADDRINT bblAddr, BblInfo* bblInfo) {
+    bbl(bblAddr, bblInfo);
+}
+
+void OOOCore::sweepLoad(ADDRINT addr, BOOL pred) {
+    if (pred) load(addr);
+    else predFalseMemOp();
+}
+
+void OOOCore::sweepStore(ADDRINT addr, BOOL pred) {
+    if (pred) store(addr);
+    else predFalseMemOp();
+}
+
+void OOOCore::sweepBranch(ADDRINT pc, BOOL taken, ADDRINT takenNpc, ADDRINT notTakenNpc) {
+    branch(pc, taken, takenNpc, notTakenNpc);
+}
+
+void OOOCore::nextPhase() {
+    phaseEndCycle += zinfo->phaseLength;
+}
+
 // Pin interface code
 
 void OOOCore::LoadFunc(THREADID tid, ADDRINT addr) {static_cast<OOOCore*>(cores[tid])->load(addr);}
@@ -449,6 +449,16 @@ class OOOCore : public Core {
 
         InstrFuncPtrs GetFuncPtrs();
 
+        void sweepBbl(ADDRINT bblAddr, BblInfo* bblInfo);
+        void sweepLoad(ADDRINT addr, BOOL pred);
+        void sweepStore(ADDRINT addr, BOOL pred);
+        void sweepBranch(ADDRINT pc, BOOL taken, ADDRINT takenNpc, ADDRINT notTakenNpc);
+        bool pastPhaseEnd() const {return curCycle > phaseEndCycle;}
+        void nextPhase();
+
+        void saveState(CheckpointWriter& cw);
+        void restoreState(CheckpointReader& cr);
+
         // Contention simulation interface
         inline EventRecorder* getEventRecorder() {return cRec.getEventRecorder();}
         void cSimStart();
@@ -0,0 +1,76 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "opt_repl_policy.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <unordered_map>
+#include "access_tracing.h"
+#include "log.h"
+
+NextUseTable::NextUseTable(const std::string& traceFile, const std::string& tmpDir) : pos(0), posLineAddr(-1L) {
+    AccessTraceReader tr(traceFile);
+    numRecords = tr.getNumRecords();
+    if (!numRecords) panic("OPT: trace %s is empty", traceFile.c_str());
+    info("OPT: computing next uses for %ld records of %s", numRecords, traceFile.c_str());
+
+    // Backed by an unlinked file, so the OS can page it out, and it's gone when we exit
+    // (unique name, since simulations may share tmpDir)
+    std::string path = tmpDir + "/opt_nextuse.XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if (fd < 0) panic("OPT: could not create %s: %s", path.c_str(), strerror(errno));
+    unlink(path.c_str());
+    size_t bytes = numRecords*sizeof(uint64_t);
+    if (ftruncate(fd, bytes) != 0) panic("OPT: could not size %s: %s", path.c_str(), strerror(errno));
+    void* map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) panic("OPT: could not mmap %s: %s", path.c_str(), strerror(errno));
+    close(fd);
+    next = static_cast<uint64_t*>(map);
+
+    // Link each GET to the next one to the same line; lastUse holds the latest GET to each line so far
+    std::unordered_map<Address, uint64_t> lastUse;
+    for (uint64_t i = 0; i < numRecords; i++) {
+        AccessRecord acc = tr.read();
+        next[i] = NEVER;
+        if (acc.type != GETS && acc.type != GETX) continue;
+        auto it = lastUse.find(acc.lineAddr);
+        if (it != lastUse.end()) {
+            next[it->second] = i;
+            it->second = i;
+        } else {
+            lastUse[acc.lineAddr] = i;
+        }
+    }
+    assert(tr.empty());
+    info("OPT: done, %ld distinct lines", lastUse.size());
+}
+
+NextUseTable::~NextUseTable() {
+    munmap(next, numRecords*sizeof(uint64_t));
+}
@@ -0,0 +1,140 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPT_REPL_POLICY_H_
+#define OPT_REPL_POLICY_H_
+
+#include <string>
+#include "galloc.h"
+#include "repl_policies.h"
+#include "stats.h"
+
+/* Future knowledge for Belady's OPT, from an access trace. For each GET record, holds the index of the next
+ * GET to the same line, or NEVER. It is built in one streaming pass over the trace, and stored in an unlinked,
+ * mmapped file in tmpDir, so only the footprint (one entry per distinct line, during the build) stays in memory.
+ *
+ * Whoever replays the trace (TraceDriver, replsim) calls setPos() before issuing each record.
+ */
+class NextUseTable : public GlobAlloc {
+    public:
+        static const uint64_t NEVER = -1L;
+
+    private:
+        uint64_t* next;
+        uint64_t numRecords;
+
+        // Record being replayed
+        uint64_t pos;
+        Address posLineAddr;
+
+    public:
+        NextUseTable(const std::string& traceFile, const std::string& tmpDir);
+        ~NextUseTable();
+
+        uint64_t getNumRecords() const { return numRecords; }
+
+        inline void setPos(uint64_t _pos, Address lineAddr) {
+            assert(_pos < numRecords);
+            pos = _pos;
+            posLineAddr = lineAddr;
+        }
+
+        // Whether lineAddr is the line of the record being replayed
+        inline bool isCurrent(Address lineAddr) const { return lineAddr == posLineAddr; }
+
+        // Next use of the current record's line
+        inline uint64_t nextUse() const { return next[pos]; }
+
+        // Refreshes a next use that may have already passed (e.g., on a GET the driver did not replay)
+        inline uint64_t refresh(uint64_t n) const {
+            while (n < pos) n = next[n];
+            return n;
+        }
+};
+
+/* Belady's OPT: evicts the candidate reused furthest in the future, using a NextUseTable. It is only exact
+ * in the caches that the trace replays into directly; accesses that do not match the record being replayed
+ * (e.g., from prefetchers) are treated as never reused.
+ */
+class OPTReplPolicy : public ReplPolicy {
+    private:
+        NextUseTable* table;
+        uint64_t* lineNext;
+        uint32_t numLines;
+
+        Counter profUntracked, profNeverEvictions;
+
+    public:
+        OPTReplPolicy(uint32_t _numLines, NextUseTable* _table) : table(_table), numLines(_numLines) {
+            lineNext = gm_calloc_aligned<uint64_t>(CACHE_LINE_BYTES, numLines);
+            for (uint32_t i = 0; i < numLines; i++) lineNext[i] = NextUseTable::NEVER;
+        }
+
+        ~OPTReplPolicy() {
+            gm_free(lineNext);
+        }
+
+        void initStats(AggregateStat* parentStat) {
+            profUntracked.init("untracked", "Accesses not in the trace (treated as never reused)"); parentStat->append(&profUntracked);
+            profNeverEvictions.init("neverEvs", "Evictions of lines never reused again"); parentStat->append(&profNeverEvictions);
+        }
+
+        void update(uint32_t id, const MemReq* req) {
+            if (table->isCurrent(req->lineAddr)) {
+                lineNext[id] = table->nextUse();
+            } else {
+                lineNext[id] = NextUseTable::NEVER;
+                profUntracked.inc();
+            }
+        }
+
+        void replaced(uint32_t id) {
+            lineNext[id] = NextUseTable::NEVER;
+        }
+
+        template <typename C> inline uint32_t rank(const MemReq* req, C cands) {
+            uint32_t bestCand = -1;
+            uint64_t bestNext = 0;
+            for (auto ci = cands.begin(); ci != cands.end(); ci.inc()) {
+                uint32_t id = *ci;
+                if (!cc->isValid(id)) return id;
+                uint64_t n = table->refresh(lineNext[id]);
+                lineNext[id] = n;
+                if (n == NextUseTable::NEVER) {
+                    profNeverEvictions.inc();
+                    return id;
+                }
+                if (bestCand == (uint32_t)-1 || n > bestNext) {
+                    bestCand = id;
+                    bestNext = n;
+                }
+            }
+            return bestCand;
+        }
+
+        DECL_RANK_BINDINGS;
+};
+
+#endif  // OPT_REPL_POLICY_H_
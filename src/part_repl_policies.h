@@ -110,7 +110,7 @@ class WayPartReplPolicy : public PartReplPolicy, public LegacyReplPolicy {
                 new (&partInfo[i].profExtEvictions) Counter;
             }
 
-            array = gm_calloc<WayPartInfo>(totalSize); //all have ts, p == 0...
+            array = gm_calloc_aligned<WayPartInfo>(CACHE_LINE_BYTES, totalSize); //all have ts, p == 0...
             partInfo[0].size = totalSize; // so partition 0 has all the lines
 
             wayPartIndex = gm_calloc<uint32_t>(ways);
@@ -150,19 +150,20 @@ class WayPartReplPolicy : public PartReplPolicy, public LegacyReplPolicy {
 
         void update(uint32_t id, const MemReq* req) {
             WayPartInfo* e = &array[id];
+            uint32_t count = !req->is(MemReq::WARM); //warming accesses are not counted
             if (e->ts > 0) { //this is a hit update
-                partInfo[e->p].profHits.inc();
+                partInfo[e->p].profHits.inc(count);
             } else { //post-miss update, old line has been removed, this is empty
                 uint32_t oldPart = e->p;
                 uint32_t newPart = incomingLinePart;
                 if (oldPart != newPart) {
                     partInfo[oldPart].size--;
-                    partInfo[oldPart].profExtEvictions.inc();
+                    partInfo[oldPart].profExtEvictions.inc(count);
                     partInfo[newPart].size++;
                 } else {
-                    partInfo[oldPart].profSelfEvictions.inc();
+                    partInfo[oldPart].profSelfEvictions.inc(count);
                 }
-                partInfo[newPart].profMisses.inc();
+                partInfo[newPart].profMisses.inc(count);
                 e->p = newPart;
             }
             e->ts = timestamp++;
@@ -341,7 +342,7 @@ class VantageReplPolicy : public PartReplPolicy, public LegacyReplPolicy {
             partInfo[partitions].targetSize = 0;
             partInfo[partitions].longTermTargetSize = 0;
 
-            array = gm_calloc<LineInfo>(totalSize);
+            array = gm_calloc_aligned<LineInfo>(CACHE_LINE_BYTES, totalSize);
 
             //Initially, assign all the lines to the unmanaged region
             partInfo[partitions].size = totalSize;
@@ -406,27 +407,28 @@ class VantageReplPolicy : public PartReplPolicy, public LegacyReplPolicy {
             }
 
             LineInfo* e = &array[id];
+            uint32_t count = !req->is(MemReq::WARM); //warming accesses are not counted
             if (e->ts > 0) {
                 if (e->p == partitions) { //this is an unmanaged region promotion
                     e->p = mapper->getPartition(*req);
-                    profPromotions.inc();
+                    profPromotions.inc(count);
                     partInfo[e->p].curIntervalIns++;
                     partInfo[e->p].size++;
                     partInfo[partitions].size--;
                 }
                 e->ts = timestamp++;
-                partInfo[e->p].profHits.inc();
+                partInfo[e->p].profHits.inc(count);
             } else { //post-miss update, old one has been removed, this is empty
                 e->ts = timestamp++;
                 partInfo[e->p].size--;
-                partInfo[e->p].profEvictions.inc();
+                partInfo[e->p].profEvictions.inc(count);
                 partInfo[e->op].extendedSize--;
                 e->p = mapper->getPartition(*req);
                 e->op = e->p;
                 partInfo[e->p].curIntervalIns++;
                 partInfo[e->p].size++;
                 partInfo[e->op].extendedSize++;
-                partInfo[e->p].profMisses.inc();
+                partInfo[e->p].profMisses.inc(count);
 
                 if (partInfo[e->p].targetSize < partInfo[e->p].longTermTargetSize) {
                     assert(smoothTransients);
@@ -28,8 +28,10 @@
 #include "process_tree.h"
 #include "zsim.h"
 
+// NOTE: srcIds >= numCores are warming accesses on behalf of core srcId - numCores (see FilterCache::warm())
+
 uint32_t CorePartMapper::getPartition(const MemReq& req) {
-    return req.srcId;
+    return req.srcId % numCores;
 }
 
 uint32_t InstrDataPartMapper::getPartition(const MemReq& req) {
@@ -38,7 +40,7 @@ uint32_t InstrDataPartMapper::getPartition(const MemReq& req) {
 
 uint32_t InstrDataCorePartMapper::getPartition(const MemReq& req) {
     bool instr = req.flags & MemReq::IFETCH;
-    return req.srcId + (instr ? numCores : 0); //all instruction partitions come after data partitions
+    return (req.srcId % numCores) + (instr ? numCores : 0); //all instruction partitions come after data partitions
 }
 
 uint32_t ProcessPartMapper::getPartition(const MemReq& req) {
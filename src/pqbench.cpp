@@ -0,0 +1,160 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Event queue microbenchmark. Replays an enqueue-distance distribution through PrioQueue and
+ * TimingWheel: a fixed number of events stay in flight, and each dequeued event is enqueued
+ * again, a sampled distance after the dequeued cycle, as a weave domain does with its children.
+ *
+ * Distributions are the eqd histograms that contention_sim.h records with PROFILE_ENQUEUE_DIST
+ * (copy a domain's "<bucket>: <count>" lines to a file). Without one, the built-in distribution
+ * has mostly short delays, some memory latencies, and a few refresh-like far events.
+ */
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "contention_sim.h"
+#include "galloc.h"
+#include "log.h"
+#include "mtrand.h"
+#include "prio_queue.h"
+#include "profile_stats.h"
+
+using namespace std;
+
+static const uint32_t NUM_BUCKETS = 65;
+static const uint32_t NUM_DISTS = 1 << 20;  // sampled once, cycled through by all queues
+
+struct BenchEvent {
+    BenchEvent* next;
+    uint64_t privCycle;
+};
+
+static vector<uint64_t> ReadHistogram(const char* file) {
+    FILE* f = fopen(file, "r");
+    if (!f) panic("Could not open histogram file %s", file);
+    vector<uint64_t> hist(NUM_BUCKETS, 0);
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        uint32_t bucket;
+        uint64_t count;
+        if (sscanf(line, " %u: %lu", &bucket, &count) != 2) continue;
+        if (bucket >= NUM_BUCKETS) panic("Bucket %d out of range", bucket);
+        hist[bucket] += count;
+    }
+    fclose(f);
+    return hist;
+}
+
+static vector<uint64_t> DefaultHistogram() {
+    vector<uint64_t> hist(NUM_BUCKETS, 0);
+    hist[1] = 300;  // 1 cycle
+    hist[2] = 200;
+    hist[3] = 150;
+    hist[4] = 120;
+    hist[5] = 80;
+    hist[6] = 40;
+    hist[7] = 40;   // 64-127 cycles, LLC/NoC
+    hist[8] = 30;   // 128-255 cycles, DRAM
+    hist[9] = 20;
+    hist[10] = 5;
+    hist[14] = 1;   // 8K-16K cycles, refresh
+    return hist;
+}
+
+static vector<uint64_t> SampleDistances(const vector<uint64_t>& hist) {
+    vector<uint64_t> cumHist(NUM_BUCKETS);
+    uint64_t total = 0;
+    for (uint32_t b = 0; b < NUM_BUCKETS; b++) {
+        total += hist[b];
+        cumHist[b] = total;
+    }
+    if (!total) panic("Empty histogram");
+
+    MTRand rng(0xE7E47);
+    vector<uint64_t> dists(NUM_DISTS);
+    for (uint64_t& d : dists) {
+        uint64_t r = (rng.randInt() << 32) | rng.randInt();
+        uint32_t b = upper_bound(cumHist.begin(), cumHist.end(), r % total) - cumHist.begin();
+        if (b == 0) {
+            d = 0;
+        } else {
+            uint64_t lo = 1ul << (b-1);
+            uint64_t r2 = (rng.randInt() << 32) | rng.randInt();
+            d = lo + r2 % lo;
+        }
+    }
+    return dists;
+}
+
+template <typename Q>
+static void Run(const char* name, const vector<uint64_t>& dists, uint32_t inFlight, uint64_t numEvents) {
+    Q* q = new Q();
+    vector<BenchEvent> evs(inFlight);
+    for (uint32_t i = 0; i < inFlight; i++) {
+        evs[i].next = nullptr;
+        q->enqueue(&evs[i], dists[i % NUM_DISTS]);
+    }
+
+    uint64_t checksum = 0;
+    uint64_t startNs = getNs();
+    for (uint64_t i = 0; i < numEvents; i++) {
+        uint64_t cycle;
+        BenchEvent* ev = q->dequeue(cycle);
+        checksum = (checksum << 5) + (checksum >> 59) + cycle;
+        q->enqueue(ev, cycle + dists[(inFlight + i) % NUM_DISTS]);
+    }
+    uint64_t ns = getNs() - startNs;
+
+    // Same distances and same dequeued cycles, so both queues must produce the same checksum
+    info("%12s %10.2f Mevents/s  %6.2f ns/event  checksum %016lx", name, 1e3*numEvents/ns, ((double)ns)/numEvents, checksum);
+    delete q;
+}
+
+int main(int argc, const char* argv[]) {
+    InitLog(""); //no log header
+    if (argc < 2 || argc > 4) {
+        info("Replays an enqueue-distance distribution through PrioQueue and TimingWheel");
+        info("Usage: %s <eqd histogram file, or \"default\"> [<in-flight events> (default 256)] [<Mevents> (default 50)]", argv[0]);
+        exit(1);
+    }
+
+    vector<uint64_t> hist = (strcmp(argv[1], "default") == 0)? DefaultHistogram() : ReadHistogram(argv[1]);
+    uint32_t inFlight = (argc >= 3)? strtoul(argv[2], nullptr, 0) : 256;
+    uint64_t numEvents = ((argc >= 4)? strtoul(argv[3], nullptr, 0) : 50)*1000000ul;
+    if (!inFlight) panic("Need at least one event in flight");
+
+    gm_init(256<<20 /*far-event map in PrioQueue*/);
+    vector<uint64_t> dists = SampleDistances(hist);
+
+    uint64_t maxDist = *max_element(dists.begin(), dists.end());
+    info("%d events in flight, %ld Mevents, max distance %ld cycles (PrioQueue window %d cycles)",
+            inFlight, numEvents/1000000, maxDist, PQ_BLOCKS*64);
+    Run< PrioQueue<BenchEvent, PQ_BLOCKS> >("PrioQueue", dists, inFlight, numEvents);
+    Run< TimingWheel<BenchEvent> >("TimingWheel", dists, inFlight, numEvents);
+    return 0;
+}
@@ -24,29 +24,122 @@
  */
 
 #include "prefetcher.h"
+#include <string>
 #include "bithacks.h"
+#include "checkpoint.h"
 
 //#define DBG(args...) info(args)
 #define DBG(args...)
 
-void StreamPrefetcher::setParents(uint32_t _childId, const g_vector<MemObject*>& parents, Network* network) {
+/* Prefetcher */
+
+Prefetcher::Prefetcher(const g_string& _name) : name(_name) {
+    pfLines = gm_calloc<PfLine>(TRACK_ENTRIES);
+    pfVictims = gm_calloc<Address>(TRACK_ENTRIES);
+}
+
+void Prefetcher::setParents(uint32_t _childId, const g_vector<MemObject*>& parents, Network* network) {
     childId = _childId;
     if (parents.size() != 1) panic("Must have one parent");
     if (network) panic("Network not handled");
     parent = parents[0];
 }
 
-void StreamPrefetcher::setChildren(const g_vector<BaseCache*>& children, Network* network) {
+void Prefetcher::setChildren(const g_vector<BaseCache*>& children, Network* network) {
     if (children.size() != 1) panic("Must have one children");
     if (network) panic("Network not handled");
     child = children[0];
 }
 
+void Prefetcher::initPrefetchStats(AggregateStat* s) {
+    profPrefetches.init("pf", "Issued prefetches"); s->append(&profPrefetches);
+    profRedundant.init("pfRedundant", "Prefetches of lines already in the parent"); s->append(&profRedundant);
+    profUseful.init("pfUseful", "Prefetches first demanded after their fill"); s->append(&profUseful);
+    profLate.init("pfLate", "Prefetches first demanded before their fill"); s->append(&profLate);
+    profLateCycles.init("pfLateCycles", "Cycles demands waited for late prefetches"); s->append(&profLateCycles);
+    profLeadCycles.init("pfLeadCycles", "Cycles from issue to first demand of useful and late prefetches"); s->append(&profLeadCycles);
+    profUseless.init("pfUseless", "Prefetches evicted before any demand"); s->append(&profUseless);
+    profPolluting.init("pfPolluting", "Demand accesses to lines evicted by prefetches"); s->append(&profPolluting);
+}
+
+uint64_t Prefetcher::demandAccess(MemReq& req, bool* pfHit, bool* pfLate, bool* allocated) {
+    if (req.is(MemReq::WARM)) return parent->access(req); //warming accesses don't count towards prefetch stats
+    req.evictedLineAddr = -1L;  // the parent overwrites it iff it allocates
+    uint64_t respCycle = parent->access(req);
+    Address victim = req.evictedLineAddr;
+    if (allocated) *allocated = (victim != (Address)-1L);
+    if (victim != (Address)-1L && victim) evicted(victim, false);
+
+    bool hit = false;
+    bool late = false;
+    if (req.type == GETS || req.type == GETX) {
+        uint32_t idx = req.lineAddr & (TRACK_ENTRIES-1);
+        PfLine& p = pfLines[idx];
+        if (p.lineAddr == req.lineAddr) {
+            hit = true;
+            late = p.respCycle > respCycle;
+            if (late) {
+                profLate.inc();
+                profLateCycles.inc(p.respCycle - respCycle);
+                respCycle = p.respCycle;
+            } else {
+                profUseful.inc();
+            }
+            if (req.cycle > p.startCycle) profLeadCycles.inc(req.cycle - p.startCycle);  // OOO cores may issue out of order
+            p.lineAddr = 0;
+        }
+        if (pfVictims[idx] == req.lineAddr) {
+            profPolluting.inc();
+            pfVictims[idx] = 0;
+        }
+    }
+
+    if (pfHit) *pfHit = hit;
+    if (pfLate) *pfLate = late;
+    return respCycle;
+}
+
+uint64_t Prefetcher::prefetch(Address lineAddr, const MemReq& req, uint64_t cycle) {
+    MESIState state = I;
+    MemReq pfReq = {lineAddr, GETS, childId, &state, cycle, req.childLock, state, req.srcId, MemReq::PREFETCH, req.pc, (Address)-1L};
+    uint64_t respCycle = parent->access(pfReq);  // FIXME, might segfault
+    assert(state == I);  // prefetch access should not give us any permissions
+    profPrefetches.inc();
+
+    if (pfReq.evictedLineAddr == (Address)-1L) {  // parent had the line
+        profRedundant.inc();
+        return respCycle;
+    }
+    if (pfReq.evictedLineAddr) evicted(pfReq.evictedLineAddr, true);
+
+    uint32_t idx = lineAddr & (TRACK_ENTRIES-1);
+    if (pfVictims[idx] == lineAddr) pfVictims[idx] = 0;  // refetched before any demand, no harm done
+    pfLines[idx] = {lineAddr, cycle, respCycle};  // may drop an older tracked line
+    return respCycle;
+}
+
+void Prefetcher::evicted(Address lineAddr, bool byPrefetch) {
+    uint32_t idx = lineAddr & (TRACK_ENTRIES-1);
+    if (pfLines[idx].lineAddr == lineAddr) {
+        profUseless.inc();
+        pfLines[idx].lineAddr = 0;
+    }
+    if (byPrefetch) pfVictims[idx] = lineAddr;
+}
+
+uint32_t Prefetcher::accuracy() const {
+    uint64_t issued = profPrefetches.get() - profRedundant.get();
+    uint64_t used = profUseful.get() + profLate.get();
+    return issued? MIN(100*used/issued, (uint64_t)100) : 100;
+}
+
+/* StreamPrefetcher */
+
 void StreamPrefetcher::initStats(AggregateStat* parentStat) {
     AggregateStat* s = new AggregateStat();
     s->init(name.c_str(), "Prefetcher stats");
     profAccesses.init("acc", "Accesses"); s->append(&profAccesses);
-    profPrefetches.init("pf", "Issued prefetches"); s->append(&profPrefetches);
+    initPrefetchStats(s);
     profDoublePrefetches.init("dpf", "Issued double prefetches"); s->append(&profDoublePrefetches);
     profPageHits.init("pghit", "Page/entry hit"); s->append(&profPageHits);
     profHits.init("hit", "Prefetch buffer hits, short and full"); s->append(&profHits);
@@ -60,12 +153,13 @@ uint64_t StreamPrefetcher::access(MemReq& req) {
     uint32_t origChildId = req.childId;
     req.childId = childId;
 
-    if (req.type != GETS) return parent->access(req); //other reqs ignored, including stores
+    if (req.type != GETS || req.is(MemReq::WARM)) return demandAccess(req); //other reqs ignored, including stores and warming accesses
 
     profAccesses.inc();
 
     uint64_t reqCycle = req.cycle;
-    uint64_t respCycle = parent->access(req);
+    bool pfLate;
+    uint64_t respCycle = demandAccess(req, nullptr, &pfLate);
 
     Address pageAddr = req.lineAddr >> 6;
     uint32_t pos = req.lineAddr & (64-1);
@@ -109,17 +203,15 @@ uint64_t StreamPrefetcher::access(MemReq& req) {
         array[idx].ts = timestamp++;
         DBG("%s: PAGE HIT idx %d", name.c_str(), idx);
 
-        // 1. Did we prefetch-hit?
+        // 1. Did we prefetch-hit? (demandAccess() already accounted for the prefetch's delay)
         bool shortPrefetch = false;
         if (e.valid[pos]) {
-            uint64_t pfRespCycle = e.times[pos].respCycle;
-            shortPrefetch = pfRespCycle > respCycle;
+            shortPrefetch = pfLate;
             e.valid[pos] = false;  // close, will help with long-lived transactions
-            respCycle = MAX(pfRespCycle, respCycle);
             e.lastCycle = MAX(respCycle, e.lastCycle);
             profHits.inc();
             if (shortPrefetch) profShortHits.inc();
-            DBG("%s: pos %d prefetched on %ld, pf resp %ld, demand resp %ld, short %d", name.c_str(), pos, e.times[pos].startCycle, pfRespCycle, respCycle, shortPrefetch);
+            DBG("%s: pos %d prefetch hit, demand resp %ld, short %d", name.c_str(), pos, respCycle, shortPrefetch);
         }
 
         // 2. Update predictors, issue prefetches
@@ -137,24 +229,16 @@ uint64_t StreamPrefetcher::access(MemReq& req) {
                 DBG("%s: pos %d stride %d conf %d lastPrefetchPos %d prefetchPos %d fetchDepth %d", name.c_str(), pos, stride, e.conf.counter(), e.lastPrefetchPos, prefetchPos, fetchDepth);
 
                 if (prefetchPos < 64 && !e.valid[prefetchPos]) {
-                    MESIState state = I;
-                    MemReq pfReq = {req.lineAddr + prefetchPos - pos, GETS, req.childId, &state, reqCycle, req.childLock, state, req.srcId, MemReq::PREFETCH};
-                    uint64_t pfRespCycle = parent->access(pfReq);  // FIXME, might segfault
+                    prefetch(req.lineAddr + prefetchPos - pos, req, reqCycle);
                     e.valid[prefetchPos] = true;
-                    e.times[prefetchPos].fill(reqCycle, pfRespCycle);
-                    profPrefetches.inc();
 
                     if (shortPrefetch && fetchDepth < 8 && prefetchPos + stride < 64 && !e.valid[prefetchPos + stride]) {
                         prefetchPos += stride;
-                        pfReq.lineAddr += stride;
-                        pfRespCycle = parent->access(pfReq);
+                        prefetch(req.lineAddr + prefetchPos - pos, req, reqCycle);
                         e.valid[prefetchPos] = true;
-                        e.times[prefetchPos].fill(reqCycle, pfRespCycle);
-                        profPrefetches.inc();
                         profDoublePrefetches.inc();
                     }
                     e.lastPrefetchPos = prefetchPos;
-                    assert(state == I);  // prefetch access should not give us any permissions
                 }
             } else {
                 profLowConfAccs.inc();
@@ -182,9 +266,328 @@ uint64_t StreamPrefetcher::access(MemReq& req) {
     return respCycle;
 }
 
-// nop for now; do we need to invalidate our own state?
-uint64_t StreamPrefetcher::invalidate(const InvReq& req) {
-    return child->invalidate(req);
+void StreamPrefetcher::saveState(CheckpointWriter& cw) {
+    std::string n = name.c_str();
+    cw.write(n + ".timestamp", &timestamp, sizeof(timestamp));
+    cw.write(n + ".tags", tag, sizeof(tag));
+    cw.write(n + ".streams", array, sizeof(array));
+}
+
+void StreamPrefetcher::restoreState(CheckpointReader& cr) {
+    std::string n = name.c_str();
+    cr.read(n + ".timestamp", &timestamp, sizeof(timestamp));
+    cr.read(n + ".tags", tag, sizeof(tag));
+    if (cr.read(n + ".streams", array, sizeof(array))) {
+        //Cycles are from the checkpointed run; prefetch delays are not restored, so all prefetches are complete
+        for (Entry& e : array) e.lastCycle = 0;
+    }
 }
 
+/* IPStridePrefetcher */
 
+IPStridePrefetcher::IPStridePrefetcher(const g_string& _name, uint32_t entries, uint32_t _degree)
+    : Prefetcher(_name), degree(_degree)
+{
+    assert(isPow2(entries));
+    table = gm_calloc<Entry>(entries);
+    tableMask = entries - 1;
+}
+
+void IPStridePrefetcher::initStats(AggregateStat* parentStat) {
+    AggregateStat* s = new AggregateStat();
+    s->init(name.c_str(), "Prefetcher stats");
+    profAccesses.init("acc", "Accesses"); s->append(&profAccesses);
+    initPrefetchStats(s);
+    profTableMisses.init("tmiss", "Accesses that missed in the PC table"); s->append(&profTableMisses);
+    profLowConfAccs.init("lcAccs", "Low-confidence accesses with no prefetches"); s->append(&profLowConfAccs);
+    parentStat->append(s);
+}
+
+uint64_t IPStridePrefetcher::access(MemReq& req) {
+    uint32_t origChildId = req.childId;
+    req.childId = childId;
+
+    if (req.type != GETS || req.is(MemReq::WARM)) return demandAccess(req); //other reqs ignored, including stores and warming accesses
+
+    profAccesses.inc();
+    uint64_t respCycle = demandAccess(req);
+
+    Entry& e = table[(req.pc ^ (req.pc >> 16)) & tableMask];
+    if (e.pc != req.pc) {
+        profTableMisses.inc();
+        e.pc = req.pc;
+        e.lastLineAddr = req.lineAddr;
+        e.stride = 0;
+        e.conf.reset();
+    } else if (req.lineAddr != e.lastLineAddr) {  // same-line misses don't train
+        int64_t stride = req.lineAddr - e.lastLineAddr;
+        if (stride == e.stride) {
+            e.conf.inc();
+        } else {
+            e.conf.dec();
+            if (!e.conf.pred()) e.stride = stride;
+        }
+        e.lastLineAddr = req.lineAddr;
+
+        if (e.conf.pred()) {
+            for (uint32_t d = 1; d <= degree; d++) {
+                Address pfLineAddr = req.lineAddr + d*e.stride;
+                if ((pfLineAddr >> PAGE_BITS) != (req.lineAddr >> PAGE_BITS)) break;
+                if (!isPrefetched(pfLineAddr)) prefetch(pfLineAddr, req, req.cycle);
+            }
+        } else {
+            profLowConfAccs.inc();
+        }
+    }
+
+    req.childId = origChildId;
+    return respCycle;
+}
+
+void IPStridePrefetcher::saveState(CheckpointWriter& cw) {
+    cw.write(std::string(name.c_str()) + ".table", table, (tableMask + 1)*sizeof(Entry));
+}
+
+void IPStridePrefetcher::restoreState(CheckpointReader& cr) {
+    cr.read(std::string(name.c_str()) + ".table", table, (tableMask + 1)*sizeof(Entry));
+}
+
+/* SPPPrefetcher */
+
+SPPPrefetcher::SPPPrefetcher(const g_string& _name, uint32_t _threshold) : Prefetcher(_name), threshold(_threshold) {
+    st = gm_calloc<SigEntry>(ST_ENTRIES);
+    pt = gm_calloc<PatternEntry>(PT_ENTRIES);
+}
+
+void SPPPrefetcher::initStats(AggregateStat* parentStat) {
+    AggregateStat* s = new AggregateStat();
+    s->init(name.c_str(), "Prefetcher stats");
+    profAccesses.init("acc", "Accesses"); s->append(&profAccesses);
+    initPrefetchStats(s);
+    profSigMisses.init("stmiss", "Accesses that missed in the signature table"); s->append(&profSigMisses);
+    profLookahead.init("lookahead", "Lookahead steps"); s->append(&profLookahead);
+    parentStat->append(s);
+}
+
+void SPPPrefetcher::train(uint32_t sig, int32_t delta) {
+    PatternEntry& p = pt[sig % PT_ENTRIES];
+    uint32_t match = PT_DELTAS;
+    uint32_t victim = 0;
+    for (uint32_t i = 0; i < PT_DELTAS; i++) {
+        if (p.cDelta[i] && p.delta[i] == delta) match = i;
+        if (p.cDelta[i] < p.cDelta[victim]) victim = i;
+    }
+    if (match == PT_DELTAS) {
+        match = victim;
+        p.delta[match] = delta;
+        p.cDelta[match] = 0;
+    }
+
+    p.cDelta[match]++;
+    p.cSig++;
+    if (p.cSig > COUNTER_MAX || p.cDelta[match] > COUNTER_MAX) {  // halve all, keeping ratios
+        p.cSig >>= 1;
+        for (uint32_t i = 0; i < PT_DELTAS; i++) p.cDelta[i] >>= 1;
+    }
+}
+
+uint64_t SPPPrefetcher::access(MemReq& req) {
+    uint32_t origChildId = req.childId;
+    req.childId = childId;
+
+    if (req.type != GETS || req.is(MemReq::WARM)) return demandAccess(req); //other reqs ignored, including stores and warming accesses
+
+    profAccesses.inc();
+    uint64_t respCycle = demandAccess(req);
+
+    Address pageAddr = req.lineAddr >> PAGE_BITS;
+    uint32_t offset = req.lineAddr & ((1 << PAGE_BITS) - 1);
+    SigEntry& e = st[pageAddr % ST_ENTRIES];
+    if (e.pageAddr != pageAddr) {
+        profSigMisses.inc();
+        e.pageAddr = pageAddr;
+        e.lastOffset = offset;
+        e.sig = 0;
+    } else if (offset != e.lastOffset) {
+        int32_t delta = offset - e.lastOffset;
+        train(e.sig, delta);
+        e.sig = nextSig(e.sig, delta);
+        e.lastOffset = offset;
+
+        // Lookahead: follow the most likely delta while the path's confidence (in %) stays above threshold
+        uint32_t alpha = accuracy();
+        uint32_t sig = e.sig;
+        int32_t pos = offset;
+        uint32_t conf = 100;
+        for (uint32_t depth = 0; depth < MAX_DEPTH; depth++) {
+            const PatternEntry& p = pt[sig % PT_ENTRIES];
+            if (!p.cSig) break;
+            profLookahead.inc();
+
+            uint32_t bestConf = 0;
+            int32_t bestDelta = 0;
+            for (uint32_t i = 0; i < PT_DELTAS; i++) {
+                if (!p.cDelta[i]) continue;
+                uint32_t c = conf*p.cDelta[i]/p.cSig;
+                if (depth) c = c*alpha/100;
+                if (c < threshold) continue;
+                int32_t pfPos = pos + p.delta[i];
+                if (pfPos >= 0 && pfPos < (1 << PAGE_BITS)) {
+                    Address pfLineAddr = (pageAddr << PAGE_BITS) | pfPos;
+                    if (!isPrefetched(pfLineAddr)) prefetch(pfLineAddr, req, req.cycle);
+                }
+                if (c > bestConf) {
+                    bestConf = c;
+                    bestDelta = p.delta[i];
+                }
+            }
+
+            if (!bestConf) break;
+            pos += bestDelta;
+            if (pos < 0 || pos >= (1 << PAGE_BITS)) break;
+            conf = bestConf;
+            sig = nextSig(sig, bestDelta);
+        }
+    }
+
+    req.childId = origChildId;
+    return respCycle;
+}
+
+void SPPPrefetcher::saveState(CheckpointWriter& cw) {
+    std::string n = name.c_str();
+    cw.write(n + ".st", st, ST_ENTRIES*sizeof(SigEntry));
+    cw.write(n + ".pt", pt, PT_ENTRIES*sizeof(PatternEntry));
+}
+
+void SPPPrefetcher::restoreState(CheckpointReader& cr) {
+    std::string n = name.c_str();
+    cr.read(n + ".st", st, ST_ENTRIES*sizeof(SigEntry));
+    cr.read(n + ".pt", pt, PT_ENTRIES*sizeof(PatternEntry));
+}
+
+/* BestOffsetPrefetcher */
+
+// Offsets of the form 2^i*3^j*5^k, as in the paper, up to the page size
+const int32_t BestOffsetPrefetcher::offsets[NUM_OFFSETS] =
+    {1, 2, 3, 4, 5, 6, 8, 9, 10, 12, 15, 16, 18, 20, 24, 25, 27, 30, 32, 36, 40, 45, 48, 50, 54, 60};
+
+BestOffsetPrefetcher::BestOffsetPrefetcher(const g_string& _name)
+    : Prefetcher(_name), numPending(0), testIdx(0), round(0), bestOffset(1), pfOn(true)
+{
+    for (Address& a : rr) a = 0;
+    for (uint32_t& s : scores) s = 0;
+}
+
+void BestOffsetPrefetcher::initStats(AggregateStat* parentStat) {
+    AggregateStat* s = new AggregateStat();
+    s->init(name.c_str(), "Prefetcher stats");
+    profAccesses.init("acc", "Accesses"); s->append(&profAccesses);
+    initPrefetchStats(s);
+    profPhases.init("phases", "Learning phases"); s->append(&profPhases);
+    profOffPhases.init("offPhases", "Learning phases that turned prefetching off"); s->append(&profOffPhases);
+    auto offsetLambda = [this]() -> uint64_t { return pfOn? bestOffset : 0; };
+    auto offsetStat = makeLambdaStat(offsetLambda);
+    offsetStat->init("offset", "Current best offset (0 if off)");
+    s->append(offsetStat);
+    parentStat->append(s);
+}
+
+void BestOffsetPrefetcher::fillsDone(uint64_t cycle) {
+    uint32_t i = 0;
+    while (i < numPending) {
+        if (pending[i].respCycle <= cycle) {
+            rr[rrIdx(pending[i].baseLineAddr)] = pending[i].baseLineAddr;
+            pending[i] = pending[--numPending];
+        } else {
+            i++;
+        }
+    }
+}
+
+void BestOffsetPrefetcher::addPending(Address baseLineAddr, uint64_t respCycle) {
+    if (numPending == MAX_PENDING) {  // full, complete the earliest fill
+        uint32_t first = 0;
+        for (uint32_t i = 1; i < numPending; i++) {
+            if (pending[i].respCycle < pending[first].respCycle) first = i;
+        }
+        rr[rrIdx(pending[first].baseLineAddr)] = pending[first].baseLineAddr;
+        pending[first] = pending[--numPending];
+    }
+    pending[numPending++] = {baseLineAddr, respCycle};
+}
+
+void BestOffsetPrefetcher::learn(Address lineAddr) {
+    Address testLineAddr = lineAddr - offsets[testIdx];
+    if (rr[rrIdx(testLineAddr)] == testLineAddr) scores[testIdx]++;
+    bool done = scores[testIdx] >= SCORE_MAX;
+
+    if (++testIdx == NUM_OFFSETS) {
+        testIdx = 0;
+        done |= (++round >= ROUND_MAX);
+    }
+
+    if (done) {
+        uint32_t best = 0;
+        for (uint32_t i = 1; i < NUM_OFFSETS; i++) {
+            if (scores[i] > scores[best]) best = i;
+        }
+        bestOffset = offsets[best];
+        pfOn = scores[best] > BAD_SCORE;
+        profPhases.inc();
+        if (!pfOn) profOffPhases.inc();
+        DBG("%s: phase done, best offset %d score %d", name.c_str(), bestOffset, scores[best]);
+
+        for (uint32_t& s : scores) s = 0;
+        testIdx = 0;
+        round = 0;
+    }
+}
+
+uint64_t BestOffsetPrefetcher::access(MemReq& req) {
+    uint32_t origChildId = req.childId;
+    req.childId = childId;
+
+    if (req.type != GETS || req.is(MemReq::WARM)) return demandAccess(req); //other reqs ignored, including stores and warming accesses
+
+    profAccesses.inc();
+    bool pfHit, allocated;
+    uint64_t respCycle = demandAccess(req, &pfHit, nullptr, &allocated);
+
+    // Like the paper, train and prefetch on misses and prefetched hits only
+    if (allocated || pfHit) {
+        fillsDone(req.cycle);
+        learn(req.lineAddr);
+
+        Address pfLineAddr = req.lineAddr + bestOffset;
+        if (pfOn && (pfLineAddr >> PAGE_BITS) == (req.lineAddr >> PAGE_BITS)) {
+            if (!isPrefetched(pfLineAddr)) addPending(req.lineAddr, prefetch(pfLineAddr, req, req.cycle));
+        } else if (allocated) {
+            addPending(req.lineAddr, respCycle);
+        }
+    }
+
+    req.childId = origChildId;
+    return respCycle;
+}
+
+void BestOffsetPrefetcher::saveState(CheckpointWriter& cw) {
+    std::string n = name.c_str();
+    cw.write(n + ".rr", rr, sizeof(rr));
+    cw.write(n + ".scores", scores, sizeof(scores));
+    cw.write(n + ".testIdx", &testIdx, sizeof(testIdx));
+    cw.write(n + ".round", &round, sizeof(round));
+    cw.write(n + ".bestOffset", &bestOffset, sizeof(bestOffset));
+    cw.write(n + ".pfOn", &pfOn, sizeof(pfOn));
+}
+
+void BestOffsetPrefetcher::restoreState(CheckpointReader& cr) {
+    std::string n = name.c_str();
+    cr.read(n + ".rr", rr, sizeof(rr));
+    cr.read(n + ".scores", scores, sizeof(scores));
+    cr.read(n + ".testIdx", &testIdx, sizeof(testIdx));
+    cr.read(n + ".round", &round, sizeof(round));
+    cr.read(n + ".bestOffset", &bestOffset, sizeof(bestOffset));
+    cr.read(n + ".pfOn", &pfOn, sizeof(pfOn));
+    numPending = 0;  // cycles are from the checkpointed run
+}
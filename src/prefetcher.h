@@ -50,6 +50,74 @@ class SatCounter {
         uint32_t counter() const { return count; }
 };
 
+/* Common base of all prefetchers. A prefetcher has a single child (e.g., the L1) and a single parent
+ * cache (e.g., the L2); it sees the child's misses, and its prefetches allocate lines in the parent.
+ *
+ * The base class keeps the delays of prefetched lines, and profiles prefetches from the cycles that
+ * fills and demand accesses actually see:
+ *  - useful: first demanded after its fill completed
+ *  - late: first demanded while in flight (the demand waits for the fill)
+ *  - useless: evicted from the parent before any demand
+ *  - polluting: demand accesses to lines that a prefetch fill evicted from the parent
+ * Lines are tracked in fixed-size, direct-mapped tables, so some may be lost. The parent only reports
+ * the victims of accesses that go through this prefetcher (see MemReq::evictedLineAddr), so with a
+ * shared parent, prefetched lines evicted by other children's accesses are not seen.
+ */
+class Prefetcher : public BaseCache {
+    private:
+        struct PfLine {
+            Address lineAddr;  // 0 if unused
+            uint64_t startCycle;  // issue cycle
+            uint64_t respCycle;  // fill cycle
+        };
+
+        static const uint32_t TRACK_ENTRIES = 4096;
+        PfLine* pfLines;  // prefetched lines that have not been demanded yet
+        Address* pfVictims;  // lines evicted by prefetch fills that have not been demanded yet
+
+        Counter profPrefetches, profRedundant, profUseful, profLate, profLateCycles, profLeadCycles, profUseless, profPolluting;
+
+    protected:
+        static const uint32_t PAGE_BITS = 6;  // prefetches stay within 64-line pages (4KB w/64-byte lines)
+
+        MemObject* parent;
+        BaseCache* child;
+        uint32_t childId;
+        g_string name;
+
+    public:
+        explicit Prefetcher(const g_string& _name);
+        const char* getName() { return name.c_str();}
+        void setParents(uint32_t _childId, const g_vector<MemObject*>& parents, Network* network);
+        void setChildren(const g_vector<BaseCache*>& children, Network* network);
+
+        // nop for now; do we need to invalidate our own state?
+        uint64_t invalidate(const InvReq& req) { return child->invalidate(req); }
+
+    protected:
+        void initPrefetchStats(AggregateStat* s);  // appends the common stats to s
+
+        /* Forwards demand access req to the parent (set req.childId first). If it is the first demand of a
+         * prefetched line, the response is no earlier than the prefetch's fill, and pfHit/pfLate say so.
+         * allocated (if given) says whether the parent missed and allocated the line.
+         */
+        uint64_t demandAccess(MemReq& req, bool* pfHit = nullptr, bool* pfLate = nullptr, bool* allocated = nullptr);
+
+        // Prefetches lineAddr into the parent on behalf of demand access req, issued at cycle; returns the fill cycle
+        uint64_t prefetch(Address lineAddr, const MemReq& req, uint64_t cycle);
+
+        // Was lineAddr prefetched and not demanded yet? (only for tracked lines)
+        bool isPrefetched(Address lineAddr) const {
+            return pfLines[lineAddr & (TRACK_ENTRIES-1)].lineAddr == lineAddr;
+        }
+
+        // Percentage of non-redundant prefetches that have been demanded (100 before any prefetch)
+        uint32_t accuracy() const;
+
+    private:
+        void evicted(Address lineAddr, bool byPrefetch);
+};
+
 /* This is basically a souped-up version of the DLP L2 prefetcher in Nehalem: 16 stream buffers,
  * but (a) no up/down distinction, and (b) strided operation based on dominant stride detection
  * to try to subsume as much of the L1 IP/strided prefetcher as possible.
@@ -57,22 +125,14 @@ class SatCounter {
  * FIXME: For now, mostly hardcoded; 64-line entries (4KB w/64-byte lines), fixed granularities, etc.
  * TODO: Adapt to use weave models
  */
-class StreamPrefetcher : public BaseCache {
+class StreamPrefetcher : public Prefetcher {
     private:
         struct Entry {
             // Two competing strides; at most one active
             int32_t stride;
             SatCounter<3, 2, 1> conf;
 
-            struct AccessTimes {
-                uint64_t startCycle;  // FIXME: Dead for now, we should use it for profiling
-                uint64_t respCycle;
-
-                void fill(uint32_t s, uint64_t r) { startCycle = s; respCycle = r; }
-            };
-
-            AccessTimes times[64];
-            std::bitset<64> valid;
+            std::bitset<64> valid;  // prefetched, not demanded yet; the base class keeps their delays
 
             uint32_t lastPos;
             uint32_t lastLastPos;
@@ -95,22 +155,144 @@ class StreamPrefetcher : public BaseCache {
         Address tag[16];
         Entry array[16];
 
-        Counter profAccesses, profPrefetches, profDoublePrefetches, profPageHits, profHits, profShortHits, profStrideSwitches, profLowConfAccs;
+        Counter profAccesses, profDoublePrefetches, profPageHits, profHits, profShortHits, profStrideSwitches, profLowConfAccs;
 
-        MemObject* parent;
-        BaseCache* child;
-        uint32_t childId;
-        g_string name;
+    public:
+        explicit StreamPrefetcher(const g_string& _name) : Prefetcher(_name), timestamp(0) {}
+        void initStats(AggregateStat* parentStat);
+
+        uint64_t access(MemReq& req);
+
+        void saveState(CheckpointWriter& cw);
+        void restoreState(CheckpointReader& cr);
+};
+
+/* Instruction-pointer stride prefetcher: a direct-mapped table indexed by the PC signature of the
+ * demand access (see MemReq::pc) detects per-instruction strides. Once a stride is confirmed, keeps
+ * up to degree lines ahead of the access in flight, within its page.
+ */
+class IPStridePrefetcher : public Prefetcher {
+    private:
+        struct Entry {
+            Address pc;
+            Address lastLineAddr;
+            int64_t stride;
+            SatCounter<3, 2, 0> conf;
+        };
+
+        Entry* table;
+        uint32_t tableMask;
+        uint32_t degree;
+
+        Counter profAccesses, profTableMisses, profLowConfAccs;
 
     public:
-        explicit StreamPrefetcher(const g_string& _name) : timestamp(0), name(_name) {}
+        IPStridePrefetcher(const g_string& _name, uint32_t entries, uint32_t _degree);
         void initStats(AggregateStat* parentStat);
-        const char* getName() { return name.c_str();}
-        void setParents(uint32_t _childId, const g_vector<MemObject*>& parents, Network* network);
-        void setChildren(const g_vector<BaseCache*>& children, Network* network);
 
         uint64_t access(MemReq& req);
-        uint64_t invalidate(const InvReq& req);
+
+        void saveState(CheckpointWriter& cw);
+        void restoreState(CheckpointReader& cr);
+};
+
+/* Signature path prefetcher (Kim et al., MICRO 2016). A signature table compresses the history of
+ * deltas within each page into a 12-bit signature, and a pattern table learns which deltas follow
+ * each signature. Prefetching walks down the most likely path of deltas, multiplying the confidence
+ * of each step by the prefetcher's measured accuracy, and stops when it drops below threshold (%).
+ * Simplified: no global history register (no cross-page lookahead) and no prefetch filter (the base
+ * class already drops lines in flight).
+ */
+class SPPPrefetcher : public Prefetcher {
+    private:
+        static const uint32_t ST_ENTRIES = 256;
+        static const uint32_t PT_ENTRIES = 512;
+        static const uint32_t PT_DELTAS = 4;
+        static const uint32_t SIG_BITS = 12;
+        static const uint32_t COUNTER_MAX = 15;  // 4-bit counters
+        static const uint32_t MAX_DEPTH = 16;
+
+        struct SigEntry {
+            Address pageAddr;
+            uint32_t lastOffset;
+            uint32_t sig;
+        };
+
+        struct PatternEntry {
+            int32_t delta[PT_DELTAS];
+            uint32_t cDelta[PT_DELTAS];
+            uint32_t cSig;
+        };
+
+        SigEntry* st;
+        PatternEntry* pt;
+        uint32_t threshold;
+
+        Counter profAccesses, profSigMisses, profLookahead;
+
+        static uint32_t nextSig(uint32_t sig, int32_t delta) {
+            uint32_t d = (delta < 0)? ((-delta) & 0x3f) | 0x40 : delta;  // 7-bit sign-magnitude
+            return ((sig << 3) ^ d) & ((1 << SIG_BITS) - 1);
+        }
+
+        void train(uint32_t sig, int32_t delta);
+
+    public:
+        SPPPrefetcher(const g_string& _name, uint32_t _threshold);
+        void initStats(AggregateStat* parentStat);
+
+        uint64_t access(MemReq& req);
+
+        void saveState(CheckpointWriter& cw);
+        void restoreState(CheckpointReader& cr);
+};
+
+/* Best-offset prefetcher (Michaud, HPCA 2016). Prefetches X + D on each access to line X. D is picked
+ * in learning phases that test, one per access, each candidate offset d: d scores if X - d is in the
+ * recent requests (RR) table, which holds the base address of prefetches and misses whose fills have
+ * completed, so D is the largest offset whose prefetches tend to be timely. Prefetching turns off if
+ * no offset scores above BAD_SCORE. Offsets are limited to positive ones within a page.
+ */
+class BestOffsetPrefetcher : public Prefetcher {
+    private:
+        static const uint32_t NUM_OFFSETS = 26;
+        static const int32_t offsets[NUM_OFFSETS];
+        static const uint32_t RR_ENTRIES = 256;
+        static const uint32_t SCORE_MAX = 31;
+        static const uint32_t ROUND_MAX = 100;
+        static const uint32_t BAD_SCORE = 1;
+        static const uint32_t MAX_PENDING = 32;
+
+        struct PendingFill {
+            Address baseLineAddr;
+            uint64_t respCycle;
+        };
+
+        Address rr[RR_ENTRIES];
+        PendingFill pending[MAX_PENDING];  // fills not completed yet; they go in the RR table when they do
+        uint32_t numPending;
+
+        uint32_t scores[NUM_OFFSETS];
+        uint32_t testIdx;
+        uint32_t round;
+        int32_t bestOffset;
+        bool pfOn;
+
+        Counter profAccesses, profPhases, profOffPhases;
+
+        static uint32_t rrIdx(Address lineAddr) { return (lineAddr ^ (lineAddr >> 8)) & (RR_ENTRIES-1); }
+        void fillsDone(uint64_t cycle);
+        void addPending(Address baseLineAddr, uint64_t respCycle);
+        void learn(Address lineAddr);
+
+    public:
+        explicit BestOffsetPrefetcher(const g_string& _name);
+        void initStats(AggregateStat* parentStat);
+
+        uint64_t access(MemReq& req);
+
+        void saveState(CheckpointWriter& cw);
+        void restoreState(CheckpointReader& cr);
 };
 
 #endif  // PREFETCHER_H_
@@ -150,5 +150,117 @@ class PrioQueue {
         }
 };
 
+/* Hierarchical timing wheel with the same interface as PrioQueue. Cycles are split in 6-bit digits; level l holds
+ * the elements whose cycle first differs from the current cycle (cur) at digit l, in a 64-slot wheel indexed by that
+ * digit. Unlike PrioQueue, there is no window: enqueue is O(1) for any cycle, and each element moves down at most
+ * LEVELS times before being dequeued. Like PrioQueue, elements must be enqueued at or after the last dequeued cycle.
+ */
+template <typename T>
+class TimingWheel {
+    static const uint32_t LEVELS = 11; // 6*11 bits >= 64 bits
+
+    struct Wheel {
+        T* slots[64];
+        uint64_t occ; // bit i is 1 if slots[i] is populated
+    };
+
+    Wheel wheels[LEVELS];
+
+    uint64_t cur;
+    uint64_t minCycle;  // cached, so that firstCycle() is always O(1)
+    uint64_t elems;
+
+    static inline uint32_t levelOf(uint64_t cycle, uint64_t ref) {
+        uint64_t diff = cycle ^ ref;
+        return diff? (63 - __builtin_clzl(diff))/6 : 0;
+    }
+
+    inline void insert(T* obj, uint64_t cycle) {
+        uint32_t l = levelOf(cycle, cur);
+        uint32_t pos = (cycle >> (6*l)) & 63;
+        assert(!obj->next);
+        obj->next = wheels[l].slots[pos];
+        wheels[l].slots[pos] = obj;
+        wheels[l].occ |= 1L << pos;
+    }
+
+    public:
+        TimingWheel() {
+            for (uint32_t l = 0; l < LEVELS; l++) {
+                for (uint32_t i = 0; i < 64; i++) wheels[l].slots[i] = nullptr;
+                wheels[l].occ = 0;
+            }
+            cur = 0;
+            minCycle = 0;
+            elems = 0;
+        }
+
+        void enqueue(T* obj, uint64_t cycle) {
+            assert(cycle >= cur);
+            obj->privCycle = cycle;
+            insert(obj, cycle);
+            minCycle = elems? MIN(minCycle, cycle) : cycle;
+            elems++;
+        }
+
+        T* dequeue(uint64_t& deqCycle) {
+            assert(elems);
+            // Cascade the first populated slot of the lowest populated level down until level 0 has elements.
+            // cur only moves up to that slot's first cycle, which is <= minCycle, so later enqueues stay valid.
+            while (!wheels[0].occ) {
+                uint32_t l = 1;
+                while (!wheels[l].occ) l++;
+                assert(l < LEVELS);
+                uint32_t pos = __builtin_ctzl(wheels[l].occ);
+                T* list = wheels[l].slots[pos];
+                wheels[l].slots[pos] = nullptr;
+                wheels[l].occ ^= 1L << pos;
+
+                uint64_t hiMask = (l == LEVELS-1)? 0 : ~((1L << (6*(l+1))) - 1);
+                cur = (cur & hiMask) | (((uint64_t)pos) << (6*l));
+                while (list) {
+                    T* next = list->next;
+                    list->next = nullptr;
+                    insert(list, list->privCycle);
+                    list = next;
+                }
+            }
+
+            uint32_t pos = __builtin_ctzl(wheels[0].occ);
+            T* obj = wheels[0].slots[pos];
+            wheels[0].slots[pos] = obj->next;
+            if (!obj->next) wheels[0].occ ^= 1L << pos;
+            obj->next = nullptr;
+            elems--;
+
+            cur = (cur & ~63L) | pos;
+            deqCycle = cur;
+            assert(deqCycle == minCycle);
+
+            // Refresh minCycle; only scans a slot's list when level 0 has drained
+            if (elems) {
+                if (wheels[0].occ) {
+                    minCycle = (cur & ~63L) | __builtin_ctzl(wheels[0].occ);
+                } else {
+                    uint32_t l = 1;
+                    while (!wheels[l].occ) l++;
+                    T* e = wheels[l].slots[__builtin_ctzl(wheels[l].occ)];
+                    minCycle = e->privCycle;
+                    for (e = e->next; e; e = e->next) minCycle = MIN(minCycle, e->privCycle);
+                }
+            }
+            return obj;
+        }
+
+        inline uint64_t size() const {
+            return elems;
+        }
+
+        inline uint64_t firstCycle() const {
+            assert(elems);
+            return minCycle;
+        }
+};
+
 #endif  // PRIO_QUEUE_H_
 
@@ -24,6 +24,8 @@
  */
 
 #include "process_tree.h"
+#include <algorithm>
+#include <fstream>
 #include <sstream>
 #include <stdlib.h>
 #include <string>
@@ -44,8 +46,35 @@ static string DefaultMaskStr() {
     return ss.str();
 }
 
+/* Turns a SimPoint .simpoints file (one "<interval> <cluster>" line per simulation point, as written by the
+ * simpoint tool) into FFI points, i.e., alternating fast-forward and simulated instruction counts. Adjacent
+ * points are not merged (they get a zero-length fast-forward), so each point ends with its own stats dump.
+ */
+static g_vector<uint64_t> SimPointsToFFIPoints(const string& file, uint64_t interval) {
+    std::ifstream in(file.c_str());
+    if (!in.good()) panic("Could not open simpoints file %s", file.c_str());
+    std::vector<uint64_t> points;
+    uint64_t point, cluster;
+    while (in >> point >> cluster) points.push_back(point);
+    if (points.empty()) panic("Simpoints file %s has no points", file.c_str());
+    std::sort(points.begin(), points.end());
+    for (uint32_t i = 1; i < points.size(); i++) {
+        if (points[i] == points[i-1]) panic("Simpoints file %s lists interval %ld twice", file.c_str(), points[i]);
+    }
+
+    g_vector<uint64_t> ffiPoints;
+    uint64_t pos = 0;
+    for (uint64_t p : points) {
+        ffiPoints.push_back(p*interval - pos);
+        ffiPoints.push_back(interval);
+        pos = (p + 1)*interval;
+    }
+    info("%s: %ld simulation points of %ld instructions (%ld instructions simulated in detail)", file.c_str(), points.size(), interval, points.size()*interval);
+    return ffiPoints;
+}
+
 //Helper
-static void DumpEventualStats(uint32_t procIdx, const char* reason) {
+void DumpEventualStats(uint32_t procIdx, const char* reason) {
     uint32_t p = zinfo->procArray[procIdx]->getGroupIdx();
     info("Dumping eventual stats for process GROUP %d (%s)", p, reason);
     zinfo->trigger = p;
@@ -187,6 +216,26 @@ static void PopulateLevel(Config& config, const std::string& prefix, std::vector
         }  //  else leave mask empty, no cores
         g_vector<uint64_t> ffiPoints(ParseList<uint64_t>(config.get<const char*>(p_ss.str() +  ".ffiPoints", "")));
 
+        //SimPoints: profile BBVs with bbvInterval, cluster them with the simpoint tool, then simulate the chosen intervals
+        uint64_t bbvInterval = config.get<uint64_t>(p_ss.str() +  ".bbvInterval", 0);
+        string simpoints = config.get<const char*>(p_ss.str() +  ".simpoints", "");
+        if (!simpoints.empty()) {
+            if (!ffiPoints.empty()) panic("process%d: ffiPoints and simpoints are mutually exclusive", procIdx);
+            if (!startFastForwarded) panic("process%d: simpoints needs startFastForwarded = true", procIdx);
+            uint64_t simpointInterval = config.get<uint64_t>(p_ss.str() +  ".simpointInterval");
+            ffiPoints = SimPointsToFFIPoints(simpoints, simpointInterval);
+        }
+        bool ffiDumpStats = config.get<bool>(p_ss.str() +  ".ffiDumpStats", !simpoints.empty());
+
+        //Instruction traces (see instr_trace.h). A replayed process does not run its command; threads of the same
+        //recorded process should be replayed as a group of processes (groupWithPrevious), which share its address space.
+        bool recordInstrTrace = config.get<bool>(p_ss.str() +  ".recordInstrTrace", false);
+        g_string instrTrace = config.get<const char*>(p_ss.str() +  ".instrTrace", "");
+        if (!instrTrace.empty()) {
+            if (recordInstrTrace) panic("process%d: recordInstrTrace and instrTrace are mutually exclusive", procIdx);
+            if (startFastForwarded || !ffiPoints.empty()) panic("process%d: replayed processes can't be fast-forwarded", procIdx);
+        }
+
         if (dumpInstrs) {
             if (dumpHeartbeats) warn("Dumping eventual stats on both heartbeats AND instructions; you won't be able to distinguish both!");
             auto getInstrs = [procIdx]() { return zinfo->processStats->getProcessInstrs(procIdx); };
@@ -207,7 +256,7 @@ static void PopulateLevel(Config& config, const std::string& prefix, std::vector
         else
             panic("Invalid synced fast forward mode %s", syncedFastForwardStr.c_str());
 
-        ProcessTreeNode* ptn = new ProcessTreeNode(procIdx, groupIdx, startFastForwarded, startPaused, syncedFastForward, clockDomain, portDomain, dumpHeartbeats, dumpsResetHeartbeats, restarts, mask, ffiPoints, syscallBlacklistRegex, gpr);
+        ProcessTreeNode* ptn = new ProcessTreeNode(procIdx, groupIdx, startFastForwarded, startPaused, syncedFastForward, clockDomain, portDomain, dumpHeartbeats, dumpsResetHeartbeats, restarts, mask, ffiPoints, ffiDumpStats, bbvInterval, recordInstrTrace, instrTrace, syscallBlacklistRegex, gpr);
         //info("Created ProcessTreeNode, procIdx %d", procIdx);
         parent->addChild(ptn);
         children.push_back(ptn);
@@ -229,7 +278,7 @@ static void PopulateLevel(Config& config, const std::string& prefix, std::vector
 }
 
 void CreateProcessTree(Config& config) {
-    ProcessTreeNode* rootNode = new ProcessTreeNode(-1, -1, false, false, SFF_NEVER, 0, 0, 0, false, 0, g_vector<bool> {},  g_vector<uint64_t> {}, g_string {}, nullptr);
+    ProcessTreeNode* rootNode = new ProcessTreeNode(-1, -1, false, false, SFF_NEVER, 0, 0, 0, false, 0, g_vector<bool> {},  g_vector<uint64_t> {}, false, 0, false, g_string {}, g_string {}, nullptr);
     uint32_t procIdx = 0;
     uint32_t groupIdx = 0;
     std::vector<ProcessTreeNode*> globProcVector;
@@ -59,14 +59,20 @@ class ProcessTreeNode : public GlobAlloc {
         const bool dumpsResetHeartbeats;
         const g_vector<bool> mask;
         const g_vector<uint64_t> ffiPoints;
+        const bool ffiDumpStats; //dump eventual stats at the end of each simulated FFI region (e.g., for SimPoints)
+        const uint64_t bbvInterval; //0 if not profiling BBVs
+        const bool recordInstrTrace; //write per-thread instruction traces (see instr_trace.h)
+        const g_string instrTrace; //if not empty, replay this instruction trace instead of running the process
         const g_string syscallBlacklistRegex;
 
     public:
         ProcessTreeNode(uint32_t _procIdx, uint32_t _groupIdx, bool _inFastForward, bool _inPause, const SyncedFastForwardMode& _syncedFastForward,
                         uint32_t _clockDomain, uint32_t _portDomain, uint64_t _dumpHeartbeats, bool _dumpsResetHeartbeats, uint32_t _restarts,
-                        const g_vector<bool>& _mask, const g_vector<uint64_t>& _ffiPoints, const g_string& _syscallBlacklistRegex, const char*_patchRoot)
+                        const g_vector<bool>& _mask, const g_vector<uint64_t>& _ffiPoints, bool _ffiDumpStats, uint64_t _bbvInterval,
+                        bool _recordInstrTrace, const g_string& _instrTrace, const g_string& _syscallBlacklistRegex, const char*_patchRoot)
             : patchRoot(_patchRoot), procIdx(_procIdx), groupIdx(_groupIdx), curChildren(0), heartbeats(0), started(false), inFastForward(_inFastForward),
-              inPause(_inPause), restartsLeft(_restarts), syncedFastForward(_syncedFastForward), clockDomain(_clockDomain), portDomain(_portDomain), dumpHeartbeats(_dumpHeartbeats), dumpsResetHeartbeats(_dumpsResetHeartbeats), mask(_mask), ffiPoints(_ffiPoints), syscallBlacklistRegex(_syscallBlacklistRegex) {}
+              inPause(_inPause), restartsLeft(_restarts), syncedFastForward(_syncedFastForward), clockDomain(_clockDomain), portDomain(_portDomain), dumpHeartbeats(_dumpHeartbeats), dumpsResetHeartbeats(_dumpsResetHeartbeats), mask(_mask), ffiPoints(_ffiPoints), ffiDumpStats(_ffiDumpStats), bbvInterval(_bbvInterval),
+              recordInstrTrace(_recordInstrTrace), instrTrace(_instrTrace), syscallBlacklistRegex(_syscallBlacklistRegex) {}
 
         void addChild(ProcessTreeNode* child) {
             children.push_back(child);
@@ -140,6 +146,22 @@ class ProcessTreeNode : public GlobAlloc {
             return ffiPoints;
         }
 
+        bool getFFIDumpStats() const {
+            return ffiDumpStats;
+        }
+
+        uint64_t getBbvInterval() const {
+            return bbvInterval;
+        }
+
+        bool getRecordInstrTrace() const {
+            return recordInstrTrace;
+        }
+
+        const g_string& getInstrTrace() const {
+            return instrTrace;
+        }
+
         const g_string& getSyscallBlacklistRegex() const {
             return syscallBlacklistRegex;
         }
@@ -149,5 +171,8 @@ class ProcessTreeNode : public GlobAlloc {
 
 void CreateProcessTree(Config& config);
 
+//Dumps eventual stats for procIdx's process group; must be called at the end of a phase
+void DumpEventualStats(uint32_t procIdx, const char* reason);
+
 
 #endif  // PROCESS_TREE_H_
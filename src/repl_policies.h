@@ -26,12 +26,17 @@
 #ifndef REPL_POLICIES_H_
 #define REPL_POLICIES_H_
 
+#include <algorithm>
 #include <functional>
+#include <string.h>
+#include <vector>
 #include "bithacks.h"
 #include "cache_arrays.h"
+#include "checkpoint.h"
 #include "coherence_ctrls.h"
 #include "memory_hierarchy.h"
 #include "mtrand.h"
+#include "pad.h"
 
 /* Generic replacement policy interface. A replacement policy is initialized by the cache (by calling setTop/BottomCC) and used by the cache array. Usage follows two models:
  * - On lookups, update() is called if the replacement policy is to be updated on a hit
@@ -54,6 +59,10 @@ class ReplPolicy : public GlobAlloc {
         virtual uint32_t rankCands(const MemReq* req, ZCands cands) = 0;
 
         virtual void initStats(AggregateStat* parent) {}
+
+        //Checkpointing (see checkpoint.h); name is the policy's section. Caches whose policy doesn't implement it can't be checkpointed.
+        virtual void saveState(CheckpointWriter& cw, const std::string& name) {cw.unsupported(name);}
+        virtual void restoreState(CheckpointReader& cr, const std::string& name) {cr.unsupported(name);}
 };
 
 /* Add DECL_RANK_BINDINGS to each class that implements the new interface,
@@ -101,23 +110,61 @@ class LRUReplPolicy : public ReplPolicy {
         uint64_t* array;
         uint32_t numLines;
 
+        // With lock striping (see StripedLock), accesses to different stripes race, so each stripe has its own
+        // timestamp, in its own cache line. Stripes are groups of sets, and LRU only compares lines of one set.
+        static const uint32_t TS_STRIDE = CACHE_LINE_BYTES/sizeof(uint64_t);
+        uint64_t* stripeTimestamps; // nullptr with a single stripe
+        uint32_t ways;
+        uint32_t stripeMask;
+
+        inline uint64_t& curTimestamp(uint32_t id) {
+            return stripeMask? stripeTimestamps[((id/ways) & stripeMask)*TS_STRIDE] : timestamp;
+        }
+
     public:
-        explicit LRUReplPolicy(uint32_t _numLines) : timestamp(1), numLines(_numLines) {
-            array = gm_calloc<uint64_t>(numLines);
+        explicit LRUReplPolicy(uint32_t _numLines, uint32_t _ways = 1, uint32_t _lockStripes = 1)
+            : timestamp(1), numLines(_numLines), stripeTimestamps(nullptr), ways(_ways), stripeMask(_lockStripes - 1)
+        {
+            array = gm_calloc_aligned<uint64_t>(CACHE_LINE_BYTES, numLines);
+            assert(isPow2(_lockStripes));
+            if (stripeMask) {
+                stripeTimestamps = gm_calloc_aligned<uint64_t>(CACHE_LINE_BYTES, _lockStripes*TS_STRIDE);
+                for (uint32_t s = 0; s < _lockStripes; s++) stripeTimestamps[s*TS_STRIDE] = 1;
+            }
         }
 
         ~LRUReplPolicy() {
             gm_free(array);
+            if (stripeTimestamps) gm_free(stripeTimestamps);
         }
 
         void update(uint32_t id, const MemReq* req) {
-            array[id] = timestamp++;
+            array[id] = curTimestamp(id)++;
         }
 
         void replaced(uint32_t id) {
             array[id] = 0;
         }
 
+        //State is the timestamp, followed by the per-line timestamps. With stripes, the timestamp is the
+        //largest one, so restoring it to every stripe keeps all lines older than their stripe's timestamp.
+        void saveState(CheckpointWriter& cw, const std::string& name) {
+            std::vector<uint64_t> buf(numLines + 1);
+            buf[0] = timestamp;
+            for (uint32_t s = 0; stripeMask && s <= stripeMask; s++) buf[0] = MAX(buf[0], stripeTimestamps[s*TS_STRIDE]);
+            std::copy(array, array + numLines, buf.begin() + 1);
+            cw.write(name, buf);
+        }
+
+        void restoreState(CheckpointReader& cr, const std::string& name) {
+            std::vector<uint64_t> buf(numLines + 1);
+            if (cr.read(name, buf.data(), buf.size()*sizeof(uint64_t))) {
+                timestamp = buf[0];
+                for (uint32_t s = 0; stripeMask && s <= stripeMask; s++) stripeTimestamps[s*TS_STRIDE] = buf[0];
+                std::copy(buf.begin() + 1, buf.end(), array);
+            }
+        }
+
         template <typename C> inline uint32_t rank(const MemReq* req, C cands) {
             uint32_t bestCand = -1;
             uint64_t bestScore = (uint64_t)-1L;
@@ -133,11 +180,11 @@ class LRUReplPolicy : public ReplPolicy {
 
     private:
         inline uint64_t score(uint32_t id) { //higher is least evictable
-            //array[id] < timestamp always, so this prioritizes by:
+            //array[id] < its stripe's timestamp always, so this prioritizes by:
             // (1) valid (if not valid, it's 0)
             // (2) sharers, and
             // (3) timestamp
-            return (sharersAware? cc->numSharers(id) : 0)*timestamp + array[id]*cc->isValid(id);
+            return (sharersAware? cc->numSharers(id) : 0)*curTimestamp(id) + array[id]*cc->isValid(id);
         }
 };
 
@@ -186,6 +233,10 @@ class TreeLRUReplPolicy : public LRUReplPolicy<true> {
             candIdx = 0;
             array[id] = 0;
         }
+
+        //LRU's state would restore into a TreeLRU cache and vice versa, so don't claim it
+        void saveState(CheckpointWriter& cw, const std::string& name) {cw.unsupported(name);}
+        void restoreState(CheckpointReader& cr, const std::string& name) {cr.unsupported(name);}
 };
 
 //2-bit NRU, see A new Case for Skew-Associativity, A. Seznec, 1997
@@ -204,7 +255,7 @@ class NRUReplPolicy : public LegacyReplPolicy {
 
     public:
         NRUReplPolicy(uint32_t _numLines, uint32_t _numCands) :numLines(_numLines), numCands(_numCands), youngLines(0), candIdx(0) {
-            array = gm_calloc<uint32_t>(numLines);
+            array = gm_calloc_aligned<uint32_t>(CACHE_LINE_BYTES, numLines);
             candArray = gm_calloc<uint32_t>(numCands);
             candVal = (1<<20);
         }
@@ -249,6 +300,20 @@ class NRUReplPolicy : public LegacyReplPolicy {
             candIdx = 0;
             array[id] = 0;
         }
+        void saveState(CheckpointWriter& cw, const std::string& name) {
+            std::vector<uint32_t> buf(numLines + 1);
+            buf[0] = youngLines;
+            std::copy(array, array + numLines, buf.begin() + 1);
+            cw.write(name, buf);
+        }
+
+        void restoreState(CheckpointReader& cr, const std::string& name) {
+            std::vector<uint32_t> buf(numLines + 1);
+            if (cr.read(name, buf.data(), buf.size()*sizeof(uint32_t))) {
+                youngLines = buf[0];
+                std::copy(buf.begin() + 1, buf.end(), array);
+            }
+        }
 };
 
 class RandReplPolicy : public LegacyReplPolicy {
@@ -286,6 +351,9 @@ class RandReplPolicy : public LegacyReplPolicy {
         void replaced(uint32_t id) {
             candIdx = 0;
         }
+
+        void saveState(CheckpointWriter& cw, const std::string& name) {} //no state to save
+        void restoreState(CheckpointReader& cr, const std::string& name) {} //no state to restore
 };
 
 class LFUReplPolicy : public LegacyReplPolicy {
@@ -336,7 +404,7 @@ class LFUReplPolicy : public LegacyReplPolicy {
 
     public:
         explicit LFUReplPolicy(uint32_t _numLines) : timestamp(1), bestCandidate(-1), numLines(_numLines) {
-            array = gm_calloc<LFUInfo>(numLines);
+            array = gm_calloc_aligned<LFUInfo>(CACHE_LINE_BYTES, numLines);
             bestRank.reset();
         }
 
@@ -370,6 +438,20 @@ class LFUReplPolicy : public LegacyReplPolicy {
             bestRank.reset();
             array[id].acc = 0;
         }
+        void saveState(CheckpointWriter& cw, const std::string& name) {
+            std::vector<uint64_t> buf(2*numLines + 1);
+            buf[0] = timestamp;
+            memcpy(&buf[1], array, numLines*sizeof(LFUInfo));
+            cw.write(name, buf);
+        }
+
+        void restoreState(CheckpointReader& cr, const std::string& name) {
+            std::vector<uint64_t> buf(2*numLines + 1);
+            if (cr.read(name, buf.data(), buf.size()*sizeof(uint64_t))) {
+                timestamp = buf[0];
+                memcpy(array, &buf[1], numLines*sizeof(LFUInfo));
+            }
+        }
 };
 
 //Extends a given replacement policy to profile access ordering violations
@@ -420,6 +502,7 @@ class ProfViolReplPolicy : public T {
 
         void update(uint32_t id, const MemReq* req) {
             T::update(id, req);
+            if (req->is(MemReq::WARM)) return T::update(id, req); //functional warming access, its cycle is meaningless
 
             bool read = (req->type == GETS);
             assert(read || req->type == GETX);
@@ -471,6 +554,10 @@ class ProfViolReplPolicy : public T {
             accTimes[id].read = 0;
             accTimes[id].write = 0;
         }
+
+        //Per-line access times are not saved, and T's state alone would restore into a plain T cache
+        void saveState(CheckpointWriter& cw, const std::string& name) {cw.unsupported(name);}
+        void restoreState(CheckpointReader& cr, const std::string& name) {cr.unsupported(name);}
 };
 
 #endif  // REPL_POLICIES_H_
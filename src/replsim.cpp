@@ -0,0 +1,189 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Trace-driven comparison of replacement policies. Replays an access trace (e.g., one
+ * written by a TracingCache in front of the LLC, ideally ordered with sorttrace) through
+ * a single cache with each policy, side by side, and reports misses and MPKI. Only GETS
+ * and GETX accesses count and allocate; writebacks just look up the array.
+ *
+ * Access traces have no PCs, so PC-based policies (SHiP, Hawkeye) use memory-region
+ * signatures (see ReplSignature). OPT (Belady's) gives an upper bound on the hit rate; it
+ * needs an extra pass over the trace, and a temporary file in the current directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "access_tracing.h"
+#include "cache_arrays.h"
+#include "coherence_ctrls.h"
+#include "galloc.h"
+#include "hash.h"
+#include "log.h"
+#include "opt_repl_policy.h"
+#include "repl_policies.h"
+#include "rrip_repl_policies.h"
+#include "zsim.h"
+
+using namespace std;
+
+// Referenced by checkpointing code in the cache arrays, which this tool never uses
+GlobSimInfo* zinfo = nullptr;
+uint32_t lineBits = 6;
+
+/* Coherence controller stand-in: the replayed cache has no coherence, so this just tracks which lines are
+ * valid (for the replacement policies) */
+class ReplayCC : public CC {
+    private:
+        vector<bool> valid;
+
+    public:
+        explicit ReplayCC(uint32_t numLines) : valid(numLines, false) {}
+
+        void setValid(uint32_t lineId) { valid[lineId] = true; }
+
+        void setParents(uint32_t childId, const g_vector<MemObject*>& parents, Network* network) {}
+        void setChildren(const g_vector<BaseCache*>& children, Network* network) {}
+        void initStats(AggregateStat* cacheStat) {}
+
+        bool startAccess(MemReq& req) { return false; }
+        bool shouldAllocate(const MemReq& req) { return true; }
+        uint64_t processEviction(const MemReq& triggerReq, Address wbLineAddr, int32_t lineId, uint64_t startCycle) { return startCycle; }
+        uint64_t processAccess(const MemReq& req, int32_t lineId, uint64_t startCycle, uint64_t* getDoneCycle = nullptr) { return startCycle; }
+        void endAccess(const MemReq& req) {}
+
+        void startInv(const InvReq& req) {}
+        uint64_t processInv(const InvReq& req, int32_t lineId, uint64_t startCycle) { return startCycle; }
+
+        uint32_t numSharers(uint32_t lineId) { return 0; }
+        bool isValid(uint32_t lineId) { return valid[lineId]; }
+
+        void saveState(CheckpointWriter& cw, const std::string& name) {}
+        void restoreState(CheckpointReader& cr, const std::string& name) {}
+};
+
+struct ReplayCache {
+    string policy;
+    ReplayCC* cc;
+    CacheArray* array;
+    uint64_t accesses;
+    uint64_t misses;
+};
+
+static ReplPolicy* BuildPolicy(const string& type, uint32_t numLines, uint32_t ways, uint32_t cands, NextUseTable* nextUse) {
+    uint32_t numSets = numLines/ways;
+    if (type == "LRU") return new LRUReplPolicy<false>(numLines);
+    if (type == "NRU") return new NRUReplPolicy(numLines, cands);
+    if (type == "Rand") return new RandReplPolicy(cands);
+    if (type == "SRRIP") return new SRRIPReplPolicy(numLines, numSets, 2);
+    if (type == "BRRIP") return new BRRIPReplPolicy(numLines, numSets, 2);
+    if (type == "DRRIP") return new DRRIPReplPolicy(numLines, numSets, 2);
+    if (type == "SHiP") return new SHiPReplPolicy(numLines, numSets, 2);
+    if (type == "Hawkeye") return new HawkeyeReplPolicy(numLines, numSets, ways);
+    if (type == "OPT") return new OPTReplPolicy(numLines, nextUse);
+    panic("Invalid policy %s", type.c_str());
+}
+
+int main(int argc, const char* argv[]) {
+    InitLog(""); //no log header
+    if (argc < 4 || argc > 7) {
+        info("Compares the misses of replacement policies on an access trace");
+        info("Usage: %s <trace> <sizeKB> <ways> [<instrs> (for MPKI; default 0, reports misses per kilo-access)]", argv[0]);
+        info("       [<policies> (default LRU,SRRIP,BRRIP,DRRIP,SHiP,Hawkeye,OPT)] [<zcands> (default 0, SetAssoc; otherwise Z array)]");
+        exit(1);
+    }
+
+    uint32_t sizeKB = strtoul(argv[2], nullptr, 0);
+    uint32_t ways = strtoul(argv[3], nullptr, 0);
+    uint64_t instrs = (argc >= 5)? strtoul(argv[4], nullptr, 0) : 0;
+    string policyList = (argc >= 6)? argv[5] : "LRU,SRRIP,BRRIP,DRRIP,SHiP,Hawkeye,OPT";
+    uint32_t zcands = (argc >= 7)? strtoul(argv[6], nullptr, 0) : 0;
+
+    uint32_t numLines = (sizeKB*1024) >> lineBits;
+    if (!ways || numLines % ways || !isPow2(numLines/ways)) panic("Number of sets must be a power of two");
+    if (ways >= 256) panic("Up to 255 ways supported");
+    uint32_t cands = zcands? zcands : ways;
+    uint32_t setBits = 31 - __builtin_clz(numLines/ways);
+
+    vector<string> policies;
+    stringstream ss(policyList);
+    string p;
+    while (getline(ss, p, ',')) policies.push_back(p);
+
+    gm_init((32<<20) + policies.size()*numLines*64 /*ample for arrays and policy state*/);
+
+    NextUseTable* nextUse = nullptr;
+    for (const string& policy : policies) {
+        if (policy == "OPT" && !nextUse) nextUse = new NextUseTable(argv[1], ".");
+    }
+
+    vector<ReplayCache> caches;
+    for (const string& policy : policies) {
+        ReplPolicy* rp = BuildPolicy(policy, numLines, ways, cands, nextUse);
+        ReplayCC* cc = new ReplayCC(numLines);
+        rp->setCC(cc);
+        CacheArray* array;
+        if (zcands) {
+            array = new ZArray(numLines, ways, zcands, rp, new H3HashFamily(ways, setBits, 0xCAC7EAFFA1));
+        } else {
+            array = new SetAssocArray(numLines, ways, rp, new IdHashFamily());
+        }
+        caches.push_back({policy, cc, array, 0, 0});
+    }
+
+    AccessTraceReader tr(argv[1]);
+    info("Replaying %ld accesses through a %d KB, %d-way %s cache", tr.getNumRecords(), sizeKB, ways,
+            zcands? "Z" : "set-associative");
+    for (uint64_t i = 0; !tr.empty(); i++) {
+        AccessRecord acc = tr.read();
+        if (nextUse) nextUse->setPos(i, acc.lineAddr);
+        bool isGet = (acc.type == GETS || acc.type == GETX);
+        for (ReplayCache& c : caches) {
+            MESIState state = I;
+            MemReq req = {acc.lineAddr, acc.type, acc.childId, &state, acc.reqCycle, nullptr, state, acc.childId, 0};
+            int32_t lineId = c.array->lookup(acc.lineAddr, &req, isGet);
+            if (!isGet) continue;
+            c.accesses++;
+            if (lineId == -1) {
+                c.misses++;
+                Address wbLineAddr;
+                lineId = c.array->preinsert(acc.lineAddr, &req, &wbLineAddr);
+                c.array->postinsert(acc.lineAddr, &req, lineId);
+                c.cc->setValid(lineId);
+            }
+        }
+    }
+
+    info("%10s %14s %14s %8s %10s", "Policy", "Accesses", "Misses", "MissRate", instrs? "MPKI" : "MPKA");
+    for (ReplayCache& c : caches) {
+        double missRate = c.accesses? ((double)c.misses)/c.accesses : 0.0;
+        double mpk = 1000.0*c.misses/(instrs? instrs : MAX(c.accesses, 1ul));
+        info("%10s %14ld %14ld %8.4f %10.3f", c.policy.c_str(), c.accesses, c.misses, missRate, mpk);
+    }
+
+    return 0;
+}
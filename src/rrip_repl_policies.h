@@ -0,0 +1,412 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RRIP_REPL_POLICIES_H_
+#define RRIP_REPL_POLICIES_H_
+
+#include <string>
+#include "bithacks.h"
+#include "repl_policies.h"
+#include "stats.h"
+
+/* RRIP-family replacement policies, meant for LLCs.
+ *
+ * Policies that need per-set information (set dueling, OPT sampling) use the set the line would map to in an
+ * unhashed set-associative array of the same geometry, lineAddr & (numSets-1). These match the real sets of
+ * unhashed SetAssoc arrays, and for hashed and Z arrays, they still sample a uniform fraction of the lines.
+ */
+
+// PC signature of the access (see MemReq::pc), or its 16KB region if unknown (as in SHiP-Mem), folded to bits
+static inline uint32_t ReplSignature(const MemReq* req, uint32_t bits) {
+    uint64_t v = req->pc? req->pc : (req->lineAddr >> 8);
+    return (v ^ (v >> bits) ^ (v >> 2*bits)) & ((1 << bits) - 1);
+}
+
+/* Re-reference interval prediction (Jaleel et al., ISCA 2010). Each line has a re-reference prediction
+ * value (RRPV); hits set it to 0, and replacements evict a candidate with the maximum RRPV, aging all
+ * candidates until one has it (with ZCands, only the candidates age). Invalid lines go first.
+ * Subclasses implement update(), and choose the insertion RRPV.
+ */
+class RRIPReplPolicy : public ReplPolicy {
+    protected:
+        static const uint8_t RRPV_INSERT = 0xff;  // set by replaced(), so the following update() knows it's an insertion
+
+        uint8_t* rrpv;
+        uint32_t numLines;
+        uint32_t setMask;
+        const uint8_t rrpvMax;
+
+        inline bool inserting(uint32_t id) const { return rrpv[id] == RRPV_INSERT; }
+        inline uint32_t setOf(Address lineAddr) const { return lineAddr & setMask; }
+
+    public:
+        RRIPReplPolicy(uint32_t _numLines, uint32_t numSets, uint32_t rrpvBits) : numLines(_numLines), setMask(numSets - 1), rrpvMax((1 << rrpvBits) - 1) {
+            assert(isPow2(numSets));
+            assert(rrpvBits >= 1 && rrpvBits <= 7);
+            rrpv = gm_calloc_aligned<uint8_t>(CACHE_LINE_BYTES, numLines);
+            for (uint32_t i = 0; i < numLines; i++) rrpv[i] = rrpvMax;
+        }
+
+        ~RRIPReplPolicy() {
+            gm_free(rrpv);
+        }
+
+        void replaced(uint32_t id) {
+            rrpv[id] = RRPV_INSERT;
+        }
+
+        template <typename C> inline uint32_t rank(const MemReq* req, C cands) {
+            uint32_t bestCand = -1;
+            uint32_t bestRrpv = 0;
+            for (auto ci = cands.begin(); ci != cands.end(); ci.inc()) {
+                uint32_t id = *ci;
+                if (!cc->isValid(id)) return id;
+                if (bestCand == (uint32_t)-1 || rrpv[id] > bestRrpv) {
+                    bestCand = id;
+                    bestRrpv = rrpv[id];
+                }
+            }
+            uint32_t age = rrpvMax - bestRrpv;
+            if (age) {
+                for (auto ci = cands.begin(); ci != cands.end(); ci.inc()) rrpv[*ci] += age;
+            }
+            return bestCand;
+        }
+
+        DECL_RANK_BINDINGS;
+
+        void saveState(CheckpointWriter& cw, const std::string& name) {
+            cw.write(name, rrpv, numLines);
+        }
+
+        void restoreState(CheckpointReader& cr, const std::string& name) {
+            cr.read(name, rrpv, numLines);
+        }
+};
+
+// Static RRIP: inserts with a long re-reference interval (max-1)
+class SRRIPReplPolicy : public RRIPReplPolicy {
+    public:
+        SRRIPReplPolicy(uint32_t _numLines, uint32_t numSets, uint32_t rrpvBits) : RRIPReplPolicy(_numLines, numSets, rrpvBits) {}
+
+        void update(uint32_t id, const MemReq* req) {
+            rrpv[id] = inserting(id)? rrpvMax - 1 : 0;
+        }
+};
+
+// Bimodal RRIP: inserts with a distant re-reference interval (max), except for one in BRRIP_PERIOD insertions (max-1)
+class BRRIPReplPolicy : public RRIPReplPolicy {
+    protected:
+        static const uint32_t BRRIP_PERIOD = 32;
+        uint32_t brripInsertions;
+
+        inline uint8_t brripRrpv() {
+            return (++brripInsertions % BRRIP_PERIOD == 0)? rrpvMax - 1 : rrpvMax;
+        }
+
+    public:
+        BRRIPReplPolicy(uint32_t _numLines, uint32_t numSets, uint32_t rrpvBits) : RRIPReplPolicy(_numLines, numSets, rrpvBits), brripInsertions(0) {}
+
+        void update(uint32_t id, const MemReq* req) {
+            rrpv[id] = inserting(id)? brripRrpv() : 0;
+        }
+};
+
+/* Dynamic RRIP: set dueling between SRRIP and BRRIP. One in DUEL_PERIOD sets always uses SRRIP, and
+ * another always uses BRRIP; misses in these leader sets move a saturating counter (psel) that picks
+ * the policy of all other sets.
+ */
+class DRRIPReplPolicy : public BRRIPReplPolicy {
+    private:
+        static const uint32_t DUEL_PERIOD = 32;
+        static const uint64_t PSEL_MAX = 1023;  // 10 bits
+        uint64_t psel;
+
+    public:
+        DRRIPReplPolicy(uint32_t _numLines, uint32_t numSets, uint32_t rrpvBits) : BRRIPReplPolicy(_numLines, numSets, rrpvBits), psel(PSEL_MAX/2) {}
+
+        void update(uint32_t id, const MemReq* req) {
+            if (!inserting(id)) {
+                rrpv[id] = 0;
+                return;
+            }
+            bool brrip;
+            switch (setOf(req->lineAddr) % DUEL_PERIOD) {
+                case 0:  // SRRIP leader missed
+                    psel = MIN(psel + 1, PSEL_MAX);
+                    brrip = false;
+                    break;
+                case 1:  // BRRIP leader missed
+                    psel = psel? psel - 1 : 0;
+                    brrip = true;
+                    break;
+                default:
+                    brrip = psel > PSEL_MAX/2;
+            }
+            rrpv[id] = brrip? brripRrpv() : rrpvMax - 1;
+        }
+
+        void initStats(AggregateStat* parentStat) {
+            ProxyStat* pselStat = new ProxyStat();
+            pselStat->init("psel", "DRRIP policy selector (higher favors BRRIP)", &psel);
+            parentStat->append(pselStat);
+        }
+
+        void saveState(CheckpointWriter& cw, const std::string& name) {
+            RRIPReplPolicy::saveState(cw, name);
+            cw.write(name + ".psel", &psel, sizeof(psel));
+        }
+
+        void restoreState(CheckpointReader& cr, const std::string& name) {
+            RRIPReplPolicy::restoreState(cr, name);
+            cr.read(name + ".psel", &psel, sizeof(psel));
+        }
+};
+
+/* Signature-based hit prediction (Wu et al., MICRO 2011) over SRRIP. A table of saturating counters
+ * (SHCT), indexed by the signature of the access that inserted each line (see ReplSignature), learns
+ * whether lines get reused: hits increment their signature's counter, and evictions of never-reused
+ * lines decrement it. Lines whose signature's counter is 0 are inserted with a distant RRPV.
+ */
+class SHiPReplPolicy : public RRIPReplPolicy {
+    private:
+        static const uint32_t SIG_BITS = 14;
+        static const uint8_t SHCT_MAX = 7;  // 3-bit counters
+
+        struct LineInfo {
+            uint16_t sig;
+            bool reused;
+            bool valid;
+        };
+
+        LineInfo* lines;
+        uint8_t* shct;
+
+    public:
+        SHiPReplPolicy(uint32_t _numLines, uint32_t numSets, uint32_t rrpvBits) : RRIPReplPolicy(_numLines, numSets, rrpvBits) {
+            lines = gm_calloc_aligned<LineInfo>(CACHE_LINE_BYTES, numLines);
+            shct = gm_calloc<uint8_t>(1 << SIG_BITS);
+            for (uint32_t i = 0; i < (1u << SIG_BITS); i++) shct[i] = 1;  // weakly reused
+        }
+
+        ~SHiPReplPolicy() {
+            gm_free(lines);
+            gm_free(shct);
+        }
+
+        void update(uint32_t id, const MemReq* req) {
+            LineInfo& l = lines[id];
+            if (inserting(id)) {
+                l.sig = ReplSignature(req, SIG_BITS);
+                l.reused = false;
+                l.valid = true;
+                rrpv[id] = shct[l.sig]? rrpvMax - 1 : rrpvMax;
+            } else {
+                l.reused = true;
+                if (shct[l.sig] < SHCT_MAX) shct[l.sig]++;
+                rrpv[id] = 0;
+            }
+        }
+
+        void replaced(uint32_t id) {
+            LineInfo& l = lines[id];
+            if (l.valid && !l.reused && shct[l.sig]) shct[l.sig]--;
+            l.valid = false;
+            RRIPReplPolicy::replaced(id);
+        }
+
+        void saveState(CheckpointWriter& cw, const std::string& name) {
+            RRIPReplPolicy::saveState(cw, name);
+            cw.write(name + ".lines", lines, numLines*sizeof(LineInfo));
+            cw.write(name + ".shct", shct, 1 << SIG_BITS);
+        }
+
+        void restoreState(CheckpointReader& cr, const std::string& name) {
+            RRIPReplPolicy::restoreState(cr, name);
+            cr.read(name + ".lines", lines, numLines*sizeof(LineInfo));
+            cr.read(name + ".shct", shct, 1 << SIG_BITS);
+        }
+};
+
+/* Hawkeye (Jain and Lin, ISCA 2016). OPTgen reconstructs Belady's OPT decisions on NUM_SAMPLED sampled
+ * sets: it keeps, per set, the occupancy of the last histLen (8x the associativity) set accesses, and a
+ * sampler with the last access time and signature of recent lines. On a reuse, OPT would have hit iff the
+ * occupancy stayed below the associativity over the reuse interval, and the predictor (counters indexed
+ * by signature, see ReplSignature) is trained towards the result for the signature of the previous access.
+ * Lines from cache-averse signatures are inserted at max RRPV and evicted first; otherwise, the oldest
+ * cache-friendly line is evicted, and its signature detrained. Sampled lines that age out of the window
+ * without a reuse count as OPT misses. Friendly lines age by one per miss in their candidates (max-1 at
+ * most), instead of aging the whole set.
+ */
+class HawkeyeReplPolicy : public RRIPReplPolicy {
+    private:
+        static const uint32_t SIG_BITS = 13;
+        static const uint8_t PRED_MAX = 7;  // 3-bit counters
+        static const uint8_t PRED_FRIENDLY = 4;
+        static const uint32_t NUM_SAMPLED = 64;
+
+        struct SamplerEntry {
+            Address lineAddr;  // 0 if unused
+            uint32_t time;
+            uint32_t sig;
+        };
+
+        uint8_t* pred;
+        uint16_t* lineSigs;
+
+        // OPTgen state, NUM_SAMPLED sets
+        const uint32_t ways;
+        const uint32_t histLen;
+        uint32_t samplePeriod;
+        uint32_t* optTimes;  // per-set access counter
+        uint8_t* occupancy;  // histLen entries per set, indexed by time % histLen
+        SamplerEntry* sampler;  // histLen entries per set
+
+        Counter profOptHits, profOptMisses, profAverseInserts, profDetrains;
+
+        inline void train(uint32_t sig, bool optHit) {
+            if (optHit) {
+                if (pred[sig] < PRED_MAX) pred[sig]++;
+            } else {
+                if (pred[sig]) pred[sig]--;
+            }
+        }
+
+        void optAccess(uint32_t s, Address lineAddr, uint32_t sig) {
+            uint32_t now = optTimes[s]++;
+            uint8_t* occ = &occupancy[s*histLen];
+            SamplerEntry* entries = &sampler[s*histLen];
+
+            SamplerEntry* e = nullptr;
+            SamplerEntry* oldest = &entries[0];
+            for (uint32_t i = 0; i < histLen; i++) {
+                SamplerEntry* c = &entries[i];
+                if (c->lineAddr == lineAddr) {
+                    e = c;
+                    break;
+                }
+                if (!c->lineAddr || (oldest->lineAddr && now - c->time > now - oldest->time)) oldest = c;
+            }
+
+            if (e) {
+                bool optHit = (now - e->time < histLen);
+                for (uint32_t t = e->time; optHit && t != now; t++) optHit = occ[t % histLen] < ways;
+                if (optHit) {
+                    for (uint32_t t = e->time; t != now; t++) occ[t % histLen]++;
+                    profOptHits.inc();
+                } else {
+                    profOptMisses.inc();
+                }
+                train(e->sig, optHit);
+            } else {
+                // A full sampler evicts entries older than the OPTgen window, so they were OPT misses
+                if (oldest->lineAddr) train(oldest->sig, false);
+                e = oldest;
+                e->lineAddr = lineAddr;
+            }
+            e->time = now;
+            e->sig = sig;
+            occ[now % histLen] = 0;
+        }
+
+    public:
+        HawkeyeReplPolicy(uint32_t _numLines, uint32_t numSets, uint32_t _ways)
+            : RRIPReplPolicy(_numLines, numSets, 3), ways(_ways), histLen(8*_ways)
+        {
+            assert(ways < 256);  // occupancy counters are 8-bit
+            samplePeriod = MAX(numSets/NUM_SAMPLED, 1u);
+            pred = gm_calloc<uint8_t>(1 << SIG_BITS);
+            for (uint32_t i = 0; i < (1u << SIG_BITS); i++) pred[i] = PRED_FRIENDLY - 1;  // weakly averse, so never-reused signatures (e.g., streams) are not cached
+            lineSigs = gm_calloc_aligned<uint16_t>(CACHE_LINE_BYTES, numLines);
+            optTimes = gm_calloc<uint32_t>(NUM_SAMPLED);
+            occupancy = gm_calloc<uint8_t>(NUM_SAMPLED*histLen);
+            sampler = gm_calloc<SamplerEntry>(NUM_SAMPLED*histLen);
+        }
+
+        ~HawkeyeReplPolicy() {
+            gm_free(pred);
+            gm_free(lineSigs);
+            gm_free(optTimes);
+            gm_free(occupancy);
+            gm_free(sampler);
+        }
+
+        void initStats(AggregateStat* parentStat) {
+            profOptHits.init("optHits", "OPTgen hits on sampled sets"); parentStat->append(&profOptHits);
+            profOptMisses.init("optMisses", "OPTgen misses on sampled sets (reuses only)"); parentStat->append(&profOptMisses);
+            profAverseInserts.init("averseIns", "Insertions predicted cache-averse"); parentStat->append(&profAverseInserts);
+            profDetrains.init("detrains", "Evictions of cache-friendly lines"); parentStat->append(&profDetrains);
+        }
+
+        void update(uint32_t id, const MemReq* req) {
+            uint32_t sig = ReplSignature(req, SIG_BITS);
+            uint32_t set = setOf(req->lineAddr);
+            if (set % samplePeriod == 0 && set/samplePeriod < NUM_SAMPLED) optAccess(set/samplePeriod, req->lineAddr, sig);
+
+            bool friendly = pred[sig] >= PRED_FRIENDLY;
+            if (!friendly && inserting(id)) profAverseInserts.inc();
+            lineSigs[id] = sig;
+            rrpv[id] = friendly? 0 : rrpvMax;
+        }
+
+        template <typename C> inline uint32_t rank(const MemReq* req, C cands) {
+            uint32_t bestCand = -1;
+            uint32_t bestRrpv = 0;
+            uint32_t averseCand = -1;
+            for (auto ci = cands.begin(); ci != cands.end(); ci.inc()) {
+                uint32_t id = *ci;
+                if (!cc->isValid(id)) return id;
+                if (rrpv[id] == rrpvMax && averseCand == (uint32_t)-1) averseCand = id;
+                if (bestCand == (uint32_t)-1 || rrpv[id] > bestRrpv) {
+                    bestCand = id;
+                    bestRrpv = rrpv[id];
+                }
+            }
+            if (averseCand != (uint32_t)-1) return averseCand;  // only evict friendly lines if there are no averse ones
+            for (auto ci = cands.begin(); ci != cands.end(); ci.inc()) {
+                if (rrpv[*ci] < rrpvMax - 1) rrpv[*ci]++;
+            }
+            train(lineSigs[bestCand], false);
+            profDetrains.inc();
+            return bestCand;
+        }
+
+        DECL_RANK_BINDINGS;
+
+        //OPTgen state is not saved; it retrains quickly
+        void saveState(CheckpointWriter& cw, const std::string& name) {
+            RRIPReplPolicy::saveState(cw, name);
+            cw.write(name + ".pred", pred, 1 << SIG_BITS);
+            cw.write(name + ".sigs", lineSigs, numLines*sizeof(uint16_t));
+        }
+
+        void restoreState(CheckpointReader& cr, const std::string& name) {
+            RRIPReplPolicy::restoreState(cr, name);
+            cr.read(name + ".pred", pred, 1 << SIG_BITS);
+            cr.read(name + ".sigs", lineSigs, numLines*sizeof(uint16_t));
+        }
+};
+
+#endif  // RRIP_REPL_POLICIES_H_
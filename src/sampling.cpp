@@ -0,0 +1,139 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sampling.h"
+#include <math.h>
+#include <vector>
+#include "log.h"
+#include "process_stats.h"
+
+void Sampler::Estimate::add(double x) {
+    n++;
+    double delta = x - mean;
+    mean += delta/n;
+    m2 += delta*(x - mean);
+}
+
+double Sampler::Estimate::halfWidth(double z) const {
+    if (n < 2) return 0.0;
+    double stddev = sqrt(m2/(n - 1));
+    return z*stddev/sqrt((double)n);
+}
+
+bool Sampler::Estimate::within(double z, double errorBound) const {
+    if (mean == 0.0) return halfWidth(z) == 0.0;  // e.g., no misses at all
+    return halfWidth(z) <= errorBound*mean;
+}
+
+Sampler::Sampler(uint64_t _period, uint64_t _warmup, uint64_t _window, double _errorBound, double confidence,
+        uint32_t _minSamples, AggregateStat* _missStats)
+    : period(_period), warmup(_warmup), window(_window), errorBound(_errorBound), minSamples(MAX(_minSamples, 2u)),
+      missStats(_missStats), converged(false), startCycles(0), startInstrs(0), startMisses(0)
+{
+    if (!window) panic("sim.samplingWindow must be > 0");
+    if (warmup + window > period) panic("Sampling period (%ld) must be at least samplingWarmup + samplingWindow (%ld)", period, warmup + window);
+    if (confidence <= 0.0 || confidence >= 1.0) panic("sim.samplingConfidence must be in (0, 1), %f", confidence);
+
+    // Two-sided normal quantile: find z s.t. erf(z/sqrt(2)) == confidence by bisection
+    double lo = 0.0, hi = 10.0;
+    for (uint32_t i = 0; i < 64; i++) {
+        double mid = (lo + hi)/2;
+        if (erf(mid/sqrt(2.0)) < confidence) lo = mid;
+        else hi = mid;
+    }
+    z = hi;
+
+    info("Sampling: %ld-instr period, %ld warmup + %ld measured instrs per sample, stop at +-%.1f%% with %.1f%% confidence (z = %.3f)%s",
+            period, warmup, window, 100*errorBound, 100*confidence, z, missStats? "" : ", no miss stats (IPC only)");
+}
+
+void Sampler::initStats(AggregateStat* parentStat) {
+    AggregateStat* samplingStat = new AggregateStat();
+    samplingStat->init("sampling", "Sampling estimates (x1000 values are fixed-point)");
+
+    auto samplesStat = makeLambdaStat([this]() { return ipc.n; });
+    samplesStat->init("samples", "Samples taken");
+    samplingStat->append(samplesStat);
+
+    auto convergedStat = makeLambdaStat([this]() { return (uint64_t)converged; });
+    convergedStat->init("converged", "1 if the estimates met the error bound");
+    samplingStat->append(convergedStat);
+
+    auto addEstimate = [this, samplingStat](const Estimate* e, const char* name, const char* desc, const char* ciName, const char* ciDesc) {
+        auto meanStat = makeLambdaStat([e]() { return (uint64_t)(1000*e->mean); });
+        meanStat->init(name, desc);
+        samplingStat->append(meanStat);
+        auto ciStat = makeLambdaStat([this, e]() { return (uint64_t)(1000*e->halfWidth(z)); });
+        ciStat->init(ciName, ciDesc);
+        samplingStat->append(ciStat);
+    };
+    addEstimate(&ipc, "ipc", "Sampled IPC, mean (x1000)", "ipcCI", "Sampled IPC, confidence interval half-width (x1000)");
+    if (missStats) addEstimate(&mpki, "mpki", "Sampled MPKI, mean (x1000)", "mpkiCI", "Sampled MPKI, confidence interval half-width (x1000)");
+
+    parentStat->append(samplingStat);
+}
+
+uint64_t Sampler::countMisses() const {
+    uint64_t misses = 0;
+    if (!missStats) return misses;
+    // missStats is a filtered hierarchy of aggregates with scalar leaves
+    std::vector<const AggregateStat*> stack = {missStats};
+    while (!stack.empty()) {
+        const AggregateStat* as = stack.back();
+        stack.pop_back();
+        for (uint32_t i = 0; i < as->size(); i++) {
+            Stat* s = as->get(i);
+            if (const AggregateStat* child = dynamic_cast<const AggregateStat*>(s)) stack.push_back(child);
+            else if (const ScalarStat* ss = dynamic_cast<const ScalarStat*>(s)) misses += ss->get();
+        }
+    }
+    return misses;
+}
+
+void Sampler::startSample(uint32_t procIdx) {
+    startCycles = zinfo->processStats->getProcessCycles(procIdx);
+    startInstrs = zinfo->processStats->getProcessInstrs(procIdx);
+    startMisses = countMisses();
+}
+
+bool Sampler::endSample(uint32_t procIdx) {
+    uint64_t cycles = zinfo->processStats->getProcessCycles(procIdx) - startCycles;
+    uint64_t instrs = zinfo->processStats->getProcessInstrs(procIdx) - startInstrs;
+    uint64_t misses = countMisses() - startMisses;
+    if (!instrs || !cycles) {
+        warn("Sampling: empty sample window (%ld instrs, %ld cycles), ignored", instrs, cycles);
+        return false;
+    }
+
+    ipc.add(((double)instrs)/cycles);
+    if (missStats) mpki.add(1000.0*misses/instrs);
+
+    converged = ipc.n >= minSamples && ipc.within(z, errorBound) && (!missStats || mpki.within(z, errorBound));
+    if (converged) {
+        info("Sampling: error bound met after %ld samples, IPC %.3f +- %.3f", ipc.n, ipc.mean, ipc.halfWidth(z));
+        if (missStats) info("Sampling: MPKI %.3f +- %.3f", mpki.mean, mpki.halfWidth(z));
+    }
+    return converged;
+}
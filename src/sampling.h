@@ -0,0 +1,153 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SAMPLING_H_
+#define SAMPLING_H_
+
+#include <stdint.h>
+#include "bithacks.h"
+#include "event_queue.h"
+#include "galloc.h"
+#include "process_stats.h"
+#include "stats.h"
+#include "zsim.h"
+
+/* SMARTS-style systematic sampling (sim.samplingPeriod)
+ *
+ * Every samplingPeriod instructions, the simulated process runs
+ * samplingWarmup instructions in detail to warm up the pipeline and timing
+ * state (not measured), then samplingWindow measured instructions; the rest
+ * of the period is fast-forwarded, with functional warming if sim.warmFF is
+ * set. The schedule is driven by FFI (see zsim.cpp), so like FFI, this needs
+ * a single-threaded process.
+ *
+ * Each window yields one IPC and one MPKI sample. The sampler keeps running
+ * means and confidence intervals in the stats tree, and ends the simulation
+ * once the relative half-width of the confidence intervals is below
+ * samplingErrorBound (after at least samplingMinSamples samples).
+ *
+ * Windows start and end on phase boundaries, so they may run up to a phase
+ * longer than samplingWarmup/samplingWindow (and should span several phases);
+ * samples use the actual instructions and cycles of each window.
+ */
+class Sampler : public GlobAlloc {
+    private:
+        // Running mean and variance (Welford's algorithm)
+        struct Estimate {
+            uint64_t n;
+            double mean, m2;
+
+            Estimate() : n(0), mean(0.0), m2(0.0) {}
+            void add(double x);
+            double halfWidth(double z) const;  // of the confidence interval
+            bool within(double z, double errorBound) const;
+        };
+
+        const uint64_t period, warmup, window;
+        const double errorBound;
+        const uint32_t minSamples;
+        double z;  // for the required confidence
+
+        AggregateStat* missStats;  // scalar stats summed to count misses; nullptr if MPKI is not estimated
+
+        Estimate ipc, mpki;
+        bool converged;
+
+        // Sample in progress
+        uint64_t startCycles, startInstrs, startMisses;
+
+    public:
+        Sampler(uint64_t _period, uint64_t _warmup, uint64_t _window, double _errorBound, double confidence,
+                uint32_t _minSamples, AggregateStat* _missStats);
+
+        void initStats(AggregateStat* parentStat);
+
+        uint64_t getFFInstrs() const {return period - warmup - window;}
+        uint64_t getDetailedInstrs() const {return warmup + window;}
+        uint64_t getWarmupInstrs() const {return warmup;}
+        uint64_t getWindowInstrs() const {return window;}
+
+        // Called at the end of the phase where detailed warmup ends and the window starts
+        void startSample(uint32_t procIdx);
+
+        // Called at the end of the phase where the window ends; returns true if the error bound is met
+        bool endSample(uint32_t procIdx);
+
+    private:
+        uint64_t countMisses() const;
+};
+
+/* Tracks one detailed interval of a process: calls sampler->startSample() once
+ * the process has run the detailed warmup, and sampler->endSample() and then
+ * fire(converged) at the end of the window. Like AdaptiveEvent, it can be
+ * called from any process, so it cannot touch process-local state.
+ */
+template <typename F>
+class SamplingWindowEvent : public Event {
+    private:
+        Sampler* sampler;
+        uint32_t procIdx;
+        uint64_t startInstrs;
+        uint64_t target;
+        uint64_t maxRate;
+        bool measuring;
+        F fire;
+
+        uint64_t get() const {
+            return zinfo->processStats->getProcessInstrs(procIdx) - startInstrs;
+        }
+
+    public:
+        SamplingWindowEvent(Sampler* _sampler, uint32_t _procIdx, uint64_t _startInstrs, uint64_t _maxRate, F _fire)
+            : Event(0), sampler(_sampler), procIdx(_procIdx), startInstrs(_startInstrs), maxRate(_maxRate), measuring(false), fire(_fire)
+        {
+            target = sampler->getWarmupInstrs();
+            period = MAX(target/maxRate, (uint64_t)1);
+        }
+
+        void callback() {
+            uint64_t cur = get();
+            if (cur >= target) {
+                if (!measuring) {
+                    sampler->startSample(procIdx);
+                    measuring = true;
+                    target = cur + sampler->getWindowInstrs();
+                    period = MAX(sampler->getWindowInstrs()/maxRate, (uint64_t)1);
+                } else {
+                    fire(sampler->endSample(procIdx));
+                    period = 0;  // event queue will dispose of us
+                }
+            } else {
+                period = MAX((target - cur)/maxRate, (uint64_t)1);
+            }
+        }
+};
+
+template <typename F>
+SamplingWindowEvent<F>* makeSamplingWindowEvent(Sampler* sampler, uint32_t procIdx, uint64_t startInstrs, uint64_t maxRate, F fire) {
+    return new SamplingWindowEvent<F>(sampler, procIdx, startInstrs, maxRate, fire);
+}
+
+#endif  // SAMPLING_H_
@@ -42,6 +42,7 @@
 #include "proc_stats.h"
 #include "process_stats.h"
 #include "stats.h"
+#include "sweep.h"
 #include "zsim.h"
 
 /**
@@ -308,6 +309,7 @@ class Scheduler : public GlobAlloc, public Callee {
                 th->state = RUNNING;
                 outQueue.remove(th);
                 zinfo->cores[th->cid]->join();
+                SweepJoin(th->cid);
                 bar.join(th->cid, &schedLock); //releases lock
             } else {
                 assert(th->state == BLOCKED || th->state == STARTED);
@@ -316,6 +318,7 @@ class Scheduler : public GlobAlloc, public Callee {
                 if (ctx) {
                     schedule(th, ctx);
                     zinfo->cores[th->cid]->join();
+                    SweepJoin(th->cid);
                     bar.join(th->cid, &schedLock); //releases lock
                 } else {
                     th->state = QUEUED;
@@ -335,6 +338,7 @@ class Scheduler : public GlobAlloc, public Callee {
             assert(th->gid == gid);
             assert(th->state == RUNNING);
             zinfo->cores[cid]->leave();
+            SweepLeave(cid);
 
             if (th->markedForSleep) { //transition to SLEEPING, eagerly deschedule
                 trace(Sched, "Sched: %d going to SLEEP, wakeup on phase %ld", gid, th->wakeupPhase);
@@ -359,6 +363,7 @@ class Scheduler : public GlobAlloc, public Callee {
                 if (inTh) {
                     schedule(inTh, ctx);
                     zinfo->cores[ctx->cid]->join(); //inTh does not do a sched->join, so we need to notify the core since we just called leave() on it
+                    SweepJoin(ctx->cid);
                     wakeup(inTh, false /*no join, we did not leave*/);
                 } else {
                     freeList.push_back(ctx);
@@ -371,6 +376,7 @@ class Scheduler : public GlobAlloc, public Callee {
                     deschedule(th, ctx, BLOCKED);
                     schedule(inTh, ctx);
                     zinfo->cores[ctx->cid]->join(); //inTh does not do a sched->join, so we need to notify the core since we just called leave() on it
+                    SweepJoin(ctx->cid);
                     wakeup(inTh, false /*no join, we did not leave*/);
                 } else if (th->mask[th->cid] == false) {
                     deschedule(th, ctx, BLOCKED);
@@ -412,6 +418,7 @@ class Scheduler : public GlobAlloc, public Callee {
                     schedule(th, ctx);
                     //We need to do a join, because dst will not join
                     zinfo->cores[ctx->cid]->join();
+                    SweepJoin(ctx->cid);
                     bar.join(ctx->cid, &schedLock); //releases lock
                 } else {
                     runQueue.push_back(th);
@@ -612,6 +619,7 @@ class Scheduler : public GlobAlloc, public Callee {
             scheduledThreads++;
             //info("Scheduled %d <-> %d", th->gid, ctx->cid);
             zinfo->cores[ctx->cid]->contextSwitch(th->gid);
+            SweepContextSwitch(ctx->cid, th->gid);
         }
 
         void deschedule(ThreadInfo* th, ContextInfo* ctx, ThreadState targetState) {
@@ -628,6 +636,7 @@ class Scheduler : public GlobAlloc, public Callee {
             //Notify core of context-switch eagerly.
             //TODO: we may need more callbacks in the cores, e.g. in schedule(). Revise interface as needed...
             zinfo->cores[ctx->cid]->contextSwitch(-1);
+            SweepContextSwitch(ctx->cid, -1);
             zinfo->processStats->notifyDeschedule(ctx->cid, getPid(th->gid));
             //info("Descheduled %d <-> %d", th->gid, ctx->cid);
         }
@@ -649,6 +658,7 @@ class Scheduler : public GlobAlloc, public Callee {
             if (th->needsJoin) {
                 //assert(th->needsJoin); //re-check after the lock
                 zinfo->cores[th->cid]->join();
+                SweepJoin(th->cid);
                 bar.join(th->cid, &schedLock);
                 //info("%d join done", th->gid);
             }
@@ -0,0 +1,48 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIMD_H_
+#define SIMD_H_
+
+/* Runtime detection of host SIMD support. Performance-critical structures
+ * (cache arrays, hash functions) pick a vectorized kernel at construction
+ * time, and fall back to scalar code on hosts without it. We do not compile
+ * the whole simulator with -mavx2; kernels use the target function attribute.
+ */
+
+enum SimdLevel {
+    SIMD_NONE,  // scalar only
+    SIMD_SSE4,  // SSE4.1, 128-bit vectors
+    SIMD_AVX2,  // AVX2, 256-bit vectors
+};
+
+static inline SimdLevel HostSimdLevel() {
+    __builtin_cpu_init();  // may be called before constructors run
+    if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+    if (__builtin_cpu_supports("sse4.1")) return SIMD_SSE4;
+    return SIMD_NONE;
+}
+
+#endif  // SIMD_H_
@@ -27,7 +27,7 @@
 #include "filter_cache.h"
 #include "zsim.h"
 
-SimpleCore::SimpleCore(FilterCache* _l1i, FilterCache* _l1d, g_string& _name) : Core(_name), l1i(_l1i), l1d(_l1d), instrs(0), curCycle(0), haltedCycles(0) {
+SimpleCore::SimpleCore(FilterCache* _l1i, FilterCache* _l1d, g_string& _name) : Core(_name), l1i(_l1i), l1d(_l1d), instrs(0), curCycle(0), haltedCycles(0), curBblAddr(0), loadIdx(0) {
 }
 
 void SimpleCore::initStats(AggregateStat* parentStat) {
@@ -48,7 +48,7 @@ uint64_t SimpleCore::getPhaseCycles() const {
 }
 
 void SimpleCore::load(Address addr) {
-    curCycle = l1d->load(addr, curCycle);
+    curCycle = l1d->load(addr, curCycle, curBblAddr + loadIdx++);
 }
 
 void SimpleCore::store(Address addr) {
@@ -60,6 +60,8 @@ void SimpleCore::bbl(Address bblAddr, BblInfo* bblInfo) {
     //info("%d %d", bblInfo->instrs, bblInfo->bytes);
     instrs += bblInfo->instrs;
     curCycle += bblInfo->instrs;
+    curBblAddr = bblAddr;
+    loadIdx = 0;
 
     Address endBblAddr = bblAddr + bblInfo->bytes;
     for (Address fetchAddr = bblAddr; fetchAddr < endBblAddr; fetchAddr+=(1 << lineBits)) {
@@ -85,6 +87,25 @@ void SimpleCore::join() {
     //info("[%s] Joined, curCycle %ld phaseEnd %ld haltedCycles %ld", name.c_str(), curCycle, phaseEndCycle, haltedCycles);
 }
 
+void SimpleCore::sweepBbl(ADDRINT bblAddr, BblInfo* bblInfo) {
+    bbl(bblAddr, bblInfo);
+}
+
+void SimpleCore::sweepLoad(ADDRINT addr, BOOL pred) {
+    if (pred) {
+        load(addr);
+    } else {
+        loadIdx++;
+    }
+}
+
+void SimpleCore::sweepStore(ADDRINT addr, BOOL pred) {
+    if (pred) store(addr);
+}
+
+void SimpleCore::nextPhase() {
+    phaseEndCycle += zinfo->phaseLength;
+}
 
 //Static class functions: Function pointers and trampolines
 
@@ -101,7 +122,12 @@ void SimpleCore::StoreFunc(THREADID tid, ADDRINT addr) {
 }
 
 void SimpleCore::PredLoadFunc(THREADID tid, ADDRINT addr, BOOL pred) {
-    if (pred) static_cast<SimpleCore*>(cores[tid])->load(addr);
+    SimpleCore* core = static_cast<SimpleCore*>(cores[tid]);
+    if (pred) {
+        core->load(addr);
+    } else {
+        core->loadIdx++;  //keeps the signatures of later loads in the BBL
+    }
 }
 
 void SimpleCore::PredStoreFunc(THREADID tid, ADDRINT addr, BOOL pred) {
@@ -43,6 +43,8 @@ class SimpleCore : public Core {
         uint64_t curCycle;
         uint64_t phaseEndCycle; //next stopping point
         uint64_t haltedCycles;
+        Address curBblAddr;
+        uint32_t loadIdx; //loads so far in the current BBL; curBblAddr + loadIdx is the PC signature of a load (see MemReq)
 
     public:
         SimpleCore(FilterCache* _l1i, FilterCache* _l1d, g_string& _name);
@@ -57,6 +59,12 @@ class SimpleCore : public Core {
 
         InstrFuncPtrs GetFuncPtrs();
 
+        void sweepBbl(ADDRINT bblAddr, BblInfo* bblInfo);
+        void sweepLoad(ADDRINT addr, BOOL pred);
+        void sweepStore(ADDRINT addr, BOOL pred);
+        bool pastPhaseEnd() const {return curCycle > phaseEndCycle;}
+        void nextPhase();
+
     protected:
         //Simulation functions
         inline void load(Address addr);
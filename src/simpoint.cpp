@@ -0,0 +1,260 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Picks simulation points from a basic-block vector profile (processN.bbvInterval),
+ * following the SimPoint methodology: BBVs are normalized, randomly projected
+ * to a few dimensions, and clustered with k-means for k = 1..maxK. The
+ * clustering chosen is the one with the smallest k whose BIC score is within
+ * bicThreshold of the best score seen. Each cluster is represented by the
+ * interval closest to its centroid, and weighted by the fraction of intervals
+ * in it.
+ *
+ * Writes <prefix>.simpoints and <prefix>.weights ("<value> <cluster>" lines,
+ * in interval order), which processN.simpoints reads.
+ */
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "bithacks.h"
+#include "log.h"
+#include "mtrand.h"
+
+using namespace std;
+
+static const uint32_t PROJ_DIMS = 15;
+static const uint32_t KMEANS_SEEDS = 5;
+static const uint32_t KMEANS_ITERS = 100;
+
+typedef vector<double> Point;
+
+struct Clustering {
+    uint32_t k;
+    vector<uint32_t> assign;
+    vector<Point> centroids;
+    double distortion;  // sum of squared distances to centroids
+    double bic;
+};
+
+static double dist2(const Point& a, const Point& b) {
+    double d = 0.0;
+    for (uint32_t i = 0; i < a.size(); i++) d += (a[i] - b[i])*(a[i] - b[i]);
+    return d;
+}
+
+/* Reads "T:<id>:<count> ..." lines, and returns each interval's vector, normalized and projected.
+ * The projection matrix is generated lazily, one row per BBL id, so we never hold full BBVs.
+ */
+static vector<Point> ReadBbvs(const char* file, MTRand& rng) {
+    FILE* f = fopen(file, "r");
+    if (!f) panic("Could not open BBV file %s", file);
+
+    vector<Point> proj;  // BBL id -> projection row
+    vector<Point> points;
+    vector<pair<uint32_t, uint64_t>> counts;
+    char* line = nullptr;
+    size_t lineCap = 0;
+    while (getline(&line, &lineCap, f) > 0) {
+        if (line[0] != 'T') continue;
+        counts.clear();
+        uint64_t total = 0;
+        char* p = line + 1;
+        while (*p == ':') {
+            char* end;
+            uint32_t id = strtoul(p + 1, &end, 10);
+            if (*end != ':' || id == 0) panic("%s: malformed BBV entry: %s", file, p);
+            uint64_t count = strtoull(end + 1, &p, 10);
+            counts.push_back(make_pair(id - 1, count));
+            total += count;
+            while (*p == ' ') p++;
+        }
+        if (!total) continue;
+
+        Point pt(PROJ_DIMS, 0.0);
+        for (auto& c : counts) {
+            while (c.first >= proj.size()) {
+                Point row(PROJ_DIMS);
+                for (double& r : row) r = 2.0*rng.rand() - 1.0;
+                proj.push_back(row);
+            }
+            double frac = ((double)c.second)/total;
+            for (uint32_t d = 0; d < PROJ_DIMS; d++) pt[d] += frac*proj[c.first][d];
+        }
+        points.push_back(pt);
+    }
+    free(line);
+    fclose(f);
+    return points;
+}
+
+static Clustering KMeans(const vector<Point>& points, uint32_t k, MTRand& rng) {
+    uint32_t n = points.size();
+    Clustering c;
+    c.k = k;
+    c.assign.resize(n, 0);
+
+    // Initialize centroids with k distinct random points
+    vector<uint32_t> perm(n);
+    for (uint32_t i = 0; i < n; i++) perm[i] = i;
+    for (uint32_t i = 0; i < k; i++) {
+        swap(perm[i], perm[i + rng.randInt(n - i - 1)]);
+        c.centroids.push_back(points[perm[i]]);
+    }
+
+    for (uint32_t iter = 0; iter < KMEANS_ITERS; iter++) {
+        bool changed = false;
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t best = 0;
+            double bestDist = dist2(points[i], c.centroids[0]);
+            for (uint32_t j = 1; j < k; j++) {
+                double d = dist2(points[i], c.centroids[j]);
+                if (d < bestDist) {
+                    best = j;
+                    bestDist = d;
+                }
+            }
+            if (c.assign[i] != best || iter == 0) changed = true;
+            c.assign[i] = best;
+        }
+        if (!changed) break;
+
+        vector<uint32_t> sizes(k, 0);
+        for (auto& ct : c.centroids) ct.assign(PROJ_DIMS, 0.0);
+        for (uint32_t i = 0; i < n; i++) {
+            sizes[c.assign[i]]++;
+            for (uint32_t d = 0; d < PROJ_DIMS; d++) c.centroids[c.assign[i]][d] += points[i][d];
+        }
+        for (uint32_t j = 0; j < k; j++) {
+            if (sizes[j]) {
+                for (double& x : c.centroids[j]) x /= sizes[j];
+            } else {
+                c.centroids[j] = points[rng.randInt(n - 1)];  // re-seed empty clusters
+            }
+        }
+    }
+
+    c.distortion = 0.0;
+    for (uint32_t i = 0; i < n; i++) c.distortion += dist2(points[i], c.centroids[c.assign[i]]);
+    return c;
+}
+
+/* Bayesian Information Criterion of a clustering, assuming identical spherical
+ * Gaussians (Pelleg and Moore, X-means, ICML 2000), as in SimPoint
+ */
+static double BIC(const Clustering& c, uint32_t n) {
+    const double dims = PROJ_DIMS;
+    vector<uint32_t> sizes(c.k, 0);
+    for (uint32_t a : c.assign) sizes[a]++;
+
+    double variance = (n > c.k)? c.distortion/(dims*(n - c.k)) : 0.0;
+    variance = MAX(variance, 1e-12);  // perfect clusterings
+    double logLikelihood = 0.0;
+    for (uint32_t s : sizes) {
+        if (!s) continue;
+        logLikelihood += s*log((double)s) - s*log((double)n) - s*log(2*M_PI*variance)*dims/2 - (s - 1)*dims/2;
+    }
+    double params = (c.k - 1) + dims*c.k + 1;
+    return logLikelihood - params/2*log((double)n);
+}
+
+int main(int argc, const char* argv[]) {
+    InitLog("");  // no log header
+    if (argc < 3 || argc > 5) {
+        info("Picks simulation points from a BBV profile (processN.bbvInterval)");
+        info("Usage: %s <bbv_file> <output_prefix> [<maxK> (default 10)] [<bicThreshold> (default 0.9)]", argv[0]);
+        exit(1);
+    }
+    uint32_t maxK = (argc >= 4)? strtoul(argv[3], nullptr, 0) : 10;
+    double bicThreshold = (argc >= 5)? atof(argv[4]) : 0.9;
+    if (maxK == 0) panic("maxK must be positive");
+
+    MTRand rng(42);  // fixed seed, so results are reproducible
+    vector<Point> points = ReadBbvs(argv[1], rng);
+    uint32_t n = points.size();
+    if (!n) panic("%s has no intervals", argv[1]);
+    info("Read %d intervals", n);
+
+    vector<Clustering> clusterings;  // best of KMEANS_SEEDS runs for each k
+    for (uint32_t k = 1; k <= MIN(maxK, n); k++) {
+        Clustering best = KMeans(points, k, rng);
+        for (uint32_t s = 1; s < KMEANS_SEEDS; s++) {
+            Clustering c = KMeans(points, k, rng);
+            if (c.distortion < best.distortion) best = c;
+        }
+        best.bic = BIC(best, n);
+        info(" k = %2d  distortion %10.6f  BIC %12.2f", k, best.distortion, best.bic);
+        clusterings.push_back(best);
+    }
+
+    double minBic = clusterings[0].bic, maxBic = clusterings[0].bic;
+    for (auto& c : clusterings) {
+        minBic = MIN(minBic, c.bic);
+        maxBic = MAX(maxBic, c.bic);
+    }
+    const Clustering* chosen = &clusterings.back();
+    for (auto& c : clusterings) {
+        if (c.bic >= minBic + bicThreshold*(maxBic - minBic)) {
+            chosen = &c;
+            break;
+        }
+    }
+
+    // Representative of each non-empty cluster: the interval closest to its centroid
+    uint32_t k = chosen->k;
+    vector<int64_t> reps(k, -1);
+    vector<double> repDists(k, 0.0);
+    vector<uint32_t> sizes(k, 0);
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t a = chosen->assign[i];
+        double d = dist2(points[i], chosen->centroids[a]);
+        if (reps[a] < 0 || d < repDists[a]) {
+            reps[a] = i;
+            repDists[a] = d;
+        }
+        sizes[a]++;
+    }
+
+    vector<pair<uint32_t, uint32_t>> simpoints;  // (interval, cluster), sorted by interval
+    for (uint32_t j = 0; j < k; j++) if (reps[j] >= 0) simpoints.push_back(make_pair(reps[j], j));
+    sort(simpoints.begin(), simpoints.end());
+
+    string prefix = argv[2];
+    FILE* spFile = fopen((prefix + ".simpoints").c_str(), "w");
+    FILE* wFile = fopen((prefix + ".weights").c_str(), "w");
+    if (!spFile || !wFile) panic("Could not open output files with prefix %s", prefix.c_str());
+    for (auto& sp : simpoints) {
+        fprintf(spFile, "%d %d\n", sp.first, sp.second);
+        fprintf(wFile, "%f %d\n", ((double)sizes[sp.second])/n, sp.second);
+        info("Interval %6d  cluster %3d  weight %.4f", sp.first, sp.second, ((double)sizes[sp.second])/n);
+    }
+    fclose(spFile);
+    fclose(wFile);
+    info("Chose k = %d; wrote %s.simpoints and %s.weights", k, prefix.c_str(), prefix.c_str());
+    return 0;
+}
@@ -49,6 +49,7 @@ int main(int argc, const char* argv[]) {
     if (argc != 3) {
         info("Sorts an access trace");
         info("Usage: %s <input_trace> <output_trace>", argv[0]);
+        info("Output traces ending in %s use the native format (see access_tracing.h)", TRACE_NATIVE_SUFFIX);
         exit(1);
     }
 
@@ -0,0 +1,192 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Bound-phase scaling benchmark for shared cache banks. Builds the real hierarchy that init.cpp
+ * builds for one shared bank: per-thread private L1s (MESITerminalCC) in front of a shared LRU
+ * bank (MESICC) with the given number of lock stripes, over a fixed-latency memory. Each host
+ * thread then drives its own L1 as a core does, holding its L1's lock across the access, and
+ * we report the aggregate access rate for 1 to maxThreads threads.
+ *
+ * Threads mostly touch a private footprint larger than their L1, plus a shared region that the
+ * other threads write, so the bank sees misses, evictions and invalidations of other L1s.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cache.h"
+#include "cache_arrays.h"
+#include "coherence_ctrls.h"
+#include "contention_sim.h"
+#include "galloc.h"
+#include "hash.h"
+#include "locks.h"
+#include "log.h"
+#include "mem_ctrls.h"
+#include "mtrand.h"
+#include "profile_stats.h"
+#include "repl_policies.h"
+#include "zsim.h"
+
+using namespace std;
+
+GlobSimInfo* zinfo = nullptr;
+uint32_t lineBits = 6;
+
+// Cache::access only builds timing events with event recorders, which this benchmark does not create
+void ContentionSim::enqueue(TimingEvent* ev, uint64_t cycle) { panic("No contention simulation in stripebench"); }
+void ContentionSim::enqueueSynced(TimingEvent* ev, uint64_t cycle) { panic("No contention simulation in stripebench"); }
+void ContentionSim::enqueueCrossing(CrossingEvent* ev, uint64_t cycle, uint32_t srcId, uint32_t srcDomain, uint32_t dstDomain, EventRecorder* evRec) {
+    panic("No contention simulation in stripebench");
+}
+
+static const uint32_t L1_LINES = 512;  // 32KB
+static const uint32_t L1_WAYS = 8;
+static const uint32_t PRIVATE_LINES = 4*L1_LINES;
+static const uint32_t SHARED_PCT = 10;
+static const uint32_t WRITE_PCT = 20;
+
+static Cache* BuildCache(const char* name, uint32_t numLines, uint32_t ways, uint32_t lockStripes, bool terminal) {
+    g_string gname(name);
+    uint32_t setBits = 31 - __builtin_clz(numLines/ways);
+    HashFamily* hf = terminal? (HashFamily*) new IdHashFamily() : new H3HashFamily(1, setBits, 0xCAC7EAFFA1);
+    ReplPolicy* rp = terminal? (ReplPolicy*) new LRUReplPolicy<false>(numLines) : new LRUReplPolicy<true>(numLines, ways, lockStripes);
+    CacheArray* array = new SetAssocArray(numLines, ways, rp, hf);
+    CC* cc = terminal? (CC*) new MESITerminalCC(numLines, gname) : new MESICC(numLines, false, gname, lockStripes, hf);
+    rp->setCC(cc);
+    return new Cache(numLines, cc, array, rp, terminal? 0 : 10, 10, gname);
+}
+
+static void RunThread(Cache* l1, uint32_t tid, uint64_t numAccesses, uint64_t sharedLines, volatile bool* start) {
+    MTRand rng(tid + 1);
+    lock_t filterLock;
+    futex_init(&filterLock);
+    Address privateBase = ((Address)(tid + 1)) << 32;
+    uint64_t cycle = 0;
+
+    while (!*start) sched_yield();
+    for (uint64_t i = 0; i < numAccesses; i++) {
+        bool shared = rng.randInt(99) < SHARED_PCT;
+        Address lineAddr = shared? 1 + rng.randInt(sharedLines - 2) : privateBase + rng.randInt(PRIVATE_LINES - 1);
+        AccessType type = (rng.randInt(99) < WRITE_PCT)? GETX : GETS;
+        MESIState dummyState = I;
+        futex_lock(&filterLock);
+        MemReq req = {lineAddr, type, 0, &dummyState, cycle, &filterLock, dummyState, tid, 0};
+        cycle = l1->access(req);
+        futex_unlock(&filterLock);
+    }
+}
+
+// Returns accesses/s
+static double Run(uint32_t numThreads, uint32_t lockStripes, uint32_t bankLines, uint32_t bankWays, uint64_t accsPerThread) {
+    zinfo->numCores = numThreads;
+    zinfo->eventRecorders = gm_calloc<EventRecorder*>(numThreads);
+
+    g_string memName("mem");
+    g_vector<MemObject*> memParents;
+    memParents.push_back(new SimpleMemory(100, memName));
+
+    Cache* bank = BuildCache("bank", bankLines, bankWays, lockStripes, false);
+    g_vector<BaseCache*> l1s;
+    g_vector<MemObject*> bankParents;
+    bankParents.push_back(bank);
+    for (uint32_t t = 0; t < numThreads; t++) {
+        Cache* l1 = BuildCache("l1", L1_LINES, L1_WAYS, 1, true);
+        l1->setParents(t, bankParents, nullptr);
+        l1s.push_back(l1);
+    }
+    bank->setParents(0, memParents, nullptr);
+    bank->setChildren(l1s, nullptr);
+
+    volatile bool start = false;
+    vector<thread> threads;
+    for (uint32_t t = 0; t < numThreads; t++) {
+        threads.push_back(thread(RunThread, (Cache*)l1s[t], t, accsPerThread, bankLines/2, &start));
+    }
+    uint64_t startNs = getNs();
+    start = true;
+    for (thread& th : threads) th.join();
+    uint64_t ns = getNs() - startNs;
+    return 1e9*numThreads*accsPerThread/ns;
+}
+
+int main(int argc, const char* argv[]) {
+    InitLog(""); //no log header
+    if (argc > 6) {
+        info("Measures shared-bank access throughput as host threads grow, for each lock stripe count");
+        info("Usage: %s [<stripes> (default 1,64)] [<max threads> (default 128)] [<Kaccesses per thread> (default 200)]", argv[0]);
+        info("       [<bank KB> (default 8192)] [<bank ways> (default 16)]");
+        exit(1);
+    }
+
+    vector<uint32_t> stripes;
+    stringstream ss((argc >= 2)? argv[1] : "1,64");
+    string s;
+    while (getline(ss, s, ',')) stripes.push_back(strtoul(s.c_str(), nullptr, 0));
+    uint32_t maxThreads = (argc >= 3)? strtoul(argv[2], nullptr, 0) : 128;
+    uint64_t accsPerThread = ((argc >= 4)? strtoul(argv[3], nullptr, 0) : 200)*1000;
+    uint32_t bankKB = (argc >= 5)? strtoul(argv[4], nullptr, 0) : 8192;
+    uint32_t bankWays = (argc >= 6)? strtoul(argv[5], nullptr, 0) : 16;
+
+    uint32_t bankLines = bankKB*1024/64;
+    if (!bankWays || bankLines % bankWays || !isPow2(bankLines/bankWays)) panic("Number of bank sets must be a power of two");
+    for (uint32_t st : stripes) {
+        if (!isPow2(st) || st > bankLines/bankWays) panic("Stripes must be a power of 2 and <= sets (%d given)", st);
+    }
+
+    // Each run builds a fresh hierarchy and never frees it
+    uint32_t runs = 0;
+    for (uint32_t t = 1; t <= maxThreads; t *= 2) runs++;
+    gm_init((64ul << 20) + runs*stripes.size()*(bankLines*64ul + 2*maxThreads*L1_LINES*64ul));
+    zinfo = gm_calloc<GlobSimInfo>();
+    zinfo->lineSize = 64;
+
+    info("%d KB %d-way bank, %d KB L1s, %ld Kaccesses/thread, %d%% shared, %d%% writes, %d host CPUs",
+            bankKB, bankWays, L1_LINES*64/1024, accsPerThread/1000, SHARED_PCT, WRITE_PCT, std::thread::hardware_concurrency());
+    string line = "   threads";
+    char buf[64];
+    for (uint32_t st : stripes) {
+        snprintf(buf, sizeof(buf), "  %5d-stripe Macc/s (speedup)", st);
+        line += buf;
+    }
+    info("%s", line.c_str());
+
+    vector<double> base(stripes.size());
+    for (uint32_t t = 1; t <= maxThreads; t *= 2) {
+        snprintf(buf, sizeof(buf), "%10d", t);
+        line = buf;
+        for (uint32_t i = 0; i < stripes.size(); i++) {
+            double rate = Run(t, stripes[i], bankLines, bankWays, accsPerThread);
+            if (t == 1) base[i] = rate;
+            snprintf(buf, sizeof(buf), "  %18.2f (%6.2fx)", rate/1e6, rate/base[i]);
+            line += buf;
+        }
+        info("%s", line.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,143 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SWEEP_H_
+#define SWEEP_H_
+
+#include <vector>
+#include "core.h"
+#include "galloc.h"
+#include "instr_trace.h"
+#include "zsim.h"
+
+class FilterCache;
+
+/* Sweep systems evaluate several configurations in a single run, paying for instrumentation and decoding once.
+ *
+ * Each sweep.<name> config group describes a full system, with the same format as sys (caches, cores, mem,
+ * networkFile), and as many cores as sys. Each sweep core is fed the instruction stream of the thread running on
+ * the primary core with the same cid (see the sweep analysis functions in zsim.cpp), and each sweep system has its
+ * own stats subtree (sweep.<name>). Sweep caches are also warmed during fast-forwarding (sim.warmFF).
+ *
+ * Sweep cores follow the global phase clock: the scheduler joins and leaves them with their primary core, and a
+ * thread only takes the phase barrier once its primary and all its sweep cores are past the end of the phase (a
+ * core that gets there first queues the thread's stream until the next phase, see SweepQueue). Their event
+ * recorders use source ids (1 + sweep index)*numCores + cid, so weave (contention) models simulate them too. Threads are
+ * scheduled on the primary system only, so every system sees the same thread-to-core mapping.
+ * Sweep systems are not checkpointed.
+ */
+class SweepSystem : public GlobAlloc {
+    public:
+        const char* name;
+        uint32_t srcIdBase; //source ids of its cores' accesses are srcIdBase + cid
+        Core** cores; //CID->core
+        FilterCache** l1is; //CID->l1i, nullptr for Null cores
+        FilterCache** l1ds;
+
+        SweepSystem(const char* _name, uint32_t _srcIdBase) : name(_name), srcIdBase(_srcIdBase), cores(nullptr) {
+            l1is = gm_calloc<FilterCache*>(zinfo->numCores);
+            l1ds = gm_calloc<FilterCache*>(zinfo->numCores);
+        }
+};
+
+//CID->core array of system sys: 0 is the primary system, 1..numSweeps are the sweep systems
+static inline Core** SystemCores(uint32_t sys) {
+    return sys? zinfo->sweeps[sys-1]->cores : zinfo->cores;
+}
+
+//Called by the scheduler on every context switch, join and leave of a primary core
+static inline void SweepContextSwitch(uint32_t cid, int32_t gid) {
+    for (uint32_t s = 0; s < zinfo->numSweeps; s++) zinfo->sweeps[s]->cores[cid]->contextSwitch(gid);
+}
+
+static inline void SweepJoin(uint32_t cid) {
+    for (uint32_t s = 0; s < zinfo->numSweeps; s++) zinfo->sweeps[s]->cores[cid]->join();
+}
+
+static inline void SweepLeave(uint32_t cid) {
+    for (uint32_t s = 0; s < zinfo->numSweeps; s++) zinfo->sweeps[s]->cores[cid]->leave();
+}
+
+/* Part of a thread's instruction stream that one of its cores has not simulated yet (process-local, one per thread
+ * and system). A core stops at the first BBL it gets past the end of its phase, and queues everything from there
+ * on; the queue drains once nextPhase() moves the core's phase end. Queues belong to the thread, not the core, so
+ * if the thread is switched to another core at the barrier, the rest of its stream goes there, as it would without
+ * sweeps.
+ */
+class SweepQueue {
+    private:
+        std::vector<InstrTraceRecord> recs;
+        size_t head;
+
+        static inline void simulate(Core* core, const InstrTraceRecord& rec) {
+            switch (rec.type) {
+                case ITR_BBL: core->sweepBbl(rec.addr, rec.bblInfo); break;
+                case ITR_LOAD: core->sweepLoad(rec.addr, true); break;
+                case ITR_STORE: core->sweepStore(rec.addr, true); break;
+                case ITR_PRED_LOAD: core->sweepLoad(rec.addr, rec.flag); break;
+                case ITR_PRED_STORE: core->sweepStore(rec.addr, rec.flag); break;
+                case ITR_BRANCH: core->sweepBranch(rec.addr, rec.flag, rec.takenNpc, rec.notTakenNpc); break;
+            }
+        }
+
+    public:
+        SweepQueue() : head(0) {}
+
+        //True if the core is done with this phase
+        bool stopped() const {return head < recs.size();}
+
+        inline void feed(Core* core, const InstrTraceRecord& rec) {
+            if (likely(!stopped() && !(rec.type == ITR_BBL && core->pastPhaseEnd()))) {
+                simulate(core, rec);
+            } else {
+                recs.push_back(rec);
+                drain(core);
+            }
+        }
+
+        //Simulates queued records until the core stops again
+        void drain(Core* core) {
+            while (head < recs.size()) {
+                const InstrTraceRecord& rec = recs[head];
+                if (rec.type == ITR_BBL && core->pastPhaseEnd()) return;
+                simulate(core, rec);
+                head++;
+            }
+            clear();
+        }
+
+        //Simulates all queued records regardless of the phase, when the thread is about to leave the core
+        void flush(Core* core) {
+            for (; head < recs.size(); head++) simulate(core, recs[head]);
+            clear();
+        }
+
+        void clear() {
+            recs.clear();
+            head = 0;
+        }
+};
+
+#endif  // SWEEP_H_
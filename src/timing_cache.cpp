@@ -113,6 +113,7 @@ void TimingCache::initStats(AggregateStat* parentStat) {
 // TODO(dsm): This is copied verbatim from Cache. We should split Cache into different methods, then call those.
 uint64_t TimingCache::access(MemReq& req) {
     EventRecorder* evRec = zinfo->eventRecorders[req.srcId];
+    if (unlikely(req.is(MemReq::WARM) || (!evRec && req.srcId >= zinfo->numCores))) return Cache::access(req); //functional (warming or sweep) access, no timing
     assert_msg(evRec, "TimingCache is not connected to TimingCore");
 
     TimingRecord writebackRecord, accessRecord;
@@ -133,6 +134,7 @@ uint64_t TimingCache::access(MemReq& req) {
             //Make space for new line
             Address wbLineAddr;
             lineId = array->preinsert(req.lineAddr, &req, &wbLineAddr); //find the lineId to replace
+            req.evictedLineAddr = cc->isValid(lineId)? wbLineAddr : 0;
             trace(Cache, "[%s] Evicting 0x%lx", name.c_str(), wbLineAddr);
 
             //Evictions are not in the critical path in any sane implementation -- we do not include their delays
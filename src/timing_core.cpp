@@ -31,7 +31,8 @@
 //#define DEBUG_MSG(args...) info(args)
 
 TimingCore::TimingCore(FilterCache* _l1i, FilterCache* _l1d, uint32_t _domain, g_string& _name)
-    : Core(_name), l1i(_l1i), l1d(_l1d), instrs(0), curCycle(0), cRec(_domain, _name) {}
+    : Core(_name), l1i(_l1i), l1d(_l1d), instrs(0), curCycle(0), curBblAddr(0), loadIdx(0), cRec(_domain, _name) {
+}
 
 uint64_t TimingCore::getPhaseCycles() const {
     return curCycle % zinfo->phaseLength;
@@ -41,7 +42,7 @@ void TimingCore::initStats(AggregateStat* parentStat) {
     AggregateStat* coreStat = new AggregateStat();
     coreStat->init(name.c_str(), "Core stats");
 
-    auto x = [this]() { return cRec.getUnhaltedCycles(curCycle); };
+    auto x = [this]() { return getCycles(); };
     LambdaStat<decltype(x)>* cyclesStat = new LambdaStat<decltype(x)>(x);
     cyclesStat->init("cycles", "Simulated unhalted cycles");
     coreStat->append(cyclesStat);
@@ -79,7 +80,7 @@ void TimingCore::leave() {
 
 void TimingCore::loadAndRecord(Address addr) {
     uint64_t startCycle = curCycle;
-    curCycle = l1d->load(addr, curCycle);
+    curCycle = l1d->load(addr, curCycle, curBblAddr + loadIdx++);
     cRec.record(startCycle);
 }
 
@@ -92,6 +93,8 @@ void TimingCore::storeAndRecord(Address addr) {
 void TimingCore::bblAndRecord(Address bblAddr, BblInfo* bblInfo) {
     instrs += bblInfo->instrs;
     curCycle += bblInfo->instrs;
+    curBblAddr = bblAddr;
+    loadIdx = 0;
 
     Address endBblAddr = bblAddr + bblInfo->bytes;
     for (Address fetchAddr = bblAddr; fetchAddr < endBblAddr; fetchAddr+=(1 << lineBits)) {
@@ -101,6 +104,25 @@ void TimingCore::bblAndRecord(Address bblAddr, BblInfo* bblInfo) {
     }
 }
 
+void TimingCore::sweepBbl(ADDRINT bblAddr, BblInfo* bblInfo) {
+    bblAndRecord(bblAddr, bblInfo);
+}
+
+void TimingCore::sweepLoad(ADDRINT addr, BOOL pred) {
+    if (pred) {
+        loadAndRecord(addr);
+    } else {
+        loadIdx++;
+    }
+}
+
+void TimingCore::sweepStore(ADDRINT addr, BOOL pred) {
+    if (pred) storeAndRecord(addr);
+}
+
+void TimingCore::nextPhase() {
+    phaseEndCycle += zinfo->phaseLength;
+}
 
 InstrFuncPtrs TimingCore::GetFuncPtrs() {
     return {LoadAndRecordFunc, StoreAndRecordFunc, BblAndRecordFunc, BranchFunc, PredLoadAndRecordFunc, PredStoreAndRecordFunc, FPTR_ANALYSIS, {0}};
@@ -127,7 +149,12 @@ void TimingCore::BblAndRecordFunc(THREADID tid, ADDRINT bblAddr, BblInfo* bblInf
 }
 
 void TimingCore::PredLoadAndRecordFunc(THREADID tid, ADDRINT addr, BOOL pred) {
-    if (pred) static_cast<TimingCore*>(cores[tid])->loadAndRecord(addr);
+    TimingCore* core = static_cast<TimingCore*>(cores[tid]);
+    if (pred) {
+        core->loadAndRecord(addr);
+    } else {
+        core->loadIdx++;  //keeps the signatures of later loads in the BBL
+    }
 }
 
 void TimingCore::PredStoreAndRecordFunc(THREADID tid, ADDRINT addr, BOOL pred) {
@@ -43,6 +43,8 @@ class TimingCore : public Core {
 
         uint64_t curCycle; //phase 1 clock
         uint64_t phaseEndCycle; //phase 1 end clock
+        Address curBblAddr;
+        uint32_t loadIdx; //PC signature of loads is curBblAddr + loadIdx (as in SimpleCore)
 
         CoreRecorder cRec;
 
@@ -60,6 +62,12 @@ class TimingCore : public Core {
 
         InstrFuncPtrs GetFuncPtrs();
 
+        void sweepBbl(ADDRINT bblAddr, BblInfo* bblInfo);
+        void sweepLoad(ADDRINT addr, BOOL pred);
+        void sweepStore(ADDRINT addr, BOOL pred);
+        bool pastPhaseEnd() const {return curCycle > phaseEndCycle;}
+        void nextPhase();
+
         //Contention simulation interface
         inline EventRecorder* getEventRecorder() {return cRec.getEventRecorder();}
         void cSimStart() {curCycle = cRec.cSimStart(curCycle);}
@@ -109,6 +109,12 @@ CrossingEvent::CrossingEvent(TimingEvent* parent, TimingEvent* child, uint64_t _
         _minStartCycle++;
     }
 
+    //Lookahead: by default, just the delays adjacent to the crossing. Parents that wake their children directly
+    //(DelayEvents carrying network or access latencies) add their delay, since if they have not fired, their own
+    //parents have not finished either, so they finish no earlier than srcDomain's current cycle.
+    lookahead = preSlack + postSlack;
+    if (zinfo->contentionSim->useCrossingLookahead()) lookahead += parent->getPassThroughDelay();
+
     minStartCycle = _minStartCycle;
     origStartCycle = minStartCycle - evRec->getGapCycles();
     //queue(MAX(zinfo->contentionSim->getLastLimit(), minStartCycle)); //this initial queue always works --- 0 parents
@@ -142,7 +148,7 @@ void CrossingEvent::parentDone(uint64_t startCycle) {
 
 void CrossingEvent::simulate(uint64_t simCycle) {
     if (!called) {
-        uint64_t curSrcCycle = zinfo->contentionSim->getCurCycle(srcDomain) + preSlack + postSlack;
+        uint64_t curSrcCycle = zinfo->contentionSim->getCurCycle(srcDomain) + lookahead;
         //uint64_t coreRelCycle = 0; //evRec->getSlack(origStartCycle) + postSlack; //note we do not add preDelay, because minStartCycle already has it
         uint64_t coreRelCycle = evRec->getSlack(origStartCycle) + postSlack; //note we do not add preDelay, because minStartCycle already has it
         uint64_t nextCycle = MAX(coreRelCycle, MAX(curSrcCycle, simCycle));
@@ -150,6 +156,7 @@ void CrossingEvent::simulate(uint64_t simCycle) {
         __sync_synchronize(); //not needed --- these are all volatile, and by TSO, if we see a cycle > doneCycle, by force we must see doneCycle set
         if (!called) { //have to check again, AFTER reading the cycles! Otherwise, we have a race
             zinfo->contentionSim->setPrio(domain, (nextCycle == simCycle)? 1 : 2);
+            zinfo->contentionSim->profileLookaheadStall(srcDomain, domain);
 
 #if PROFILE_CROSSINGS
             simCount++;
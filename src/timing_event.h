@@ -66,7 +66,7 @@ class CrossingEvent;
 
 class TimingEvent {
     private:
-        uint64_t privCycle; //only touched by ContentionSim
+        uint64_t privCycle; //only touched by ContentionSim and TimingWheel
 
     public:
         TimingEvent* next; //used by PrioQueue --- PRIVATE
@@ -212,6 +212,10 @@ class TimingEvent {
         //Describe yourself, useful for debugging
         virtual std::string str() { std::string res; return res; }
 
+        //Minimum cycles between this event's parents finishing and this event finishing, if that does not
+        //require this event to be queued in its domain. Used to extend crossing lookahead.
+        virtual uint32_t getPassThroughDelay() const { return 0; }
+
     private:
         void* operator new (size_t);
 
@@ -280,6 +284,7 @@ class TimingEvent {
 
 
     friend class ContentionSim;
+    template <typename T> friend class TimingWheel;
     friend class DelayEvent; //DelayEvent is, for now, the only child of TimingEvent that should do anything other than implement simulate
     friend class CrossingEvent;
 };
@@ -301,6 +306,8 @@ class DelayEvent : public TimingEvent {
         virtual void simulate(uint64_t simCycle) {
             panic("DelayEvent::simulate() was called --- DelayEvent wakes its children directly");
         }
+
+        virtual uint32_t getPassThroughDelay() const { return preDelay; }
 };
 
 class CrossingEvent : public TimingEvent {
@@ -315,6 +322,7 @@ class CrossingEvent : public TimingEvent {
         TimingEvent* parentEv; //stored exclusively for resp-req xing chaining
 
         uint32_t preSlack, postSlack;
+        uint32_t lookahead; //if the source event has not run, it will not be done until srcDomain's cycle + lookahead
 
         class CrossingSrcEvent : public TimingEvent {
             private:
@@ -25,10 +25,11 @@
 
 #include <sstream>
 #include "trace_driver.h"
+#include "opt_repl_policy.h"
 #include "zsim.h"
 
-TraceDriver::TraceDriver(std::string filename, std::string retraceFilename, std::vector<TraceDriverProxyCache*>& proxies, bool _useSkews, bool _playPuts, bool _playAllGets)
-    : tr(filename), numChildren(proxies.size()), useSkews(_useSkews), playPuts(_playPuts), playAllGets(_playAllGets)
+TraceDriver::TraceDriver(std::string filename, std::string retraceFilename, std::vector<TraceDriverProxyCache*>& proxies, bool _useSkews, bool _playPuts, bool _playAllGets, TraceThreadSpawnFn spawnThread)
+    : tr(filename, spawnThread), numRead(0), numChildren(proxies.size()), useSkews(_useSkews), playPuts(_playPuts), playAllGets(_playAllGets)
 {
     assert(numChildren > 0);
     assert(!useSkews || numChildren == 1);
@@ -39,6 +40,9 @@ TraceDriver::TraceDriver(std::string filename, std::string retraceFilename, std:
     parent = proxies[0]->getParent();
     for (uint32_t i = 0; i < numChildren; i++) proxies[i]->setDriver(this);
 
+    nextUse = zinfo->nextUseTable;
+    if (nextUse && nextUse->getNumRecords() != tr.getNumRecords()) panic("OPT next-use table does not match trace %s", filename.c_str());
+
     if (retraceFilename != "") { //we're doing retracing with the new skews
         g_string fname(retraceFilename.c_str());
         atw = new AccessTraceWriter(fname, numChildren);
@@ -103,6 +107,7 @@ bool TraceDriver::executePhase() {
     if (lastAcc.childId == (uint32_t)-1) {
         if (tr.empty()) return false;
         acc = tr.read();
+        numRead++;
         if (useSkews) acc.reqCycle += children[acc.childId].skew;
     } else {
         acc = lastAcc;
@@ -114,6 +119,7 @@ bool TraceDriver::executePhase() {
         executeAccess(acc);
         if (tr.empty()) return false;
         acc = tr.read();
+        numRead++;
         if (useSkews) acc.reqCycle += children[acc.childId].skew;
     }
 
@@ -124,6 +130,7 @@ bool TraceDriver::executePhase() {
 void TraceDriver::executeAccess(AccessRecord acc) {
     assert(acc.childId < numChildren);
     std::unordered_map<Address, MESIState>& cStore = children[acc.childId].cStore;
+    if (nextUse) nextUse->setPos(numRead - 1, acc.lineAddr);
 
     int64_t lat = 0;
     switch (acc.type) {
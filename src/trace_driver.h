@@ -34,6 +34,7 @@
 
 /* Basic class for trace-driven simulation. Shares the cache interface (invalidate), but it is not a cache in any sense --- it just reads in a single trace and replays it */
 
+class NextUseTable;
 class TraceDriverProxyCache;
 
 class TraceDriver {
@@ -53,6 +54,8 @@ class TraceDriver {
         ChildInfo* children;
         lock_t lock; //NOTE: not needed for now
         AccessTraceReader tr;
+        uint64_t numRead; //records read from tr so far; the last one read is the one being executed
+        NextUseTable* nextUse; //if the parent runs OPT, tells it which record is being executed
         uint32_t numChildren;
         bool useSkews; //If false, replays the trace using its request cycles. If true, it skews the simulated child. Can only be true with a single child.
         bool playPuts; //If true, issues PUTS/PUTX requests as they appear in the trace. If false, it just issues the GETS/X requests, leaving it up to the parent to decide when to evict something (NOTE: if the parent is running OPT, it knows better!)
@@ -65,7 +68,7 @@ class TraceDriver {
         AccessRecord lastAcc;
 
     public:
-        TraceDriver(std::string filename, std::string retracefile, std::vector<TraceDriverProxyCache*>& proxies, bool _useSkews, bool _playPuts, bool _playAllGets);
+        TraceDriver(std::string filename, std::string retracefile, std::vector<TraceDriverProxyCache*>& proxies, bool _useSkews, bool _playPuts, bool _playAllGets, TraceThreadSpawnFn spawnThread);
         void initStats(AggregateStat* parentStat);
         void setParent(MemObject* _parent);
 
@@ -41,6 +41,7 @@ void TracingCache::setChildren(const g_vector<BaseCache*>& children, Network* ne
 
 uint64_t TracingCache::access(MemReq& req) {
     uint64_t respCycle = Cache::access(req);
+    if (req.is(MemReq::WARM)) return respCycle; //warming accesses are not part of the trace
     futex_lock(&traceLock);
     uint32_t lat = respCycle - req.cycle;
     AccessRecord acc = {req.lineAddr, req.cycle, lat, req.childId, req.type};
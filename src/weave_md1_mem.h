@@ -64,6 +64,7 @@ class WeaveMD1Memory : public MD1Memory {
         }
 
         uint64_t access(MemReq& req) {
+            if (req.is(MemReq::WARM)) return MD1Memory::access(req); //functional, no timing
             uint64_t realRespCycle = MD1Memory::access(req);
             uint32_t realLatency = realRespCycle - req.cycle;
 
@@ -100,6 +101,7 @@ class WeaveSimpleMemory : public SimpleMemory {
         }
 
         uint64_t access(MemReq& req) {
+            if (req.is(MemReq::WARM)) return SimpleMemory::access(req); //functional, no timing
             uint64_t realRespCycle = SimpleMemory::access(req);
             uint32_t realLatency = realRespCycle - req.cycle;
 
@@ -40,7 +40,10 @@
 #include <sys/resource.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <unordered_map>
+#include <vector>
 #include "access_tracing.h"
+#include "checkpoint.h"
 #include "constants.h"
 #include "contention_sim.h"
 #include "core.h"
@@ -48,15 +51,19 @@
 #include "cpuid.h"
 #include "debug_zsim.h"
 #include "event_queue.h"
+#include "filter_cache.h"
 #include "galloc.h"
 #include "init.h"
+#include "instr_trace.h"
 #include "log.h"
 #include "pin.H"
 #include "pin_cmd.h"
 #include "process_tree.h"
 #include "profile_stats.h"
+#include "sampling.h"
 #include "scheduler.h"
 #include "stats.h"
+#include "sweep.h"
 #include "trace_driver.h"
 #include "virt/virt.h"
 
@@ -189,9 +196,217 @@ VOID PIN_FAST_ANALYSIS_CALL IndirectPredStoreSingle(THREADID tid, ADDRINT addr,
     fPtrs[tid].predStorePtr(tid, addr, pred);
 }
 
+/* Buffered memory access instrumentation (sim.bufferedMemInstr)
+ *
+ * Instead of an analysis call per memory operand, each access appends an
+ * entry to a per-thread buffer with a routine that Pin inlines. The buffer
+ * is drained through fPtrs at the next BBL or conditional branch, and before
+ * any other analysis code that depends on core state (syscalls, magic ops,
+ * RDTSC, thread exit...), so cores see exactly the same sequence of calls.
+ * BBLs with more memory operands than fit in the buffer use the unbuffered
+ * path; so do REP instructions (their instrumentation runs once per
+ * iteration), after draining the buffer.
+ */
+
+#define MEMBUF_ENTRIES 256
+
+enum MemBufKind : uint32_t {MB_LOAD, MB_STORE, MB_PRED_LOAD, MB_PRED_STORE};
+
+struct MemBufEntry {
+    ADDRINT addr;
+    uint32_t kind; //a MemBufKind
+    uint32_t pred; //only meaningful for predicated ops
+};
+
+struct MemBuf {
+    MemBufEntry* cur;
+    MemBufEntry entries[MEMBUF_ENTRIES];
+};
+
+static MemBuf memBufs[MAX_THREADS] ATTR_LINE_ALIGNED;
+
+// Inlined by Pin: no calls, no branches
+VOID PIN_FAST_ANALYSIS_CALL BufferMemOp(THREADID tid, ADDRINT addr, UINT32 kind) {
+    MemBufEntry* e = memBufs[tid].cur++;
+    e->addr = addr;
+    e->kind = kind;
+}
+
+VOID PIN_FAST_ANALYSIS_CALL BufferPredMemOp(THREADID tid, ADDRINT addr, UINT32 kind, BOOL pred) {
+    MemBufEntry* e = memBufs[tid].cur++;
+    e->addr = addr;
+    e->kind = kind;
+    e->pred = pred;
+}
+
+static inline void DrainMemBuf(THREADID tid) {
+    MemBuf& b = memBufs[tid];
+    //NOTE: Reload fPtrs on every access; the first access after a leave may join and switch them
+    for (MemBufEntry* e = b.entries; e < b.cur; e++) {
+        switch (e->kind) {
+            case MB_LOAD: fPtrs[tid].loadPtr(tid, e->addr); break;
+            case MB_STORE: fPtrs[tid].storePtr(tid, e->addr); break;
+            case MB_PRED_LOAD: fPtrs[tid].predLoadPtr(tid, e->addr, e->pred); break;
+            case MB_PRED_STORE: fPtrs[tid].predStorePtr(tid, e->addr, e->pred); break;
+        }
+    }
+    b.cur = b.entries;
+}
+
+VOID PIN_FAST_ANALYSIS_CALL DrainMemBufCall(THREADID tid) {
+    DrainMemBuf(tid);
+}
+
+VOID PIN_FAST_ANALYSIS_CALL BufferedBasicBlock(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
+    DrainMemBuf(tid);
+    fPtrs[tid].bblPtr(tid, bblAddr, bblInfo);
+}
+
+VOID PIN_FAST_ANALYSIS_CALL BufferedRecordBranch(THREADID tid, ADDRINT branchPc, BOOL taken, ADDRINT takenNpc, ADDRINT notTakenNpc) {
+    DrainMemBuf(tid);
+    fPtrs[tid].branchPtr(tid, branchPc, taken, takenNpc, notTakenNpc);
+}
+
+/* Basic-block vector (BBV) profiling (processN.bbvInterval)
+ *
+ * For every interval of bbvInterval instructions, records how many
+ * instructions each basic block executed, in SimPoint's frequency-vector
+ * format (one "T:id:count :id:count ..." line per interval), to be clustered
+ * with the simpoint tool. BBL ids are assigned at instrumentation time and
+ * passed to the analysis routine, so recording is an array increment. Each
+ * thread writes its own file, bbv.p<procIdx>.t<tid> in the output dir; like
+ * FFI, this is meant for single-threaded processes. Intervals are counted in
+ * BBL instructions, as FFI counts them in fast-forward.
+ */
+static uint64_t bbvInterval; //0 if disabled
+static std::unordered_map<ADDRINT, uint32_t> bbvIds; //BBL address -> id; only touched from Trace(), under the client lock
+static volatile uint32_t bbvNumIds;
+
+struct BbvState {
+    std::vector<uint64_t> counts; //instructions per BBL id in the current interval
+    std::vector<uint32_t> touched; //ids with nonzero counts
+    uint64_t instrs; //in the current interval
+    uint64_t intervals;
+    FILE* file;
+};
+
+static BbvState* bbvStates[MAX_THREADS];
+
+static void BbvDumpInterval(BbvState* s) {
+    fputc('T', s->file);
+    for (uint32_t id : s->touched) {
+        fprintf(s->file, ":%d:%ld ", id + 1, s->counts[id]); //SimPoint ids start at 1
+        s->counts[id] = 0;
+    }
+    fputc('\n', s->file);
+    s->touched.clear();
+    s->intervals++;
+}
+
+static void BbvThreadStart(THREADID tid) {
+    std::stringstream ss;
+    ss << zinfo->outputDir << "/bbv.p" << procIdx << ".t" << tid;
+    BbvState* s = new BbvState();
+    s->instrs = 0;
+    s->intervals = 0;
+    s->file = fopen(ss.str().c_str(), "w");
+    if (!s->file) panic("Could not open BBV file %s", ss.str().c_str());
+    bbvStates[tid] = s;
+}
+
+static void BbvThreadFini(THREADID tid) {
+    BbvState* s = bbvStates[tid];
+    if (!s) return;
+    if (!s->touched.empty()) BbvDumpInterval(s); //last, partial interval
+    fclose(s->file);
+    info("BBV: thread %d recorded %ld intervals of %ld instructions", tid, s->intervals, bbvInterval);
+    delete s;
+    bbvStates[tid] = nullptr;
+}
+
+VOID PIN_FAST_ANALYSIS_CALL BbvBasicBlock(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo, UINT32 bbvId) {
+    BbvState* s = bbvStates[tid];
+    if (unlikely(bbvId >= s->counts.size())) s->counts.resize(bbvNumIds + 1024);
+    if (!s->counts[bbvId]) s->touched.push_back(bbvId);
+    s->counts[bbvId] += bblInfo->instrs;
+    s->instrs += bblInfo->instrs;
+    if (unlikely(s->instrs >= bbvInterval)) {
+        BbvDumpInterval(s);
+        s->instrs -= bbvInterval; //keep intervals aligned to multiples of bbvInterval
+    }
+
+    if (zinfo->bufferedMemInstr) DrainMemBuf(tid);
+    fPtrs[tid].bblPtr(tid, bblAddr, bblInfo);
+}
+
+static uint32_t BbvGetId(ADDRINT bblAddr) {
+    auto it = bbvIds.find(bblAddr);
+    if (it != bbvIds.end()) return it->second;
+    uint32_t id = bbvNumIds++;
+    bbvIds[bblAddr] = id;
+    return id;
+}
+
+/* Instruction trace recording (processN.recordInstrTrace, see instr_trace.h)
+ *
+ * These wrap the indirect calls and record what the core sees, i.e., calls
+ * made while the thread is simulated (or joining); fast-forwarded and NOP
+ * threads are not recorded. Each thread writes itrace.p<procIdx>.t<tid> in
+ * the output dir. Syscalls and magic ops are not recorded.
+ */
+static bool itraceRecord;
+static InstrTraceWriter* itraceWriters[MAX_THREADS];
+
+static inline bool ITraceRecording(THREADID tid) {
+    return fPtrs[tid].type == FPTR_ANALYSIS || fPtrs[tid].type == FPTR_JOIN;
+}
+
+VOID PIN_FAST_ANALYSIS_CALL ITraceLoadSingle(THREADID tid, ADDRINT addr) {
+    if (ITraceRecording(tid)) itraceWriters[tid]->memOp(ITR_LOAD, addr);
+    fPtrs[tid].loadPtr(tid, addr);
+}
+
+VOID PIN_FAST_ANALYSIS_CALL ITraceStoreSingle(THREADID tid, ADDRINT addr) {
+    if (ITraceRecording(tid)) itraceWriters[tid]->memOp(ITR_STORE, addr);
+    fPtrs[tid].storePtr(tid, addr);
+}
+
+VOID PIN_FAST_ANALYSIS_CALL ITraceBasicBlock(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
+    if (ITraceRecording(tid)) itraceWriters[tid]->bbl(bblAddr, bblInfo);
+    fPtrs[tid].bblPtr(tid, bblAddr, bblInfo);
+}
+
+VOID PIN_FAST_ANALYSIS_CALL ITraceRecordBranch(THREADID tid, ADDRINT branchPc, BOOL taken, ADDRINT takenNpc, ADDRINT notTakenNpc) {
+    if (ITraceRecording(tid)) itraceWriters[tid]->branch(branchPc, taken, takenNpc, notTakenNpc);
+    fPtrs[tid].branchPtr(tid, branchPc, taken, takenNpc, notTakenNpc);
+}
+
+VOID PIN_FAST_ANALYSIS_CALL ITracePredLoadSingle(THREADID tid, ADDRINT addr, BOOL pred) {
+    if (ITraceRecording(tid)) itraceWriters[tid]->memOp(ITR_PRED_LOAD, addr, pred);
+    fPtrs[tid].predLoadPtr(tid, addr, pred);
+}
+
+VOID PIN_FAST_ANALYSIS_CALL ITracePredStoreSingle(THREADID tid, ADDRINT addr, BOOL pred) {
+    if (ITraceRecording(tid)) itraceWriters[tid]->memOp(ITR_PRED_STORE, addr, pred);
+    fPtrs[tid].predStorePtr(tid, addr, pred);
+}
+
+static void ITraceThreadStart(THREADID tid) {
+    std::stringstream ss;
+    ss << zinfo->outputDir << "/itrace.p" << procIdx << ".t" << tid;
+    itraceWriters[tid] = new InstrTraceWriter(ss.str().c_str(), zinfo->oooDecode);
+}
+
+static void ITraceThreadFini(THREADID tid) {
+    delete itraceWriters[tid];
+    itraceWriters[tid] = nullptr;
+}
+
 
 //Non-simulation variants of analysis functions
 
+static InstrFuncPtrs GetCorePtrs(THREADID tid);
+
 // Join variants: Call join on the next instrumentation poin and return to analysis code
 void Join(uint32_t tid) {
     assert(fPtrs[tid].type == FPTR_JOIN);
@@ -204,7 +419,7 @@ void Join(uint32_t tid) {
         SimEnd();
     }
 
-    fPtrs[tid] = cores[tid]->GetFuncPtrs(); //back to normal pointers
+    fPtrs[tid] = GetCorePtrs(tid); //back to normal pointers
 }
 
 VOID JoinAndLoadSingle(THREADID tid, ADDRINT addr) {
@@ -243,8 +458,58 @@ VOID NOPBasicBlock(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {}
 VOID NOPRecordBranch(THREADID tid, ADDRINT addr, BOOL taken, ADDRINT takenNpc, ADDRINT notTakenNpc) {}
 VOID NOPPredLoadStoreSingle(THREADID tid, ADDRINT addr, BOOL pred) {}
 
+// Warm FF (sim.warmFF): while fast-forwarding, loads, stores and ifetches
+// functionally update the caches of a core in the process mask, chosen by tid.
+// Warming accesses (MemReq::WARM) keep tag, replacement and coherence state
+// warm, but produce no timing, events, stats or traces (see FilterCache::warm).
+static bool warmFF = false; //process-local, false if the process has no cores with caches
+static std::vector<uint32_t> warmCids;
+
+static inline uint32_t WarmCid(THREADID tid) {
+    return warmCids[tid % warmCids.size()];
+}
+
+//Sweep systems (see sweep.h) are warmed through their L1s with the same cid
+static inline void WarmSweeps(uint32_t cid, Address addr, bool isLoad, bool isFetch) {
+    for (uint32_t s = 0; s < zinfo->numSweeps; s++) {
+        FilterCache* l1 = isFetch? zinfo->sweeps[s]->l1is[cid] : zinfo->sweeps[s]->l1ds[cid];
+        if (l1) l1->warm(addr, isLoad, zinfo->globPhaseCycles);
+    }
+}
+
+VOID WarmLoadSingle(THREADID tid, ADDRINT addr) {
+    uint32_t cid = WarmCid(tid);
+    zinfo->coreL1ds[cid]->warm(addr, true, zinfo->globPhaseCycles);
+    WarmSweeps(cid, addr, true, false);
+}
+
+VOID WarmStoreSingle(THREADID tid, ADDRINT addr) {
+    uint32_t cid = WarmCid(tid);
+    zinfo->coreL1ds[cid]->warm(addr, false, zinfo->globPhaseCycles);
+    WarmSweeps(cid, addr, false, false);
+}
+
+VOID WarmPredLoadSingle(THREADID tid, ADDRINT addr, BOOL pred) {
+    if (pred) WarmLoadSingle(tid, addr);
+}
+
+VOID WarmPredStoreSingle(THREADID tid, ADDRINT addr, BOOL pred) {
+    if (pred) WarmStoreSingle(tid, addr);
+}
+
+static inline void WarmFetch(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
+    uint32_t cid = WarmCid(tid);
+    FilterCache* l1i = zinfo->coreL1is[cid];
+    Address endBblAddr = bblAddr + bblInfo->bytes;
+    for (Address fetchAddr = bblAddr; fetchAddr < endBblAddr; fetchAddr += (1 << lineBits)) {
+        l1i->warm(fetchAddr, true, zinfo->globPhaseCycles);
+        WarmSweeps(cid, fetchAddr, true, true);
+    }
+}
+
 // FF is basically NOP except for basic blocks
 VOID FFBasicBlock(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
+    if (warmFF) WarmFetch(tid, bblAddr, bblInfo);
     if (unlikely(!procTreeNode->isInFastForward())) {
         SimThreadStart(tid);
     }
@@ -278,6 +543,20 @@ static uint64_t* ffiPrevFFStartInstrs;
 
 static const InstrFuncPtrs& GetFFPtrs();
 
+/* Gets the length of FFI segment i (even segments are FF, odd ones are NFF); returns false past the last one.
+ * With sampling (sim.samplingPeriod), segments are periodic and never end.
+ */
+static bool FFIGetSegment(uint32_t i, uint64_t* instrs) {
+    if (zinfo->sampler) {
+        *instrs = (i & 1)? zinfo->sampler->getDetailedInstrs() : zinfo->sampler->getFFInstrs();
+        return true;
+    }
+    const g_vector<uint64_t>& ffiPoints = procTreeNode->getFFIPoints();
+    if (i >= ffiPoints.size()) return false;
+    *instrs = ffiPoints[i];
+    return true;
+}
+
 VOID FFITrackNFFInterval() {
     assert(!procTreeNode->isInFastForward());
     assert(ffiInstrsDone < ffiInstrsLimit); //unless you have ~10-instr FFWds, this does not happen
@@ -290,7 +569,8 @@ VOID FFITrackNFFInterval() {
     uint64_t* _ffiPrevFFStartInstrs = ffiPrevFFStartInstrs;
     auto ffiGet = [p, startInstrs]() { return zinfo->processStats->getProcessInstrs(p) - startInstrs; };
     auto ffiFire = [p, _ffiFFStartInstrs, _ffiPrevFFStartInstrs]() {
-        info("FFI: Entering fast-forward for process %d", p);
+        if (zinfo->procArray[p]->getFFIDumpStats()) DumpEventualStats(p, "end of FFI region");
+        if (!zinfo->sampler) info("FFI: Entering fast-forward for process %d", p);
         /* Note this is sufficient due to the lack of reinstruments on FF, and this way we do not need to touch global state */
         futex_lock(&zinfo->ffLock);
         assert(!zinfo->procArray[p]->isInFastForward());
@@ -299,25 +579,38 @@ VOID FFITrackNFFInterval() {
         *_ffiPrevFFStartInstrs = *_ffiFFStartInstrs;
         *_ffiFFStartInstrs = zinfo->processStats->getProcessInstrs(p);
     };
-    zinfo->eventQueue->insert(makeAdaptiveEvent(ffiGet, ffiFire, 0, ffiInstrsLimit - ffiInstrsDone, MAX_IPC*zinfo->phaseLength));
+    if (zinfo->sampler) {
+        //The sampler measures the window, and ends the simulation instead of fast-forwarding once its estimates converge
+        auto sampleFire = [ffiFire](bool converged) {
+            if (converged) zinfo->terminationConditionMet = true; //works because events run at the end of the phase
+            else ffiFire();
+        };
+        zinfo->eventQueue->insert(makeSamplingWindowEvent(zinfo->sampler, p, startInstrs, MAX_IPC*zinfo->phaseLength, sampleFire));
+    } else {
+        zinfo->eventQueue->insert(makeAdaptiveEvent(ffiGet, ffiFire, 0, ffiInstrsLimit - ffiInstrsDone, MAX_IPC*zinfo->phaseLength));
+    }
 
     ffiNFF = true;
 }
 
 // Called on process start
 VOID FFIInit() {
-    const g_vector<uint64_t>& ffiPoints = procTreeNode->getFFIPoints();
-    if (!ffiPoints.empty()) {
+    uint64_t firstSegment;
+    if (FFIGetSegment(0, &firstSegment)) {
         if (zinfo->ffReinstrument) panic("FFI and reinstrumenting on FF switches are incompatible");
         ffiEnabled = true;
         ffiPoint = 0;
         ffiInstrsDone = 0;
-        ffiInstrsLimit = ffiPoints[0];
+        ffiInstrsLimit = firstSegment;
 
         ffiFFStartInstrs = gm_calloc<uint64_t>(1);
         ffiPrevFFStartInstrs = gm_calloc<uint64_t>(1);
         ffiNFF = false;
-        info("FFI mode initialized, %ld ffiPoints", ffiPoints.size());
+        if (zinfo->sampler) {
+            info("FFI mode initialized for sampling");
+        } else {
+            info("FFI mode initialized, %ld ffiPoints", procTreeNode->getFFIPoints().size());
+        }
         if (!procTreeNode->isInFastForward()) FFITrackNFFInterval();
     } else {
         ffiEnabled = false;
@@ -326,24 +619,25 @@ VOID FFIInit() {
 
 //Set the next ffiPoint, or finish
 VOID FFIAdvance() {
-    const g_vector<uint64_t>& ffiPoints = procTreeNode->getFFIPoints();
+    uint64_t segment;
     ffiPoint++;
-    if (ffiPoint >= ffiPoints.size()) {
+    if (!FFIGetSegment(ffiPoint, &segment)) {
         info("Last ffiPoint reached, %ld instrs, limit %ld", ffiInstrsDone, ffiInstrsLimit);
         SimEnd();
     } else {
-        info("ffiPoint reached, %ld instrs, limit %ld", ffiInstrsDone, ffiInstrsLimit);
-        ffiInstrsLimit += ffiPoints[ffiPoint];
+        if (!zinfo->sampler) info("ffiPoint reached, %ld instrs, limit %ld", ffiInstrsDone, ffiInstrsLimit); //too frequent with sampling
+        ffiInstrsLimit += segment;
     }
 }
 
 VOID FFIBasicBlock(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
+    if (warmFF) WarmFetch(tid, bblAddr, bblInfo);
     ffiInstrsDone += bblInfo->instrs;
     if (unlikely(ffiInstrsDone >= ffiInstrsLimit)) {
         FFIAdvance();
         assert(procTreeNode->isInFastForward());
         futex_lock(&zinfo->ffLock);
-        info("FFI: Exiting fast-forward");
+        if (!zinfo->sampler) info("FFI: Exiting fast-forward");
         ExitFastForward();
         futex_unlock(&zinfo->ffLock);
         FFITrackNFFInterval();
@@ -371,10 +665,76 @@ static const InstrFuncPtrs ffPtrs = {NOPLoadStoreSingle, NOPLoadStoreSingle, FFB
 static const InstrFuncPtrs ffiPtrs = {NOPLoadStoreSingle, NOPLoadStoreSingle, FFIBasicBlock, NOPRecordBranch, NOPPredLoadStoreSingle, NOPPredLoadStoreSingle, FPTR_NOP};
 static const InstrFuncPtrs ffiEntryPtrs = {NOPLoadStoreSingle, NOPLoadStoreSingle, FFIEntryBasicBlock, NOPRecordBranch, NOPPredLoadStoreSingle, NOPPredLoadStoreSingle, FPTR_NOP};
 
+// Warm FF variants
+static const InstrFuncPtrs warmFFPtrs = {WarmLoadSingle, WarmStoreSingle, FFBasicBlock, NOPRecordBranch, WarmPredLoadSingle, WarmPredStoreSingle, FPTR_NOP};
+static const InstrFuncPtrs warmFFIPtrs = {WarmLoadSingle, WarmStoreSingle, FFIBasicBlock, NOPRecordBranch, WarmPredLoadSingle, WarmPredStoreSingle, FPTR_NOP};
+static const InstrFuncPtrs warmFFIEntryPtrs = {WarmLoadSingle, WarmStoreSingle, FFIEntryBasicBlock, NOPRecordBranch, WarmPredLoadSingle, WarmPredStoreSingle, FPTR_NOP};
+
 static const InstrFuncPtrs& GetFFPtrs() {
+    if (warmFF) return ffiEnabled? (ffiNFF? warmFFIEntryPtrs : warmFFIPtrs) : warmFFPtrs;
     return ffiEnabled? (ffiNFF? ffiEntryPtrs : ffiPtrs) : ffPtrs;
 }
 
+// Sweep systems (see sweep.h): with sweeps, analysis fPtrs point to these, which feed the thread's stream to the
+// primary core and the sweep cores with its cid through their sweep interface and per-thread SweepQueues. The thread
+// takes the barrier once all of them have stopped, i.e., are past the end of the phase, as BblFunc does for one core.
+static bool sweeping = false; //process-local copy of zinfo->numSweeps != 0
+static std::vector<SweepQueue> sweepQueues[MAX_THREADS]; //per thread, one per system (primary first)
+
+static inline void SweepFeed(THREADID tid, const InstrTraceRecord& rec) {
+    uint32_t cid = getCid(tid);
+    std::vector<SweepQueue>& queues = sweepQueues[tid];
+    for (uint32_t s = 0; s < queues.size(); s++) queues[s].feed(SystemCores(s)[cid], rec);
+}
+
+//A thread that leaves its core would leave the rest of its phase behind, so its cores simulate it past the phase end
+static inline void SweepFlush(THREADID tid, uint32_t cid) {
+    std::vector<SweepQueue>& queues = sweepQueues[tid];
+    for (uint32_t s = 0; s < queues.size(); s++) queues[s].flush(SystemCores(s)[cid]);
+}
+
+VOID SweepLoadSingle(THREADID tid, ADDRINT addr) {
+    SweepFeed(tid, {ITR_LOAD, true, addr, 0, 0, nullptr});
+}
+
+VOID SweepStoreSingle(THREADID tid, ADDRINT addr) {
+    SweepFeed(tid, {ITR_STORE, true, addr, 0, 0, nullptr});
+}
+
+VOID SweepBasicBlock(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
+    SweepFeed(tid, {ITR_BBL, false, bblAddr, 0, 0, bblInfo});
+
+    std::vector<SweepQueue>& queues = sweepQueues[tid];
+    uint32_t cid = getCid(tid);
+    while (true) {
+        for (SweepQueue& q : queues) if (!q.stopped()) return;
+        for (uint32_t s = 0; s < queues.size(); s++) SystemCores(s)[cid]->nextPhase();
+        //NOTE: As in BblFunc, TakeBarrier may switch us to another core. The queues are ours, so they go with us.
+        cid = TakeBarrier(tid, cid);
+        if (cid == INVALID_CID || fPtrs[tid].type != FPTR_ANALYSIS) return; //entered fast-forward or terminating
+        for (uint32_t s = 0; s < queues.size(); s++) queues[s].drain(SystemCores(s)[cid]);
+    }
+}
+
+VOID SweepRecordBranch(THREADID tid, ADDRINT branchPc, BOOL taken, ADDRINT takenNpc, ADDRINT notTakenNpc) {
+    SweepFeed(tid, {ITR_BRANCH, (bool)taken, branchPc, takenNpc, notTakenNpc, nullptr});
+}
+
+VOID SweepPredLoadSingle(THREADID tid, ADDRINT addr, BOOL pred) {
+    SweepFeed(tid, {ITR_PRED_LOAD, (bool)pred, addr, 0, 0, nullptr});
+}
+
+VOID SweepPredStoreSingle(THREADID tid, ADDRINT addr, BOOL pred) {
+    SweepFeed(tid, {ITR_PRED_STORE, (bool)pred, addr, 0, 0, nullptr});
+}
+
+static const InstrFuncPtrs sweepPtrs = {SweepLoadSingle, SweepStoreSingle, SweepBasicBlock, SweepRecordBranch, SweepPredLoadSingle, SweepPredStoreSingle, FPTR_ANALYSIS};
+
+// Analysis pointers of the thread's current core
+static InstrFuncPtrs GetCorePtrs(THREADID tid) {
+    return sweeping? sweepPtrs : cores[tid]->GetFuncPtrs();
+}
+
 //Fast-forwarding
 void EnterFastForward() {
     assert(!procTreeNode->isInFastForward());
@@ -488,6 +848,7 @@ VOID EndOfPhaseActions() {
     }
 
     CheckForTermination();
+    if (!zinfo->checkpointDone && !zinfo->terminationConditionMet) CheckpointPhaseEnd();
     zinfo->contentionSim->simulatePhase(zinfo->globPhaseCycles + zinfo->phaseLength);
     zinfo->eventQueue->tick();
     zinfo->profSimTime->transition(PROF_BOUND);
@@ -512,7 +873,7 @@ uint32_t TakeBarrier(uint32_t tid, uint32_t cid) {
         SimEnd(); //need to call this on a per-process basis...
     } else {
         // Set fPtrs to those of the new core after possible context switch
-        fPtrs[tid] = cores[tid]->GetFuncPtrs();
+        fPtrs[tid] = GetCorePtrs(tid);
     }
 
     return newCid;
@@ -528,44 +889,67 @@ static void PrintIp(THREADID tid, ADDRINT ip) {
 }
 #endif
 
-VOID Instruction(INS ins) {
+// Inserts buffered (if bufferMemOps) or unbuffered instrumentation for one memory operand
+static void InstrumentMemOp(INS ins, IARG_TYPE eaArg, bool isLoad, bool bufferMemOps) {
+    if (bufferMemOps) {
+        if (!INS_IsPredicated(ins)) {
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR) BufferMemOp, IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID, eaArg,
+                    IARG_UINT32, isLoad? MB_LOAD : MB_STORE, IARG_END);
+        } else {
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR) BufferPredMemOp, IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID, eaArg,
+                    IARG_UINT32, isLoad? MB_PRED_LOAD : MB_PRED_STORE, IARG_EXECUTING, IARG_END);
+        }
+    } else if (itraceRecord) {
+        if (!INS_IsPredicated(ins)) {
+            INS_InsertCall(ins, IPOINT_BEFORE, isLoad? (AFUNPTR) ITraceLoadSingle : (AFUNPTR) ITraceStoreSingle,
+                    IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID, eaArg, IARG_END);
+        } else {
+            INS_InsertCall(ins, IPOINT_BEFORE, isLoad? (AFUNPTR) ITracePredLoadSingle : (AFUNPTR) ITracePredStoreSingle,
+                    IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID, eaArg, IARG_EXECUTING, IARG_END);
+        }
+    } else {
+        if (!INS_IsPredicated(ins)) {
+            INS_InsertCall(ins, IPOINT_BEFORE, isLoad? (AFUNPTR) IndirectLoadSingle : (AFUNPTR) IndirectStoreSingle,
+                    IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID, eaArg, IARG_END);
+        } else {
+            INS_InsertCall(ins, IPOINT_BEFORE, isLoad? (AFUNPTR) IndirectPredLoadSingle : (AFUNPTR) IndirectPredStoreSingle,
+                    IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID, eaArg, IARG_EXECUTING, IARG_END);
+        }
+    }
+}
+
+// Number of memory access analysis calls per execution of the BBL (ignoring REPs)
+static uint32_t CountMemOps(BBL bbl) {
+    uint32_t memOps = 0;
+    for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins)) {
+        memOps += (INS_IsMemoryRead(ins)? 1 : 0) + (INS_HasMemoryRead2(ins)? 1 : 0) + (INS_IsMemoryWrite(ins)? 1 : 0);
+    }
+    return memOps;
+}
+
+/* If bufferedBbl is set, the BBL is instrumented with BufferedBasicBlock, which drains the memory access buffer;
+ * bufferMemOps tells whether memory accesses should go to the buffer (the BBL may have too many of them).
+ */
+VOID Instruction(INS ins, bool bufferedBbl, bool bufferMemOps) {
     //Uncomment to print an instruction trace
     //INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)PrintIp, IARG_THREAD_ID, IARG_REG_VALUE, REG_INST_PTR, IARG_END);
 
     if (!procTreeNode->isInFastForward() || !zinfo->ffReinstrument) {
-        AFUNPTR LoadFuncPtr = (AFUNPTR) IndirectLoadSingle;
-        AFUNPTR StoreFuncPtr = (AFUNPTR) IndirectStoreSingle;
-
-        AFUNPTR PredLoadFuncPtr = (AFUNPTR) IndirectPredLoadSingle;
-        AFUNPTR PredStoreFuncPtr = (AFUNPTR) IndirectPredStoreSingle;
-
-        if (INS_IsMemoryRead(ins)) {
-            if (!INS_IsPredicated(ins)) {
-                INS_InsertCall(ins, IPOINT_BEFORE, LoadFuncPtr, IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID, IARG_MEMORYREAD_EA, IARG_END);
-            } else {
-                INS_InsertCall(ins, IPOINT_BEFORE, PredLoadFuncPtr, IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID, IARG_MEMORYREAD_EA, IARG_EXECUTING, IARG_END);
-            }
+        bool isMemOp = INS_IsMemoryRead(ins) || INS_IsMemoryWrite(ins);
+        if (bufferMemOps && isMemOp && INS_HasRealRep(ins)) {
+            //Runs once per iteration, so it can't go in the buffer; drain what precedes it
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR) DrainMemBufCall, IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID, IARG_END);
+            bufferMemOps = false;
         }
 
-        if (INS_HasMemoryRead2(ins)) {
-            if (!INS_IsPredicated(ins)) {
-                INS_InsertCall(ins, IPOINT_BEFORE, LoadFuncPtr, IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID, IARG_MEMORYREAD2_EA, IARG_END);
-            } else {
-                INS_InsertCall(ins, IPOINT_BEFORE, PredLoadFuncPtr, IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID, IARG_MEMORYREAD2_EA, IARG_EXECUTING, IARG_END);
-            }
-        }
-
-        if (INS_IsMemoryWrite(ins)) {
-            if (!INS_IsPredicated(ins)) {
-                INS_InsertCall(ins, IPOINT_BEFORE,  StoreFuncPtr, IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID, IARG_MEMORYWRITE_EA, IARG_END);
-            } else {
-                INS_InsertCall(ins, IPOINT_BEFORE,  PredStoreFuncPtr, IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID, IARG_MEMORYWRITE_EA, IARG_EXECUTING, IARG_END);
-            }
-        }
+        if (INS_IsMemoryRead(ins)) InstrumentMemOp(ins, IARG_MEMORYREAD_EA, true, bufferMemOps);
+        if (INS_HasMemoryRead2(ins)) InstrumentMemOp(ins, IARG_MEMORYREAD2_EA, true, bufferMemOps);
+        if (INS_IsMemoryWrite(ins)) InstrumentMemOp(ins, IARG_MEMORYWRITE_EA, false, bufferMemOps);
 
         // Instrument only conditional branches
         if (INS_Category(ins) == XED_CATEGORY_COND_BR) {
-            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR) IndirectRecordBranch, IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID,
+            AFUNPTR branchFuncPtr = bufferedBbl? (AFUNPTR) BufferedRecordBranch : itraceRecord? (AFUNPTR) ITraceRecordBranch : (AFUNPTR) IndirectRecordBranch;
+            INS_InsertCall(ins, IPOINT_BEFORE, branchFuncPtr, IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID,
                     IARG_INST_PTR, IARG_BRANCH_TAKEN, IARG_BRANCH_TARGET_ADDR, IARG_FALLTHROUGH_ADDR, IARG_END);
         }
     }
@@ -596,22 +980,35 @@ VOID Instruction(INS ins) {
 }
 
 
+// Time spent in Trace(), reported with BBL cache stats. Pin serializes instrumentation, so no need to sync.
+static uint64_t traceInstrNs = 0;
+
 VOID Trace(TRACE trace, VOID *v) {
+    uint64_t startNs = getNs();
+    bool buffered = zinfo->bufferedMemInstr;
     if (!procTreeNode->isInFastForward() || !zinfo->ffReinstrument) {
         // Visit every basic block in the trace
+        AFUNPTR bblFuncPtr = buffered? (AFUNPTR) BufferedBasicBlock : itraceRecord? (AFUNPTR) ITraceBasicBlock : (AFUNPTR) IndirectBasicBlock;
         for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl)) {
             BblInfo* bblInfo = Decoder::decodeBbl(bbl, zinfo->oooDecode);
-            BBL_InsertCall(bbl, IPOINT_BEFORE /*could do IPOINT_ANYWHERE if we redid load and store simulation in OOO*/, (AFUNPTR)IndirectBasicBlock, IARG_FAST_ANALYSIS_CALL,
-                 IARG_THREAD_ID, IARG_ADDRINT, BBL_Address(bbl), IARG_PTR, bblInfo, IARG_END);
+            if (bbvInterval) {
+                BBL_InsertCall(bbl, IPOINT_BEFORE, (AFUNPTR) BbvBasicBlock, IARG_FAST_ANALYSIS_CALL,
+                     IARG_THREAD_ID, IARG_ADDRINT, BBL_Address(bbl), IARG_PTR, bblInfo, IARG_UINT32, BbvGetId(BBL_Address(bbl)), IARG_END);
+            } else {
+                BBL_InsertCall(bbl, IPOINT_BEFORE /*could do IPOINT_ANYWHERE if we redid load and store simulation in OOO*/, bblFuncPtr, IARG_FAST_ANALYSIS_CALL,
+                     IARG_THREAD_ID, IARG_ADDRINT, BBL_Address(bbl), IARG_PTR, bblInfo, IARG_END);
+            }
         }
     }
 
     //Instruction instrumentation now here to ensure proper ordering
     for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl)) {
+        bool bufferMemOps = buffered && CountMemOps(bbl) <= MEMBUF_ENTRIES;
         for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins)) {
-            Instruction(ins);
+            Instruction(ins, buffered, bufferMemOps);
         }
     }
+    traceInstrNs += getNs() - startNs;
 }
 
 /***** vDSO instrumentation and patching code *****/
@@ -854,6 +1251,9 @@ VOID ThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v) {
         info("Unpaused");
     }
 
+    if (bbvInterval) BbvThreadStart(tid);
+    if (itraceRecord) ITraceThreadStart(tid);
+
     if (procTreeNode->isInFastForward()) {
         info("FF thread %d starting", tid);
         fPtrs[tid] = GetFFPtrs();
@@ -869,11 +1269,15 @@ VOID ThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v) {
 VOID SimThreadFini(THREADID tid) {
     // zinfo->sched->leave(); //exit syscall (SyscallEnter) already leaves
     zinfo->sched->finish(procIdx, tid);
+    for (SweepQueue& q : sweepQueues[tid]) q.clear(); //only left over on fast-forward or blocking syscalls
     activeThreads[tid] = false;
     cids[tid] = UNINITIALIZED_CID; //clear this cid, it might get reused
 }
 
 VOID ThreadFini(THREADID tid, const CONTEXT *ctxt, INT32 flags, VOID *v) {
+    DrainMemBuf(tid);
+    if (bbvInterval) BbvThreadFini(tid);
+    if (itraceRecord) ITraceThreadFini(tid);
     //NOTE: Thread has no valid cid here!
     if (fPtrs[tid].type == FPTR_NOP) {
         info("Shadow/NOP thread %d finished", tid);
@@ -886,6 +1290,7 @@ VOID ThreadFini(THREADID tid, const CONTEXT *ctxt, INT32 flags, VOID *v) {
 
 //Need to remove ourselves from running threads in case the syscall is blocking
 VOID SyscallEnter(THREADID tid, CONTEXT *ctxt, SYSCALL_STANDARD std, VOID *v) {
+    DrainMemBuf(tid); //deliver accesses before the syscall (and leave) to the core
     bool isNopThread = fPtrs[tid].type == FPTR_NOP;
     bool isRetryThread = fPtrs[tid].type == FPTR_RETRY;
 
@@ -904,6 +1309,7 @@ VOID SyscallEnter(THREADID tid, CONTEXT *ctxt, SYSCALL_STANDARD std, VOID *v) {
      */
     if (fPtrs[tid].type != FPTR_JOIN && !zinfo->blockingSyscalls) {
         uint32_t cid = getCid(tid);
+        if (sweeping) SweepFlush(tid, cid);
         // set an invalid cid, ours is property of the scheduler now!
         clearCid(tid);
 
@@ -924,7 +1330,7 @@ VOID SyscallExit(THREADID tid, CONTEXT *ctxt, SYSCALL_STANDARD std, VOID *v) {
         if (!zinfo->blockingSyscalls) {
             fPtrs[tid] = joinPtrs;
         } else {
-            fPtrs[tid] = cores[tid]->GetFuncPtrs(); //go back to normal pointers, directly
+            fPtrs[tid] = GetCorePtrs(tid); //go back to normal pointers, directly
         }
     } else if (ppa == PPA_USE_RETRY_PTRS) {
         fPtrs[tid] = retryPtrs;
@@ -976,6 +1382,7 @@ VOID ContextChange(THREADID tid, CONTEXT_CHANGE_REASON reason, const CONTEXT* fr
     }
 
     warn("[%d] ContextChange, reason %s, inSyscall %d", tid, reasonStr, inSyscall[tid]);
+    DrainMemBuf(tid);
     if (inSyscall[tid]) {
         SyscallExit(tid, to, SYSCALL_STANDARD_IA32E_LINUX, nullptr);
     }
@@ -1062,6 +1469,7 @@ VOID AfterForkInChild(THREADID tid, const CONTEXT* ctxt, VOID * arg) {
     for (uint32_t i = 0; i < MAX_THREADS; i++) {
         fPtrs[i] = joinPtrs;
         cids[i] = UNINITIALIZED_CID;
+        memBufs[i].cur = memBufs[i].entries;
         activeThreads[i] = false;
         inSyscall[i] = false;
         cores[i] = nullptr;
@@ -1094,6 +1502,11 @@ VOID SimEnd() {
     //at this point, we're in charge of exiting our whole process, but we still need to race for the stats
 
     //per-process
+    Decoder::flushBblCache(traceInstrNs);
+    //other threads may still be running, so just flush their BBV files
+    if (bbvInterval) for (uint32_t tid = 0; tid < MAX_THREADS; tid++) if (bbvStates[tid]) fflush(bbvStates[tid]->file);
+    if (itraceRecord) for (uint32_t tid = 0; tid < MAX_THREADS; tid++) if (itraceWriters[tid]) itraceWriters[tid]->flush();
+
 #ifdef BBL_PROFILING
     Decoder::dumpBblProfile();
 #endif
@@ -1133,8 +1546,10 @@ VOID SimEnd() {
 #define ZSIM_MAGIC_OP_ROI_END           (1026)
 #define ZSIM_MAGIC_OP_REGISTER_THREAD   (1027)
 #define ZSIM_MAGIC_OP_HEARTBEAT         (1028)
+#define ZSIM_MAGIC_OP_CHECKPOINT        (1034)
 
 VOID HandleMagicOp(THREADID tid, ADDRINT op) {
+    DrainMemBuf(tid);
     switch (op) {
         case ZSIM_MAGIC_OP_ROI_BEGIN:
             if (!zinfo->ignoreHooks) {
@@ -1191,6 +1606,13 @@ VOID HandleMagicOp(THREADID tid, ADDRINT op) {
             procTreeNode->heartbeat(); //heartbeats are per process for now
             return;
 
+        case ZSIM_MAGIC_OP_CHECKPOINT:
+            if (zinfo->checkpointTrigger == CKPT_MAGIC) {
+                info("Thread %d: CHECKPOINT magic op, checkpointing at the end of this phase", tid);
+                zinfo->checkpointRequested = true;
+            }
+            return;
+
         // HACK: Ubik magic ops
         case 1029:
         case 1030:
@@ -1263,6 +1685,7 @@ VOID FakeCPUIDPost(THREADID tid, ADDRINT* eax, ADDRINT* ebx, ADDRINT* ecx, ADDRI
 
 //RDTSC faking
 VOID FakeRDTSCPost(THREADID tid, REG* eax, REG* edx) {
+    DrainMemBuf(tid); //core cycles must include preceding accesses
     if (fPtrs[tid].type == FPTR_NOP) return; //avoid virtualizing NOP threads.
 
     uint32_t cid = getCid(tid);
@@ -1425,8 +1848,60 @@ static EXCEPT_HANDLING_RESULT InternalExceptionHandler(THREADID tid, EXCEPTION_I
     return EHR_CONTINUE_SEARCH; //we never solve anything at all :P
 }
 
+/* Replays an instruction trace (processN.instrTrace) as thread 0, without running the process. Records go
+ * through fPtrs, as instrumentation calls would, so the thread joins, takes phase barriers and leaves the
+ * scheduler like a live one. Never returns.
+ */
+static VOID ReplayInstrTrace(const char* file) {
+    info("Replaying instruction trace %s", file);
+    InstrTraceReader tr(file, zinfo->oooDecode);
+    const THREADID tid = 0;
+    SimThreadStart(tid);
+
+    InstrTraceRecord rec;
+    uint64_t records = 0;
+    while (tr.next(rec)) {
+        switch (rec.type) {
+            case ITR_BBL:
+                fPtrs[tid].bblPtr(tid, rec.addr, rec.bblInfo);
+                break;
+            case ITR_LOAD:
+                fPtrs[tid].loadPtr(tid, rec.addr);
+                break;
+            case ITR_STORE:
+                fPtrs[tid].storePtr(tid, rec.addr);
+                break;
+            case ITR_PRED_LOAD:
+                fPtrs[tid].predLoadPtr(tid, rec.addr, rec.flag);
+                break;
+            case ITR_PRED_STORE:
+                fPtrs[tid].predStorePtr(tid, rec.addr, rec.flag);
+                break;
+            case ITR_BRANCH:
+                fPtrs[tid].branchPtr(tid, rec.addr, rec.flag, rec.takenNpc, rec.notTakenNpc);
+                break;
+        }
+        records++;
+    }
+    info("Finished replaying %ld records", records);
+
+    //Leave as an exiting thread does (the exit syscall leaves, then the thread finishes)
+    if (fPtrs[tid].type != FPTR_JOIN) {
+        uint32_t cid = getCid(tid);
+        clearCid(tid);
+        zinfo->sched->leave(procIdx, tid, cid);
+    }
+    SimThreadFini(tid);
+    SimEnd();
+}
+
 /* ===================================================================== */
 
+// Runs the trace driver's decode thread (see access_tracing.h); Pin tools must use Pin's internal threads
+static void SpawnTraceThread(void (*fn)(void*), void* arg) {
+    PIN_SpawnInternalThread(fn, arg, 1024*1024, nullptr);
+}
+
 int main(int argc, char *argv[]) {
     PIN_InitSymbols();
     if (PIN_Init(argc, argv)) return Usage();
@@ -1459,7 +1934,7 @@ int main(int argc, char *argv[]) {
     bool masterProcess = false;
     if (procIdx == 0 && !gm_isready()) {  // process 0 can exec() without fork()ing first, so we must check gm_isready() to ensure we don't initialize twice
         masterProcess = true;
-        SimInit(KnobConfigFile.Value().c_str(), KnobOutputDir.Value().c_str(), KnobShmid.Value());
+        SimInit(KnobConfigFile.Value().c_str(), KnobOutputDir.Value().c_str(), KnobShmid.Value(), SpawnTraceThread);
     } else {
         while (!gm_isready()) usleep(1000);  // wait till proc idx 0 initializes everything
         zinfo = static_cast<GlobSimInfo*>(gm_get_glob_ptr());
@@ -1503,10 +1978,22 @@ int main(int argc, char *argv[]) {
     lineBits = ilog2(zinfo->lineSize);
     procMask = ((uint64_t)procIdx) << (64-lineBits);
 
+    const g_string& instrTrace = procTreeNode->getInstrTrace();
+    if (!instrTrace.empty()) {
+        //Replayed threads of the same recorded process form a group, and use the address space of its first process
+        for (uint32_t p = 0; p < (uint32_t)procIdx; p++) {
+            if (zinfo->procArray[p]->getGroupIdx() == procTreeNode->getGroupIdx()) {
+                procMask = ((uint64_t)p) << (64-lineBits);
+                break;
+            }
+        }
+    }
+
     //Initialize process-local per-thread state, even if ThreadStart does so later
     for (uint32_t i = 0; i < MAX_THREADS; i++) {
         fPtrs[i] = joinPtrs;
         cids[i] = UNINITIALIZED_CID;
+        memBufs[i].cur = memBufs[i].entries;
     }
 
     info("Started process, PID %d", getpid()); //NOTE: external scripts expect this line, please do not change without checking first
@@ -1523,11 +2010,42 @@ int main(int argc, char *argv[]) {
 
     if (zinfo->sched) zinfo->sched->processCleanup(procIdx);
 
+    if (zinfo->warmFF) {
+        const g_vector<bool>& mask = procTreeNode->getMask();
+        for (uint32_t i = 0; i < zinfo->numCores; i++) {
+            if (mask[i] && zinfo->coreL1ds[i]) warmCids.push_back(i);
+        }
+        warmFF = !warmCids.empty();
+        if (!warmFF) warn("sim.warmFF: process has no cores with caches in its mask, will not warm caches");
+    }
+
+    bbvInterval = procTreeNode->getBbvInterval();
+    if (bbvInterval) {
+        if (zinfo->ffReinstrument) panic("BBV profiling and reinstrumenting on FF switches are incompatible");
+        info("BBV profiling enabled, %ld-instruction intervals", bbvInterval);
+    }
+
+    itraceRecord = procTreeNode->getRecordInstrTrace();
+    if (itraceRecord) {
+        if (zinfo->bufferedMemInstr) panic("Instruction trace recording needs unbuffered instrumentation (sim.bufferedMemInstr must be false)");
+        if (bbvInterval) panic("Instruction trace recording and BBV profiling are mutually exclusive");
+        if (zinfo->ffReinstrument) panic("Instruction trace recording and reinstrumenting on FF switches are incompatible");
+        info("Recording instruction traces");
+    }
+
+    sweeping = zinfo->numSweeps > 0;
+    if (sweeping) {
+        for (uint32_t tid = 0; tid < MAX_THREADS; tid++) sweepQueues[tid].resize(1 + zinfo->numSweeps);
+        info("Feeding %d sweep systems", zinfo->numSweeps);
+    }
+
     VirtCaptureClocks(false);
     FFIInit();
 
     VirtInit();
 
+    if (zinfo->bblCacheFile && zinfo->oooDecode) Decoder::initBblCache(zinfo->bblCacheFile);
+
     //Register instrumentation
     TRACE_AddInstrumentFunction(Trace, 0);
     VdsoInit(); //initialized vDSO patching information (e.g., where all the possible vDSO entry points are)
@@ -1562,6 +2080,9 @@ int main(int argc, char *argv[]) {
         }
         info("Finished trace-driven simulation");
         SimEnd();
+    } else if (!instrTrace.empty()) {
+        // Never returns; the process's own command does not run
+        ReplayInstrTrace(instrTrace.c_str());
     } else {
         // Never returns
         PIN_StartProgram();
@@ -48,6 +48,12 @@ class PortVirtualizer;
 class VectorCounter;
 class AccessTraceWriter;
 class TraceDriver;
+class NextUseTable;
+class SharedBblTable;
+class FilterCache;
+class BaseCache;
+class Sampler;
+class SweepSystem;
 template <typename T> class g_vector;
 
 struct ClockDomainInfo {
@@ -88,7 +94,7 @@ struct GlobSimInfo {
     //Contention simulation
     uint32_t numDomains;
     ContentionSim* contentionSim;
-    EventRecorder** eventRecorders; //CID->EventRecorder* array
+    EventRecorder** eventRecorders; //source id->EventRecorder* array; ids < numCores are the primary cores, then numCores per sweep system (see sweep.h); has twice as many entries, and the upper half are warming accesses, always nullptr
 
     PAD();
 
@@ -108,6 +114,8 @@ struct GlobSimInfo {
     bool blockingSyscalls;
     bool perProcessCpuEnum; //if true, cpus are enumerated according to per-process masks (e.g., a 16-core mask in a 64-core sim sees 16 cores)
     bool oooDecode; //if true, Decoder does OOO (instr->uop) decoding
+    const char* bblCacheFile; //persistent decoded-BBL cache, nullptr if disabled
+    SharedBblTable* bblTable; //decoded BBLs shared across processes, nullptr if disabled
 
     PAD();
 
@@ -168,6 +176,14 @@ struct GlobSimInfo {
     struct LibInfo libzsimAddrs;
 
     bool ffReinstrument; //true if we should reinstrument on ffwd, works fine with ST apps and it's faster since we run with basically no instrumentation, but it's not precise with MT apps
+    bool bufferedMemInstr; //if true, memory accesses are buffered per thread and delivered to the core at the next BBL (see zsim.cpp)
+    bool warmFF; //if true, memory accesses and ifetches update the caches functionally during fast-forwarding
+    FilterCache** coreL1is; //CID->l1i, nullptr for Null cores (used by warm FF)
+    FilterCache** coreL1ds; //CID->l1d
+
+    //Sweep systems (see sweep.h), fed the same instruction stream as the primary system
+    uint32_t numSweeps;
+    SweepSystem** sweeps;
 
     //fftoggle stuff
     lock_t ffToggleLocks[256]; //f*ing Pin and its f*ing inability to handle external signals...
@@ -178,9 +194,22 @@ struct GlobSimInfo {
     // Trace writers (stored globally because they need to be deleted when the simulation ends)
     g_vector<AccessTraceWriter*>* traceWriters;
 
+    // Checkpoints of warmed state (see checkpoint.h)
+    g_vector<BaseCache*>* caches; //all cache banks, saved/restored in checkpoints
+    const char* checkpointSaveFile; //nullptr if not saving
+    const char* checkpointRestoreFile; //nullptr if not restoring
+    uint32_t checkpointTrigger; //a CheckpointTrigger
+    uint64_t checkpointInstrs; //for CKPT_INSTRS
+    bool checkpointExit; //if true, terminate after saving the checkpoint
+    volatile bool checkpointRequested; //set by the CHECKPOINT magic op
+    bool checkpointDone;
+
+    Sampler* sampler; //systematic sampling (see sampling.h), nullptr if disabled
+
     // Trace-driven simulation (no cores)
     bool traceDriven;
     TraceDriver* traceDriver;
+    NextUseTable* nextUseTable; //future knowledge for OPT replacement, nullptr if unused
 };
 
 